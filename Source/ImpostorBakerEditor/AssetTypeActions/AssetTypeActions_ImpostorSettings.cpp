@@ -1,6 +1,14 @@
 ﻿#include "AssetTypeActions_ImpostorSettings.h"
 #include <AssetRegistry/AssetRegistryModule.h>
+#include <Engine/StaticMesh.h>
+#include <Misc/MessageDialog.h>
+#include <Misc/ScopedSlowTask.h>
 #include "EditorToolkit/ImpostorBakerEditorToolkit.h"
+#include "Managers/ImpostorBakerManager.h"
+#include "Managers/ImpostorProceduralMeshManager.h"
+#include "Settings/ImpostorBakerSettings.h"
+#include "Utilities/ImpostorDeduplicator.h"
+#include "Utilities/ImpostorSharedAtlas.h"
 
 void FAssetTypeActions_ImpostorSettings::OpenAssetEditor(const TArray<UObject*>& InObjects, TSharedPtr<IToolkitHost> EditWithinLevelEditor)
 {
@@ -29,6 +37,38 @@ TSharedRef<FExtender> FAssetTypeActions_ImpostorSettings::OnExtendContentBrowser
 {
 	TSharedRef<FExtender> Extender = MakeShared<FExtender>();
 
+	if (Assets.Num() > 1 &&
+		!Assets.ContainsByPredicate([](const FAssetData& Asset) { return !Asset.GetClass()->IsChildOf<UImpostorData>(); }))
+	{
+		Extender->AddMenuExtension(
+			"GetAssetActions",
+			EExtensionHook::After,
+			nullptr,
+			FMenuExtensionDelegate::CreateLambda([Assets](FMenuBuilder& MenuBuilder)
+			{
+				MenuBuilder.AddMenuEntry(
+					INVTEXT("Create Shared Impostor Atlas"),
+					INVTEXT("Packs saved textures of selected impostors into one atlas with one material instance. Components have to pass impostor parameters as custom primitive data."),
+					FSlateIcon(FAppStyle::GetAppStyleSetName(), "LevelEditor.Tabs.ComposureCompositing"),
+					FUIAction(FExecuteAction::CreateStatic(&FAssetTypeActions_ImpostorSettings::CreateSharedAtlas, Assets)));
+
+				MenuBuilder.AddMenuEntry(
+					INVTEXT("Find Duplicate Impostors"),
+					INVTEXT("Compares saved textures of selected impostors by content and perceptual hashes. Identical or near identical impostors can share one texture set and material."),
+					FSlateIcon(FAppStyle::GetAppStyleSetName(), "Icons.Search"),
+					FUIAction(FExecuteAction::CreateStatic(&FAssetTypeActions_ImpostorSettings::DeduplicateImpostors, Assets)));
+
+				MenuBuilder.AddMenuEntry(
+					INVTEXT("Add Saved Impostors as LODs"),
+					INVTEXT("Adds saved impostor meshes of selected impostors as Target LOD of their referenced meshes. All referenced meshes are built at once."),
+					FSlateIcon(FAppStyle::GetAppStyleSetName(), "ClassIcon.StaticMesh"),
+					FUIAction(FExecuteAction::CreateStatic(&FAssetTypeActions_ImpostorSettings::AddSavedLODs, Assets)));
+			})
+		);
+
+		return Extender;
+	}
+
 	if (Assets.Num() != 1)
 	{
 		return Extender;
@@ -82,4 +122,138 @@ void FAssetTypeActions_ImpostorSettings::OpenImpostorBaking(FAssetData Asset)
 	GEditor->SyncBrowserToObjects(ObjectsToSync);
 
 	GEditor->GetEditorSubsystem<UAssetEditorSubsystem>()->OpenEditorForAsset(NewImpostorData);
+}
+
+void FAssetTypeActions_ImpostorSettings::CreateSharedAtlas(TArray<FAssetData> Assets)
+{
+	FScopedSlowTask SlowTask(0.f, INVTEXT("Creating shared impostor atlas..."));
+	SlowTask.MakeDialog();
+
+	TArray<UImpostorData*> ImpostorDatas;
+	for (const FAssetData& Asset : Assets)
+	{
+		if (UImpostorData* ImpostorData = Cast<UImpostorData>(Asset.GetAsset()))
+		{
+			ImpostorDatas.Add(ImpostorData);
+		}
+	}
+
+	// Shared assets are named after the first impostor
+	FString AssetName = ImpostorDatas.Num() > 0 ? ImpostorDatas[0]->GetName() : FString();
+	AssetName.RemoveFromStart("ID_");
+	AssetName += "_SharedAtlas";
+
+	FString Error;
+	if (!FImpostorSharedAtlas::Create(ImpostorDatas, AssetName, Error))
+	{
+		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(Error));
+	}
+}
+
+void FAssetTypeActions_ImpostorSettings::DeduplicateImpostors(TArray<FAssetData> Assets)
+{
+	TArray<FImpostorDuplicateGroup> Groups;
+	{
+		FScopedSlowTask SlowTask(0.f, INVTEXT("Hashing impostor textures..."));
+		SlowTask.MakeDialog();
+
+		TArray<UImpostorData*> ImpostorDatas;
+		for (const FAssetData& Asset : Assets)
+		{
+			if (UImpostorData* ImpostorData = Cast<UImpostorData>(Asset.GetAsset()))
+			{
+				ImpostorDatas.Add(ImpostorData);
+			}
+		}
+
+		Groups = FImpostorDeduplicator::FindDuplicates(ImpostorDatas);
+	}
+
+	if (Groups.Num() == 0)
+	{
+		FMessageDialog::Open(EAppMsgType::Ok, INVTEXT("No duplicate impostors were found."));
+		return;
+	}
+
+	// Near identical groups are only reported, unless enabled in project settings
+	const bool bConsolidateNear = GetDefault<UImpostorBakerSettings>()->bConsolidateNearDuplicates;
+
+	int64 Bytes = 0;
+	FString Report;
+	TArray<const FImpostorDuplicateGroup*> GroupsToConsolidate;
+	for (const FImpostorDuplicateGroup& Group : Groups)
+	{
+		const bool bConsolidate = Group.bExact || bConsolidateNear;
+		if (bConsolidate)
+		{
+			Bytes += FImpostorDeduplicator::GetDuplicateBytes(Group);
+			GroupsToConsolidate.Add(&Group);
+		}
+
+		Report += FString::Printf(TEXT("%s (%s%s): %s\n"),
+			*Group.Source->GetName(),
+			Group.bExact ? TEXT("identical") : TEXT("near identical"),
+			bConsolidate ? TEXT("") : TEXT(", report only"),
+			*FString::JoinBy(Group.Duplicates, TEXT(", "), [](const UImpostorData* Duplicate) { return Duplicate->GetName(); }));
+	}
+
+	UE_LOG(LogImpostorBaker, Log, TEXT("Duplicate impostors:\n%s"), *Report);
+
+	if (GroupsToConsolidate.Num() == 0)
+	{
+		Report += "\nOnly near identical impostors were found. Check them manually, or enable Consolidate Near Duplicates in project settings.";
+		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(Report));
+		return;
+	}
+
+	Report += FString::Printf(TEXT("\nConsolidating duplicates saves %.2f MB of texture memory. Their textures (and materials with the same parameters) will be DELETED and references replaced, this can't be undone. Continue?"), Bytes / (1024.0 * 1024.0));
+
+	if (FMessageDialog::Open(EAppMsgType::YesNo, EAppReturnType::No, FText::FromString(Report)) != EAppReturnType::Yes)
+	{
+		return;
+	}
+
+	for (const FImpostorDuplicateGroup* Group : GroupsToConsolidate)
+	{
+		FImpostorDeduplicator::Consolidate(*Group);
+	}
+}
+
+void FAssetTypeActions_ImpostorSettings::AddSavedLODs(TArray<FAssetData> Assets)
+{
+	TArray<FImpostorLODDescription> Descriptions;
+	FString Skipped;
+	for (const FAssetData& Asset : Assets)
+	{
+		const UImpostorData* ImpostorData = Cast<UImpostorData>(Asset.GetAsset());
+		if (!ImpostorData)
+		{
+			continue;
+		}
+
+		UStaticMesh* SavedMesh = ImpostorData->LoadSavedMesh();
+		if (!ImpostorData->ReferencedMesh ||
+			!SavedMesh)
+		{
+			Skipped += ImpostorData->GetName() + "\n";
+			continue;
+		}
+
+		// Impostor mesh is destroyed once it's set as LOD, so saved one is kept intact
+		FImpostorLODDescription Description;
+		Description.Mesh = ImpostorData->ReferencedMesh;
+		Description.ImpostorMesh = DuplicateObject<UStaticMesh>(SavedMesh, ImpostorData->ReferencedMesh, MakeUniqueObjectName(ImpostorData->ReferencedMesh, UStaticMesh::StaticClass(), *ImpostorData->NewMeshName));
+		Description.Material = ImpostorData->LoadSavedMaterial();
+		Description.ShadowMaterial = ImpostorData->LoadSavedShadowMaterial();
+		Description.LODIndex = ImpostorData->TargetLOD;
+		Description.bCastShadow = ImpostorData->bMeshCastShadow;
+		Descriptions.Add(Description);
+	}
+
+	if (!Skipped.IsEmpty())
+	{
+		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Impostors without referenced mesh or saved impostor mesh are skipped:\n" + Skipped));
+	}
+
+	UImpostorBakerManager::AddLODs(Descriptions);
 }
\ No newline at end of file
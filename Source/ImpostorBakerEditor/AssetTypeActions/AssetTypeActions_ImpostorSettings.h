@@ -22,4 +22,7 @@ public:
 
 private:
 	static void OpenImpostorBaking(FAssetData Asset);
+	static void CreateSharedAtlas(TArray<FAssetData> Assets);
+	static void DeduplicateImpostors(TArray<FAssetData> Assets);
+	static void AddSavedLODs(TArray<FAssetData> Assets);
 };
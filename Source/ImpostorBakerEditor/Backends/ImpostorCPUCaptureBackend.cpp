@@ -0,0 +1,180 @@
+﻿#include "ImpostorCPUCaptureBackend.h"
+#include <Async/ParallelFor.h>
+#include <Engine/TextureRenderTarget2D.h>
+#include <Misc/App.h>
+#include "Managers/ImpostorComponentsManager.h"
+#include "Managers/ImpostorRenderTargetsManager.h"
+#include "Utilities/ImpostorSymmetry.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorCPUCaptureBackend)
+
+void UImpostorCPUCaptureBackend::Initialize(UImpostorRenderTargetsManager* InManager)
+{
+	Manager = InManager;
+}
+
+FString UImpostorCPUCaptureBackend::GetBackendName() const
+{
+	return "CPU Rasterizer";
+}
+
+bool UImpostorCPUCaptureBackend::SupportsMap(const EImpostorBakeMapType TargetMap) const
+{
+	if (Geometry.IsEmpty())
+	{
+		return false;
+	}
+
+	return
+		TargetMap == EImpostorBakeMapType::Depth ||
+		TargetMap == EImpostorBakeMapType::Normal ||
+		TargetMap == EImpostorBakeMapType::Opacity;
+}
+
+void UImpostorCPUCaptureBackend::BeginBake()
+{
+	Frames.Empty();
+	Atlases.Empty();
+
+	Geometry = FImpostorMeshGeometry::Gather(Manager->ImpostorData->ReferencedMesh);
+}
+
+void UImpostorCPUCaptureBackend::PrepareMap(const EImpostorBakeMapType TargetMap)
+{
+	CurrentMap = TargetMap;
+
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+	const int32 NumFrames = ComponentsManager->ViewCaptureVectors.Num();
+
+	if (Frames.Num() != NumFrames)
+	{
+		TArray<FImpostorViewProjection> Views;
+		Views.Reserve(NumFrames);
+		for (int32 Index = 0; Index < NumFrames; Index++)
+		{
+			Views.Add(ComponentsManager->GetViewProjection(Index));
+		}
+
+		Frames = FImpostorRasterizer::RasterizeFrames(Geometry, Views, ComponentsManager->GetFrameRect(0).Width());
+	}
+
+	const FIntPoint AtlasSize = ComponentsManager->GetMapAtlasSize(TargetMap);
+	Atlases.FindOrAdd(TargetMap).Init(AtlasSize.X, AtlasSize.Y, FColor::Black);
+}
+
+void UImpostorCPUCaptureBackend::CaptureView(const int32 VectorIndex)
+{
+	const FImpostorRasterizedFrame& Frame = Frames[VectorIndex];
+	CurrentFrame.Init(Frame.Size, Frame.Size, FColor::Black);
+
+	// Depth is encoded as height towards the camera, normalized by capture radius (same as depth post process material)
+	const float DepthScale = 0.5f / FMath::Max(Manager->GetManager<UImpostorComponentsManager>()->ObjectRadius, UE_KINDA_SMALL_NUMBER);
+
+	ParallelFor(Frame.Size, [&](const int32 Y)
+	{
+		for (int32 X = 0; X < Frame.Size; X++)
+		{
+			if (!Frame.IsCovered(X, Y))
+			{
+				continue;
+			}
+
+			const int32 Index = Y * Frame.Size + X;
+			FColor& Pixel = CurrentFrame.GetPixel(X, Y);
+			switch (CurrentMap)
+			{
+			default: check(false);
+			case EImpostorBakeMapType::Depth:
+			{
+				const uint8 Depth = FMath::Clamp(FMath::RoundToInt32((0.5f - Frame.Depths[Index] * DepthScale) * 255.f), 0, 255);
+				Pixel = FColor(Depth, Depth, Depth, 255);
+				break;
+			}
+
+			case EImpostorBakeMapType::Normal:
+				Pixel = FLinearColor(Frame.Normals[Index] * 0.5f + 0.5f).QuantizeRound();
+				Pixel.A = 255;
+				break;
+
+			case EImpostorBakeMapType::Opacity:
+				Pixel = FColor::White;
+				break;
+			}
+		}
+	});
+}
+
+void UImpostorCPUCaptureBackend::PlaceFrame(const int32 VectorIndex)
+{
+	FImpostorImage& Atlas = Atlases[CurrentMap];
+	const FIntRect Rect = Manager->GetManager<UImpostorComponentsManager>()->GetFrameRect(VectorIndex, Atlas.GetSize());
+
+	// Frames are rasterized once at full resolution, reduced maps resample them
+	if (Rect.Size() == CurrentFrame.GetSize())
+	{
+		CurrentFrame.CopyTo(Atlas, Rect.Min);
+	}
+	else
+	{
+		CurrentFrame.Resample(FIntRect(FIntPoint::ZeroValue, CurrentFrame.GetSize()), Rect.Size()).CopyTo(Atlas, Rect.Min);
+	}
+}
+
+void UImpostorCPUCaptureBackend::FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry)
+{
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+	FImpostorImage& Atlas = Atlases[CurrentMap];
+	Symmetry.FillFrames(Atlas, [ComponentsManager, AtlasSize = Atlas.GetSize()](const int32 Index) { return ComponentsManager->GetFrameRect(Index, AtlasSize); }, CurrentMap == EImpostorBakeMapType::Normal);
+}
+
+void UImpostorCPUCaptureBackend::Composite()
+{
+	const UImpostorData* ImpostorData = Manager->ImpostorData;
+
+	FImpostorImage* NormalAtlas = Atlases.Find(EImpostorBakeMapType::Normal);
+	const FImpostorImage* DepthAtlas = Atlases.Find(EImpostorBakeMapType::Depth);
+	if (ImpostorData->CombinesNormalAndDepth() &&
+		NormalAtlas &&
+		DepthAtlas &&
+		ensure(NormalAtlas->GetSize() == DepthAtlas->GetSize()))
+	{
+		for (int32 Index = 0; Index < NormalAtlas->Pixels.Num(); Index++)
+		{
+			NormalAtlas->Pixels[Index].A = DepthAtlas->Pixels[Index].R;
+		}
+	}
+
+	if (!FApp::CanEverRender())
+	{
+		return;
+	}
+
+	// Render targets are still used for preview and compositing
+	for (const auto& It : Atlases)
+	{
+		if (UTextureRenderTarget2D* RenderTarget = Manager->TargetMaps.FindRef(It.Key))
+		{
+			Manager->ResampleRenderTarget(It.Value.CreateTransientTexture(), RenderTarget);
+		}
+	}
+}
+
+bool UImpostorCPUCaptureBackend::Readback(const EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const
+{
+	const FImpostorImage* Atlas = Atlases.Find(TargetMap);
+	if (!Atlas)
+	{
+		return false;
+	}
+
+	OutImage = *Atlas;
+	return true;
+}
+
+void UImpostorCPUCaptureBackend::EndBake()
+{
+	Geometry = {};
+	Frames.Empty();
+	CurrentFrame = {};
+	CurrentMap = EImpostorBakeMapType::None;
+}
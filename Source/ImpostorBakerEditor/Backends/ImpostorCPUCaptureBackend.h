@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include "ImpostorCaptureBackend.h"
+#include "Utilities/ImpostorImage.h"
+#include "Utilities/ImpostorMeshGeometry.h"
+#include "Utilities/ImpostorRasterizer.h"
+#include "ImpostorCPUCaptureBackend.generated.h"
+
+// Rasterizes Depth, Normal and Opacity maps on CPU from referenced mesh geometry, without the renderer.
+// Gives exact coverage, but ignores material effects (normal maps, masked opacity, WPO).
+UCLASS()
+class IMPOSTORBAKEREDITOR_API UImpostorCPUCaptureBackend : public UObject, public IImpostorCaptureBackend
+{
+	GENERATED_BODY()
+
+public:
+	//~ Begin IImpostorCaptureBackend Interface
+	virtual void Initialize(UImpostorRenderTargetsManager* InManager) override;
+	virtual FString GetBackendName() const override;
+	virtual bool SupportsMap(EImpostorBakeMapType TargetMap) const override;
+	virtual void BeginBake() override;
+	virtual void PrepareMap(EImpostorBakeMapType TargetMap) override;
+	virtual void CaptureView(int32 VectorIndex) override;
+	virtual void PlaceFrame(int32 VectorIndex) override;
+	virtual void FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry) override;
+	virtual void Composite() override;
+	virtual bool Readback(EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const override;
+	virtual void EndBake() override;
+	//~ End IImpostorCaptureBackend Interface
+
+private:
+	UPROPERTY(Transient)
+	TObjectPtr<UImpostorRenderTargetsManager> Manager;
+
+	FImpostorMeshGeometry Geometry;
+	EImpostorBakeMapType CurrentMap = EImpostorBakeMapType::None;
+
+	// Every view is rasterized once, and encoded into each map
+	TArray<FImpostorRasterizedFrame> Frames;
+	FImpostorImage CurrentFrame;
+
+	TMap<EImpostorBakeMapType, FImpostorImage> Atlases;
+};
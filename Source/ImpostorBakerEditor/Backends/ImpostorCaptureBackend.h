@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include <UObject/Interface.h>
+#include "ImpostorData/ImpostorData.h"
+#include "ImpostorCaptureBackend.generated.h"
+
+class UImpostorRenderTargetsManager;
+struct FImpostorImage;
+struct FImpostorViewSymmetry;
+
+UINTERFACE()
+class UImpostorCaptureBackend : public UInterface
+{
+	GENERATED_BODY()
+};
+
+// Produces impostor maps for render targets manager.
+// Every map goes through PrepareMap, CaptureView + PlaceFrame for every view, then Composite once all maps are done.
+class IImpostorCaptureBackend
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(UImpostorRenderTargetsManager* InManager) = 0;
+	virtual FString GetBackendName() const = 0;
+	virtual bool SupportsMap(EImpostorBakeMapType TargetMap) const = 0;
+
+	// Frames to wait after PrepareMap before views can be captured
+	virtual int32 GetWarmupFrames() const
+	{
+		return 0;
+	}
+
+	virtual void BeginBake()
+	{
+	}
+
+	virtual void PrepareMap(EImpostorBakeMapType TargetMap) = 0;
+	virtual void CaptureView(int32 VectorIndex) = 0;
+	// Places last captured view into its frame of the atlas
+	virtual void PlaceFrame(int32 VectorIndex) = 0;
+	// Fills frames of current map, which weren't captured, from their symmetric source frames
+	virtual void FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry) = 0;
+	// Called once after all maps are placed, for maps combined from several others
+	virtual void Composite() = 0;
+	// Reads baked atlas back to CPU
+	virtual bool Readback(EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const = 0;
+
+	virtual void EndBake()
+	{
+	}
+};
@@ -0,0 +1,358 @@
+﻿#include "ImpostorGPUCaptureBackend.h"
+#include <Components/SceneCaptureComponent2D.h>
+#include <Engine/Canvas.h>
+#include <Engine/TextureRenderTarget2D.h>
+#include <Kismet/KismetRenderingLibrary.h>
+#include <Materials/MaterialInstanceDynamic.h>
+#include <TextureResource.h>
+#include "Managers/ImpostorComponentsManager.h"
+#include "Managers/ImpostorLightingManager.h"
+#include "Managers/ImpostorMaterialsManager.h"
+#include "Managers/ImpostorRenderTargetsManager.h"
+#include "SceneRenderBuilderInterface.h"
+#include "Utilities/ImpostorImage.h"
+#include "Utilities/ImpostorSymmetry.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorGPUCaptureBackend)
+
+void UImpostorGPUCaptureBackend::Initialize(UImpostorRenderTargetsManager* InManager)
+{
+	Manager = InManager;
+}
+
+FString UImpostorGPUCaptureBackend::GetBackendName() const
+{
+	return "GPU";
+}
+
+bool UImpostorGPUCaptureBackend::SupportsMap(const EImpostorBakeMapType TargetMap) const
+{
+	return TargetMap != EImpostorBakeMapType::None;
+}
+
+int32 UImpostorGPUCaptureBackend::GetWarmupFrames() const
+{
+	return 5;
+}
+
+void UImpostorGPUCaptureBackend::BeginBake()
+{
+	bCapturingFinalColor = false;
+	CapturedMaps.Empty();
+}
+
+void UImpostorGPUCaptureBackend::PrepareMap(const EImpostorBakeMapType TargetMap)
+{
+	// Second Base Color pass captures final color, which is used for Base Color opacity
+	bCapturingFinalColor = TargetMap == EImpostorBakeMapType::BaseColor && CapturedMaps.Contains(EImpostorBakeMapType::BaseColor);
+
+	PreparePostProcess(TargetMap);
+	CurrentMap = TargetMap;
+
+	UpdateLightsVisibility();
+
+	// Maps with resolution divisor are rendered straight into matching lower mip, so their captures are cheaper too
+	const int32 CaptureMip = FMath::Min(int32(FMath::FloorLog2(Manager->ImpostorData->GetMapResolutionDivisor(TargetMap))), Manager->SceneCaptureMipChain.Num() - 1);
+	Manager->GetManager<UImpostorMaterialsManager>()->UpdateSampleFrameMaterial(CaptureMip);
+
+	USceneCaptureComponent2D* SceneCaptureComponent2D = Manager->SceneCaptureComponent2D;
+	SceneCaptureComponent2D->TextureTarget = CurrentMap == EImpostorBakeMapType::BaseColor && !bCapturingFinalColor ? Manager->SceneCaptureSRGBMip : Manager->SceneCaptureMipChain[CaptureMip];
+
+	// Base Color render target is kept as it is (e.g. for progressive preview), final color is drawn into scratch render target
+	if (bCapturingFinalColor)
+	{
+		Manager->ClearRenderTarget(Manager->ScratchRenderTarget);
+	}
+}
+
+void UImpostorGPUCaptureBackend::CaptureView(const int32 VectorIndex)
+{
+	const UImpostorData* ImpostorData = Manager->ImpostorData;
+	UWorld* SceneWorld = Manager->SceneWorld;
+	USceneCaptureComponent2D* SceneCaptureComponent2D = Manager->SceneCaptureComponent2D;
+
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+	const FVector& Vector = ComponentsManager->ViewCaptureVectors[VectorIndex];
+
+	FVector WorldLocation = ComponentsManager->GetBounds().Origin;
+	WorldLocation += Vector * (ImpostorData->ProjectionType == ECameraProjectionMode::Type::Orthographic ? (ComponentsManager->CaptureDepthRadius * 1.25f) : ImpostorData->CameraDistance);
+	SceneCaptureComponent2D->SetWorldLocation(WorldLocation);
+	SceneCaptureComponent2D->SetWorldRotation((Vector * -1.f).ToOrientationRotator());
+
+	Manager->GetManager<UImpostorMaterialsManager>()->UpdateDepthMaterialData(Vector);
+
+	SceneWorld->SendAllEndOfFrameUpdates();
+
+	TUniquePtr<ISceneRenderBuilder> SceneRenderBuilder = ISceneRenderBuilder::Create(SceneWorld->Scene);
+	SceneCaptureComponent2D->UpdateSceneCaptureContents(SceneWorld->Scene, *SceneRenderBuilder);
+	SceneRenderBuilder->Execute();
+
+	// Lower mips are necessary for distance field alpha and mesh cutouts
+	if (ImpostorData->bUseDistanceFieldAlpha || ImpostorData->bUseMeshCutout)
+	{
+		if (CurrentMap == EImpostorBakeMapType::BaseColor && bCapturingFinalColor)
+		{
+			const TArray<TObjectPtr<UTextureRenderTarget2D>>& SceneCaptureMipChain = Manager->SceneCaptureMipChain;
+			for (int32 MipIndex = 1; MipIndex < SceneCaptureMipChain.Num(); MipIndex++)
+			{
+				UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, SceneCaptureMipChain[MipIndex], FLinearColor::Black);
+				Manager->ResampleRenderTarget(SceneCaptureMipChain[MipIndex - 1], SceneCaptureMipChain[MipIndex]);
+			}
+		}
+	}
+}
+
+void UImpostorGPUCaptureBackend::PlaceFrame(const int32 VectorIndex)
+{
+	UWorld* SceneWorld = Manager->SceneWorld;
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+	const UImpostorMaterialsManager* MaterialsManager = Manager->GetManager<UImpostorMaterialsManager>();
+
+	UTextureRenderTarget2D* RenderTarget = GetCurrentRenderTarget();
+
+	UCanvas* Canvas;
+	FVector2D Size;
+	FDrawToRenderTargetContext Context;
+
+	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(SceneWorld, RenderTarget, Canvas, Size, Context);
+
+	// Reduced maps keep the same layout, scaled to their render target
+	const FVector2D FramePitch = ComponentsManager->GetFramePitch() * Size / ComponentsManager->GetRenderTargetSize();
+
+	UMaterialInstanceDynamic* TargetMaterial = MaterialsManager->GetSampleMaterial(CurrentMap);
+	Canvas->K2_DrawMaterial(
+		TargetMaterial,
+		FramePitch * FVector2D(ComponentsManager->GetFrameCell(VectorIndex)),
+		FramePitch,
+		FVector2D::Zero(),
+		FVector2D::One(),
+		0.f,
+		FVector2D(0.5f, 0.5f));
+
+	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(SceneWorld, Context);
+
+	if (CurrentMap == EImpostorBakeMapType::BaseColor)
+	{
+		// Accumulate Alphas for Mesh Cutout
+		const bool bPerViewAlphas = Manager->ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards;
+		UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, Manager->CombinedAlphas[bPerViewAlphas ? VectorIndex : 0], MaterialsManager->AddAlphasMaterial);
+	}
+
+	CapturedMaps.Add(CurrentMap);
+}
+
+void UImpostorGPUCaptureBackend::FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry)
+{
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+
+	UTextureRenderTarget2D* RenderTarget = GetCurrentRenderTarget();
+	FImpostorImage Atlas;
+	if (ReadRenderTarget(RenderTarget, Atlas))
+	{
+		Symmetry.FillFrames(Atlas, [ComponentsManager, AtlasSize = Atlas.GetSize()](const int32 Index) { return ComponentsManager->GetFrameRect(Index, AtlasSize); }, CurrentMap == EImpostorBakeMapType::Normal);
+		Manager->ResampleRenderTarget(Atlas.CreateTransientTexture(RenderTarget->RenderTargetFormat == RTF_RGBA8_SRGB), RenderTarget);
+	}
+
+	if (CurrentMap != EImpostorBakeMapType::BaseColor)
+	{
+		return;
+	}
+
+	// Alphas for Mesh Cutout were accumulated from captured views only
+	const TArray<TObjectPtr<UTextureRenderTarget2D>>& CombinedAlphas = Manager->CombinedAlphas;
+	if (Manager->ImpostorData->ImpostorType != EImpostorLayoutType::TraditionalBillboards)
+	{
+		FImpostorImage Mask;
+		if (ReadRenderTarget(CombinedAlphas[0], Mask))
+		{
+			Symmetry.FillCombinedMask(Mask);
+			Manager->ResampleRenderTarget(Mask.CreateTransientTexture(), CombinedAlphas[0]);
+		}
+		return;
+	}
+
+	for (int32 Index = 0; Index < CombinedAlphas.Num(); Index++)
+	{
+		if (!Symmetry.IsCopy(Index))
+		{
+			continue;
+		}
+
+		const FImpostorSymmetricFrame& Frame = Symmetry.GetFrame(Index);
+
+		FImpostorImage SourceMask;
+		if (!ReadRenderTarget(CombinedAlphas[Frame.SourceIndex], SourceMask))
+		{
+			continue;
+		}
+
+		const FIntRect Rect(FIntPoint::ZeroValue, SourceMask.GetSize());
+
+		FImpostorImage Mask;
+		Mask.Init(SourceMask.SizeX, SourceMask.SizeY);
+		FImpostorViewSymmetry::CopyFrame(SourceMask, Rect, Mask, Rect, Frame, false);
+		Manager->ResampleRenderTarget(Mask.CreateTransientTexture(), CombinedAlphas[Index]);
+	}
+}
+
+void UImpostorGPUCaptureBackend::Composite()
+{
+	const UImpostorData* ImpostorData = Manager->ImpostorData;
+	UWorld* SceneWorld = Manager->SceneWorld;
+	const UImpostorMaterialsManager* MaterialsManager = Manager->GetManager<UImpostorMaterialsManager>();
+
+	// Enable disabled Lights when baking some maps
+	UImpostorLightingManager* LightingManager = Manager->GetManager<UImpostorLightingManager>();
+	if (IsValid(LightingManager))
+	{
+		LightingManager->SetLightsVisibility(true);
+	}
+
+	// Final color opacity is only available if this backend captured Base Color. Final color is already in scratch render target.
+	if (CapturedMaps.Contains(EImpostorBakeMapType::BaseColor))
+	{
+		if (UTextureRenderTarget2D* RenderTarget = Manager->TargetMaps.FindRef(EImpostorBakeMapType::BaseColor))
+		{
+			Manager->ResampleRenderTarget(RenderTarget, Manager->BaseColorScratchRenderTarget);
+			UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
+			UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, RenderTarget, MaterialsManager->AddAlphaFromFinalColorMaterial);
+		}
+	}
+
+	// Other backends combine these themselves
+	if (ImpostorData->CombinesNormalAndDepth() &&
+		(CapturedMaps.Contains(EImpostorBakeMapType::Normal) || CapturedMaps.Contains(EImpostorBakeMapType::Depth)))
+	{
+		UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, Manager->ScratchRenderTarget, FLinearColor::Black);
+		if (UTextureRenderTarget2D* RenderTarget = Manager->TargetMaps.FindRef(EImpostorBakeMapType::Normal))
+		{
+			Manager->ResampleRenderTarget(RenderTarget, Manager->ScratchRenderTarget);
+			UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
+			UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, RenderTarget, MaterialsManager->CombinedNormalsDepthMaterial);
+		}
+	}
+
+	if (ImpostorData->bCombineLightingAndColor &&
+		(CapturedMaps.Contains(EImpostorBakeMapType::BaseColor) || CapturedMaps.Contains(EImpostorBakeMapType::CustomLighting)) &&
+		ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::BaseColor) &&
+		ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::CustomLighting))
+	{
+		UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, Manager->BaseColorScratchRenderTarget, FLinearColor::Black);
+		if (UTextureRenderTarget2D* RenderTarget = Manager->TargetMaps.FindRef(EImpostorBakeMapType::BaseColor))
+		{
+			Manager->ResampleRenderTarget(RenderTarget, Manager->BaseColorScratchRenderTarget);
+			UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
+			UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, RenderTarget, MaterialsManager->BaseColorCustomLightingMaterial);
+		}
+	}
+}
+
+bool UImpostorGPUCaptureBackend::Readback(const EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const
+{
+	return ReadRenderTarget(Manager->TargetMaps.FindRef(TargetMap), OutImage);
+}
+
+bool UImpostorGPUCaptureBackend::ReadRenderTarget(UTextureRenderTarget2D* RenderTarget, FImpostorImage& OutImage)
+{
+	if (!RenderTarget)
+	{
+		return false;
+	}
+
+	FTextureRenderTargetResource* Resource = RenderTarget->GameThread_GetRenderTargetResource();
+	if (!Resource)
+	{
+		return false;
+	}
+
+	OutImage.SizeX = RenderTarget->SizeX;
+	OutImage.SizeY = RenderTarget->SizeY;
+
+	// Keep stored values as they are, formats with sRGB gamma are saved the same way
+	FReadSurfaceDataFlags Flags(RCM_UNorm);
+	Flags.SetLinearToGamma(false);
+	return Resource->ReadPixels(OutImage.Pixels, Flags);
+}
+
+void UImpostorGPUCaptureBackend::EndBake()
+{
+	Manager->SceneCaptureComponent2D->TextureTarget = nullptr;
+	CurrentMap = EImpostorBakeMapType::None;
+}
+
+void UImpostorGPUCaptureBackend::PreparePostProcess(const EImpostorBakeMapType TargetMap)
+{
+	const UImpostorData* ImpostorData = Manager->ImpostorData;
+	USceneCaptureComponent2D* SceneCaptureComponent2D = Manager->SceneCaptureComponent2D;
+
+	switch (TargetMap)
+	{
+	default:
+		check(false);
+
+	case EImpostorBakeMapType::BaseColor:
+		SceneCaptureComponent2D->CaptureSource = ImpostorData->bUseFinalColorInsteadBaseColor || ImpostorData->ProjectionType == ECameraProjectionMode::Orthographic || bCapturingFinalColor ? SCS_SceneColorHDR : SCS_BaseColor;
+		SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array.Empty();
+		SceneCaptureComponent2D->SceneViewExtensions.Empty();
+		Extension = nullptr;
+		break;
+
+	case EImpostorBakeMapType::CustomLighting:
+		SceneCaptureComponent2D->CaptureSource = SCS_SceneColorHDR;
+		SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array.Empty();
+		Extension = FSceneViewExtensions::NewExtension<FLightingViewExtension>(SceneCaptureComponent2D->GetScene());
+		SceneCaptureComponent2D->SceneViewExtensions.Add(Extension);
+		break;
+
+	case EImpostorBakeMapType::Metallic:
+	case EImpostorBakeMapType::Specular:
+	case EImpostorBakeMapType::Roughness:
+	case EImpostorBakeMapType::Opacity:
+	case EImpostorBakeMapType::Subsurface:
+	case EImpostorBakeMapType::Normal:
+	case EImpostorBakeMapType::Depth:
+		SceneCaptureComponent2D->CaptureSource = SCS_FinalColorLDR;
+		if (UMaterialInterface* Material = Manager->GetManager<UImpostorMaterialsManager>()->GetRenderTypeMaterial(TargetMap))
+		{
+			Material->EnsureIsComplete();
+			SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array = {FWeightedBlendable(1.0f, Material)};
+		}
+		else
+		{
+			SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array.Empty();
+		}
+		SceneCaptureComponent2D->SceneViewExtensions.Empty();
+		Extension = nullptr;
+		break;
+	}
+}
+
+UTextureRenderTarget2D* UImpostorGPUCaptureBackend::GetCurrentRenderTarget() const
+{
+	return bCapturingFinalColor ? Manager->ScratchRenderTarget : Manager->TargetMaps[CurrentMap];
+}
+
+void UImpostorGPUCaptureBackend::UpdateLightsVisibility() const
+{
+	// Disable unnecessary Lights when baking some maps (increase baking speed)
+	UImpostorLightingManager* LightingManager = Manager->GetManager<UImpostorLightingManager>();
+	if (!IsValid(LightingManager))
+	{
+		return;
+	}
+
+	switch (CurrentMap)
+	{
+	case EImpostorBakeMapType::BaseColor:
+		LightingManager->SetLightsVisibility(Manager->ImpostorData->bUseFinalColorInsteadBaseColor);
+		break;
+
+	case EImpostorBakeMapType::CustomLighting:
+		LightingManager->SetLightsVisibility(true);
+		break;
+
+	default:
+		LightingManager->SetLightsVisibility(false);
+		break;
+	}
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include <SceneView.h>
+#include <SceneViewExtension.h>
+#include "ImpostorCaptureBackend.h"
+#include "ImpostorGPUCaptureBackend.generated.h"
+
+class UTextureRenderTarget2D;
+
+struct FLightingViewExtension final : FSceneViewExtensionBase
+{
+	FSceneInterface* Scene;
+	FLightingViewExtension(const FAutoRegister& AutoRegister, FSceneInterface* Scene)
+		: FSceneViewExtensionBase(AutoRegister)
+		, Scene(Scene)
+	{
+	}
+
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override
+	{
+	}
+
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override
+	{
+		InView.DiffuseOverrideParameter = FVector4f(GEngine->LightingOnlyBrightness.R, GEngine->LightingOnlyBrightness.G, GEngine->LightingOnlyBrightness.B, 0.0f);
+		InView.SpecularOverrideParameter = FVector4f(0.f, 0.f, 0.f, 0.f);
+	}
+
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override
+	{
+	}
+
+protected:
+	virtual bool IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const override
+	{
+		return Context.Scene == Scene;
+	}
+};
+
+// Captures every view of the referenced mesh with scene capture component and draws it into render target with sample materials
+UCLASS()
+class IMPOSTORBAKEREDITOR_API UImpostorGPUCaptureBackend : public UObject, public IImpostorCaptureBackend
+{
+	GENERATED_BODY()
+
+public:
+	//~ Begin IImpostorCaptureBackend Interface
+	virtual void Initialize(UImpostorRenderTargetsManager* InManager) override;
+	virtual FString GetBackendName() const override;
+	virtual bool SupportsMap(EImpostorBakeMapType TargetMap) const override;
+	virtual int32 GetWarmupFrames() const override;
+	virtual void BeginBake() override;
+	virtual void PrepareMap(EImpostorBakeMapType TargetMap) override;
+	virtual void CaptureView(int32 VectorIndex) override;
+	virtual void PlaceFrame(int32 VectorIndex) override;
+	virtual void FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry) override;
+	virtual void Composite() override;
+	virtual bool Readback(EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const override;
+	virtual void EndBake() override;
+	//~ End IImpostorCaptureBackend Interface
+
+private:
+	void PreparePostProcess(EImpostorBakeMapType TargetMap);
+	void UpdateLightsVisibility() const;
+	UTextureRenderTarget2D* GetCurrentRenderTarget() const;
+
+	static bool ReadRenderTarget(UTextureRenderTarget2D* RenderTarget, FImpostorImage& OutImage);
+
+private:
+	UPROPERTY(Transient)
+	TObjectPtr<UImpostorRenderTargetsManager> Manager;
+
+	EImpostorBakeMapType CurrentMap = EImpostorBakeMapType::None;
+	TSharedPtr<FLightingViewExtension> Extension;
+
+	bool bCapturingFinalColor = false;
+
+	// Maps placed by this backend during current bake
+	TSet<EImpostorBakeMapType> CapturedMaps;
+};
@@ -0,0 +1,133 @@
+﻿#include "ImpostorReplayCaptureBackend.h"
+#include <Engine/TextureRenderTarget2D.h>
+#include <Misc/App.h>
+#include <Misc/Paths.h>
+#include "ImpostorBakerEditorModule.h"
+#include "Managers/ImpostorComponentsManager.h"
+#include "Managers/ImpostorRenderTargetsManager.h"
+#include "Utilities/ImpostorSymmetry.h"
+#include "Settings/ImpostorBakerSettings.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorReplayCaptureBackend)
+
+void UImpostorReplayCaptureBackend::Initialize(UImpostorRenderTargetsManager* InManager)
+{
+	Manager = InManager;
+}
+
+FString UImpostorReplayCaptureBackend::GetBackendName() const
+{
+	return "Replay";
+}
+
+bool UImpostorReplayCaptureBackend::SupportsMap(const EImpostorBakeMapType TargetMap) const
+{
+	return Recordings.Contains(TargetMap);
+}
+
+void UImpostorReplayCaptureBackend::BeginBake()
+{
+	Recordings.Empty();
+	Atlases.Empty();
+
+	const UImpostorData* ImpostorData = Manager->ImpostorData;
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+
+	for (const EImpostorBakeMapType MapType : ImpostorData->MapsToRender)
+	{
+		// Recordings are made at size of map render target
+		const FIntPoint AtlasSize = ComponentsManager->GetMapAtlasSize(MapType);
+
+		const FString Filename = GetRecordingFilename(ImpostorData, MapType);
+		if (!FPaths::FileExists(Filename))
+		{
+			continue;
+		}
+
+		FImpostorImage Recording;
+		if (!Recording.LoadFromFile(Filename))
+		{
+			UE_LOG(LogImpostorBaker, Warning, TEXT("Failed to load recorded capture %s"), *Filename);
+			continue;
+		}
+
+		// Recording of different layout can't be replayed
+		if (Recording.GetSize() != AtlasSize)
+		{
+			UE_LOG(LogImpostorBaker, Warning, TEXT("Recorded capture %s is %dx%d, while %dx%d is expected"), *Filename, Recording.SizeX, Recording.SizeY, AtlasSize.X, AtlasSize.Y);
+			continue;
+		}
+
+		Recordings.Add(MapType, MoveTemp(Recording));
+	}
+}
+
+void UImpostorReplayCaptureBackend::PrepareMap(const EImpostorBakeMapType TargetMap)
+{
+	CurrentMap = TargetMap;
+
+	const FIntPoint AtlasSize = Manager->GetManager<UImpostorComponentsManager>()->GetMapAtlasSize(TargetMap);
+	Atlases.FindOrAdd(TargetMap).Init(AtlasSize.X, AtlasSize.Y, FColor::Black);
+}
+
+void UImpostorReplayCaptureBackend::CaptureView(const int32 VectorIndex)
+{
+	const FImpostorImage& Recording = Recordings[CurrentMap];
+	CurrentFrame = Recording.CopyRect(Manager->GetManager<UImpostorComponentsManager>()->GetFrameRect(VectorIndex, Recording.GetSize()));
+}
+
+void UImpostorReplayCaptureBackend::PlaceFrame(const int32 VectorIndex)
+{
+	FImpostorImage& Atlas = Atlases[CurrentMap];
+	CurrentFrame.CopyTo(Atlas, Manager->GetManager<UImpostorComponentsManager>()->GetFrameRect(VectorIndex, Atlas.GetSize()).Min);
+}
+
+void UImpostorReplayCaptureBackend::FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry)
+{
+	const UImpostorComponentsManager* ComponentsManager = Manager->GetManager<UImpostorComponentsManager>();
+	FImpostorImage& Atlas = Atlases[CurrentMap];
+	Symmetry.FillFrames(Atlas, [ComponentsManager, AtlasSize = Atlas.GetSize()](const int32 Index) { return ComponentsManager->GetFrameRect(Index, AtlasSize); }, CurrentMap == EImpostorBakeMapType::Normal);
+}
+
+void UImpostorReplayCaptureBackend::Composite()
+{
+	// Recordings are made after compositing, so maps are already final
+
+	if (!FApp::CanEverRender())
+	{
+		return;
+	}
+
+	for (const auto& It : Atlases)
+	{
+		if (UTextureRenderTarget2D* RenderTarget = Manager->TargetMaps.FindRef(It.Key))
+		{
+			Manager->ResampleRenderTarget(It.Value.CreateTransientTexture(), RenderTarget);
+		}
+	}
+}
+
+bool UImpostorReplayCaptureBackend::Readback(const EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const
+{
+	const FImpostorImage* Atlas = Atlases.Find(TargetMap);
+	if (!Atlas)
+	{
+		return false;
+	}
+
+	OutImage = *Atlas;
+	return true;
+}
+
+void UImpostorReplayCaptureBackend::EndBake()
+{
+	Recordings.Empty();
+	CurrentFrame = {};
+	CurrentMap = EImpostorBakeMapType::None;
+}
+
+FString UImpostorReplayCaptureBackend::GetRecordingFilename(const UImpostorData* ImpostorData, const EImpostorBakeMapType TargetMap)
+{
+	const FString MapName = GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames[TargetMap].ToString();
+	return FPaths::ProjectSavedDir() / "ImpostorBaker" / "Replay" / ImpostorData->NewTextureName / MapName + ".png";
+}
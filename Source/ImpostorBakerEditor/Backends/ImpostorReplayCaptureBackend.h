@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include "ImpostorCaptureBackend.h"
+#include "Utilities/ImpostorImage.h"
+#include "ImpostorReplayCaptureBackend.generated.h"
+
+// Replays maps recorded by previous bake (see UImpostorData::bRecordCapturesForReplay) frame by frame, without rendering anything.
+// Allows running whole bake with -nullrhi, and gives baseline timings of the bake itself.
+UCLASS()
+class IMPOSTORBAKEREDITOR_API UImpostorReplayCaptureBackend : public UObject, public IImpostorCaptureBackend
+{
+	GENERATED_BODY()
+
+public:
+	//~ Begin IImpostorCaptureBackend Interface
+	virtual void Initialize(UImpostorRenderTargetsManager* InManager) override;
+	virtual FString GetBackendName() const override;
+	virtual bool SupportsMap(EImpostorBakeMapType TargetMap) const override;
+	virtual void BeginBake() override;
+	virtual void PrepareMap(EImpostorBakeMapType TargetMap) override;
+	virtual void CaptureView(int32 VectorIndex) override;
+	virtual void PlaceFrame(int32 VectorIndex) override;
+	virtual void FillSymmetricFrames(const FImpostorViewSymmetry& Symmetry) override;
+	virtual void Composite() override;
+	virtual bool Readback(EImpostorBakeMapType TargetMap, FImpostorImage& OutImage) const override;
+	virtual void EndBake() override;
+	//~ End IImpostorCaptureBackend Interface
+
+	static FString GetRecordingFilename(const UImpostorData* ImpostorData, EImpostorBakeMapType TargetMap);
+
+private:
+	UPROPERTY(Transient)
+	TObjectPtr<UImpostorRenderTargetsManager> Manager;
+
+	EImpostorBakeMapType CurrentMap = EImpostorBakeMapType::None;
+	FImpostorImage CurrentFrame;
+
+	TMap<EImpostorBakeMapType, FImpostorImage> Recordings;
+	TMap<EImpostorBakeMapType, FImpostorImage> Atlases;
+};
@@ -169,6 +169,21 @@ void FImpostorBakerEditorToolkit::BuildToolbar(FToolBarBuilder& ToolBarBuilder)
 			INVTEXT("Captures mesh to render targets"),
 			FSlateIcon(FAppStyle::GetAppStyleSetName(), "ClassIcon.SceneCaptureComponent2D"));
 
+		ToolBarBuilder.AddToolBarButton(
+			FUIAction(FExecuteAction::CreateLambda([this]
+			{
+				if (ObjectBeingEdited &&
+					Viewport &&
+					Viewport->GetManager())
+				{
+					Viewport->GetManager()->AutoTune();
+				}
+			})),
+			NAME_None,
+			INVTEXT("Auto Tune"),
+			INVTEXT("Measures Frames Count and Resolution candidates on CPU and applies the cheapest one meeting Auto Tune thresholds"),
+			FSlateIcon(FAppStyle::GetAppStyleSetName(), "Icons.Settings"));
+
 		ToolBarBuilder.AddToolBarButton(
 			FUIAction(FExecuteAction::CreateLambda([this]
 			{
@@ -218,7 +233,7 @@ void FImpostorBakerEditorToolkit::BuildToolbar(FToolBarBuilder& ToolBarBuilder)
 			})),
 			NAME_None,
 			INVTEXT("Export to LOD"),
-			INVTEXT("Creates material and textures for impostor and adds new LOD for referenced mesh"),
+			INVTEXT("Creates material and textures for impostor and adds new LOD for referenced mesh, followed by lower resolution LODs of LOD Chain Resolutions"),
 			FSlateIcon(FAppStyle::GetAppStyleSetName(), "Icons.LOD"));
 	}
 	ToolBarBuilder.EndSection();
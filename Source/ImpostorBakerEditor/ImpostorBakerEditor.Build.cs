@@ -16,7 +16,10 @@ public class ImpostorBakerEditor : ModuleRules
 				"Slate",
 				"SlateCore",
 				"UnrealEd",
+				"MaterialEditor",
 				"MeshDescription",
+				"StaticMeshDescription",
+				"ImageCore",
 				"DeveloperSettings",
 				"CommonMenuExtensions",
 				"AdvancedPreviewScene",
@@ -8,6 +8,8 @@
 #include "Managers/ImpostorBakerManager.h"
 #include "ThumbnailRenderer/ImpostorDataThumbnailRenderer.h"
 
+DEFINE_LOG_CATEGORY(LogImpostorBaker);
+
 void FImpostorBakerEditorModule::StartupModule()
 {
 	if (FModuleManager::Get().IsModuleLoaded("ContentBrowser"))
@@ -5,6 +5,8 @@
 
 class FAssetTypeActions_ImpostorSettings;
 
+DECLARE_LOG_CATEGORY_EXTERN(LogImpostorBaker, Log, All);
+
 class FImpostorBakerEditorModule : public IModuleInterface
 {
 public:
@@ -1,6 +1,9 @@
 ﻿#include "ImpostorData/ImpostorData.h"
 #include <AssetRegistry/AssetData.h>
+#include <Engine/RendererSettings.h>
 #include <Engine/StaticMesh.h>
+#include <Engine/Texture2D.h>
+#include <Materials/MaterialInstanceConstant.h>
 #include <PackageTools.h>
 #include "Settings/ImpostorBakerSettings.h"
 
@@ -140,6 +143,103 @@ FString UImpostorData::GetPackageName(const FString& AssetName) const
 	return UPackageTools::SanitizePackageName(SaveLocation.Path / AssetName);
 }
 
+int32 UImpostorData::GetFrameAlignment() const
+{
+	if (ImpostorType == EImpostorLayoutType::TraditionalBillboards)
+	{
+		return 1;
+	}
+
+	switch (FrameAlignment)
+	{
+	default: check(false);
+	case EImpostorFrameAlignment::None: return 1;
+	case EImpostorFrameAlignment::BlockCompression: return 4;
+	case EImpostorFrameAlignment::VirtualTextureTile: return FMath::Max(int32(GetDefault<URendererSettings>()->VirtualTextureTileSize), 1);
+	}
+}
+
+EImpostorFrameOrder UImpostorData::GetFrameOrder() const
+{
+	if (ImpostorType == EImpostorLayoutType::TraditionalBillboards ||
+		!FMath::IsPowerOfTwo(FramesCount))
+	{
+		return EImpostorFrameOrder::RowMajor;
+	}
+
+	return FrameOrder;
+}
+
+bool UImpostorData::UsesShadowProxy() const
+{
+	// Proxy material snaps to octahedral grid views and rebuilds orthographic frame cards
+	return bMeshCastShadow &&
+		bSaveShadowProxy &&
+		ImpostorType != EImpostorLayoutType::TraditionalBillboards &&
+		ViewDistribution == EImpostorViewDistribution::OctahedralGrid &&
+		ProjectionType == ECameraProjectionMode::Orthographic;
+}
+
+bool UImpostorData::CombinesNormalAndDepth() const
+{
+	return bCombineNormalAndDepth &&
+		NormalEncoding == EImpostorNormalEncoding::Packed &&
+		MapsToRender.Contains(EImpostorBakeMapType::Normal) &&
+		MapsToRender.Contains(EImpostorBakeMapType::Depth);
+}
+
+int32 UImpostorData::GetMapResolutionDivisor(const EImpostorBakeMapType TargetMap) const
+{
+	// Base Color coverage drives cutout and opacity of every map, combined maps are composited texel to texel
+	if (TargetMap == EImpostorBakeMapType::BaseColor ||
+		(TargetMap == EImpostorBakeMapType::CustomLighting && bCombineLightingAndColor))
+	{
+		return 1;
+	}
+
+	if (TargetMap == EImpostorBakeMapType::Depth &&
+		CombinesNormalAndDepth())
+	{
+		return GetMapResolutionDivisor(EImpostorBakeMapType::Normal);
+	}
+
+	const int32* Divisor = MapResolutionDivisors.Find(TargetMap);
+	return Divisor ? int32(FMath::RoundUpToPowerOfTwo(FMath::Clamp(*Divisor, 1, 8))) : 1;
+}
+
+UTexture2D* UImpostorData::LoadSavedTexture(const EImpostorBakeMapType TargetMap) const
+{
+	const FName* MapName = GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames.Find(TargetMap);
+	if (!ensure(MapName))
+	{
+		return nullptr;
+	}
+
+	return Cast<UTexture2D>(LoadSavedTextureBySuffix(MapName->ToString()));
+}
+
+UTexture* UImpostorData::LoadSavedTextureBySuffix(const FString& Suffix) const
+{
+	const FString AssetName = NewTextureName + "_" + Suffix;
+	return LoadObject<UTexture>(nullptr, *(GetPackageName(AssetName) + "." + AssetName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+}
+
+UMaterialInstanceConstant* UImpostorData::LoadSavedMaterial() const
+{
+	return LoadObject<UMaterialInstanceConstant>(nullptr, *(GetPackageName(NewMaterialName) + "." + NewMaterialName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+}
+
+UMaterialInstanceConstant* UImpostorData::LoadSavedShadowMaterial() const
+{
+	const FString AssetName = NewMaterialName + "_Shadow";
+	return LoadObject<UMaterialInstanceConstant>(nullptr, *(GetPackageName(AssetName) + "." + AssetName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+}
+
+UStaticMesh* UImpostorData::LoadSavedMesh() const
+{
+	return LoadObject<UStaticMesh>(nullptr, *(GetPackageName(NewMeshName) + "." + NewMeshName), nullptr, LOAD_NoWarn | LOAD_Quiet);
+}
+
 void UImpostorData::UpdateFOVDistance()
 {
 	if (!ReferencedMesh)
@@ -152,7 +252,7 @@ void UImpostorData::UpdateFOVDistance()
 		return;
 	}
 
-	const float Radius = ReferencedMesh->GetBounds().SphereRadius + GetMeshOffset().GetAbsMax();
+	const float Radius = ProjectionRadius > 0.f ? ProjectionRadius : ReferencedMesh->GetBounds().SphereRadius + GetMeshOffset().GetAbsMax();
 
 	if (PerspectiveCameraType == EImpostorPerspectiveCameraType::Distance)
 	{
@@ -163,6 +263,19 @@ void UImpostorData::UpdateFOVDistance()
 	CameraDistance = Radius / FMath::Tan(CameraFOV / 2.f / (180.f / UE_DOUBLE_PI));
 }
 
+void UImpostorData::SetProjectionRadius(const float NewProjectionRadius)
+{
+	// Called on every preview update, asset is only dirtied when radius changes
+	if (ProjectionRadius == NewProjectionRadius)
+	{
+		return;
+	}
+
+	Modify();
+	ProjectionRadius = NewProjectionRadius;
+	UpdateFOVDistance();
+}
+
 FVector2D UImpostorData::GetMeshOffset() const
 {
 	FVector2D Offset = FVector2D::ZeroVector;
@@ -6,6 +6,10 @@
 #include <UObject/Object.h>
 #include "ImpostorData.generated.h"
 
+class UMaterialInstanceConstant;
+class UTexture;
+class UTexture2D;
+
 UENUM()
 enum class EImpostorBakeMapType
 {
@@ -30,6 +34,36 @@ enum class EImpostorLayoutType
 	TraditionalBillboards UMETA(Tooltip = "Uses a 3x3 grid of tradtional billboards. 8 views are from the sides and 1 from above.")
 };
 
+UENUM()
+enum class EImpostorViewDistribution
+{
+	OctahedralGrid UMETA(Tooltip = "Views are placed on (hemi)octahedral grid, frame is found from view direction by the material. Views are denser near octahedron corners than along its edges."),
+	Fibonacci UMETA(Tooltip = "Views are placed near uniformly on Fibonacci spiral. Lower Frames Count is needed for the same max angular error, but material has to blend frames from view lookup texture.")
+};
+
+UENUM()
+enum class EImpostorFrameAlignment
+{
+	None UMETA(Tooltip = "Frames evenly divide the atlas, their borders can share compressed blocks and virtual texture pages"),
+	BlockCompression UMETA(Tooltip = "Frame size and origins are multiples of 4 texels, so no BC block holds texels of two frames"),
+	VirtualTextureTile UMETA(Tooltip = "Frame size and origins are multiples of virtual texture tile size from project settings, so each page holds a single frame")
+};
+
+UENUM()
+enum class EImpostorFrameOrder
+{
+	RowMajor UMETA(Tooltip = "Frames are stored row by row, in view grid order"),
+	Morton UMETA(Tooltip = "Frames are stored in Z-order of their view grid coordinates, so frames blended together are closer in memory. Needs power of two Frames Count."),
+	Hilbert UMETA(Tooltip = "Frames are stored along Hilbert curve over view grid, consecutive frames are always grid neighbors. Needs power of two Frames Count.")
+};
+
+UENUM()
+enum class EImpostorNormalEncoding
+{
+	Packed UMETA(Tooltip = "Normal is stored in RGB, depth can be combined into its alpha (BC7), otherwise normal map compression is used"),
+	Octahedral UMETA(Tooltip = "Normal is stored as octahedral coordinates in RG (BC5), depth is saved as separate single channel texture (BC4). Material has to decode normal with MF_ImpostorOctahedralNormal.")
+};
+
 UENUM()
 enum class EImpostorPerspectiveCameraType
 {
@@ -46,6 +80,54 @@ enum class EImpostorMeshOffsetType
 	CustomOffset UMETA(Tooltip = "Will offset mesh by custom offset")
 };
 
+UENUM()
+enum class EImpostorCaptureBackendType
+{
+	GPU UMETA(DisplayName = "GPU", Tooltip = "Every view is captured from the scene with scene capture component."),
+	CPURasterizer UMETA(DisplayName = "CPU Rasterizer", Tooltip = "Depth, Normal and Opacity maps are rasterized on CPU from mesh geometry. Exact coverage, but ignores material effects (normal maps, masked opacity, WPO)."),
+	Replay UMETA(Tooltip = "Maps recorded by previous bake are replayed without rendering. Useful for testing without RHI.")
+};
+
+// Single configuration measured by auto tune
+USTRUCT()
+struct FImpostorAutoTuneResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	int32 FramesCount = 0;
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	int32 Resolution = 0;
+
+	// CPU rasterization of frames (shared by all resolutions of same Frames Count) and their resampling into atlases, not time of GPU bake
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	float RasterizeTimeMs = 0.f;
+
+	// Compressed size of saved textures, including mips
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	int64 TextureBytes = 0;
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	float PSNR = 0.f;
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	float SSIM = 0.f;
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	float SilhouetteIoU = 0.f;
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	float NormalError = 0.f;
+
+	// Meets both auto tune thresholds
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	bool bPassed = false;
+
+	UPROPERTY(Category = "Auto Tune", VisibleAnywhere)
+	bool bSelected = false;
+};
+
 UCLASS()
 class UImpostorData : public UObject
 {
@@ -63,9 +145,32 @@ public:
 	UMaterialInterface* GetMaterial() const;
 
 	FString GetPackageName(const FString& AssetName) const;
+	// Texture of TargetMap saved by last export, if it exists
+	UTexture2D* LoadSavedTexture(EImpostorBakeMapType TargetMap) const;
+	// Any texture saved by last export next to maps, by suffix of its name (e.g. BaseColor_Array, DepthRange)
+	UTexture* LoadSavedTextureBySuffix(const FString& Suffix) const;
+	UMaterialInstanceConstant* LoadSavedMaterial() const;
+	// Shadow proxy material saved by last export, null if impostor casts shadow itself
+	UMaterialInstanceConstant* LoadSavedShadowMaterial() const;
+	// Impostor mesh saved by last Create Assets
+	UStaticMesh* LoadSavedMesh() const;
 
 	FVector2D GetMeshOffset() const;
 
+	// Texels, which frame size and origins are multiples of
+	int32 GetFrameAlignment() const;
+	// Frame Order, which is used for current layout
+	EImpostorFrameOrder GetFrameOrder() const;
+	// Shadow proxy is enabled and supported by current layout
+	bool UsesShadowProxy() const;
+	// Depth is composited into Normal alpha, instead of being saved as separate texture
+	bool CombinesNormalAndDepth() const;
+	// Power of two divisor of atlas size and scene capture resolution of TargetMap
+	int32 GetMapResolutionDivisor(EImpostorBakeMapType TargetMap) const;
+
+	// Radius, which capture is framed with
+	void SetProjectionRadius(float NewProjectionRadius);
+
 private:
 	void UpdateFOVDistance();
 
@@ -102,6 +207,35 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Saving")
 	bool bMeshCastShadow = false;
 
+	// Shadows are cast by separate mesh section with tiny coverage and depth atlas and generated shadow only material (masked, single frame, one fetch),
+	// while full impostor section doesn't cast shadows. Requires octahedral grid with orthographic capture.
+	UPROPERTY(EditAnywhere, Category = "Saving", Meta = (EditCondition = "bMeshCastShadow && ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
+	bool bSaveShadowProxy = false;
+
+	// Size of shadow proxy atlas, frames keep their grid
+	UPROPERTY(EditAnywhere, Category = "Saving", Meta = (ClampMin = 16, ClampMax = 2048, EditCondition = "bMeshCastShadow && bSaveShadowProxy && ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
+	int32 ShadowProxyResolution = 256;
+
+	// Screen size of impostor LOD is set, so frame texels match screen pixels when it switches in (at Reference Screen Height from project settings).
+	// It's clamped between screen sizes of neighbor LODs. Textures max size and streaming are set to match.
+	UPROPERTY(EditAnywhere, Category = "Saving")
+	bool bSetLODScreenSize = true;
+
+	// Export to LOD also adds successive LODs with these atlas resolutions (e.g. 1024, 256), downsampled frame by frame from the same capture.
+	// Every LOD of the chain gets its own textures and material, so streaming can drop them whole. Resolutions not below the atlas are skipped.
+	UPROPERTY(EditAnywhere, Category = "Saving", Meta = (ClampMin = 16))
+	TArray<int32> LODChainResolutions;
+
+	// Every frame is also saved as a slice of Texture2DArray per map, so filtering never bleeds between frames and each frame has its own mips.
+	// Slices are resampled to the nearest power of two size. Parent material has to read them behind UseFrameArrays switch, otherwise this is turned off.
+	UPROPERTY(EditAnywhere, Category = "Saving")
+	bool bSaveFrameArrays = false;
+
+	// Atlases are saved as virtual textures (virtual texture support has to be enabled in project), so sampling far impostor streams only pages of its frames.
+	// Best combined with Virtual Texture Tile frame alignment.
+	UPROPERTY(EditAnywhere, Category = "Saving")
+	bool bSaveVirtualTextures = false;
+
 	UPROPERTY(EditAnywhere, Category = "Default")
 	TObjectPtr<UStaticMesh> ReferencedMesh;
 
@@ -139,6 +273,31 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Impostors", Meta = (EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
 	int32 Resolution = 2048;
 
+	// How views are placed over the (hemi)sphere. Frames are stored in the same FramesCount x FramesCount atlas.
+	// Non grid distributions save view lookup textures (3 frame indices and blend weights per direction), which are bound to the saved material.
+	// They require parent material reading view lookup, otherwise distribution is reset to grid.
+	UPROPERTY(EditAnywhere, Category = "Impostors", Meta = (EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
+	EImpostorViewDistribution ViewDistribution = EImpostorViewDistribution::OctahedralGrid;
+
+	// Octahedral grid also saves view lookup textures, so material can blend frames without per pixel grid math and frame triangle interpolation.
+	// Lookup is sampled without filtering, so its resolution should be several times higher than Frames Count.
+	UPROPERTY(EditAnywhere, Category = "Impostors", Meta = (EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards && ViewDistribution == EImpostorViewDistribution::OctahedralGrid", EditConditionHides))
+	bool bSaveGridViewLookup = false;
+
+	// Size of view lookup textures, in (hemi)octahedral mapping of view direction
+	UPROPERTY(EditAnywhere, Category = "Impostors", Meta = (ClampMin = 8, ClampMax = 512, EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards && (ViewDistribution != EImpostorViewDistribution::OctahedralGrid || bSaveGridViewLookup)", EditConditionHides))
+	int32 ViewLookupResolution = 64;
+
+	// Frames are snapped to block or tile boundaries, leftover texels are left as gutter at right and bottom atlas edges.
+	// Parent material has to scale atlas UVs by Frame UV Scale parameter, otherwise alignment is reset to None. Frames smaller than tile are aligned to their power of two size.
+	UPROPERTY(EditAnywhere, Category = "Impostors", Meta = (EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
+	EImpostorFrameAlignment FrameAlignment = EImpostorFrameAlignment::None;
+
+	// Order of frames in atlas cells and frame array slices. Parent material has to remap frame coordinates by MF_ImpostorFrameOrder with Frame Order parameter, otherwise order is reset to Row Major.
+	// ImpostorBaker.SimulateFrameCache console command compares cache misses of the orders. Frames are row major, if Frames Count isn't power of two.
+	UPROPERTY(EditAnywhere, Category = "Impostors", Meta = (EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
+	EImpostorFrameOrder FrameOrder = EImpostorFrameOrder::RowMajor;
+
 	UPROPERTY(EditAnywhere, Category = "Traditional Billboards", Meta = (EditCondition = "ImpostorType == EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
 	int32 FrameSize = 256;
 
@@ -174,9 +333,23 @@ public:
 	TObjectPtr<UMaterialInterface> BillboardMaterial;
 
 	// Composites the depth texture into the normal's alpha. This should be left on unless you are rolling a custom material since all included materials expect it
-	UPROPERTY(EditAnywhere, Category = "Material")
+	UPROPERTY(EditAnywhere, Category = "Material", Meta = (EditCondition = "NormalEncoding == EImpostorNormalEncoding::Packed", EditConditionHides))
 	bool bCombineNormalAndDepth = true;
 
+	// Octahedral encoding keeps the same 8 bits per texel for normal and depth with better normal precision, depth isn't forced when it's not needed.
+	// Material parameter from project settings switches material to octahedral normal decode, encoding is reset to Packed if parent material doesn't have it.
+	UPROPERTY(EditAnywhere, Category = "Material")
+	EImpostorNormalEncoding NormalEncoding = EImpostorNormalEncoding::Packed;
+
+	// Saves per frame min / max depth pyramid and depth range of all frames, bound to material with depth range parameters.
+	// Parallax ray march can be clamped to depth range of frame and skip tiles it can't hit, so it needs fewer steps.
+	UPROPERTY(EditAnywhere, Category = "Material", Meta = (EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards", EditConditionHides))
+	bool bSaveDepthRange = false;
+
+	// Tiles on frame axis in the finest depth range mip, rounded to power of two
+	UPROPERTY(EditAnywhere, Category = "Material", Meta = (ClampMin = 1, ClampMax = 64, EditCondition = "ImpostorType != EImpostorLayoutType::TraditionalBillboards && bSaveDepthRange", EditConditionHides))
+	int32 DepthRangeTilesCount = 8;
+
 	UPROPERTY(EditAnywhere, Category = "Material", Meta = (UIMin = "0", UIMax = "1"))
 	float Specular = 0.5f;
 
@@ -279,6 +452,66 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Projection", Meta = (EditCondition = "ProjectionType == ECameraProjectionMode::Perspective", EditConditionHides))
 	float CameraFOV = 20.0f;
 
+	// Saved impostor is rendered on CPU from random directions and compared with its referenced mesh.
+	// Scores are stored below and are searchable in asset registry, so resolutions can be lowered where they allow.
+	UPROPERTY(EditAnywhere, Category = "Quality")
+	bool bEvaluateQualityOnSave = true;
+
+	// Number of random view directions to compare
+	UPROPERTY(EditAnywhere, Category = "Quality", Meta = (EditCondition = "bEvaluateQualityOnSave", ClampMin = 1, ClampMax = 256))
+	int32 QualityEvaluationViews = 32;
+
+	// Size of images rendered for every direction
+	UPROPERTY(EditAnywhere, Category = "Quality", Meta = (EditCondition = "bEvaluateQualityOnSave", ClampMin = 16, ClampMax = 2048))
+	int32 QualityEvaluationSize = 256;
+
+	// Peak signal to noise ratio of normals, in dB
+	UPROPERTY(VisibleAnywhere, AssetRegistrySearchable, Category = "Quality")
+	float QualityPSNR = 0.f;
+
+	// Structural similarity of normals, 1 is identical
+	UPROPERTY(VisibleAnywhere, AssetRegistrySearchable, Category = "Quality")
+	float QualitySSIM = 0.f;
+
+	// Intersection over union of impostor and mesh silhouettes
+	UPROPERTY(VisibleAnywhere, AssetRegistrySearchable, Category = "Quality")
+	float QualitySilhouetteIoU = 0.f;
+
+	// Mean angle between impostor and mesh normals, in degrees
+	UPROPERTY(VisibleAnywhere, AssetRegistrySearchable, Category = "Quality")
+	float QualityNormalError = 0.f;
+
+	// Frames Count candidates, swept by Auto Tune
+	UPROPERTY(EditAnywhere, Category = "Auto Tune")
+	TArray<int32> AutoTuneFramesCounts = { 8, 12, 16, 24, 32 };
+
+	// Resolution candidates, swept by Auto Tune for every Frames Count. Frames are rasterized once at the largest resolution and resampled for the rest.
+	UPROPERTY(EditAnywhere, Category = "Auto Tune")
+	TArray<int32> AutoTuneResolutions = { 512, 1024, 2048, 4096 };
+
+	// Candidate passes, if mean angle between impostor and mesh normals is lower, in degrees
+	UPROPERTY(EditAnywhere, Category = "Auto Tune", Meta = (ClampMin = "0", ClampMax = "90"))
+	float AutoTuneMaxNormalError = 12.f;
+
+	// Candidate passes, if intersection over union of impostor and mesh silhouettes is higher
+	UPROPERTY(EditAnywhere, Category = "Auto Tune", Meta = (ClampMin = "0", ClampMax = "1"))
+	float AutoTuneMinSilhouetteIoU = 0.95f;
+
+	// Results of the last Auto Tune, selected candidate is applied to Frames Count and Resolution.
+	// Scores are measured on CPU-rasterized frames and are not validated against GPU bake, check quality after baking.
+	UPROPERTY(VisibleAnywhere, Category = "Auto Tune")
+	TArray<FImpostorAutoTuneResult> AutoTuneResults;
+
+	// Material of the shared atlas, which this impostor was last packed into
+	UPROPERTY(VisibleAnywhere, Category = "Shared Atlas")
+	TSoftObjectPtr<UMaterialInterface> SharedAtlasMaterial;
+
+	// Custom primitive data, which components using shared atlas material need (starting at Shared Atlas Primitive Data Index from project settings).
+	// It's set on components of the open level when shared atlas is created, components placed later need it too.
+	// Atlas UV scale (XY) and offset (ZW), then pivot offset (XYZ) and mesh size (W).
+	UPROPERTY(VisibleAnywhere, Category = "Shared Atlas")
+	TArray<float> SharedAtlasPrimitiveData;
+
 	UPROPERTY(EditAnywhere, Category = "Advanced")
 	bool bPreviewCaptureSphere = false;
 
@@ -286,6 +519,15 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Advanced")
 	bool bUseMeshCutout = true;
 
+	// Mesh cutout is predicted on CPU from mesh triangles projected into every capture view, instead of reading back captured alphas.
+	// Cutout (and impostor mesh) is available before anything is captured.
+	UPROPERTY(EditAnywhere, Category = "Advanced", Meta = (EditCondition = "bUseMeshCutout"))
+	bool bUseGeometryCutout = false;
+
+	// Masked materials with texture driven opacity are alpha tested on CPU, so cutout isn't covering transparent parts of cards.
+	UPROPERTY(EditAnywhere, Category = "Advanced", Meta = (EditCondition = "bUseMeshCutout && bUseGeometryCutout"))
+	bool bSampleOpacityForGeometryCutout = true;
+
 	UPROPERTY(EditAnywhere, Category = "Advanced")
 	EImpostorMeshOffsetType MeshOffsetType = EImpostorMeshOffsetType::None;
 
@@ -296,10 +538,56 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Advanced")
 	bool bUseDistanceFieldAlpha = true;
 
+	// Frames capture area is fitted to mesh vertices projected into every capture view, instead of using mesh bounding sphere.
+	// Gives more texels to the mesh itself (especially for tall and thin meshes), so lower Resolution can be used for the same quality.
+	UPROPERTY(EditAnywhere, Category = "Advanced")
+	bool bUseTightProjectionBounds = true;
+
+	// Backend used to capture impostor maps. Maps which selected backend can't produce are captured on GPU.
+	UPROPERTY(EditAnywhere, Category = "Advanced")
+	EImpostorCaptureBackendType CaptureBackend = EImpostorCaptureBackendType::GPU;
+
+	// Capture starts with sparse subset of views at reduced scene capture resolution, which is shown right away (missing frames are copied from the nearest captured views).
+	// All views are then refined over editor ticks, without modal progress dialog. Export is available once refinement is complete.
+	UPROPERTY(EditAnywhere, Category = "Advanced")
+	bool bProgressiveCapture = false;
+
+	// Every Nth frame on each atlas axis is captured in the coarse pass
+	UPROPERTY(EditAnywhere, Category = "Advanced", Meta = (EditCondition = "bProgressiveCapture", ClampMin = "2"))
+	int32 ProgressiveFrameStride = 4;
+
+	// Scene capture resolution of the coarse pass is divided by this value
+	UPROPERTY(EditAnywhere, Category = "Advanced", Meta = (EditCondition = "bProgressiveCapture", ClampMin = "1"))
+	int32 ProgressiveResolutionDivisor = 2;
+
+	// Number of views captured every editor tick while refining
+	UPROPERTY(EditAnywhere, Category = "Advanced", Meta = (EditCondition = "bProgressiveCapture", ClampMin = "1"))
+	int32 ProgressiveViewsPerTick = 4;
+
+	// Mesh geometry is projected into every view on CPU, and views which don't cover any texel aren't captured for any map.
+	// E.g. bottom views of decals and ground cover in Full Sphere View.
+	UPROPERTY(EditAnywhere, Category = "Advanced")
+	bool bSkipEmptyFrames = true;
+
+	// Mesh is analyzed for rotational symmetry around vertical axis and vertical mirror planes (matching positions, normals, UVs and materials).
+	// Views which are symmetric copies of other views aren't captured, their frames are copied (and normals transformed) from captured ones.
+	// Lit captures (Custom Lighting, Base Color with final color) are always done for every view.
+	UPROPERTY(EditAnywhere, Category = "Advanced")
+	bool bSkipSymmetricCaptures = false;
+
+	// Baked maps are saved as PNG files into Saved/ImpostorBaker/Replay, so later bakes can replay them with Replay capture backend.
+	UPROPERTY(EditAnywhere, Category = "Advanced")
+	bool bRecordCapturesForReplay = false;
+
 	// Resolution for scene capturing (single frame before compositing into one texture). Generally should be slightly higher than sub frame resolution. Large sizes (>512) will take a long time to render due to distance field calculation
 	UPROPERTY(EditAnywhere, Category = "Advanced")
 	int32 SceneCaptureResolution = 512;
 
+	// Maps are captured at Scene Capture Resolution and saved at atlas size divided by their divisor (rounded to power of two, up to 8), e.g. 2 for Roughness or Depth halves their texels on each axis.
+	// Base Color stays at full size, Custom Lighting combined into Base Color and Depth combined into Normal alpha follow the map they're saved in.
+	UPROPERTY(EditAnywhere, Category = "Advanced", Meta = (ClampMin = "1", ClampMax = "8"))
+	TMap<EImpostorBakeMapType, int32> MapResolutionDivisors;
+
 	UPROPERTY(VisibleAnywhere, Category = "Advanced", AdvancedDisplay)
 	int32 SceneCaptureMips = 9;
 
@@ -312,6 +600,10 @@ public:
 	UPROPERTY(VisibleAnywhere, Category = "Advanced", AdvancedDisplay)
 	int32 DFMipTarget = 8;
 
+	// Radius of area captured into single frame. Either bounding sphere radius or tight projected radius.
+	UPROPERTY(VisibleAnywhere, Category = "Advanced", AdvancedDisplay)
+	float ProjectionRadius = 0.f;
+
 	// Will display vertices with their data in viewport
 	UPROPERTY(VisibleAnywhere, Category = "Advanced", AdvancedDisplay)
 	bool bDisplayVertices = false;
@@ -1,9 +1,16 @@
 ﻿#include "ImpostorBakerManager.h"
+#include <Engine/StaticMesh.h>
+#include <Misc/MessageDialog.h>
+#include <Misc/Paths.h>
+#include "ImpostorBakerEditorModule.h"
 #include "ImpostorLightingManager.h"
 #include "ImpostorMaterialsManager.h"
 #include "ImpostorComponentsManager.h"
 #include "ImpostorProceduralMeshManager.h"
 #include "ImpostorRenderTargetsManager.h"
+#include "ImpostorData/ImpostorData.h"
+#include "Utilities/ImpostorAutoTuner.h"
+#include "Utilities/ImpostorImageMetrics.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorBakerManager)
 
@@ -42,6 +49,9 @@ void UImpostorBakerManager::Initialize()
 
 void UImpostorBakerManager::FullUpdate()
 {
+	// Options are validated before any manager reads them
+	GetManager<UImpostorMaterialsManager>()->ValidateParentSupport();
+
 	for (UImpostorBaseManager* Manager : Managers)
 	{
 		Manager->Update();
@@ -59,6 +69,11 @@ void UImpostorBakerManager::Bake()
 	SetOverlayText("NeedsRebake", "");
 }
 
+bool UImpostorBakerManager::NeedsCapture() const
+{
+	return bNeedsCapture || GetManager<UImpostorRenderTargetsManager>()->IsBaking();
+}
+
 void UImpostorBakerManager::ClearRenderTargets() const
 {
 	GetManager<UImpostorRenderTargetsManager>()->ClearRenderTargets();
@@ -66,24 +81,233 @@ void UImpostorBakerManager::ClearRenderTargets() const
 
 void UImpostorBakerManager::CreateAssets() const
 {
-	UImpostorBaseManager::StartSlowTask(GetManager<UImpostorRenderTargetsManager>()->MapsToSave.Num() + 2, "Creating impostor mesh assets...");
+	UImpostorBaseManager::StartSlowTask(GetManager<UImpostorRenderTargetsManager>()->MapsToSave.Num() * (ImpostorData->bSaveFrameArrays ? 2 : 1) + 5, "Creating impostor mesh assets...");
 	const TMap<EImpostorBakeMapType, UTexture2D*> NewTextures = GetManager<UImpostorRenderTargetsManager>()->SaveTextures();
-	if (UMaterialInstanceConstant* NewMaterial = GetManager<UImpostorMaterialsManager>()->SaveMaterial(NewTextures))
+	const TMap<EImpostorBakeMapType, UTexture2DArray*> NewTextureArrays = GetManager<UImpostorRenderTargetsManager>()->SaveTextureArrays(NewTextures);
+	EvaluateQuality();
+	if (UMaterialInstanceConstant* NewMaterial = GetManager<UImpostorMaterialsManager>()->SaveMaterial(NewTextures, NewTextureArrays))
 	{
-		GetManager<UImpostorProceduralMeshManager>()->SaveMesh(NewMaterial);
+		UMaterialInstanceConstant* ShadowMaterial = GetManager<UImpostorMaterialsManager>()->SaveShadowProxyMaterial(GetManager<UImpostorRenderTargetsManager>()->SaveShadowProxyTexture(NewTextures));
+		GetManager<UImpostorProceduralMeshManager>()->SaveMesh(NewMaterial, ShadowMaterial);
 	}
 	UImpostorBaseManager::EndSlowTask();
 }
 
 void UImpostorBakerManager::AddLOD()
 {
-	UImpostorBaseManager::StartSlowTask(GetManager<UImpostorRenderTargetsManager>()->MapsToSave.Num() + 2, "Adding impostor LOD to referenced mesh...");
-	const TMap<EImpostorBakeMapType, UTexture2D*> NewTextures = GetManager<UImpostorRenderTargetsManager>()->SaveTextures();
-	if (UMaterialInstanceConstant* NewMaterial = GetManager<UImpostorMaterialsManager>()->SaveMaterial(NewTextures))
+	// Chain LODs follow Target LOD and replace existing LODs of referenced mesh at their indices
+	const int32 NumChainLODs = GetLODChainResolutions().Num();
+	const int32 NumExistingLODs = ImpostorData->ReferencedMesh ? ImpostorData->ReferencedMesh->GetNumSourceModels() : 0;
+	if (NumChainLODs > 0 &&
+		ImpostorData->TargetLOD + 1 < NumExistingLODs)
+	{
+		const FString Message = FString::Printf(TEXT("Impostor LOD chain replaces existing LOD%d-%d of %s. Continue?"),
+			ImpostorData->TargetLOD + 1,
+			FMath::Min(ImpostorData->TargetLOD + NumChainLODs, NumExistingLODs - 1),
+			*ImpostorData->ReferencedMesh->GetName());
+		if (FMessageDialog::Open(EAppMsgType::YesNo, EAppReturnType::No, FText::FromString(Message)) != EAppReturnType::Yes)
+		{
+			return;
+		}
+	}
+
+	const int32 NumMapSteps = GetManager<UImpostorRenderTargetsManager>()->MapsToSave.Num() * (ImpostorData->bSaveFrameArrays ? 2 : 1);
+	UImpostorBaseManager::StartSlowTask((NumMapSteps + 3) * (NumChainLODs + 1) + 2, "Preparing impostor LOD for referenced mesh...");
+	TArray<FImpostorLODDescription> Descriptions = { PrepareLOD() };
+	if (Descriptions[0].IsValid())
+	{
+		Descriptions.Append(PrepareLODChain(Descriptions[0]));
+	}
+	UImpostorBaseManager::EndSlowTask();
+
+	if (Descriptions[0].IsValid())
 	{
-		GetManager<UImpostorProceduralMeshManager>()->UpdateLOD(NewMaterial);
+		AddLODs(Descriptions);
 	}
+}
+
+void UImpostorBakerManager::AutoTune()
+{
+	UImpostorBaseManager::StartSlowTask(ImpostorData->AutoTuneFramesCounts.Num(), "Tuning impostor settings...");
+	TArray<FImpostorAutoTuneResult> Results = FImpostorAutoTuner::Run(*ImpostorData, [](const FString& Message)
+	{
+		UImpostorBaseManager::ProgressSlowTask(Message, true);
+	});
 	UImpostorBaseManager::EndSlowTask();
+
+	const int32 Selected = FImpostorAutoTuner::SelectResult(Results);
+	if (Selected == INDEX_NONE)
+	{
+		FMessageDialog::Open(EAppMsgType::Ok, INVTEXT("Auto tune requires (hemi)octahedral impostor with referenced mesh and at least one Frames Count and Resolution candidate."));
+		return;
+	}
+
+	Results[Selected].bSelected = true;
+
+	const FString Filename = FPaths::ProjectSavedDir() / "ImpostorBaker" / "AutoTune" / ImpostorData->NewTextureName + ".csv";
+	FImpostorAutoTuner::SaveResults(Results, Filename);
+
+	const FImpostorAutoTuneResult& Result = Results[Selected];
+	UE_LOG(LogImpostorBaker, Log, TEXT("%s auto tune: %d x %d frames at %d (%.2f deg normal error, %.3f silhouette IoU, %s, estimated from CPU-rasterized frames, not validated against GPU bake), results are saved to %s"),
+		*ImpostorData->GetName(),
+		Result.FramesCount,
+		Result.FramesCount,
+		Result.Resolution,
+		Result.NormalError,
+		Result.SilhouetteIoU,
+		Result.bPassed ? TEXT("passed") : TEXT("no candidate passed, the most accurate one is used"),
+		*Filename);
+
+	ImpostorData->Modify();
+	ImpostorData->AutoTuneResults = Results;
+	ImpostorData->FramesCount = Result.FramesCount;
+	ImpostorData->Resolution = Result.Resolution;
+
+	FullUpdate();
+}
+
+FImpostorLODDescription UImpostorBakerManager::PrepareLOD()
+{
+	const float ScreenSize = GetManager<UImpostorProceduralMeshManager>()->GetLODScreenSize();
+	const TMap<EImpostorBakeMapType, UTexture2D*> NewTextures = GetManager<UImpostorRenderTargetsManager>()->SaveTextures(ScreenSize);
+	const TMap<EImpostorBakeMapType, UTexture2DArray*> NewTextureArrays = GetManager<UImpostorRenderTargetsManager>()->SaveTextureArrays(NewTextures);
+	EvaluateQuality();
+	if (UMaterialInstanceConstant* NewMaterial = GetManager<UImpostorMaterialsManager>()->SaveMaterial(NewTextures, NewTextureArrays))
+	{
+		UMaterialInstanceConstant* ShadowMaterial = GetManager<UImpostorMaterialsManager>()->SaveShadowProxyMaterial(GetManager<UImpostorRenderTargetsManager>()->SaveShadowProxyTexture(NewTextures));
+		return GetManager<UImpostorProceduralMeshManager>()->PrepareLOD(NewMaterial, ShadowMaterial);
+	}
+
+	return {};
+}
+
+TArray<FImpostorLODDescription> UImpostorBakerManager::PrepareLODChain(const FImpostorLODDescription& First)
+{
+	TArray<FImpostorLODDescription> Descriptions;
+
+	const TArray<int32> Resolutions = GetLODChainResolutions();
+	if (Resolutions.Num() == 0)
+	{
+		return Descriptions;
+	}
+
+	// Lower resolutions are downsampled from textures of the first LOD, so there is only one capture
+	TMap<EImpostorBakeMapType, UTexture2D*> SourceTextures;
+	for (const EImpostorBakeMapType TargetMap : GetManager<UImpostorRenderTargetsManager>()->MapsToSave)
+	{
+		if (UTexture2D* Texture = ImpostorData->LoadSavedTexture(TargetMap))
+		{
+			SourceTextures.Add(TargetMap, Texture);
+		}
+	}
+
+	const FString TextureName = ImpostorData->NewTextureName;
+	const FString MaterialName = ImpostorData->NewMaterialName;
+	const FString MeshName = ImpostorData->NewMeshName;
+
+	float ScreenSize = First.ScreenSize;
+	for (int32 Index = 0; Index < Resolutions.Num(); Index++)
+	{
+		// Assets of every LOD are saved next to the first ones, with resolution suffix
+		const FString Suffix = "_" + LexToString(Resolutions[Index]);
+		TGuardValue<FString> TextureNameGuard(ImpostorData->NewTextureName, TextureName + Suffix);
+		TGuardValue<FString> MaterialNameGuard(ImpostorData->NewMaterialName, MaterialName + Suffix);
+		TGuardValue<FString> MeshNameGuard(ImpostorData->NewMeshName, MeshName + Suffix);
+		TGuardValue<int32> TargetLODGuard(ImpostorData->TargetLOD, First.LODIndex + Index + 1);
+
+		const TMap<EImpostorBakeMapType, UTexture2D*> NewTextures = GetManager<UImpostorRenderTargetsManager>()->SaveDownsampledTextures(SourceTextures, Resolutions[Index]);
+		const TMap<EImpostorBakeMapType, UTexture2DArray*> NewTextureArrays = GetManager<UImpostorRenderTargetsManager>()->SaveTextureArrays(NewTextures);
+		UMaterialInstanceConstant* NewMaterial = GetManager<UImpostorMaterialsManager>()->SaveMaterial(NewTextures, NewTextureArrays);
+		if (!NewMaterial)
+		{
+			break;
+		}
+
+		// Shadow proxy is already low resolution, so the whole chain shares the one of the first LOD
+		FImpostorLODDescription Description = GetManager<UImpostorProceduralMeshManager>()->PrepareLOD(NewMaterial, First.ShadowMaterial);
+		if (!Description.IsValid())
+		{
+			break;
+		}
+
+		ScreenSize = GetManager<UImpostorProceduralMeshManager>()->GetChainLODScreenSize(Resolutions[Index], ScreenSize);
+		Description.ScreenSize = ScreenSize;
+		Descriptions.Add(Description);
+
+		UE_LOG(LogImpostorBaker, Log, TEXT("%s: LOD%d of impostor chain at %d, screen size %.3f"), *ImpostorData->GetName(), Description.LODIndex, Resolutions[Index], ScreenSize);
+	}
+
+	return Descriptions;
+}
+
+void UImpostorBakerManager::AddLODs(const TArray<FImpostorLODDescription>& Descriptions)
+{
+	if (Descriptions.Num() == 0)
+	{
+		return;
+	}
+
+	// Applying and waiting for each build
+	UImpostorBaseManager::StartSlowTask(Descriptions.Num() * 2, "Adding impostor LODs to referenced meshes...");
+	const TArray<FText> Errors = UImpostorProceduralMeshManager::BuildLODs(Descriptions);
+	UImpostorBaseManager::EndSlowTask();
+
+	if (Errors.Num() == 0)
+	{
+		return;
+	}
+
+	FTextBuilder Summary;
+	Summary.AppendLine(FText::FromString(LexToString(Errors.Num()) + " error(s) while adding " + LexToString(Descriptions.Num()) + " impostor LOD(s):"));
+	for (const FText& Error : Errors)
+	{
+		UE_LOG(LogImpostorBaker, Warning, TEXT("%s"), *Error.ToString());
+		Summary.AppendLine(Error);
+	}
+
+	FMessageDialog::Open(EAppMsgType::Ok, Summary.ToText());
+}
+
+void UImpostorBakerManager::EvaluateQuality() const
+{
+	UImpostorBaseManager::ProgressSlowTask("Evaluating impostor quality...", true);
+
+	if (!ImpostorData->bEvaluateQualityOnSave)
+	{
+		return;
+	}
+
+	FImpostorImageMetrics Metrics;
+	if (!FImpostorImageMetrics::EvaluateImpostor(*ImpostorData, ImpostorData->QualityEvaluationViews, ImpostorData->QualityEvaluationSize, Metrics))
+	{
+		UE_LOG(LogImpostorBaker, Warning, TEXT("%s: quality wasn't evaluated, (hemi)octahedral impostor with saved Base Color texture is required"), *ImpostorData->GetName());
+		return;
+	}
+
+	ImpostorData->Modify();
+	ImpostorData->QualityPSNR = Metrics.PSNR;
+	ImpostorData->QualitySSIM = Metrics.SSIM;
+	ImpostorData->QualitySilhouetteIoU = Metrics.SilhouetteIoU;
+	ImpostorData->QualityNormalError = Metrics.NormalAngularError;
+
+	UE_LOG(LogImpostorBaker, Log, TEXT("%s quality: %s"), *ImpostorData->GetName(), *Metrics.ToString());
+}
+
+TArray<int32> UImpostorBakerManager::GetLODChainResolutions() const
+{
+	const int32 AtlasSize = GetManager<UImpostorComponentsManager>()->GetRenderTargetSize().X;
+	TArray<int32> Resolutions;
+	for (const int32 Resolution : ImpostorData->LODChainResolutions)
+	{
+		if (Resolution > 0 &&
+			Resolution < AtlasSize)
+		{
+			Resolutions.AddUnique(Resolution);
+		}
+	}
+
+	Resolutions.Sort(TGreater<int32>());
+	return Resolutions;
 }
 
 void UImpostorBakerManager::Cleanup()
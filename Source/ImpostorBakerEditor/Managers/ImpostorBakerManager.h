@@ -7,6 +7,7 @@
 class UImpostorBaseManager;
 class UImpostorData;
 class USkyLightComponent;
+struct FImpostorLODDescription;
 
 DECLARE_DELEGATE_OneParam(FImpostorManageComponent, USceneComponent*);
 DECLARE_DELEGATE_OneParam(FImpostorForceTick, bool);
@@ -33,8 +34,19 @@ public:
 	void ClearRenderTargets() const;
 	void CreateAssets() const;
 	void AddLOD();
+
+	// Sweeps Frames Count and Resolution candidates on CPU and applies the cheapest one, which meets quality thresholds
+	void AutoTune();
 	void Cleanup();
 
+	// Saves textures, material and impostor mesh, but doesn't touch referenced mesh yet
+	FImpostorLODDescription PrepareLOD();
+	// Saves lower resolution LODs of LOD Chain Resolutions from textures of First, for LODs following it
+	TArray<FImpostorLODDescription> PrepareLODChain(const FImpostorLODDescription& First);
+
+	// Adds all prepared impostor LODs at once, building referenced meshes in parallel
+	static void AddLODs(const TArray<FImpostorLODDescription>& Descriptions);
+
 public:
 	void Tick();
 
@@ -42,12 +54,16 @@ public:
 	void SetOverlayText(FName Section, const FString& Text, bool bIsWarning);
 	void SetOverlayText(FName Section, const FString& Text);
 
-	bool NeedsCapture() const
-	{
-		return bNeedsCapture;
-	}
+	// Also true while capture (or progressive refinement) is in progress
+	bool NeedsCapture() const;
 
 private:
+	// Compares saved impostor with referenced mesh on CPU and stores scores into ImpostorData
+	void EvaluateQuality() const;
+
+	// LOD Chain Resolutions below the atlas size, from the highest
+	TArray<int32> GetLODChainResolutions() const;
+
 	template<typename ManagerClass>
 	void AddManager()
 	{
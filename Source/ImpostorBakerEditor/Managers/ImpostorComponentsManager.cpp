@@ -1,11 +1,21 @@
 ﻿#include "ImpostorComponentsManager.h"
+#include <AssetRegistry/AssetRegistryModule.h>
 #include <Components/StaticMeshComponent.h>
 #include <Engine/StaticMesh.h>
+#include <Engine/Texture2D.h>
 #include <Materials/MaterialInstanceDynamic.h>
 #include <UObject/Package.h>
+#include "ImpostorBakerEditorModule.h"
 #include "ImpostorData/ImpostorData.h"
 #include "ImpostorLightingManager.h"
+#include "Settings/ImpostorBakerSettings.h"
 #include "Utilities/ImpostorBakerUtilities.h"
+#include "Utilities/ImpostorDepthRange.h"
+#include "Utilities/ImpostorFrameOrder.h"
+#include "Utilities/ImpostorImage.h"
+#include "Utilities/ImpostorMeshGeometry.h"
+#include "Utilities/ImpostorRasterizer.h"
+#include "Utilities/ImpostorViewDistribution.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorComponentsManager)
 
@@ -76,8 +86,19 @@ void UImpostorComponentsManager::UpdateReferencedMeshData()
 
 void UImpostorComponentsManager::UpdateComponentsData()
 {
-	ObjectRadius = GetBounds().SphereRadius;
 	OffsetVector = GetBounds().Origin - ReferencedMeshComponent->GetComponentLocation();
+
+	if (ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards)
+	{
+		SetupTraditionalBillboardLayout();
+		SetOverlayText("ViewAngularError", "");
+	}
+	else
+	{
+		SetupOctahedronLayout();
+	}
+
+	UpdateObjectRadius();
 	DebugTexelSize = ObjectRadius / 16.f;
 
 	const FVector Scale(ObjectRadius / 256.f * 2.f, ObjectRadius / 256.f * 2.f, 0.05f);
@@ -93,15 +114,6 @@ void UImpostorComponentsManager::UpdateComponentsData()
 		MeshStandComponent->SetRelativeLocation(RelativeOffset);
 	}
 
-	if (ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards)
-	{
-		SetupTraditionalBillboardLayout();
-	}
-	else
-	{
-		SetupOctahedronLayout();
-	}
-
 	SetupPreviewMeshes();
 }
 
@@ -109,16 +121,19 @@ void UImpostorComponentsManager::SetupOctahedronLayout()
 {
 	NumHorizontalFrames = NumVerticalFrames = ImpostorData->FramesCount;
 
-	ViewCaptureVectors.Empty();
-	ViewCaptureVectors.SetNumUninitialized(ImpostorData->FramesCount * ImpostorData->FramesCount);
+	ViewCaptureVectors = FImpostorViewDistribution::MakeViewVectors(*ImpostorData);
+
+	const bool bHemisphere = ImpostorData->ImpostorType == EImpostorLayoutType::UpperHemisphereOnly;
+	const float GridError = FImpostorViewDistribution::GetMaxAngularError(FImpostorViewDistribution::MakeGridVectors(ImpostorData->FramesCount, ImpostorData->ImpostorType), bHemisphere);
 
-	for (int32 Y = 0; Y < ImpostorData->FramesCount; Y++)
+	if (ImpostorData->ViewDistribution == EImpostorViewDistribution::OctahedralGrid)
 	{
-		for (int32 X = 0; X < ImpostorData->FramesCount; X++)
-		{
-			ViewCaptureVectors[Y * ImpostorData->FramesCount + X] = FImpostorBakerUtilities::GetGridVector(X, Y, ImpostorData->FramesCount, ImpostorData->ImpostorType);
-		}
+		SetOverlayText("ViewAngularError", "Max View Angular Error", FString::Printf(TEXT("%.2f deg"), GridError));
+		return;
 	}
+
+	const float Error = FImpostorViewDistribution::GetMaxAngularError(ViewCaptureVectors, bHemisphere);
+	SetOverlayText("ViewAngularError", "Max View Angular Error", FString::Printf(TEXT("%.2f deg (octahedral grid %.2f deg)"), Error, GridError));
 }
 
 void UImpostorComponentsManager::SetupTraditionalBillboardLayout()
@@ -156,6 +171,38 @@ void UImpostorComponentsManager::SetupTraditionalBillboardLayout()
 	}
 }
 
+void UImpostorComponentsManager::UpdateObjectRadius()
+{
+	const float SphereRadius = GetBounds().SphereRadius;
+	ObjectRadius = SphereRadius;
+	CaptureDepthRadius = SphereRadius;
+
+	if (ImpostorData->bUseTightProjectionBounds)
+	{
+		// Geometry is in mesh space, same as OffsetVector
+		float DepthRadius = 0.f;
+		const float ProjectedRadius = FImpostorMeshGeometry::Gather(ImpostorData->ReferencedMesh).GetProjectedRadius(OffsetVector, ViewCaptureVectors, &DepthRadius);
+		if (ProjectedRadius > 0.f)
+		{
+			ObjectRadius = ProjectedRadius;
+			CaptureDepthRadius = FMath::Max(ProjectedRadius, DepthRadius);
+		}
+	}
+
+	ImpostorData->SetProjectionRadius(ObjectRadius);
+
+	if (ObjectRadius < SphereRadius)
+	{
+		// Frame area ratio, which is now covered by the mesh instead of empty space
+		const float Gain = FMath::Square(SphereRadius / ObjectRadius);
+		SetOverlayText("TexelUtilization", "Texel Utilization", FString::Printf(TEXT("x%.2f (radius %.1f instead of %.1f)"), Gain, ObjectRadius, SphereRadius));
+	}
+	else
+	{
+		SetOverlayText("TexelUtilization", "");
+	}
+}
+
 void UImpostorComponentsManager::SetupPreviewMeshes()
 {
 	for (int32 Index = 0; Index < ViewCaptureVectors.Num(); Index++)
@@ -200,9 +247,19 @@ void UImpostorComponentsManager::SetupPreviewMeshes()
 
 	SetOverlayText("FramesCount", "Frames Count", LexToString(NumHorizontalFrames * NumVerticalFrames));
 
-	const int32 FrameSize = ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards ? ImpostorData->FrameSize : (ImpostorData->Resolution / ImpostorData->FramesCount);
+	const int32 FrameSize = ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards ? ImpostorData->FrameSize : FMath::FloorToInt32(GetFramePitch().X);
 	SetOverlayText("FrameSize", "Single Frame Size", LexToString(FrameSize) + "x" + LexToString(FrameSize));
 
+	const float UnusedArea = GetUnusedAtlasArea();
+	if (UnusedArea > GetDefault<UImpostorBakerSettings>()->FrameAlignmentMaxUnusedArea)
+	{
+		SetOverlayText("UnusedAtlasArea", FString::Printf(TEXT("Frame Alignment leaves %.0f%% of the atlas unused, change Frames Count or Resolution"), UnusedArea * 100.f), true);
+	}
+	else
+	{
+		SetOverlayText("UnusedAtlasArea", "");
+	}
+
 	const int32 TextureSizeX = ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards ? NumHorizontalFrames * ImpostorData->FrameSize : ImpostorData->Resolution;
 	const int32 TextureSizeY = ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards ? NumVerticalFrames * ImpostorData->FrameSize : ImpostorData->Resolution;
 	SetOverlayText("TextureSize", "Texture Size", LexToString(TextureSizeX) + "x" + LexToString(TextureSizeY));
@@ -221,6 +278,11 @@ FBoxSphereBounds UImpostorComponentsManager::GetBounds() const
 	return Bounds;
 }
 
+FImpostorViewProjection UImpostorComponentsManager::GetViewProjection(const int32 VectorIndex) const
+{
+	return FImpostorViewProjection(ViewCaptureVectors[VectorIndex], OffsetVector, ObjectRadius, ImpostorData->ProjectionType, ImpostorData->CameraDistance, ImpostorData->CameraFOV);
+}
+
 FVector2D UImpostorComponentsManager::GetRenderTargetSize() const
 {
 	switch (ImpostorData->ImpostorType)
@@ -230,4 +292,244 @@ FVector2D UImpostorComponentsManager::GetRenderTargetSize() const
 	case EImpostorLayoutType::UpperHemisphereOnly: return FVector2D(ImpostorData->Resolution, ImpostorData->Resolution);
 	case EImpostorLayoutType::TraditionalBillboards: return FVector2D(ImpostorData->FrameSize * NumHorizontalFrames, ImpostorData->FrameSize * NumVerticalFrames);
 	}
-}
\ No newline at end of file
+}
+
+FIntPoint UImpostorComponentsManager::GetMapAtlasSize(const EImpostorBakeMapType TargetMap) const
+{
+	return (GetRenderTargetSize().IntPoint() / ImpostorData->GetMapResolutionDivisor(TargetMap)).ComponentMax(FIntPoint(1, 1));
+}
+
+FVector2D UImpostorComponentsManager::GetFramePitch() const
+{
+	const FVector2D Size = GetRenderTargetSize();
+	const int32 Alignment = ImpostorData->GetFrameAlignment();
+
+	return FVector2D(
+		FImpostorBakerUtilities::GetFramePitch(FMath::RoundToInt32(Size.X), NumHorizontalFrames, Alignment),
+		FImpostorBakerUtilities::GetFramePitch(FMath::RoundToInt32(Size.Y), NumVerticalFrames, Alignment));
+}
+
+int32 UImpostorComponentsManager::GetFrameSlot(const int32 VectorIndex) const
+{
+	return FImpostorFrameOrder::GetSlot(ImpostorData->GetFrameOrder(), VectorIndex, NumHorizontalFrames);
+}
+
+FIntPoint UImpostorComponentsManager::GetFrameCell(const int32 VectorIndex) const
+{
+	const int32 Slot = GetFrameSlot(VectorIndex);
+	return FIntPoint(Slot % NumHorizontalFrames, Slot / NumHorizontalFrames);
+}
+
+FIntRect UImpostorComponentsManager::GetFrameRect(const int32 VectorIndex) const
+{
+	// Same placement as frames drawn into render targets
+	const FVector2D FrameSize = GetFramePitch();
+	const FIntPoint Cell = GetFrameCell(VectorIndex);
+	const FIntPoint Min(FMath::FloorToInt32(FrameSize.X * Cell.X), FMath::FloorToInt32(FrameSize.Y * Cell.Y));
+
+	return FIntRect(Min, Min + FIntPoint(FMath::FloorToInt32(FrameSize.X), FMath::FloorToInt32(FrameSize.Y)));
+}
+
+FIntRect UImpostorComponentsManager::GetFrameRect(const int32 VectorIndex, const FIntPoint& AtlasSize) const
+{
+	const FVector2D Scale = FVector2D(AtlasSize) / GetRenderTargetSize();
+	const FIntRect Rect = GetFrameRect(VectorIndex);
+	const FIntPoint Min(FMath::FloorToInt32(Rect.Min.X * Scale.X), FMath::FloorToInt32(Rect.Min.Y * Scale.Y));
+	const FIntPoint Max(FMath::FloorToInt32(Rect.Max.X * Scale.X), FMath::FloorToInt32(Rect.Max.Y * Scale.Y));
+
+	return FIntRect(Min, Max.ComponentMax(Min + 1));
+}
+
+float UImpostorComponentsManager::GetRequiredAtlasSize(const float ScreenSize) const
+{
+	// Mesh bounding sphere covers ScreenSize of screen height, while frame covers projection radius
+	const float SphereRadius = FMath::Max(ImpostorData->ReferencedMesh->GetBounds().SphereRadius, UE_KINDA_SMALL_NUMBER);
+	return ScreenSize * GetDefault<UImpostorBakerSettings>()->ReferenceScreenHeight * ObjectRadius / SphereRadius * NumHorizontalFrames / GetFrameUVScale();
+}
+
+float UImpostorComponentsManager::GetFrameUVScale() const
+{
+	return GetFramePitch().X * NumHorizontalFrames / FMath::Max(GetRenderTargetSize().X, 1.0);
+}
+
+float UImpostorComponentsManager::GetUnusedAtlasArea() const
+{
+	const FVector2D UsedSize = GetFramePitch() * FVector2D(NumHorizontalFrames, NumVerticalFrames);
+	const FVector2D Size = GetRenderTargetSize();
+	return FMath::Max(0.f, 1.f - UsedSize.X * UsedSize.Y / FMath::Max(Size.X * Size.Y, 1.0));
+}
+
+bool UImpostorComponentsManager::SaveViewLookupTextures(UTexture2D*& OutIndices, UTexture2D*& OutWeights) const
+{
+	if (ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards)
+	{
+		return false;
+	}
+
+	if (ImpostorData->ViewDistribution == EImpostorViewDistribution::OctahedralGrid &&
+		!ImpostorData->bSaveGridViewLookup)
+	{
+		return false;
+	}
+
+	const FImpostorViewDistribution Distribution = FImpostorViewDistribution::Create(*ImpostorData, ViewCaptureVectors);
+
+	if (!ensure(!Distribution.IsEmpty()))
+	{
+		return false;
+	}
+
+	const int32 Size = ImpostorData->ViewLookupResolution;
+
+	TArray<FLinearColor> Indices;
+	FImpostorImage Weights;
+	Distribution.BakeLookup(Size, Indices, Weights);
+
+	bool bIndicesCreated = false;
+	bool bWeightsCreated = false;
+	OutIndices = FindOrCreateTexture("ViewLookupIndices", bIndicesCreated);
+	OutWeights = FindOrCreateTexture("ViewLookupWeights", bWeightsCreated);
+	if (!ensure(OutIndices) ||
+		!ensure(OutWeights))
+	{
+		return false;
+	}
+
+	OutIndices->Source.Init(Size, Size, 1, 1, TSF_RGBA32F, reinterpret_cast<const uint8*>(Indices.GetData()));
+	Weights.WriteToTextureSource(OutWeights);
+
+	for (UTexture2D* Texture : { OutIndices, OutWeights })
+	{
+		Texture->PreEditChange(nullptr);
+
+		// Texels are exact values, which mustn't be filtered, compressed or streamed out
+		Texture->CompressionSettings = Texture == OutIndices ? TC_HDR_F32 : TC_VectorDisplacementmap;
+		Texture->SRGB = false;
+		Texture->Filter = TF_Nearest;
+		Texture->MipGenSettings = TMGS_NoMipmaps;
+		Texture->NeverStream = true;
+		Texture->AddressX = TA_Clamp;
+		Texture->AddressY = TA_Clamp;
+
+		Texture->UpdateResource();
+		Texture->PostEditChange();
+		Texture->MarkPackageDirty();
+	}
+
+	if (bIndicesCreated)
+	{
+		FAssetRegistryModule::AssetCreated(OutIndices);
+	}
+	if (bWeightsCreated)
+	{
+		FAssetRegistryModule::AssetCreated(OutWeights);
+	}
+
+	return true;
+}
+
+bool UImpostorComponentsManager::SaveDepthRangeTexture(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures, UTexture2D*& OutDepthRange, FVector2D& OutMinMax) const
+{
+	if (ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards ||
+		!ImpostorData->bSaveDepthRange)
+	{
+		return false;
+	}
+
+	// Same maps as read by material and FImpostorRenderSource
+	const bool bDepthInNormalAlpha = ImpostorData->CombinesNormalAndDepth();
+
+	FImpostorImage Depth;
+	if (!Depth.ReadFromTextureSource(Textures.FindRef(bDepthInNormalAlpha ? EImpostorBakeMapType::Normal : EImpostorBakeMapType::Depth)))
+	{
+		UE_LOG(LogImpostorBaker, Warning, TEXT("%s: depth map isn't saved, depth range texture is skipped"), *ImpostorData->GetName());
+		return false;
+	}
+
+	FImpostorImage Coverage;
+	Coverage.ReadFromTextureSource(Textures.FindRef(EImpostorBakeMapType::BaseColor));
+
+	// Depth saved with resolution divisor is smaller than Base Color, box filter keeps partially covered texels
+	if (!Coverage.IsEmpty() &&
+		Coverage.GetSize() != Depth.GetSize())
+	{
+		Coverage = Coverage.Resample(FIntRect(FIntPoint::ZeroValue, Coverage.GetSize()), Depth.GetSize());
+	}
+
+	// Frames are found in saved texture, which can be smaller than render target
+	TArray<FIntRect> CellRects;
+	CellRects.SetNum(NumHorizontalFrames * NumVerticalFrames);
+	for (int32 Index = 0; Index < ViewCaptureVectors.Num(); Index++)
+	{
+		CellRects[GetFrameSlot(Index)] = GetFrameRect(Index, Depth.GetSize());
+	}
+
+	const int32 TilesCount = FMath::RoundUpToPowerOfTwo(FMath::Max(ImpostorData->DepthRangeTilesCount, 1));
+	const FImpostorDepthRange DepthRange = FImpostorDepthRange::Build(Depth, bDepthInNormalAlpha ? 3 : 0, Coverage, CellRects, NumHorizontalFrames, TilesCount);
+	if (!ensure(!DepthRange.IsEmpty()))
+	{
+		return false;
+	}
+
+	bool bCreated = false;
+	OutDepthRange = FindOrCreateTexture("DepthRange", bCreated);
+	if (!ensure(OutDepthRange))
+	{
+		return false;
+	}
+
+	DepthRange.WriteToTextureSource(OutDepthRange);
+
+	OutDepthRange->PreEditChange(nullptr);
+
+	// Texels are exact ranges, mips are built by min / max reduction instead of averaging
+	OutDepthRange->CompressionSettings = TC_VectorDisplacementmap;
+	OutDepthRange->SRGB = false;
+	OutDepthRange->Filter = TF_Nearest;
+	OutDepthRange->MipGenSettings = TMGS_LeaveExistingMips;
+	OutDepthRange->NeverStream = true;
+	OutDepthRange->AddressX = TA_Clamp;
+	OutDepthRange->AddressY = TA_Clamp;
+
+	OutDepthRange->UpdateResource();
+	OutDepthRange->PostEditChange();
+	OutDepthRange->MarkPackageDirty();
+
+	if (bCreated)
+	{
+		FAssetRegistryModule::AssetCreated(OutDepthRange);
+	}
+
+	OutMinMax = FVector2D(DepthRange.MinDepth, DepthRange.MaxDepth) / MAX_uint8;
+
+	UE_LOG(LogImpostorBaker, Log, TEXT("%s depth range: frames span %.0f%% of depth range on average, %.0f%% of %dx%d frame tiles are empty"),
+		*ImpostorData->GetName(),
+		DepthRange.GetAverageFrameRange() * 100.f,
+		DepthRange.GetEmptyTilesFraction() * 100.f,
+		TilesCount,
+		TilesCount);
+
+	return true;
+}
+
+UTexture2D* UImpostorComponentsManager::FindOrCreateTexture(const FString& Suffix, bool& bOutCreated) const
+{
+	const FString AssetName = ImpostorData->NewTextureName + "_" + Suffix;
+	UPackage* TexturePackage = CreatePackage(*ImpostorData->GetPackageName(AssetName));
+	if (!ensure(TexturePackage))
+	{
+		return nullptr;
+	}
+
+	TexturePackage->FullyLoad(); // Make sure the destination package is loaded
+
+	bOutCreated = false;
+	UTexture2D* Texture = FindObject<UTexture2D>(TexturePackage, *AssetName);
+	if (!Texture)
+	{
+		bOutCreated = true;
+		Texture = NewObject<UTexture2D>(TexturePackage, *AssetName, RF_Public | RF_Standalone);
+	}
+
+	return Texture;
+}
@@ -6,6 +6,9 @@
 
 class UMaterialInstanceDynamic;
 class UStaticMeshComponent;
+class UTexture2D;
+struct FImpostorViewProjection;
+enum class EImpostorBakeMapType;
 
 UCLASS()
 class IMPOSTORBAKEREDITOR_API UImpostorComponentsManager : public UImpostorBaseManager
@@ -23,13 +26,44 @@ private:
 	void UpdateComponentsData();
 	void SetupOctahedronLayout();
 	void SetupTraditionalBillboardLayout();
+	void UpdateObjectRadius();
 	void SetupPreviewMeshes();
 
 public:
 	FBoxSphereBounds GetBounds() const;
 
+	// Projection of capture view in referenced mesh space
+	FImpostorViewProjection GetViewProjection(int32 VectorIndex) const;
+
 public:
 	FVector2D GetRenderTargetSize() const;
+	// Render target size divided by resolution divisor of TargetMap, frames keep the same layout scaled by GetFrameRect
+	FIntPoint GetMapAtlasSize(EImpostorBakeMapType TargetMap) const;
+
+	// Distance between frame origins in the atlas, in pixels
+	FVector2D GetFramePitch() const;
+	// Atlas cell (and frame array slice) of view frame, row major index
+	int32 GetFrameSlot(int32 VectorIndex) const;
+	FIntPoint GetFrameCell(int32 VectorIndex) const;
+	// Pixel rectangle of single frame in the atlas
+	FIntRect GetFrameRect(int32 VectorIndex) const;
+	// Same frame in atlas of AtlasSize (e.g. saved texture of other resolution), neighbor frames never overlap
+	FIntRect GetFrameRect(int32 VectorIndex, const FIntPoint& AtlasSize) const;
+	// Part of the atlas covered by frames, the rest is gutter left by frame alignment
+	float GetFrameUVScale() const;
+	// Fraction of atlas area not covered by frames
+	float GetUnusedAtlasArea() const;
+
+	// Atlas width needed for one frame texel per screen pixel, when impostor is shown at ScreenSize on Reference Screen Height
+	float GetRequiredAtlasSize(float ScreenSize) const;
+
+	// Saves view lookup textures of current view distribution, returns false if they aren't used
+	bool SaveViewLookupTextures(UTexture2D*& OutIndices, UTexture2D*& OutWeights) const;
+	// Saves min / max depth pyramid of saved depth map, returns false if it isn't used
+	bool SaveDepthRangeTexture(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures, UTexture2D*& OutDepthRange, FVector2D& OutMinMax) const;
+
+private:
+	UTexture2D* FindOrCreateTexture(const FString& Suffix, bool& bOutCreated) const;
 
 public:
 	UPROPERTY(Transient)
@@ -55,6 +89,10 @@ public:
 	UPROPERTY(VisibleAnywhere, Category = "Base")
 	float ObjectRadius = 0.f;
 
+	// Largest extent of the mesh along view directions, orthographic capture is placed beyond it
+	UPROPERTY(VisibleAnywhere, Category = "Base")
+	float CaptureDepthRadius = 0.f;
+
 	UPROPERTY(VisibleAnywhere, Category = "Base")
 	float DebugTexelSize = 0.f;
 
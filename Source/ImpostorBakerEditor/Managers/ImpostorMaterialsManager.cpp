@@ -1,17 +1,35 @@
 ﻿#include "ImpostorMaterialsManager.h"
+#include <AssetRegistry/AssetRegistryModule.h>
 #include <AssetToolsModule.h>
 #include <Editor.h>
 #include <Engine/Texture2D.h>
+#include <Engine/Texture2DArray.h>
 #include <Engine/TextureRenderTarget2D.h>
 #include <Factories/MaterialInstanceConstantFactoryNew.h>
+#include <MaterialEditingLibrary.h>
 #include <MaterialShared.h>
 #include <Materials/Material.h>
+#include <Materials/MaterialExpressionCameraPositionWS.h>
+#include <Materials/MaterialExpressionConstant.h>
+#include <Materials/MaterialExpressionCustom.h>
+#include <Materials/MaterialExpressionObjectPositionWS.h>
+#include <Materials/MaterialExpressionPreSkinnedPosition.h>
+#include <Materials/MaterialExpressionScalarParameter.h>
+#include <Materials/MaterialExpressionShadowReplace.h>
+#include <Materials/MaterialExpressionSubtract.h>
+#include <Materials/MaterialExpressionTextureCoordinate.h>
+#include <Materials/MaterialExpressionTextureObjectParameter.h>
+#include <Materials/MaterialExpressionTransform.h>
+#include <Materials/MaterialExpressionVectorParameter.h>
+#include <Materials/MaterialFunction.h>
 #include <Materials/MaterialInstanceConstant.h>
 #include <Materials/MaterialInstanceDynamic.h>
+#include "ImpostorBakerEditorModule.h"
 #include "ImpostorComponentsManager.h"
 #include "ImpostorRenderTargetsManager.h"
 #include "Settings/ImpostorBakerSettings.h"
 #include "Utilities/ImpostorBakerUtilities.h"
+#include "Utilities/ImpostorMaterialFunction.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorMaterialsManager)
 
@@ -200,7 +218,97 @@ bool UImpostorMaterialsManager::HasRenderTypeMaterial(const EImpostorBakeMapType
 	}
 }
 
-UMaterialInstanceConstant* UImpostorMaterialsManager::SaveMaterial(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures) const
+bool UImpostorMaterialsManager::ParentHasParameter(const EMaterialParameterType Type, const FName Name) const
+{
+	const UMaterialInterface* Parent = ImpostorData->GetMaterial();
+	if (!Parent)
+	{
+		return false;
+	}
+
+	TMap<FMaterialParameterInfo, FMaterialParameterMetadata> Parameters;
+	Parent->GetAllParametersOfType(Type, Parameters);
+	for (const auto& [MaterialParameterInfo, MaterialParameterMetadata] : Parameters)
+	{
+		if (MaterialParameterInfo.Name == Name)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UImpostorMaterialsManager::ValidateParentSupport() const
+{
+	const UImpostorBakerSettings* Settings = GetDefault<UImpostorBakerSettings>();
+	const UMaterialInterface* Parent = ImpostorData->GetMaterial();
+	if (!Parent)
+	{
+		return;
+	}
+
+	TArray<FString> Errors;
+
+	// Views of non grid distributions can only be found through lookup textures
+	const bool bSupportsViewLookup =
+		ParentHasParameter(EMaterialParameterType::StaticSwitch, Settings->ImpostorViewLookupSwitch) &&
+		ParentHasParameter(EMaterialParameterType::Texture, Settings->ImpostorViewLookupIndices) &&
+		ParentHasParameter(EMaterialParameterType::Texture, Settings->ImpostorViewLookupWeights);
+	if (!bSupportsViewLookup &&
+		(ImpostorData->ViewDistribution != EImpostorViewDistribution::OctahedralGrid || ImpostorData->bSaveGridViewLookup))
+	{
+		ImpostorData->Modify();
+		ImpostorData->ViewDistribution = EImpostorViewDistribution::OctahedralGrid;
+		ImpostorData->bSaveGridViewLookup = false;
+		Errors.Add(FString::Printf(TEXT("%s doesn't read view lookup (%s switch, %s and %s textures), View Distribution is reset to Octahedral Grid"), *Parent->GetName(), *Settings->ImpostorViewLookupSwitch.ToString(), *Settings->ImpostorViewLookupIndices.ToString(), *Settings->ImpostorViewLookupWeights.ToString()));
+	}
+
+	// Frame arrays are only sampled behind the switch, atlas textures would be used otherwise
+	if (ImpostorData->bSaveFrameArrays &&
+		!ParentHasParameter(EMaterialParameterType::StaticSwitch, Settings->ImpostorFrameArraySwitch))
+	{
+		ImpostorData->Modify();
+		ImpostorData->bSaveFrameArrays = false;
+		Errors.Add(FString::Printf(TEXT("%s doesn't read frame arrays (%s switch), Save Frame Arrays is turned off"), *Parent->GetName(), *Settings->ImpostorFrameArraySwitch.ToString()));
+	}
+
+	// Aligned frames don't cover the whole atlas, so atlas UVs have to be scaled
+	if (ImpostorData->FrameAlignment != EImpostorFrameAlignment::None &&
+		!ParentHasParameter(EMaterialParameterType::Scalar, Settings->ImpostorPreviewFrameUVScale))
+	{
+		ImpostorData->Modify();
+		ImpostorData->FrameAlignment = EImpostorFrameAlignment::None;
+		Errors.Add(FString::Printf(TEXT("%s doesn't scale atlas UVs (%s parameter), Frame Alignment is reset to None"), *Parent->GetName(), *Settings->ImpostorPreviewFrameUVScale.ToString()));
+	}
+
+	// Reordered frames would be sampled scrambled, if material assumes row major cells
+	if (ImpostorData->FrameOrder != EImpostorFrameOrder::RowMajor &&
+		!ParentHasParameter(EMaterialParameterType::Scalar, Settings->ImpostorPreviewFrameOrder))
+	{
+		ImpostorData->Modify();
+		ImpostorData->FrameOrder = EImpostorFrameOrder::RowMajor;
+		Errors.Add(FString::Printf(TEXT("%s doesn't remap frame cells (%s parameter), Frame Order is reset to Row Major"), *Parent->GetName(), *Settings->ImpostorPreviewFrameOrder.ToString()));
+	}
+
+	// Octahedral RG would be sampled as tangent normal with reconstructed Z
+	if (ImpostorData->NormalEncoding == EImpostorNormalEncoding::Octahedral &&
+		!ParentHasParameter(EMaterialParameterType::StaticSwitch, Settings->ImpostorOctahedralNormalSwitch))
+	{
+		ImpostorData->Modify();
+		ImpostorData->NormalEncoding = EImpostorNormalEncoding::Packed;
+		Errors.Add(FString::Printf(TEXT("%s doesn't decode octahedral normals (%s switch), Normal Encoding is reset to Packed"), *Parent->GetName(), *Settings->ImpostorOctahedralNormalSwitch.ToString()));
+	}
+
+	for (const FString& Error : Errors)
+	{
+		UE_LOG(LogImpostorBaker, Error, TEXT("%s"), *Error);
+	}
+
+	SetOverlayText("ParentSupport", FString::Join(Errors, TEXT("\n")), true);
+}
+
+UMaterialInstanceConstant* UImpostorMaterialsManager::SaveMaterial(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures, const TMap<EImpostorBakeMapType, UTexture2DArray*>& TextureArrays) const
 {
 	ProgressSlowTask("Creating impostor material...", true);
 	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
@@ -262,6 +370,16 @@ UMaterialInstanceConstant* UImpostorMaterialsManager::SaveMaterial(const TMap<EI
 	NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorPreviewFramesCount, ComponentsManager->NumHorizontalFrames);
 	NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorPreviewMeshRadius, ComponentsManager->ObjectRadius * 2.f);
 	NewMaterial->SetVectorParameterValueEditorOnly(Settings->ImpostorPreviewPivotOffset, FLinearColor(ComponentsManager->OffsetVector));
+	NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorPreviewFrameUVScale, ComponentsManager->GetFrameUVScale());
+	if (ComponentsManager->GetUnusedAtlasArea() > Settings->FrameAlignmentMaxUnusedArea)
+	{
+		UE_LOG(LogImpostorBaker, Warning, TEXT("%s: frame alignment leaves %.0f%% of the atlas unused"), *AssetName, ComponentsManager->GetUnusedAtlasArea() * 100.f);
+	}
+	NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorPreviewFrameOrder, float(ImpostorData->GetFrameOrder()));
+	if (ImpostorData->GetFrameOrder() != EImpostorFrameOrder::RowMajor)
+	{
+		SaveFrameOrderFunction();
+	}
 
 	// Cache Material Texture parameters Names
 	TMap<FMaterialParameterInfo, FMaterialParameterMetadata> TextureParameters;
@@ -290,6 +408,329 @@ UMaterialInstanceConstant* UImpostorMaterialsManager::SaveMaterial(const TMap<EI
 		}
 	}
 
+	// Non grid view distributions are blended by lookup textures
+	UTexture2D* ViewLookupIndices = nullptr;
+	UTexture2D* ViewLookupWeights = nullptr;
+	const bool bUseViewLookup = ComponentsManager->SaveViewLookupTextures(ViewLookupIndices, ViewLookupWeights);
+	NewMaterial->SetStaticSwitchParameterValueEditorOnly(Settings->ImpostorViewLookupSwitch, bUseViewLookup);
+
+	if (bUseViewLookup)
+	{
+		SaveViewLookupFunction();
+
+		if (TextureParameterNames.Contains(Settings->ImpostorViewLookupIndices) &&
+			TextureParameterNames.Contains(Settings->ImpostorViewLookupWeights))
+		{
+			NewMaterial->SetTextureParameterValueEditorOnly(Settings->ImpostorViewLookupIndices, ViewLookupIndices);
+			NewMaterial->SetTextureParameterValueEditorOnly(Settings->ImpostorViewLookupWeights, ViewLookupWeights);
+		}
+		else
+		{
+			UE_LOG(LogImpostorBaker, Warning, TEXT("%s has no %s and %s texture parameters, view lookup textures aren't bound"), *NewMaterial->Parent->GetName(), *Settings->ImpostorViewLookupIndices.ToString(), *Settings->ImpostorViewLookupWeights.ToString());
+		}
+	}
+
+	// Frames are sampled from array slices, atlas textures stay bound for materials without frame arrays
+	const bool bUseFrameArrays = TextureArrays.Num() > 0;
+	NewMaterial->SetStaticSwitchParameterValueEditorOnly(Settings->ImpostorFrameArraySwitch, bUseFrameArrays);
+
+	if (bUseFrameArrays)
+	{
+		SaveFrameArrayFunction();
+
+		for (const auto& [ImpostorBakeMapType, TextureArray] : TextureArrays)
+		{
+			const FName ParameterName = FName(Settings->ImpostorPreviewMapNames[ImpostorBakeMapType].ToString() + Settings->ImpostorFrameArraySuffix);
+			if (TextureParameterNames.Contains(ParameterName))
+			{
+				NewMaterial->SetTextureParameterValueEditorOnly(ParameterName, TextureArray);
+			}
+			else
+			{
+				UE_LOG(LogImpostorBaker, Warning, TEXT("%s has no %s texture parameter, frame array isn't bound"), *NewMaterial->Parent->GetName(), *ParameterName.ToString());
+			}
+		}
+	}
+
+	// Parallax steps are clamped to depth range of frame tiles
+	UTexture2D* DepthRange = nullptr;
+	FVector2D DepthRangeMinMax = FVector2D(0.f, 1.f);
+	const bool bUseDepthRange = ComponentsManager->SaveDepthRangeTexture(Textures, DepthRange, DepthRangeMinMax);
+	NewMaterial->SetStaticSwitchParameterValueEditorOnly(Settings->ImpostorDepthRangeSwitch, bUseDepthRange);
+	NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorDepthRangeMin, DepthRangeMinMax.X);
+	NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorDepthRangeMax, DepthRangeMinMax.Y);
+
+	if (bUseDepthRange)
+	{
+		SaveDepthRangeFunction();
+
+		NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorDepthRangeTiles, FMath::RoundUpToPowerOfTwo(FMath::Max(ImpostorData->DepthRangeTilesCount, 1)));
+		if (TextureParameterNames.Contains(Settings->ImpostorDepthRange))
+		{
+			NewMaterial->SetTextureParameterValueEditorOnly(Settings->ImpostorDepthRange, DepthRange);
+		}
+		else
+		{
+			UE_LOG(LogImpostorBaker, Warning, TEXT("%s has no %s texture parameter, depth range texture isn't bound"), *NewMaterial->Parent->GetName(), *Settings->ImpostorDepthRange.ToString());
+		}
+	}
+
+	// Normal is decoded from octahedral coordinates, depth comes from its own texture bound above
+	const bool bOctahedralNormals = ImpostorData->NormalEncoding == EImpostorNormalEncoding::Octahedral;
+	NewMaterial->SetStaticSwitchParameterValueEditorOnly(Settings->ImpostorOctahedralNormalSwitch, bOctahedralNormals);
+
+	if (bOctahedralNormals)
+	{
+		SaveOctahedralNormalFunction();
+	}
+
+	NewMaterial->UpdateCachedData();
+	NewMaterial->PostEditChange();
+	NewMaterial->MarkPackageDirty();
+
+	return NewMaterial;
+}
+
+UMaterialFunction* UImpostorMaterialsManager::SaveViewLookupFunction() const
+{
+	const bool bHemisphere = ImpostorData->ImpostorType == EImpostorLayoutType::UpperHemisphereOnly;
+
+	FImpostorMaterialFunction Function;
+	Function.AssetName = FString("MF_ImpostorViewLookup_") + (bHemisphere ? "Hemisphere" : "Sphere");
+	Function.Description = "Frames (atlas grid coordinates) and blend weights for view direction, read from view lookup textures saved by Impostor Baker. Replaces grid to vector, frame triangle interpolation and blend weights math.";
+	Function.Inputs = {
+		{ "Direction", FunctionInput_Vector3, "Unit vector from impostor pivot towards camera, in mesh space" },
+		{ "Indices", FunctionInput_Texture2D, "View lookup indices texture" },
+		{ "Weights", FunctionInput_Texture2D, "View lookup weights texture" },
+		{ "FramesCount", FunctionInput_Scalar, "Number of frames on atlas axis" }
+	};
+	Function.Outputs = {
+		{ "Weights", CMOT_Float3, "Blend weights of the three frames, sum up to 1" },
+		{ "Frame0", CMOT_Float2, "Frame coordinates in atlas grid" },
+		{ "Frame1", CMOT_Float2, "Frame coordinates in atlas grid" },
+		{ "Frame2", CMOT_Float2, "Frame coordinates in atlas grid" }
+	};
+
+	// Same mappings as FImpostorBakerUtilities::UnitVectorToOctahedron and UnitVectorToHemiOctahedron.
+	// Lookup texels are exact values, so they are loaded instead of sampled.
+	if (bHemisphere)
+	{
+		Function.Code +=
+			"float3 D = float3(Direction.xy, max(Direction.z, 0));\n"
+			"D /= max(dot(abs(D), 1), 1e-6);\n"
+			"float2 Octahedron = float2(D.x + D.y, D.x - D.y);\n";
+	}
+	else
+	{
+		Function.Code +=
+			"float3 D = Direction / max(dot(abs(Direction), 1), 1e-6);\n"
+			"float2 Octahedron = D.xy;\n"
+			"if (D.z < 0)\n"
+			"{\n"
+			"\tOctahedron = (1 - abs(D.yx)) * float2(D.x >= 0 ? 1 : -1, D.y >= 0 ? 1 : -1);\n"
+			"}\n";
+	}
+	Function.Code +=
+		"uint SizeX, SizeY;\n"
+		"Indices.GetDimensions(SizeX, SizeY);\n"
+		"int3 Texel = int3(clamp(int2((Octahedron * 0.5 + 0.5) * float2(SizeX, SizeY)), 0, int2(SizeX, SizeY) - 1), 0);\n"
+		"float3 FrameIndices = Indices.Load(Texel).rgb;\n"
+		"float3 FrameWeights = Weights.Load(Texel).rgb;\n"
+		"Frame0 = float2(fmod(FrameIndices.x, FramesCount), floor(FrameIndices.x / FramesCount));\n"
+		"Frame1 = float2(fmod(FrameIndices.y, FramesCount), floor(FrameIndices.y / FramesCount));\n"
+		"Frame2 = float2(fmod(FrameIndices.z, FramesCount), floor(FrameIndices.z / FramesCount));\n"
+		"return FrameWeights / max(dot(FrameWeights, 1), 1e-6);";
+
+	return Function.Save(*ImpostorData);
+}
+
+UMaterialFunction* UImpostorMaterialsManager::SaveFrameArrayFunction() const
+{
+	FImpostorMaterialFunction Function;
+	Function.AssetName = "MF_ImpostorFrameArray";
+	Function.Description = "Samples frame of impostor from Texture2DArray saved by Impostor Baker, where every frame is a slice with its own mips. Replaces sampling of frame area in atlas.";
+	Function.Inputs = {
+		{ "Frames", FunctionInput_Texture2DArray, "Frame array texture" },
+		{ "Frame", FunctionInput_Vector2, "Frame coordinates in atlas grid" },
+		{ "UV", FunctionInput_Vector2, "Texture coordinates within frame" },
+		{ "FramesCount", FunctionInput_Scalar, "Number of frames on atlas axis" }
+	};
+	Function.Outputs = {
+		{ "Color", CMOT_Float4, "Sampled frame texel" }
+	};
+
+	// Slices are stored row by row, same as frames in atlas
+	Function.Code =
+		"float Slice = round(Frame.y) * FramesCount + round(Frame.x);\n"
+		"return Texture2DArraySample(Frames, FramesSampler, float3(saturate(UV), Slice));";
+
+	return Function.Save(*ImpostorData);
+}
+
+UMaterialFunction* UImpostorMaterialsManager::SaveFrameOrderFunction() const
+{
+	FImpostorMaterialFunction Function;
+	Function.AssetName = "MF_ImpostorFrameOrder";
+	Function.Description = "Atlas cell of view frame for Frame Order used by Impostor Baker. Frame coordinates from grid math or view lookup are remapped before sampling atlas or frame array.";
+	Function.Inputs = {
+		{ "Frame", FunctionInput_Vector2, "Frame coordinates in view grid" },
+		{ "FramesCount", FunctionInput_Scalar, "Number of frames on atlas axis, power of two for swizzled orders" },
+		{ "FrameOrder", FunctionInput_Scalar, "0 row major, 1 Morton, 2 Hilbert" }
+	};
+	Function.Outputs = {
+		{ "Frame", CMOT_Float2, "Atlas cell coordinates" }
+	};
+
+	// Same encodings as FImpostorFrameOrder::EncodeMorton and EncodeHilbert
+	Function.Code =
+		"uint Size = uint(FramesCount);\n"
+		"uint X = uint(round(Frame.x));\n"
+		"uint Y = uint(round(Frame.y));\n"
+		"uint Slot = Y * Size + X;\n"
+		"if (FrameOrder > 1.5)\n"
+		"{\n"
+		"\tSlot = 0;\n"
+		"\tfor (uint Step = Size / 2; Step > 0; Step /= 2)\n"
+		"\t{\n"
+		"\t\tuint RegionX = (X & Step) > 0 ? 1 : 0;\n"
+		"\t\tuint RegionY = (Y & Step) > 0 ? 1 : 0;\n"
+		"\t\tSlot += Step * Step * ((3 * RegionX) ^ RegionY);\n"
+		"\t\tif (RegionY == 0)\n"
+		"\t\t{\n"
+		"\t\t\tif (RegionX == 1)\n"
+		"\t\t\t{\n"
+		"\t\t\t\tX = Size - 1 - X;\n"
+		"\t\t\t\tY = Size - 1 - Y;\n"
+		"\t\t\t}\n"
+		"\t\t\tuint Temp = X;\n"
+		"\t\t\tX = Y;\n"
+		"\t\t\tY = Temp;\n"
+		"\t\t}\n"
+		"\t}\n"
+		"}\n"
+		"else if (FrameOrder > 0.5)\n"
+		"{\n"
+		"\tSlot = 0;\n"
+		"\tfor (uint Bit = 0; Bit < 16; Bit++)\n"
+		"\t{\n"
+		"\t\tSlot |= ((X >> Bit) & 1) << (2 * Bit);\n"
+		"\t\tSlot |= ((Y >> Bit) & 1) << (2 * Bit + 1);\n"
+		"\t}\n"
+		"}\n"
+		"return float2(Slot % Size, Slot / Size);";
+
+	return Function.Save(*ImpostorData);
+}
+
+UMaterialFunction* UImpostorMaterialsManager::SaveDepthRangeFunction() const
+{
+	FImpostorMaterialFunction Function;
+	Function.AssetName = "MF_ImpostorDepthRange";
+	Function.Description = "Min / max encoded depth of frame tile, loaded from depth range texture saved by Impostor Baker. "
+		"Parallax starts its steps at Min and stops at Max of the whole frame (Level = log2 TilesCount), and jumps over tiles of finer levels, which ray passes in front of.";
+	Function.Inputs = {
+		{ "DepthRange", FunctionInput_Texture2D, "Depth range texture" },
+		{ "Frame", FunctionInput_Vector2, "Atlas cell coordinates of frame" },
+		{ "UV", FunctionInput_Vector2, "Texture coordinates within frame" },
+		{ "TilesCount", FunctionInput_Scalar, "Tiles on frame axis in the first mip" },
+		{ "Level", FunctionInput_Scalar, "Mip of depth range texture, every level doubles tile size" }
+	};
+	Function.Outputs = {
+		{ "Min", CMOT_Float1, "Nearest encoded depth of tile (0.5 - Depth * 0.5 / Radius)" },
+		{ "Max", CMOT_Float1, "Farthest encoded depth of tile" },
+		{ "Covered", CMOT_Float1, "0, if tile has no opaque pixels and ray can skip it" }
+	};
+
+	// Same layout as FImpostorDepthRange, texels are exact values, so they are loaded instead of sampled
+	Function.Code =
+		"uint SizeX, SizeY, NumMips;\n"
+		"DepthRange.GetDimensions(0, SizeX, SizeY, NumMips);\n"
+		"uint Mip = min(uint(max(Level, 0)), NumMips - 1);\n"
+		"int Tiles = int(TilesCount);\n"
+		"int2 Texel = (int2(round(Frame)) * Tiles + clamp(int2(UV * Tiles), 0, Tiles - 1)) >> Mip;\n"
+		"float2 Range = DepthRange.Load(int3(Texel, Mip)).rg;\n"
+		"Max = Range.y;\n"
+		"Covered = Range.x <= Range.y ? 1 : 0;\n"
+		"return Range.x;";
+
+	return Function.Save(*ImpostorData);
+}
+
+UMaterialFunction* UImpostorMaterialsManager::SaveOctahedralNormalFunction() const
+{
+	FImpostorMaterialFunction Function;
+	Function.AssetName = "MF_ImpostorOctahedralNormal";
+	Function.Description = "Normal of impostor saved with octahedral Normal Encoding (RG, BC5), same mapping as FImpostorNormalEncoding. Replaces unpacking of Normal RGB.";
+	Function.Inputs = {
+		{ "Encoded", FunctionInput_Vector2, "RG of Normal texture sampled as normal map, in [-1, 1] range" }
+	};
+	Function.Outputs = {
+		{ "Normal", CMOT_Float3, "Unit normal" },
+		{ "Packed", CMOT_Float3, "Normal * 0.5 + 0.5, same as RGB of packed Normal texture" }
+	};
+
+	// Lower hemisphere is folded over octahedron edges
+	Function.Code =
+		"float3 Normal = float3(Encoded, 1 - abs(Encoded.x) - abs(Encoded.y));\n"
+		"if (Normal.z < 0)\n"
+		"{\n"
+		"\tNormal.xy = float2(Encoded.x >= 0 ? 1 : -1, Encoded.y >= 0 ? 1 : -1) * (1 - abs(Encoded.yx));\n"
+		"}\n"
+		"Normal = normalize(Normal);\n"
+		"Packed = Normal * 0.5 + 0.5;\n"
+		"return Normal;";
+
+	return Function.Save(*ImpostorData);
+}
+
+UMaterialInstanceConstant* UImpostorMaterialsManager::SaveShadowProxyMaterial(UTexture2D* ShadowAtlas) const
+{
+	if (!ShadowAtlas)
+	{
+		return nullptr;
+	}
+
+	ProgressSlowTask("Creating impostor shadow proxy material...", true);
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+
+	UMaterial* ParentMaterial = SaveShadowProxyParentMaterial();
+	if (!ensure(ParentMaterial))
+	{
+		return nullptr;
+	}
+
+	const FString AssetName = ImpostorData->NewMaterialName + "_Shadow";
+	UPackage* MaterialInstancePackage = CreatePackage(*ImpostorData->GetPackageName(AssetName));
+	if (!ensure(MaterialInstancePackage))
+	{
+		return nullptr;
+	}
+
+	MaterialInstancePackage->FullyLoad(); // Make sure the destination package is loaded
+
+	UMaterialInstanceConstant* NewMaterial = FindObject<UMaterialInstanceConstant>(MaterialInstancePackage, *AssetName);
+	if (!NewMaterial)
+	{
+		UMaterialInstanceConstantFactoryNew* Factory = NewObject<UMaterialInstanceConstantFactoryNew>();
+		Factory->InitialParent = ParentMaterial;
+
+		IAssetTools& AssetTools = FModuleManager::Get().LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+		NewMaterial = Cast<UMaterialInstanceConstant>(AssetTools.CreateAsset(AssetName, ImpostorData->SaveLocation.Path, UMaterialInstanceConstant::StaticClass(), Factory));
+		if (!ensure(NewMaterial))
+		{
+			return nullptr;
+		}
+	}
+	else if (NewMaterial->Parent != ParentMaterial)
+	{
+		NewMaterial->SetParentEditorOnly(ParentMaterial, true);
+	}
+
+	NewMaterial->SetTextureParameterValueEditorOnly(FName("ShadowAtlas"), ShadowAtlas);
+	NewMaterial->SetScalarParameterValueEditorOnly(FName("FramesCount"), ComponentsManager->NumHorizontalFrames);
+	NewMaterial->SetScalarParameterValueEditorOnly(FName("Radius"), ComponentsManager->ObjectRadius);
+	NewMaterial->SetVectorParameterValueEditorOnly(FName("PivotOffset"), FLinearColor(ComponentsManager->OffsetVector));
+
 	NewMaterial->UpdateCachedData();
 	NewMaterial->PostEditChange();
 	NewMaterial->MarkPackageDirty();
@@ -297,6 +738,198 @@ UMaterialInstanceConstant* UImpostorMaterialsManager::SaveMaterial(const TMap<EI
 	return NewMaterial;
 }
 
+UMaterial* UImpostorMaterialsManager::SaveShadowProxyParentMaterial() const
+{
+	const bool bHemisphere = ImpostorData->ImpostorType == EImpostorLayoutType::UpperHemisphereOnly;
+
+	const FString AssetName = FString("M_ImpostorShadowProxy_") + (bHemisphere ? "Hemisphere" : "Sphere");
+	UPackage* MaterialPackage = CreatePackage(*ImpostorData->GetPackageName(AssetName));
+	if (!ensure(MaterialPackage))
+	{
+		return nullptr;
+	}
+
+	MaterialPackage->FullyLoad(); // Make sure the destination package is loaded
+
+	if (UMaterial* ExistingMaterial = FindObject<UMaterial>(MaterialPackage, *AssetName))
+	{
+		return ExistingMaterial;
+	}
+
+	UMaterial* Material = NewObject<UMaterial>(MaterialPackage, *AssetName, RF_Public | RF_Standalone);
+	Material->BlendMode = BLEND_Masked;
+	Material->SetShadingModel(MSM_Unlit);
+	Material->TwoSided = true;
+	Material->OpacityMaskClipValue = 0.5f;
+	Material->NumCustomizedUVs = 1;
+
+	const auto AddExpression = [&]<typename T>(const int32 X, const int32 Y)
+	{
+		return CastChecked<T>(UMaterialEditingLibrary::CreateMaterialExpression(Material, T::StaticClass(), X, Y));
+	};
+
+	const auto AddParameter = [&](const FName Name, const int32 Y)
+	{
+		UMaterialExpressionScalarParameter* Parameter = AddExpression.operator()<UMaterialExpressionScalarParameter>(-900, Y);
+		Parameter->ParameterName = Name;
+		return Parameter;
+	};
+
+	const auto AddConstant = [&](const float Value, const int32 X, const int32 Y)
+	{
+		UMaterialExpressionConstant* Constant = AddExpression.operator()<UMaterialExpressionConstant>(X, Y);
+		Constant->R = Value;
+		return Constant;
+	};
+
+	const auto AddCustomInput = [](UMaterialExpressionCustom* Custom, const FName Name, UMaterialExpression* Expression)
+	{
+		FCustomInput& CustomInput = Custom->Inputs.AddDefaulted_GetRef();
+		CustomInput.InputName = Name;
+		CustomInput.Input.Expression = Expression;
+	};
+
+	// Direction towards camera (light in shadow passes) in mesh space
+	UMaterialExpressionSubtract* ToCamera = AddExpression.operator()<UMaterialExpressionSubtract>(-1100, 0);
+	ToCamera->A.Expression = AddExpression.operator()<UMaterialExpressionCameraPositionWS>(-1300, 0);
+	ToCamera->B.Expression = AddExpression.operator()<UMaterialExpressionObjectPositionWS>(-1300, 100);
+
+	UMaterialExpressionTransform* ToCameraLocal = AddExpression.operator()<UMaterialExpressionTransform>(-900, 0);
+	ToCameraLocal->Input.Expression = ToCamera;
+	ToCameraLocal->TransformSourceType = TRANSFORMSOURCE_World;
+	ToCameraLocal->TransformType = TRANSFORM_Local;
+
+	UMaterialExpressionScalarParameter* FramesCount = AddParameter("FramesCount", 150);
+	UMaterialExpressionScalarParameter* Radius = AddParameter("Radius", 300);
+	UMaterialExpressionVectorParameter* PivotOffset = AddExpression.operator()<UMaterialExpressionVectorParameter>(-900, 450);
+	PivotOffset->ParameterName = "PivotOffset";
+
+	UMaterialExpressionCustom* Card = AddExpression.operator()<UMaterialExpressionCustom>(-600, 0);
+	Card->Description = "ImpostorShadowProxyCard";
+	Card->OutputType = CMOT_Float3;
+
+	// Nearest view of octahedral grid (FImpostorBakerUtilities::GetGridVector) and its capture axes (FImpostorBakerUtilities::DeriveAxes).
+	// Card vertices are saved at Point * Radius / 10 in mesh XY plane, they are placed on frame plane the same way as billboard cards.
+	FString Code =
+		"float3 D = ToCamera / max(length(ToCamera), 1e-6);\n"
+		"float N = max(FramesCount, 1);\n";
+	if (bHemisphere)
+	{
+		Code +=
+			"D = float3(D.xy, max(D.z, 0));\n"
+			"D /= max(dot(abs(D), 1), 1e-6);\n"
+			"float2 Octahedron = float2(D.x + D.y, D.x - D.y);\n"
+			"float2 Cell = clamp(round((Octahedron * 0.5 + 0.5) * (N - 1)), 0, N - 1);\n"
+			"float2 Grid = Cell / max(N - 1, 1) * 2 - 1;\n"
+			"float2 GridOctahedron = float2(Grid.x + Grid.y, Grid.x - Grid.y) * 0.5;\n"
+			"float3 View = normalize(float3(GridOctahedron, 1 - dot(abs(GridOctahedron), 1)));\n";
+	}
+	else
+	{
+		Code +=
+			"D /= max(dot(abs(D), 1), 1e-6);\n"
+			"float2 Octahedron = D.xy;\n"
+			"if (D.z < 0)\n"
+			"{\n"
+			"\tOctahedron = (1 - abs(D.yx)) * float2(D.x >= 0 ? 1 : -1, D.y >= 0 ? 1 : -1);\n"
+			"}\n"
+			"float2 Cell = clamp(round((Octahedron * 0.5 + 0.5) * (N - 1)), 0, N - 1);\n"
+			"float2 Grid = Cell / max(N - 1, 1) * 2 - 1;\n"
+			"float3 View = float3(Grid, 1 - dot(abs(Grid), 1));\n"
+			"if (View.z < 0)\n"
+			"{\n"
+			"\tView.xy = float2(Grid.x >= 0 ? 1 : -1, Grid.y >= 0 ? 1 : -1) * (1 - abs(Grid.yx));\n"
+			"}\n"
+			"View = normalize(View);\n";
+	}
+	Code +=
+		"float3 Forward = -View;\n"
+		"float Yaw = atan2(Forward.y, Forward.x);\n"
+		"float Pitch = atan2(Forward.z, length(Forward.xy));\n"
+		"float3 AxisX = float3(-sin(Yaw), cos(Yaw), 0);\n"
+		"float3 AxisY = float3(sin(Pitch) * cos(Yaw), sin(Pitch) * sin(Yaw), -cos(Pitch));\n"
+		"float2 Point = (Position.xy - PivotOffset.xy) * 10 / max(Radius, 1e-6);\n"
+		"UV = (Cell + Point * 0.5 + 0.5) / N;\n"
+		"return PivotOffset.xyz + (Point.x * AxisX + Point.y * AxisY) * Radius - Position;";
+	Card->Code = Code;
+
+	Card->Inputs.Reset();
+	AddCustomInput(Card, "Position", AddExpression.operator()<UMaterialExpressionPreSkinnedPosition>(-900, -150));
+	AddCustomInput(Card, "ToCamera", ToCameraLocal);
+	AddCustomInput(Card, "FramesCount", FramesCount);
+	AddCustomInput(Card, "Radius", Radius);
+	AddCustomInput(Card, "PivotOffset", PivotOffset);
+
+	FCustomOutput& UVOutput = Card->AdditionalOutputs.AddDefaulted_GetRef();
+	UVOutput.OutputName = "UV";
+	UVOutput.OutputType = CMOT_Float2;
+
+	// Rebuilds output pins
+	Card->PostEditChange();
+
+	UMaterialExpressionTransform* Offset = AddExpression.operator()<UMaterialExpressionTransform>(-300, 0);
+	Offset->Input.Expression = Card;
+	Offset->TransformSourceType = TRANSFORMSOURCE_Local;
+	Offset->TransformType = TRANSFORM_World;
+
+	// Main pass collapses the card into its pivot, so it never reaches pixel shader
+	UMaterialExpressionSubtract* Collapse = AddExpression.operator()<UMaterialExpressionSubtract>(-300, 150);
+	Collapse->A.Expression = PivotOffset;
+	Collapse->B.Expression = AddExpression.operator()<UMaterialExpressionPreSkinnedPosition>(-600, 300);
+
+	UMaterialExpressionTransform* CollapseOffset = AddExpression.operator()<UMaterialExpressionTransform>(-150, 150);
+	CollapseOffset->Input.Expression = Collapse;
+	CollapseOffset->TransformSourceType = TRANSFORMSOURCE_Local;
+	CollapseOffset->TransformType = TRANSFORM_World;
+
+	UMaterialExpressionShadowReplace* OffsetSwitch = AddExpression.operator()<UMaterialExpressionShadowReplace>(0, 0);
+	OffsetSwitch->Default.Expression = CollapseOffset;
+	OffsetSwitch->Shadow.Expression = Offset;
+
+	UMaterialEditingLibrary::ConnectMaterialProperty(OffsetSwitch, "", MP_WorldPositionOffset);
+	UMaterialEditingLibrary::ConnectMaterialProperty(Card, "UV", MP_CustomizedUVs0);
+
+	UMaterialExpressionTextureObjectParameter* ShadowAtlas = AddExpression.operator()<UMaterialExpressionTextureObjectParameter>(-900, 600);
+	ShadowAtlas->ParameterName = "ShadowAtlas";
+	ShadowAtlas->Texture = LoadObject<UTexture>(nullptr, TEXT("/Engine/EngineResources/DefaultTexture.DefaultTexture"));
+	ShadowAtlas->SamplerType = SAMPLERTYPE_LinearColor;
+
+	UMaterialExpressionCustom* Frame = AddExpression.operator()<UMaterialExpressionCustom>(-600, 600);
+	Frame->Description = "ImpostorShadowProxyFrame";
+	Frame->OutputType = CMOT_Float1;
+
+	// Encoded depth is 0.5 - Depth * 0.5 / Radius, pixels behind card plane are pushed back, so the proxy self shadows like the mesh
+	Frame->Code =
+		"float2 Proxy = Texture2DSample(ShadowAtlas, ShadowAtlasSampler, UV).rg;\n"
+		"Depth = max((Proxy.g - 0.5) * 2 * Radius, 0);\n"
+		"return Proxy.r;";
+
+	Frame->Inputs.Reset();
+	AddCustomInput(Frame, "ShadowAtlas", ShadowAtlas);
+	AddCustomInput(Frame, "UV", AddExpression.operator()<UMaterialExpressionTextureCoordinate>(-900, 750));
+	AddCustomInput(Frame, "Radius", Radius);
+
+	FCustomOutput& DepthOutput = Frame->AdditionalOutputs.AddDefaulted_GetRef();
+	DepthOutput.OutputName = "Depth";
+	DepthOutput.OutputType = CMOT_Float1;
+
+	// Rebuilds output pins
+	Frame->PostEditChange();
+
+	UMaterialExpressionShadowReplace* OpacitySwitch = AddExpression.operator()<UMaterialExpressionShadowReplace>(-300, 600);
+	OpacitySwitch->Default.Expression = AddConstant(0.f, -450, 750);
+	OpacitySwitch->Shadow.Expression = Frame;
+
+	UMaterialEditingLibrary::ConnectMaterialProperty(OpacitySwitch, "", MP_OpacityMask);
+	UMaterialEditingLibrary::ConnectMaterialProperty(Frame, "Depth", MP_PixelDepthOffset);
+
+	UMaterialEditingLibrary::RecompileMaterial(Material);
+	Material->MarkPackageDirty();
+	FAssetRegistryModule::AssetCreated(Material);
+
+	return Material;
+}
+
 void UImpostorMaterialsManager::UpdateDepthMaterialData(const FVector& ViewCaptureDirection) const
 {
 	FVector X, Y, Z;
@@ -340,6 +973,8 @@ void UImpostorMaterialsManager::UpdateImpostorMaterial() const
 	ImpostorPreviewMaterial->SetScalarParameterValue(Settings->ImpostorPreviewFramesCount, ComponentsManager->NumHorizontalFrames);
 	ImpostorPreviewMaterial->SetScalarParameterValue(Settings->ImpostorPreviewMeshRadius, ComponentsManager->ObjectRadius * 2.f);
 	ImpostorPreviewMaterial->SetVectorParameterValue(Settings->ImpostorPreviewPivotOffset, ComponentsManager->OffsetVector);
+	ImpostorPreviewMaterial->SetScalarParameterValue(Settings->ImpostorPreviewFrameUVScale, ComponentsManager->GetFrameUVScale());
+	ImpostorPreviewMaterial->SetScalarParameterValue(Settings->ImpostorPreviewFrameOrder, float(ImpostorData->GetFrameOrder()));
 
 	// Bind Render Targets
 	for (const auto& It : GetManager<UImpostorRenderTargetsManager>()->TargetMaps)
@@ -353,13 +988,16 @@ void UImpostorMaterialsManager::UpdateImpostorMaterial() const
 	}
 }
 
-void UImpostorMaterialsManager::UpdateSampleFrameMaterial() const
+void UImpostorMaterialsManager::UpdateSampleFrameMaterial(const int32 CaptureMip) const
 {
+	const TArray<TObjectPtr<UTextureRenderTarget2D>>& SceneCaptureMipChain = GetManager<UImpostorRenderTargetsManager>()->SceneCaptureMipChain;
+	UTextureRenderTarget2D* CaptureTarget = SceneCaptureMipChain[FMath::Clamp(CaptureMip, 0, SceneCaptureMipChain.Num() - 1)];
+
 	SampleFrameMaterial->SetTextureParameterValue(FName("SRGBBaseColor"), GetManager<UImpostorRenderTargetsManager>()->SceneCaptureSRGBMip);
-	SampleFrameMaterial->SetTextureParameterValue(FName("LinearBaseColor"), GetManager<UImpostorRenderTargetsManager>()->SceneCaptureMipChain[0]);
-	SampleFrameMaterial->SetTextureParameterValue(FName("Alpha"), GetManager<UImpostorRenderTargetsManager>()->SceneCaptureMipChain[0]);
-	SampleFrameMaterial->SetTextureParameterValue(FName("MipAlpha"), GetManager<UImpostorRenderTargetsManager>()->SceneCaptureMipChain[FMath::Min(GetManager<UImpostorRenderTargetsManager>()->SceneCaptureMipChain.Num() - 1, ImpostorData->DFMipTarget)]);
-	SampleFrameMaterial->SetScalarParameterValue(FName("TextureSize"), ImpostorData->SceneCaptureResolution);
+	SampleFrameMaterial->SetTextureParameterValue(FName("LinearBaseColor"), CaptureTarget);
+	SampleFrameMaterial->SetTextureParameterValue(FName("Alpha"), CaptureTarget);
+	SampleFrameMaterial->SetTextureParameterValue(FName("MipAlpha"), SceneCaptureMipChain[FMath::Min(SceneCaptureMipChain.Num() - 1, ImpostorData->DFMipTarget)]);
+	SampleFrameMaterial->SetScalarParameterValue(FName("TextureSize"), CaptureMip > 0 ? CaptureTarget->SizeX : ImpostorData->SceneCaptureResolution);
 }
 
 void UImpostorMaterialsManager::UpdateAddAlphasMaterial() const
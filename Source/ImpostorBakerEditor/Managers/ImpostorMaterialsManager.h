@@ -4,10 +4,15 @@
 #include "ImpostorBaseManager.h"
 #include "ImpostorMaterialsManager.generated.h"
 
+class UMaterial;
+class UMaterialFunction;
 class UMaterialInstanceConstant;
 class UMaterialInstanceDynamic;
+class UTexture2D;
+class UTexture2DArray;
 
 enum class EImpostorBakeMapType;
+enum class EMaterialParameterType : uint8;
 
 UCLASS()
 class IMPOSTORBAKEREDITOR_API UImpostorMaterialsManager : public UImpostorBaseManager
@@ -23,14 +28,38 @@ public:
 	UMaterialInstanceDynamic* GetSampleMaterial(EImpostorBakeMapType TargetMap) const;
 	UMaterialInterface* GetRenderTypeMaterial(EImpostorBakeMapType TargetMap) const;
 	bool HasRenderTypeMaterial(EImpostorBakeMapType TargetMap) const;
-	UMaterialInstanceConstant* SaveMaterial(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures) const;
+
+	// Parent impostor material of current layout has parameter of Type named Name
+	bool ParentHasParameter(EMaterialParameterType Type, FName Name) const;
+	// Turns off options, which parent impostor material doesn't read, so they can't silently produce broken impostors
+	void ValidateParentSupport() const;
+	UMaterialInstanceConstant* SaveMaterial(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures, const TMap<EImpostorBakeMapType, UTexture2DArray*>& TextureArrays = {}) const;
+
+	// Material function, which returns frames and blend weights of view direction from view lookup textures.
+	// Generated once per layout into save location, existing function is kept as it is.
+	UMaterialFunction* SaveViewLookupFunction() const;
+	// Material function, which samples frame slice of Texture2DArray saved with Save Frame Arrays
+	UMaterialFunction* SaveFrameArrayFunction() const;
+	// Material function, which remaps frame grid coordinates of view into atlas cell of its frame, same as FImpostorFrameOrder
+	UMaterialFunction* SaveFrameOrderFunction() const;
+	// Material function, which loads min / max depth of frame tile from depth range texture saved with Save Depth Range
+	UMaterialFunction* SaveDepthRangeFunction() const;
+	// Material function, which decodes normal saved with octahedral Normal Encoding
+	UMaterialFunction* SaveOctahedralNormalFunction() const;
+
+	// Shadow only instance of generated proxy material, reading coverage and depth of ShadowAtlas
+	UMaterialInstanceConstant* SaveShadowProxyMaterial(UTexture2D* ShadowAtlas) const;
+	// Masked material, which turns impostor card towards the nearest grid view and clips it by single frame coverage in shadow passes only.
+	// Generated once per layout into save location, existing material is kept as it is.
+	UMaterial* SaveShadowProxyParentMaterial() const;
 
 	void UpdateDepthMaterialData(const FVector& ViewCaptureDirection) const;
 
 private:
 	void CreatePreviewMaterial();
 	void UpdateImpostorMaterial() const;
-	void UpdateSampleFrameMaterial() const;
+	// Maps with resolution divisor are captured into lower mip of capture chain
+	void UpdateSampleFrameMaterial(int32 CaptureMip = 0) const;
 	void UpdateAddAlphasMaterial() const;
 	void UpdateBaseColorCustomLightingMaterial() const;
 	void UpdateCombinedNormalsDepthMaterial() const;
@@ -9,15 +9,36 @@
 #include <PhysicsEngine/BodySetup.h>
 #include <ProceduralMeshComponent.h>
 #include <ProceduralMeshConversion.h>
+#include <StaticMeshCompiler.h>
 #include <StaticMeshResources.h>
 #include <TextureResource.h>
 #include "ImpostorComponentsManager.h"
 #include "ImpostorMaterialsManager.h"
 #include "ImpostorRenderTargetsManager.h"
 #include "Utilities/ImpostorBakerUtilities.h"
+#include "Utilities/ImpostorMeshGeometry.h"
+#include "Utilities/ImpostorRasterizer.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorProceduralMeshManager)
 
+FImpostorTextureData FImpostorTextureData::FromCoverage(const FImpostorCoverageMask& Coverage)
+{
+	FImpostorTextureData Result;
+	Result.SizeX = Coverage.GetSize();
+	Result.SizeY = Coverage.GetSize();
+	Result.Alphas.SetNumUninitialized(Result.SizeX * Result.SizeY);
+
+	for (int32 Y = 0; Y < Result.SizeY; Y++)
+	{
+		for (int32 X = 0; X < Result.SizeX; X++)
+		{
+			Result.Alphas[X + Result.SizeX * Y] = Coverage.Get(X, Y) ? 1.f : 0.f;
+		}
+	}
+
+	return Result;
+}
+
 void UImpostorProceduralMeshManager::Initialize()
 {
 	MeshComponent = NewObject<UProceduralMeshComponent>(GetTransientPackage());
@@ -31,7 +52,7 @@ void UImpostorProceduralMeshManager::Update()
 	GenerateMeshData();
 }
 
-void UImpostorProceduralMeshManager::SaveMesh(UMaterialInstanceConstant* NewMaterial) const
+void UImpostorProceduralMeshManager::SaveMesh(UMaterialInstanceConstant* NewMaterial, UMaterialInstanceConstant* ShadowMaterial) const
 {
 	ProgressSlowTask("Creating impostor static mesh...", true);
 	if (!ensure(MeshComponent))
@@ -51,7 +72,7 @@ void UImpostorProceduralMeshManager::SaveMesh(UMaterialInstanceConstant* NewMate
 	// Make sure the destination package is loaded
 	StaticMeshPackage->FullyLoad();
 
-	UStaticMesh* NewMesh = CreateMesh(NewMaterial, StaticMeshPackage, AssetName);
+	UStaticMesh* NewMesh = CreateMesh(NewMaterial, ShadowMaterial, StaticMeshPackage, AssetName);
 	if (NewMesh)
 	{
 		NewMesh->MarkPackageDirty();
@@ -67,78 +88,167 @@ void UImpostorProceduralMeshManager::SaveMesh(UMaterialInstanceConstant* NewMate
 	}
 }
 
-void UImpostorProceduralMeshManager::UpdateLOD(UMaterialInstanceConstant* NewMaterial) const
+FImpostorLODDescription UImpostorProceduralMeshManager::PrepareLOD(UMaterialInstanceConstant* NewMaterial, UMaterialInstanceConstant* ShadowMaterial) const
 {
-	ProgressSlowTask("Adding impostor mesh as a LOD" + LexToString(ImpostorData->TargetLOD) + " to referenced mesh...", true);
+	ProgressSlowTask("Preparing impostor mesh as a LOD" + LexToString(ImpostorData->TargetLOD) + " for referenced mesh...", true);
 	IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
 	UStaticMesh* Mesh = ImpostorData->ReferencedMesh;
 	if (!Mesh)
 	{
-		return;
+		return {};
 	}
 
 	FString AssetName = ImpostorData->NewMeshName;
 	FString PackageName = ImpostorData->GetPackageName(AssetName);
 	AssetTools.CreateUniqueAssetName(PackageName, "", PackageName, AssetName);
 
-	UStaticMesh* NewMesh = CreateMesh(NewMaterial, Mesh, AssetName);
+	UStaticMesh* NewMesh = CreateMesh(NewMaterial, ShadowMaterial, Mesh, AssetName);
 	if (!ensure(NewMesh))
 	{
-		return;
+		return {};
 	}
 
-	if (ImpostorData->TargetLOD >= Mesh->GetNumSourceModels())
+	FImpostorLODDescription Description;
+	Description.Mesh = Mesh;
+	Description.ImpostorMesh = NewMesh;
+	Description.Material = NewMaterial;
+	Description.ShadowMaterial = ShadowMaterial;
+	Description.LODIndex = ImpostorData->TargetLOD;
+	Description.bCastShadow = ImpostorData->bMeshCastShadow;
+	Description.ScreenSize = GetLODScreenSize();
+	return Description;
+}
+
+float UImpostorProceduralMeshManager::GetLODScreenSize() const
+{
+	const UStaticMesh* Mesh = ImpostorData->ReferencedMesh;
+	const int32 LODIndex = ImpostorData->TargetLOD;
+	if (!ImpostorData->bSetLODScreenSize ||
+		!Mesh ||
+		LODIndex == 0)
 	{
-		FStaticMeshSourceModel& SrcModel = Mesh->AddSourceModel();
-		SrcModel.BuildSettings.bRecomputeNormals = false;
-		SrcModel.BuildSettings.bRecomputeTangents = false;
-		SrcModel.BuildSettings.bRemoveDegenerates = false;
-		SrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
-		SrcModel.BuildSettings.bUseFullPrecisionUVs = false;
-		SrcModel.BuildSettings.bGenerateLightmapUVs = true;
-		SrcModel.BuildSettings.SrcLightmapIndex = 0;
-		SrcModel.BuildSettings.DstLightmapIndex = 1;
+		return 0.f;
 	}
 
-	Mesh->SetCustomLOD(NewMesh, ImpostorData->TargetLOD, "");
-	NewMesh->ConditionalBeginDestroy();
-	NewMesh = nullptr;
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+	const float AtlasSize = ComponentsManager->GetRenderTargetSize().X;
 
-	// Remove Unused MaterialSlots.
-	// Need override index because UStaticMesh::RemoveUnusedMaterialSlots returning if any material used (from end).
-	const int32 ImpostorLODNumSections = Mesh->GetNumSections(ImpostorData->TargetLOD);
-	for (int32 SectionIndex = 0; SectionIndex < ImpostorLODNumSections; SectionIndex++)
+	// Required atlas size is linear in screen size
+	float ScreenSize = AtlasSize / FMath::Max(ComponentsManager->GetRequiredAtlasSize(1.f), UE_KINDA_SMALL_NUMBER);
+
+	// LOD screen sizes have to decrease, previous LOD wins if they can't fit
+	if (LODIndex + 1 < Mesh->GetNumSourceModels())
 	{
-		FMeshSectionInfo SectionInfo = Mesh->GetSectionInfoMap().Get(ImpostorData->TargetLOD, SectionIndex);
-		SectionInfo.MaterialIndex = 0; // Temporal override Material index to first
-		Mesh->GetSectionInfoMap().Set(ImpostorData->TargetLOD, SectionIndex, SectionInfo);
+		ScreenSize = FMath::Max(ScreenSize, GetMeshLODScreenSize(Mesh, LODIndex + 1) * 1.01f);
 	}
-	UStaticMesh::RemoveUnusedMaterialSlots(Mesh);
+	return FMath::Min(ScreenSize, GetMeshLODScreenSize(Mesh, LODIndex - 1) * 0.99f);
+}
 
-	int32 MaterialIndex = Mesh->GetStaticMaterials().Find(NewMaterial);
-	if (MaterialIndex == INDEX_NONE)
+float UImpostorProceduralMeshManager::GetChainLODScreenSize(const int32 Resolution, const float PreviousScreenSize) const
+{
+	if (!ImpostorData->bSetLODScreenSize ||
+		!ImpostorData->ReferencedMesh)
 	{
-		const FName SlotName = Mesh->AddMaterial(NewMaterial);
-		MaterialIndex = Mesh->GetMaterialIndex(SlotName);
+		return 0.f;
 	}
 
-	for (int32 SectionIndex = 0; SectionIndex < ImpostorLODNumSections; SectionIndex++)
+	const float ScreenSize = Resolution / FMath::Max(GetManager<UImpostorComponentsManager>()->GetRequiredAtlasSize(1.f), UE_KINDA_SMALL_NUMBER);
+	return PreviousScreenSize > 0.f ? FMath::Min(ScreenSize, PreviousScreenSize * 0.99f) : ScreenSize;
+}
+
+float UImpostorProceduralMeshManager::GetMeshLODScreenSize(const UStaticMesh* Mesh, const int32 LODIndex)
+{
+	const FStaticMeshRenderData* RenderData = Mesh->GetRenderData();
+	if (Mesh->bAutoComputeLODScreenSize &&
+		RenderData &&
+		RenderData->LODResources.IsValidIndex(LODIndex))
+	{
+		return RenderData->ScreenSize[LODIndex].Default;
+	}
+
+	return Mesh->IsSourceModelValid(LODIndex) ? Mesh->GetSourceModel(LODIndex).ScreenSize.Default : 0.f;
+}
+
+TArray<FText> UImpostorProceduralMeshManager::BuildLODs(const TArray<FImpostorLODDescription>& Descriptions)
+{
+	TArray<FText> Errors;
+	TArray<UStaticMesh*> MeshesToBuild;
+	TMap<UStaticMesh*, TArray<int32>> LODsToValidate;
+
+	for (const FImpostorLODDescription& Description : Descriptions)
+	{
+		if (!Description.IsValid())
+		{
+			Errors.Add(INVTEXT("Impostor LOD description is incomplete (missing referenced or impostor mesh)"));
+			continue;
+		}
+
+		ProgressSlowTask("Adding impostor LOD" + LexToString(Description.LODIndex) + " to " + Description.Mesh->GetName() + "...", false);
+		if (!ApplyLOD(Description))
+		{
+			Errors.Add(FText::FromString(Description.Mesh->GetPathName() + ": failed to set impostor as LOD" + LexToString(Description.LODIndex)));
+			continue;
+		}
+
+		MeshesToBuild.AddUnique(Description.Mesh);
+		LODsToValidate.FindOrAdd(Description.Mesh).Add(Description.LODIndex);
+	}
+
+	if (MeshesToBuild.Num() == 0)
 	{
-		FMeshSectionInfo SectionInfo = Mesh->GetSectionInfoMap().Get(ImpostorData->TargetLOD, SectionIndex);
-		SectionInfo.bCastShadow = ImpostorData->bMeshCastShadow;
-		SectionInfo.MaterialIndex = MaterialIndex;
-		Mesh->GetSectionInfoMap().Set(ImpostorData->TargetLOD, SectionIndex, SectionInfo);
+		return Errors;
 	}
 
-	Mesh->Build(false);
-	Mesh->PostEditChange();
-	Mesh->MarkPackageDirty();
+	// All builds are submitted at once, so static mesh compiling manager can distribute them across worker threads
+	UStaticMesh::FBuildParameters BuildParameters;
+	BuildParameters.bInSilent = true;
+	TArray<FText> BuildErrors;
+	BuildParameters.OutErrors = &BuildErrors;
+	UStaticMesh::BatchBuild(MeshesToBuild, BuildParameters);
+
+	// Waiting in submission order still lets remaining meshes compile in the background
+	FStaticMeshCompilingManager& CompilingManager = FStaticMeshCompilingManager::Get();
+	for (UStaticMesh* Mesh : MeshesToBuild)
+	{
+		ProgressSlowTask("Building " + Mesh->GetName() + "... [" + LexToString(CompilingManager.GetNumRemainingMeshes()) + " remaining]", true);
+		CompilingManager.FinishCompilation({ Mesh });
+
+		const FStaticMeshRenderData* RenderData = Mesh->GetRenderData();
+		for (const int32 LODIndex : LODsToValidate[Mesh])
+		{
+			if (!RenderData ||
+				!RenderData->LODResources.IsValidIndex(LODIndex))
+			{
+				Errors.Add(FText::FromString(Mesh->GetPathName() + ": LOD" + LexToString(LODIndex) + " is missing after build"));
+			}
+		}
+
+		Mesh->MarkPackageDirty();
+	}
+
+	Errors.Append(BuildErrors);
+	return Errors;
 }
 
-UStaticMesh* UImpostorProceduralMeshManager::CreateMesh(UMaterialInstanceConstant* NewMaterial, UObject* TargetPacket, const FString& AssetName) const
+UStaticMesh* UImpostorProceduralMeshManager::CreateMesh(UMaterialInstanceConstant* NewMaterial, UMaterialInstanceConstant* ShadowMaterial, UObject* TargetPacket, const FString& AssetName) const
 {
+	// Shadow proxy is a copy of the card in its own section. Polygon groups are split by material, so it needs a different one.
+	const bool bShadowProxy = IsValid(ShadowMaterial);
+	if (bShadowProxy)
+	{
+		MeshComponent->CreateMeshSection(1, Vertices, Triangles, Normals, UVs, {}, Tangents, false);
+		MeshComponent->SetMaterial(1, ShadowMaterial);
+	}
+
 	FMeshDescription MeshDescription = BuildMeshDescription(MeshComponent);
 
+	if (bShadowProxy)
+	{
+		// Preview keeps only impostor section
+		MeshComponent->ClearAllMeshSections();
+		MeshComponent->CreateMeshSection(0, Vertices, Triangles, Normals, UVs, {}, Tangents, false);
+	}
+
 	if (!ensure(MeshDescription.Polygons().Num() > 0))
 	{
 		return nullptr;
@@ -183,13 +293,20 @@ UStaticMesh* UImpostorProceduralMeshManager::CreateMesh(UMaterialInstanceConstan
 		{
 			NewMesh->GetStaticMaterials().Add(NewMaterial);
 		}
+
+		if (bShadowProxy)
+		{
+			NewMesh->GetStaticMaterials().Add(ShadowMaterial);
+		}
 	}
 
+	// Only shadow proxy casts shadow, if it's present
 	const int32 NumSections = NewMesh->GetNumSections(0);
 	for (int32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
 	{
+		const bool bShadowSection = bShadowProxy && SectionIndex == NumSections - 1;
 		FMeshSectionInfo SectionInfo = NewMesh->GetSectionInfoMap().Get(0, SectionIndex);
-		SectionInfo.bCastShadow = ImpostorData->bMeshCastShadow;
+		SectionInfo.bCastShadow = ImpostorData->bMeshCastShadow && (!bShadowProxy || bShadowSection);
 		NewMesh->GetSectionInfoMap().Set(0, SectionIndex, SectionInfo);
 	}
 
@@ -211,6 +328,93 @@ UStaticMesh* UImpostorProceduralMeshManager::CreateMesh(UMaterialInstanceConstan
 	return NewMesh;
 }
 
+bool UImpostorProceduralMeshManager::ApplyLOD(const FImpostorLODDescription& Description)
+{
+	UStaticMesh* Mesh = Description.Mesh;
+	UStaticMesh* NewMesh = Description.ImpostorMesh;
+	UMaterialInstanceConstant* NewMaterial = Description.Material;
+	const int32 LODIndex = Description.LODIndex;
+
+	// Screen sizes are frozen before LODs change, so other LODs keep switching where they were
+	if (Description.ScreenSize > 0.f &&
+		Mesh->bAutoComputeLODScreenSize)
+	{
+		for (int32 Index = 0; Index < Mesh->GetNumSourceModels(); Index++)
+		{
+			Mesh->GetSourceModel(Index).ScreenSize.Default = GetMeshLODScreenSize(Mesh, Index);
+		}
+		Mesh->bAutoComputeLODScreenSize = false;
+	}
+
+	if (LODIndex >= Mesh->GetNumSourceModels())
+	{
+		FStaticMeshSourceModel& SrcModel = Mesh->AddSourceModel();
+		SrcModel.BuildSettings.bRecomputeNormals = false;
+		SrcModel.BuildSettings.bRecomputeTangents = false;
+		SrcModel.BuildSettings.bRemoveDegenerates = false;
+		SrcModel.BuildSettings.bUseHighPrecisionTangentBasis = false;
+		SrcModel.BuildSettings.bUseFullPrecisionUVs = false;
+		SrcModel.BuildSettings.bGenerateLightmapUVs = true;
+		SrcModel.BuildSettings.SrcLightmapIndex = 0;
+		SrcModel.BuildSettings.DstLightmapIndex = 1;
+	}
+
+	const bool bSuccess = Mesh->SetCustomLOD(NewMesh, LODIndex, "");
+	NewMesh->ConditionalBeginDestroy();
+
+	if (!bSuccess)
+	{
+		return false;
+	}
+
+	// Remove Unused MaterialSlots.
+	// Need override index because UStaticMesh::RemoveUnusedMaterialSlots returning if any material used (from end).
+	const int32 ImpostorLODNumSections = Mesh->GetNumSections(LODIndex);
+	for (int32 SectionIndex = 0; SectionIndex < ImpostorLODNumSections; SectionIndex++)
+	{
+		FMeshSectionInfo SectionInfo = Mesh->GetSectionInfoMap().Get(LODIndex, SectionIndex);
+		SectionInfo.MaterialIndex = 0; // Temporal override Material index to first
+		Mesh->GetSectionInfoMap().Set(LODIndex, SectionIndex, SectionInfo);
+	}
+	UStaticMesh::RemoveUnusedMaterialSlots(Mesh);
+
+	int32 MaterialIndex = Mesh->GetStaticMaterials().Find(NewMaterial);
+	if (MaterialIndex == INDEX_NONE)
+	{
+		const FName SlotName = Mesh->AddMaterial(NewMaterial);
+		MaterialIndex = Mesh->GetMaterialIndex(SlotName);
+	}
+
+	UMaterialInstanceConstant* ShadowMaterial = Description.ShadowMaterial;
+	int32 ShadowMaterialIndex = INDEX_NONE;
+	if (ShadowMaterial)
+	{
+		ShadowMaterialIndex = Mesh->GetStaticMaterials().Find(ShadowMaterial);
+		if (ShadowMaterialIndex == INDEX_NONE)
+		{
+			const FName SlotName = Mesh->AddMaterial(ShadowMaterial);
+			ShadowMaterialIndex = Mesh->GetMaterialIndex(SlotName);
+		}
+	}
+
+	// Shadow proxy is the last section, impostor sections don't cast shadow with it
+	for (int32 SectionIndex = 0; SectionIndex < ImpostorLODNumSections; SectionIndex++)
+	{
+		const bool bShadowSection = ShadowMaterialIndex != INDEX_NONE && SectionIndex == ImpostorLODNumSections - 1;
+		FMeshSectionInfo SectionInfo = Mesh->GetSectionInfoMap().Get(LODIndex, SectionIndex);
+		SectionInfo.bCastShadow = Description.bCastShadow && (ShadowMaterialIndex == INDEX_NONE || bShadowSection);
+		SectionInfo.MaterialIndex = bShadowSection ? ShadowMaterialIndex : MaterialIndex;
+		Mesh->GetSectionInfoMap().Set(LODIndex, SectionIndex, SectionInfo);
+	}
+
+	if (Description.ScreenSize > 0.f)
+	{
+		Mesh->GetSourceModel(LODIndex).ScreenSize.Default = Description.ScreenSize;
+	}
+
+	return true;
+}
+
 void UImpostorProceduralMeshManager::GenerateMeshData()
 {
 	Vertices.Empty();
@@ -221,10 +425,15 @@ void UImpostorProceduralMeshManager::GenerateMeshData()
 	Points.Empty();
 
 	TArray<FVector> CardNormalList = GetNormalCards();
+	const TArray<FImpostorCoverageMask> GeometryCutouts = RasterizeCutouts();
 
 	for (int32 NormalsIndex = 0; NormalsIndex < CardNormalList.Num(); NormalsIndex++)
 	{
 		FImpostorTextureData TextureData;
+		if (GeometryCutouts.IsValidIndex(NormalsIndex))
+		{
+			TextureData = FImpostorTextureData::FromCoverage(GeometryCutouts[NormalsIndex]);
+		}
 		TextureData = BakeAlphasData(NormalsIndex, TextureData);
 
 		TArray<FVector2D> LocalPoints;
@@ -329,6 +538,61 @@ TArray<FVector> UImpostorProceduralMeshManager::GetNormalCards() const
 	return { FVector::UpVector };
 }
 
+TArray<FImpostorCoverageMask> UImpostorProceduralMeshManager::RasterizeCutouts() const
+{
+	if (!ImpostorData->bUseMeshCutout ||
+		!ImpostorData->bUseGeometryCutout ||
+		!ImpostorData->ReferencedMesh)
+	{
+		return {};
+	}
+
+	const FImpostorMeshGeometry Geometry = FImpostorMeshGeometry::Gather(ImpostorData->ReferencedMesh);
+	if (Geometry.IsEmpty())
+	{
+		return {};
+	}
+
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+
+	TArray<FImpostorViewProjection> Views;
+	Views.Reserve(ComponentsManager->ViewCaptureVectors.Num());
+	for (int32 Index = 0; Index < ComponentsManager->ViewCaptureVectors.Num(); Index++)
+	{
+		Views.Add(ComponentsManager->GetViewProjection(Index));
+	}
+
+	TMap<int32, FImpostorOpacityMask> OpacityMasks;
+	if (ImpostorData->bSampleOpacityForGeometryCutout)
+	{
+		const TArray<FStaticMaterial>& Materials = ImpostorData->ReferencedMesh->GetStaticMaterials();
+		for (int32 MaterialIndex = 0; MaterialIndex < Materials.Num(); MaterialIndex++)
+		{
+			FImpostorOpacityMask OpacityMask;
+			if (FImpostorOpacityMask::Create(Materials[MaterialIndex].MaterialInterface, OpacityMask))
+			{
+				OpacityMasks.Add(MaterialIndex, MoveTemp(OpacityMask));
+			}
+		}
+	}
+
+	TArray<FImpostorCoverageMask> Cutouts = FImpostorRasterizer::RasterizeCoverage(Geometry, Views, 16, &OpacityMasks);
+	if (ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards)
+	{
+		return Cutouts;
+	}
+
+	// Single octahedral card has to fit the mesh from every view
+	FImpostorCoverageMask Combined;
+	Combined.Init(16);
+	for (const FImpostorCoverageMask& Cutout : Cutouts)
+	{
+		Combined.Union(Cutout);
+	}
+
+	return { Combined };
+}
+
 FImpostorTextureData UImpostorProceduralMeshManager::BakeAlphasData(const int32 Index, const FImpostorTextureData& Data) const
 {
 	if (Data.SizeX != 0)
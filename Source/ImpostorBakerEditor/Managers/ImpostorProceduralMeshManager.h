@@ -7,6 +7,7 @@
 class UMaterialInstanceConstant;
 class UProceduralMeshComponent;
 class UStaticMesh;
+struct FImpostorCoverageMask;
 struct FProcMeshTangent;
 
 USTRUCT()
@@ -33,6 +34,8 @@ struct FImpostorTextureData
 
 		return Alphas[Index];
 	}
+
+	static FImpostorTextureData FromCoverage(const FImpostorCoverageMask& Coverage);
 };
 
 USTRUCT()
@@ -47,6 +50,36 @@ struct FImpostorPoints
 	TMap<FVector2D, FVector> PointToVertex;
 };
 
+// Everything needed to inject impostor LOD into referenced mesh, gathered before any mesh build is started
+USTRUCT()
+struct FImpostorLODDescription
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStaticMesh> Mesh;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStaticMesh> ImpostorMesh;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UMaterialInstanceConstant> Material;
+
+	// Material of shadow proxy section, null if impostor casts shadow itself
+	UPROPERTY(Transient)
+	TObjectPtr<UMaterialInstanceConstant> ShadowMaterial;
+
+	int32 LODIndex = 0;
+	bool bCastShadow = false;
+	// Screen size LOD switches in at, 0 keeps current one
+	float ScreenSize = 0.f;
+
+	bool IsValid() const
+	{
+		return Mesh && ImpostorMesh;
+	}
+};
+
 UCLASS()
 class IMPOSTORBAKEREDITOR_API UImpostorProceduralMeshManager : public UImpostorBaseManager
 {
@@ -58,14 +91,30 @@ public:
 	virtual void Update() override;
 	//~ End UImpostorBaseManager Interface
 
-	void SaveMesh(UMaterialInstanceConstant* NewMaterial) const;
-	void UpdateLOD(UMaterialInstanceConstant* NewMaterial) const;
+	// Shadow proxy section is added to the mesh, if ShadowMaterial is set
+	void SaveMesh(UMaterialInstanceConstant* NewMaterial, UMaterialInstanceConstant* ShadowMaterial = nullptr) const;
+	FImpostorLODDescription PrepareLOD(UMaterialInstanceConstant* NewMaterial, UMaterialInstanceConstant* ShadowMaterial = nullptr) const;
+
+	// Screen size, at which frame texels match screen pixels, clamped between neighbor LODs of referenced mesh.
+	// 0 if LOD screen size shouldn't be set.
+	float GetLODScreenSize() const;
+	// Screen size of next LOD in impostor chain, whose atlas is Resolution wide, kept below PreviousScreenSize (if it's set)
+	float GetChainLODScreenSize(int32 Resolution, float PreviousScreenSize) const;
+
+	// Injects all prepared LODs and builds affected meshes in parallel through async static mesh compilation.
+	// Returns errors for LODs, which failed to be added.
+	static TArray<FText> BuildLODs(const TArray<FImpostorLODDescription>& Descriptions);
 
 private:
-	UStaticMesh* CreateMesh(UMaterialInstanceConstant* NewMaterial, UObject* TargetPacket, const FString& AssetName) const;
+	UStaticMesh* CreateMesh(UMaterialInstanceConstant* NewMaterial, UMaterialInstanceConstant* ShadowMaterial, UObject* TargetPacket, const FString& AssetName) const;
+	static bool ApplyLOD(const FImpostorLODDescription& Description);
+	// Screen size mesh is currently using for LOD, either auto computed or set in source model
+	static float GetMeshLODScreenSize(const UStaticMesh* Mesh, int32 LODIndex);
 	void GenerateMeshData();
 
 	TArray<FVector> GetNormalCards() const;
+	// Cutout coverage for every card predicted from referenced mesh geometry, empty if cutout should be read back from captures
+	TArray<FImpostorCoverageMask> RasterizeCutouts() const;
 	FImpostorTextureData BakeAlphasData(int32 Index, const FImpostorTextureData& Data) const;
 
 	void CutCorners(TArray<FVector2D>& LocalPoints) const;
@@ -1,19 +1,29 @@
 ﻿#include "ImpostorRenderTargetsManager.h"
+#include <Algo/Count.h>
 #include <AssetRegistry/AssetRegistryModule.h>
+#include <Async/ParallelFor.h>
 #include <Components/SceneCaptureComponent2D.h>
 #include <Components/StaticMeshComponent.h>
-#include <Engine/Canvas.h>
+#include <Engine/StaticMesh.h>
 #include <Engine/Texture2D.h>
+#include <Engine/Texture2DArray.h>
 #include <Engine/TextureRenderTarget2D.h>
 #include <Kismet/KismetRenderingLibrary.h>
 #include <Materials/MaterialInstanceDynamic.h>
+#include <Materials/MaterialInterface.h>
 #include <UObject/Package.h>
+#include "ImpostorBakerEditorModule.h"
 #include "ImpostorComponentsManager.h"
-#include "ImpostorLightingManager.h"
 #include "ImpostorMaterialsManager.h"
 #include "ImpostorProceduralMeshManager.h"
-#include "SceneRenderBuilderInterface.h"
+#include "Backends/ImpostorCPUCaptureBackend.h"
+#include "Backends/ImpostorGPUCaptureBackend.h"
+#include "Backends/ImpostorReplayCaptureBackend.h"
 #include "Settings/ImpostorBakerSettings.h"
+#include "Utilities/ImpostorImage.h"
+#include "Utilities/ImpostorMeshGeometry.h"
+#include "Utilities/ImpostorNormalEncoding.h"
+#include "Utilities/ImpostorRasterizer.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(ImpostorRenderTargetsManager)
 
@@ -21,10 +31,22 @@ void UImpostorRenderTargetsManager::Initialize()
 {
 	SceneCaptureComponent2D = NewObject<USceneCaptureComponent2D>(GetTransientPackage(), NAME_None, RF_Transient);
 	AddComponent(SceneCaptureComponent2D);
+
+	GPUCaptureBackend = NewObject<UImpostorGPUCaptureBackend>(this);
+	GPUCaptureBackend->Initialize(this);
+
+	CPUCaptureBackend = NewObject<UImpostorCPUCaptureBackend>(this);
+	CPUCaptureBackend->Initialize(this);
+
+	ReplayCaptureBackend = NewObject<UImpostorReplayCaptureBackend>(this);
+	ReplayCaptureBackend->Initialize(this);
 }
 
 void UImpostorRenderTargetsManager::Update()
 {
+	// Render targets and views are about to change
+	CancelBake();
+
 	TArray<EImpostorBakeMapType>& MapsToRender = ImpostorData->MapsToRender;
 	if (ImpostorData->bCombineLightingAndColor)
 	{
@@ -39,7 +61,8 @@ void UImpostorRenderTargetsManager::Update()
 		}
 	}
 
-	if (ImpostorData->bCombineNormalAndDepth)
+	if (ImpostorData->bCombineNormalAndDepth &&
+		ImpostorData->NormalEncoding == EImpostorNormalEncoding::Packed)
 	{
 		if (!MapsToRender.Contains(EImpostorBakeMapType::Depth))
 		{
@@ -53,7 +76,7 @@ void UImpostorRenderTargetsManager::Update()
 	}
 
 	AllocateRenderTargets();
-	CreateRenderTargetMips();
+	CreateRenderTargetMips(ImpostorData->SceneCaptureResolution);
 	CreateAlphasScratchRenderTargets();
 	FillMapsToSave();
 
@@ -83,10 +106,9 @@ void UImpostorRenderTargetsManager::Tick()
 		return;
 	}
 
-	CaptureImposterGrid();
-	if (CurrentMap == EImpostorBakeMapType::BaseColor)
+	if (!CaptureImposterGrid(CaptureStage == ECaptureStage::Refine ? ImpostorData->ProgressiveViewsPerTick : MAX_int32))
 	{
-		bCapturingFinalColor = true;
+		return;
 	}
 
 	if (MapsToBake.Num() == 0)
@@ -95,7 +117,7 @@ void UImpostorRenderTargetsManager::Tick()
 		return;
 	}
 
-	PreparePostProcess(MapsToBake.Pop());
+	PrepareMap(MapsToBake.Pop());
 }
 
 void UImpostorRenderTargetsManager::AllocateRenderTargets()
@@ -130,7 +152,8 @@ void UImpostorRenderTargetsManager::AllocateRenderTargets()
 			break;
 		}
 
-		const FVector2D Size = GetManager<UImpostorComponentsManager>()->GetRenderTargetSize();
+		// Reduced maps are allocated at their own size, so neither capture nor export touches full size atlas
+		const FIntPoint Size = GetManager<UImpostorComponentsManager>()->GetMapAtlasSize(MapType);
 		if (UTextureRenderTarget2D* TargetMap = TargetMaps.FindRef(MapType))
 		{
 			if (TargetMap->RenderTargetFormat == Format)
@@ -154,11 +177,11 @@ void UImpostorRenderTargetsManager::AllocateRenderTargets()
 	}
 }
 
-void UImpostorRenderTargetsManager::CreateRenderTargetMips()
+void UImpostorRenderTargetsManager::CreateRenderTargetMips(const int32 Resolution)
 {
 	for (int32 MipIndex = 0; MipIndex < 8; MipIndex++)
 	{
-		const int32 MipSize = ImpostorData->SceneCaptureResolution / (1 << MipIndex);
+		const int32 MipSize = FMath::Max(1, Resolution / (1 << MipIndex));
 		if (SceneCaptureMipChain.IsValidIndex(MipIndex))
 		{
 			if (UTextureRenderTarget2D* MipRenderTarget = SceneCaptureMipChain[MipIndex])
@@ -181,11 +204,11 @@ void UImpostorRenderTargetsManager::CreateRenderTargetMips()
 
 	if (!SceneCaptureSRGBMip)
 	{
-		SceneCaptureSRGBMip = UKismetRenderingLibrary::CreateRenderTarget2D(SceneWorld, ImpostorData->SceneCaptureResolution, ImpostorData->SceneCaptureResolution, RTF_RGBA8_SRGB);
+		SceneCaptureSRGBMip = UKismetRenderingLibrary::CreateRenderTarget2D(SceneWorld, Resolution, Resolution, RTF_RGBA8_SRGB);
 	}
-	else if (SceneCaptureSRGBMip->SizeX != ImpostorData->SceneCaptureResolution)
+	else if (SceneCaptureSRGBMip->SizeX != Resolution)
 	{
-		UKismetRenderingLibrary::ResizeRenderTarget2D(SceneCaptureSRGBMip, ImpostorData->SceneCaptureResolution, ImpostorData->SceneCaptureResolution);
+		UKismetRenderingLibrary::ResizeRenderTarget2D(SceneCaptureSRGBMip, Resolution, Resolution);
 	}
 }
 
@@ -240,7 +263,7 @@ void UImpostorRenderTargetsManager::FillMapsToSave()
 		MapsToSave.Remove(EImpostorBakeMapType::CustomLighting);
 	}
 
-	if (ImpostorData->bCombineNormalAndDepth)
+	if (ImpostorData->CombinesNormalAndDepth())
 	{
 		MapsToSave.Remove(EImpostorBakeMapType::Depth);
 	}
@@ -300,7 +323,7 @@ void UImpostorRenderTargetsManager::ClearRenderTarget(UTextureRenderTarget2D* Re
 	UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
 }
 
-void UImpostorRenderTargetsManager::ResampleRenderTarget(UTextureRenderTarget2D* Source, UTextureRenderTarget2D* Dest) const
+void UImpostorRenderTargetsManager::ResampleRenderTarget(UTexture* Source, UTextureRenderTarget2D* Dest) const
 {
 	const UImpostorMaterialsManager* MaterialsManager = GetManager<UImpostorMaterialsManager>();
 
@@ -312,9 +335,57 @@ void UImpostorRenderTargetsManager::ResampleRenderTarget(UTextureRenderTarget2D*
 
 void UImpostorRenderTargetsManager::BakeRenderTargets()
 {
-	bCapturingFinalColor = false;
-
+	CancelBake();
 	ClearRenderTargets();
+
+	if (ImpostorData->bProgressiveCapture)
+	{
+		CreateRenderTargetMips(FMath::Max(1, ImpostorData->SceneCaptureResolution / ImpostorData->ProgressiveResolutionDivisor));
+		StartBake(ECaptureStage::Coarse);
+	}
+	else
+	{
+		StartBake(ECaptureStage::Full);
+	}
+}
+
+void UImpostorRenderTargetsManager::CancelBake()
+{
+	if (!IsBaking())
+	{
+		return;
+	}
+
+	TArray<IImpostorCaptureBackend*> UsedBackends;
+	for (const auto& It : MapBackends)
+	{
+		UsedBackends.AddUnique(It.Value);
+	}
+
+	for (IImpostorCaptureBackend* Backend : UsedBackends)
+	{
+		Backend->EndBake();
+	}
+	CurrentBackend = nullptr;
+
+	if (CaptureStage == ECaptureStage::Full)
+	{
+		EndSlowTask();
+	}
+	else
+	{
+		CreateRenderTargetMips(ImpostorData->SceneCaptureResolution);
+	}
+
+	ForceTick(false);
+
+	CurrentMap = EImpostorBakeMapType::None;
+	SetOverlayText("Refining", "");
+}
+
+void UImpostorRenderTargetsManager::StartBake(const ECaptureStage Stage)
+{
+	CaptureStage = Stage;
 	MapsToBake.Empty();
 
 	const UImpostorMaterialsManager* MaterialManager = GetManager<UImpostorMaterialsManager>();
@@ -333,32 +404,73 @@ void UImpostorRenderTargetsManager::BakeRenderTargets()
 
 	if (MapsToBake.Num() == 0)
 	{
+		if (CaptureStage != ECaptureStage::Full)
+		{
+			CreateRenderTargetMips(ImpostorData->SceneCaptureResolution);
+		}
 		return;
 	}
 
+	// GPU backend is always used for maps, which selected backend doesn't support
+	GPUCaptureBackend->BeginBake();
+	if (GetSelectedBackend() != GPUCaptureBackend.Get())
+	{
+		GetSelectedBackend()->BeginBake();
+	}
+
+	MapBackends.Empty();
+	CaptureTimings.Empty();
+
+	// Refinement reuses views found for coarse pass
+	if (CaptureStage != ECaptureStage::Refine)
+	{
+		AnalyzeCaptureViews();
+	}
+
 	NumMapsToBake = MapsToBake.Num();
 
 	ForceTick(true);
 
-	StartSlowTask(NumMapsToBake * GetManager<UImpostorComponentsManager>()->ViewCaptureVectors.Num(), "Capturing impostor map textures...");
+	if (CaptureStage == ECaptureStage::Full)
+	{
+		StartSlowTask(NumMapsToBake * GetManager<UImpostorComponentsManager>()->ViewCaptureVectors.Num(), "Capturing impostor map textures...");
+	}
 
-	PreparePostProcess(MapsToBake.Pop());
+	PrepareMap(MapsToBake.Pop());
 }
 
-TMap<EImpostorBakeMapType, UTexture2D*> UImpostorRenderTargetsManager::SaveTextures()
+TMap<EImpostorBakeMapType, UTexture2D*> UImpostorRenderTargetsManager::SaveTextures(const float LODScreenSize)
 {
+	const UImpostorBakerSettings* Settings = GetDefault<UImpostorBakerSettings>();
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+
+	// Impostor LOD isn't shown bigger than at its screen size, so larger mips would never be used
+	const int32 RequiredSize = LODScreenSize > 0.f ? int32(FMath::RoundUpToPowerOfTwo(FMath::Max(FMath::CeilToInt32(ComponentsManager->GetRequiredAtlasSize(LODScreenSize)), 1))) : 0;
+
 	TMap<EImpostorBakeMapType, UTexture2D*> NewTextures;
 	for (const EImpostorBakeMapType TargetMap : MapsToSave)
 	{
-		ProgressSlowTask("Creating " + GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames[TargetMap].ToString() + " texture...", true);
+		ProgressSlowTask("Creating " + Settings->ImpostorPreviewMapNames[TargetMap].ToString() + " texture...", true);
+
+		// Reduced maps need proportionally smaller mips
+		const int32 AtlasSize = ComponentsManager->GetMapAtlasSize(TargetMap).GetMax();
+		const int32 MapRequiredSize = FMath::Max(RequiredSize / ImpostorData->GetMapResolutionDivisor(TargetMap), 1);
+		const int32 MaxTextureSize = RequiredSize > 0 && MapRequiredSize < AtlasSize ? MapRequiredSize : 0;
+		const int32 ResidentSize = MaxTextureSize > 0 ? MaxTextureSize : AtlasSize;
+
+		// Maps, which weren't captured on GPU, are read from their backend instead of render targets
+		FImpostorImage BackendImage;
+		IImpostorCaptureBackend* Backend = MapBackends.FindRef(TargetMap);
+		const bool bUseBackendImage = Backend && Backend != GPUCaptureBackend.Get() && Backend->Readback(TargetMap, BackendImage);
+
 		UTextureRenderTarget2D* RenderTarget = TargetMaps.FindRef(TargetMap);
-		if (!ensure(RenderTarget) ||
-			!ensure(RenderTarget->GetResource()))
+		if (!bUseBackendImage &&
+			(!ensure(RenderTarget) || !ensure(RenderTarget->GetResource())))
 		{
 			continue;
 		}
 
-		FString AssetName = ImpostorData->NewTextureName + "_" + GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames[TargetMap].ToString();
+		FString AssetName = ImpostorData->NewTextureName + "_" + Settings->ImpostorPreviewMapNames[TargetMap].ToString();
 		FString PackageName = ImpostorData->GetPackageName(AssetName);
 
 		UPackage* TexturePackage = CreatePackage(*PackageName);
@@ -371,7 +483,17 @@ TMap<EImpostorBakeMapType, UTexture2D*> UImpostorRenderTargetsManager::SaveTextu
 
 		bool bCreatingNewTexture = false;
 		UTexture2D* NewTexture = FindObject<UTexture2D>(TexturePackage, *AssetName);
-		if (NewTexture)
+		if (bUseBackendImage)
+		{
+			if (!NewTexture)
+			{
+				bCreatingNewTexture = true;
+				NewTexture = NewObject<UTexture2D>(TexturePackage, *AssetName, RF_Public | RF_Standalone);
+			}
+
+			BackendImage.WriteToTextureSource(NewTexture);
+		}
+		else if (NewTexture)
 		{
 			RenderTarget->UpdateTexture(NewTexture, static_cast<EConstructTextureFlags>(CTF_Default | CTF_AllowMips));
 		}
@@ -386,20 +508,48 @@ TMap<EImpostorBakeMapType, UTexture2D*> UImpostorRenderTargetsManager::SaveTextu
 			continue;
 		}
 
+		// Octahedral normals and their separate depth are re-encoded on CPU, render targets keep packed normals for preview
+		const bool bOctahedralNormal = ImpostorData->NormalEncoding == EImpostorNormalEncoding::Octahedral;
+		if (bOctahedralNormal &&
+			(TargetMap == EImpostorBakeMapType::Normal || TargetMap == EImpostorBakeMapType::Depth))
+		{
+			FImpostorImage Image;
+			if (ensure(Image.ReadFromTextureSource(NewTexture)))
+			{
+				if (TargetMap == EImpostorBakeMapType::Normal)
+				{
+					FImpostorNormalEncoding::EncodeOctahedral(Image);
+				}
+				else
+				{
+					FImpostorNormalEncoding::SplatChannel(Image, 0);
+				}
+				Image.WriteToTextureSource(NewTexture);
+			}
+		}
+
 		NewTexture->PreEditChange(nullptr);
 
 		NewTexture->MipGenSettings = TMGS_FromTextureGroup;
 		NewTexture->SRGB = TargetMap == EImpostorBakeMapType::BaseColor;
 		NewTexture->CompressionSettings = TC_BC7;
+		NewTexture->LODGroup = Settings->ImpostorTextureGroup;
+		NewTexture->MaxTextureSize = MaxTextureSize;
+		NewTexture->NeverStream = ResidentSize <= Settings->NeverStreamMaxSize;
+		NewTexture->VirtualTextureStreaming = ImpostorData->bSaveVirtualTextures;
 
 		if (TargetMap == EImpostorBakeMapType::Normal)
 		{
-			if (!ImpostorData->bCombineNormalAndDepth || !ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::Depth))
+			if (!ImpostorData->CombinesNormalAndDepth())
 			{
 				NewTexture->LODGroup = TEXTUREGROUP_WorldNormalMap;
 				NewTexture->CompressionSettings = TC_Normalmap;
 			}
 		}
+		else if (TargetMap == EImpostorBakeMapType::Depth && bOctahedralNormal)
+		{
+			NewTexture->CompressionSettings = TC_Alpha;
+		}
 
 		NewTexture->UpdateResource();
 		NewTexture->PostEditChange();
@@ -415,218 +565,632 @@ TMap<EImpostorBakeMapType, UTexture2D*> UImpostorRenderTargetsManager::SaveTextu
 	return NewTextures;
 }
 
-void UImpostorRenderTargetsManager::PreparePostProcess(const EImpostorBakeMapType TargetMap)
+TMap<EImpostorBakeMapType, UTexture2DArray*> UImpostorRenderTargetsManager::SaveTextureArrays(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures) const
 {
-	switch (TargetMap)
+	TMap<EImpostorBakeMapType, UTexture2DArray*> NewTextureArrays;
+	if (!ImpostorData->bSaveFrameArrays)
 	{
-	default:
-		check(false);
+		return NewTextureArrays;
+	}
 
-	case EImpostorBakeMapType::BaseColor:
-		SceneCaptureComponent2D->CaptureSource = ImpostorData->bUseFinalColorInsteadBaseColor || ImpostorData->ProjectionType == ECameraProjectionMode::Orthographic || bCapturingFinalColor ? SCS_SceneColorHDR : SCS_BaseColor;
-		SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array.Empty();
-		SceneCaptureComponent2D->SceneViewExtensions.Empty();
-		Extension = nullptr;
-		break;
+	const UImpostorBakerSettings* Settings = GetDefault<UImpostorBakerSettings>();
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+	const int32 NumFrames = ComponentsManager->NumHorizontalFrames * ComponentsManager->NumVerticalFrames;
 
-	case EImpostorBakeMapType::CustomLighting:
-		SceneCaptureComponent2D->CaptureSource = SCS_SceneColorHDR;
-		SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array.Empty();
-		Extension = FSceneViewExtensions::NewExtension<FLightingViewExtension>(SceneCaptureComponent2D->GetScene());
-		SceneCaptureComponent2D->SceneViewExtensions.Add(Extension);
-		break;
-
-	case EImpostorBakeMapType::Metallic:
-	case EImpostorBakeMapType::Specular:
-	case EImpostorBakeMapType::Roughness:
-	case EImpostorBakeMapType::Opacity:
-	case EImpostorBakeMapType::Subsurface:
-	case EImpostorBakeMapType::Normal:
-	case EImpostorBakeMapType::Depth:
-		SceneCaptureComponent2D->CaptureSource = SCS_FinalColorLDR;
-		if (UMaterialInterface* Material = GetManager<UImpostorMaterialsManager>()->GetRenderTypeMaterial(TargetMap))
-		{
-			Material->EnsureIsComplete();
-			SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array = {FWeightedBlendable(1.0f, Material)};
+	for (const auto& [TargetMap, Texture] : Textures)
+	{
+		ProgressSlowTask("Creating " + Settings->ImpostorPreviewMapNames[TargetMap].ToString() + " frame array...", true);
+
+		FImpostorImage Atlas;
+		if (!ensure(Atlas.ReadFromTextureSource(Texture)))
+		{
+			continue;
 		}
-		else
+
+		// Octahedral coordinates can't be filtered across folds, so normals are resampled as vectors
+		const bool bOctahedralNormal = TargetMap == EImpostorBakeMapType::Normal && ImpostorData->NormalEncoding == EImpostorNormalEncoding::Octahedral;
+		if (bOctahedralNormal)
+		{
+			FImpostorNormalEncoding::DecodeOctahedral(Atlas);
+		}
+
+		// Power of two slices get full mip chain
+		const int32 FrameSize = FMath::Max(ComponentsManager->GetFrameRect(0, Atlas.GetSize()).Width(), 1);
+		const int32 SliceSize = 1 << FMath::RoundToInt32(FMath::Log2(float(FrameSize)));
+
+		TArray<FColor> Slices;
+		Slices.SetNumUninitialized(SliceSize * SliceSize * NumFrames);
+		ParallelFor(NumFrames, [&](const int32 Index)
+		{
+			FImpostorImage Slice = Atlas.Resample(ComponentsManager->GetFrameRect(Index, Atlas.GetSize()), FIntPoint(SliceSize));
+			if (bOctahedralNormal)
+			{
+				FImpostorNormalEncoding::EncodeOctahedral(Slice);
+			}
+			FMemory::Memcpy(&Slices[ComponentsManager->GetFrameSlot(Index) * SliceSize * SliceSize], Slice.Pixels.GetData(), Slice.Pixels.Num() * sizeof(FColor));
+		});
+
+		const FString AssetName = Texture->GetName() + "_Array";
+		UPackage* TexturePackage = CreatePackage(*ImpostorData->GetPackageName(AssetName));
+		if (!ensure(TexturePackage))
+		{
+			continue;
+		}
+
+		TexturePackage->FullyLoad(); // Make sure the destination package is loaded
+
+		bool bCreatingNewTexture = false;
+		UTexture2DArray* NewTextureArray = FindObject<UTexture2DArray>(TexturePackage, *AssetName);
+		if (!NewTextureArray)
+		{
+			bCreatingNewTexture = true;
+			NewTextureArray = NewObject<UTexture2DArray>(TexturePackage, *AssetName, RF_Public | RF_Standalone);
+		}
+
+		NewTextureArray->Source.Init(SliceSize, SliceSize, NumFrames, 1, TSF_BGRA8, reinterpret_cast<const uint8*>(Slices.GetData()));
+
+		NewTextureArray->PreEditChange(nullptr);
+
+		// Same settings as atlas texture, frame UVs are clamped to their slice
+		NewTextureArray->MipGenSettings = Texture->MipGenSettings;
+		NewTextureArray->SRGB = Texture->SRGB;
+		NewTextureArray->CompressionSettings = Texture->CompressionSettings;
+		NewTextureArray->LODGroup = Texture->LODGroup;
+		NewTextureArray->NeverStream = Texture->NeverStream;
+		NewTextureArray->AddressX = TA_Clamp;
+		NewTextureArray->AddressY = TA_Clamp;
+
+		NewTextureArray->UpdateResource();
+		NewTextureArray->PostEditChange();
+		NewTextureArray->MarkPackageDirty();
+
+		if (bCreatingNewTexture)
 		{
-			SceneCaptureComponent2D->PostProcessSettings.WeightedBlendables.Array.Empty();
+			FAssetRegistryModule::AssetCreated(NewTextureArray);
 		}
-		SceneCaptureComponent2D->SceneViewExtensions.Empty();
-		Extension = nullptr;
-		break;
+		NewTextureArrays.Add(TargetMap, NewTextureArray);
 	}
 
-	CurrentMap = TargetMap;
-	FramesBeforeCapture = 5;
+	return NewTextureArrays;
 }
 
-void UImpostorRenderTargetsManager::CaptureImposterGrid()
+TMap<EImpostorBakeMapType, UTexture2D*> UImpostorRenderTargetsManager::SaveDownsampledTextures(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures, const int32 Resolution) const
 {
-	// Disable unnecessary Lights when baking some maps (increase baking speed)
-	UImpostorLightingManager* LightingManager = GetManager<UImpostorLightingManager>();
-	if (IsValid(LightingManager))
+	const UImpostorBakerSettings* Settings = GetDefault<UImpostorBakerSettings>();
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+	const int32 NumViews = ComponentsManager->ViewCaptureVectors.Num();
+
+	TMap<EImpostorBakeMapType, UTexture2D*> NewTextures;
+	for (const auto& [TargetMap, Texture] : Textures)
 	{
-		switch (CurrentMap)
+		ProgressSlowTask("Creating " + Settings->ImpostorPreviewMapNames[TargetMap].ToString() + " texture at " + LexToString(Resolution) + "...", true);
+
+		FImpostorImage Atlas;
+		if (!ensure(Atlas.ReadFromTextureSource(Texture)))
 		{
-		case EImpostorBakeMapType::BaseColor:
-			LightingManager->SetLightsVisibility(ImpostorData->bUseFinalColorInsteadBaseColor);
-			break;
+			continue;
+		}
 
-		case EImpostorBakeMapType::CustomLighting:
-			LightingManager->SetLightsVisibility(true);
-			break;
+		// Octahedral coordinates can't be filtered across folds, so normals are resampled as vectors
+		const bool bOctahedralNormal = TargetMap == EImpostorBakeMapType::Normal && ImpostorData->NormalEncoding == EImpostorNormalEncoding::Octahedral;
+		if (bOctahedralNormal)
+		{
+			FImpostorNormalEncoding::DecodeOctahedral(Atlas);
+		}
 
-		default:
-			LightingManager->SetLightsVisibility(false);
-			break;
+		// Atlas is scaled as a whole, so frame placement and Frame UV Scale stay the same. Reduced maps keep their divisor.
+		const int32 MapResolution = FMath::Max(Resolution / ImpostorData->GetMapResolutionDivisor(TargetMap), 1);
+		const FIntPoint NewSize(MapResolution, FMath::Max(FMath::RoundToInt32(float(MapResolution) * Atlas.SizeY / Atlas.SizeX), 1));
+		FImpostorImage NewAtlas;
+		NewAtlas.Init(NewSize.X, NewSize.Y);
+
+		// Filtering never crosses frame borders, so lower resolutions don't bleed neighbor views into frame edges
+		ParallelFor(NumViews, [&](const int32 Index)
+		{
+			const FIntRect Rect = ComponentsManager->GetFrameRect(Index, NewSize);
+			Atlas.Resample(ComponentsManager->GetFrameRect(Index, Atlas.GetSize()), Rect.Size()).CopyTo(NewAtlas, Rect.Min);
+		});
+
+		const FString AssetName = ImpostorData->NewTextureName + "_" + Settings->ImpostorPreviewMapNames[TargetMap].ToString();
+		UPackage* TexturePackage = CreatePackage(*ImpostorData->GetPackageName(AssetName));
+		if (!ensure(TexturePackage))
+		{
+			continue;
+		}
+
+		TexturePackage->FullyLoad(); // Make sure the destination package is loaded
+
+		bool bCreatingNewTexture = false;
+		UTexture2D* NewTexture = FindObject<UTexture2D>(TexturePackage, *AssetName);
+		if (!NewTexture)
+		{
+			bCreatingNewTexture = true;
+			NewTexture = NewObject<UTexture2D>(TexturePackage, *AssetName, RF_Public | RF_Standalone);
 		}
+
+		if (bOctahedralNormal)
+		{
+			FImpostorNormalEncoding::EncodeOctahedral(NewAtlas);
+		}
+		NewAtlas.WriteToTextureSource(NewTexture);
+
+		NewTexture->PreEditChange(nullptr);
+
+		NewTexture->MipGenSettings = Texture->MipGenSettings;
+		NewTexture->SRGB = Texture->SRGB;
+		NewTexture->CompressionSettings = Texture->CompressionSettings;
+		NewTexture->LODGroup = Texture->LODGroup;
+		NewTexture->MaxTextureSize = 0;
+		NewTexture->NeverStream = NewSize.GetMax() <= Settings->NeverStreamMaxSize;
+		NewTexture->VirtualTextureStreaming = Texture->VirtualTextureStreaming;
+
+		NewTexture->UpdateResource();
+		NewTexture->PostEditChange();
+		NewTexture->MarkPackageDirty();
+
+		if (bCreatingNewTexture)
+		{
+			FAssetRegistryModule::AssetCreated(NewTexture);
+		}
+		NewTextures.Add(TargetMap, NewTexture);
 	}
 
-	SceneCaptureComponent2D->TextureTarget = CurrentMap == EImpostorBakeMapType::BaseColor && !bCapturingFinalColor ? SceneCaptureSRGBMip : SceneCaptureMipChain[0];
-	FString MapTypeString = GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames[CurrentMap].ToString();
-	if (bCapturingFinalColor && CurrentMap == EImpostorBakeMapType::BaseColor)
+	return NewTextures;
+}
+
+UTexture2D* UImpostorRenderTargetsManager::SaveShadowProxyTexture(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures) const
+{
+	if (!ImpostorData->UsesShadowProxy())
 	{
-		MapTypeString = "Final Color (Opacity)";
-		ResampleRenderTarget(TargetMaps[CurrentMap], BaseColorScratchRenderTarget);
-		ClearRenderTarget(TargetMaps[CurrentMap]);
+		return nullptr;
 	}
 
-	const FString Message = "Baking impostor " + MapTypeString + " map... [" + LexToString(NumMapsToBake - MapsToBake.Num()) + " / " + LexToString(NumMapsToBake) + "]";
+	ProgressSlowTask("Creating shadow proxy texture...", true);
+
+	// Same maps as read by material and FImpostorRenderSource
+	const bool bDepthInNormalAlpha = ImpostorData->CombinesNormalAndDepth();
+
+	FImpostorImage Coverage;
+	FImpostorImage Depth;
+	if (!Coverage.ReadFromTextureSource(Textures.FindRef(EImpostorBakeMapType::BaseColor)))
+	{
+		UE_LOG(LogImpostorBaker, Warning, TEXT("%s: Base Color isn't saved, shadow proxy is skipped"), *ImpostorData->GetName());
+		return nullptr;
+	}
+	const bool bHasDepth = Depth.ReadFromTextureSource(Textures.FindRef(bDepthInNormalAlpha ? EImpostorBakeMapType::Normal : EImpostorBakeMapType::Depth));
 
 	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
-	const TArray<FVector>& ViewCaptureVectors = ComponentsManager->ViewCaptureVectors;
+	const int32 FramesCount = ComponentsManager->NumHorizontalFrames;
+	const int32 FrameSize = FMath::Max(ImpostorData->ShadowProxyResolution / FramesCount, 1);
+
+	// Frames are stored in view order without alignment, so material finds them by grid coordinates only
+	FImpostorImage Proxy;
+	Proxy.Init(FrameSize * FramesCount, FrameSize * FramesCount);
+	ParallelFor(ComponentsManager->ViewCaptureVectors.Num(), [&](const int32 Index)
+	{
+		const FImpostorImage CoverageFrame = Coverage.Resample(ComponentsManager->GetFrameRect(Index, Coverage.GetSize()), FIntPoint(FrameSize));
+		const FImpostorImage DepthFrame = bHasDepth ? Depth.Resample(ComponentsManager->GetFrameRect(Index, Depth.GetSize()), FIntPoint(FrameSize)) : FImpostorImage();
+		const FIntPoint Min = FIntPoint(Index % FramesCount, Index / FramesCount) * FrameSize;
+
+		for (int32 Y = 0; Y < FrameSize; Y++)
+		{
+			for (int32 X = 0; X < FrameSize; X++)
+			{
+				const uint8 FrameDepth = bHasDepth ? (bDepthInNormalAlpha ? DepthFrame.GetPixel(X, Y).A : DepthFrame.GetPixel(X, Y).R) : 128;
+				Proxy.GetPixel(Min.X + X, Min.Y + Y) = FColor(CoverageFrame.GetPixel(X, Y).A, FrameDepth, 0, 255);
+			}
+		}
+	});
+
+	const FString AssetName = ImpostorData->NewTextureName + "_ShadowProxy";
+	UPackage* TexturePackage = CreatePackage(*ImpostorData->GetPackageName(AssetName));
+	if (!ensure(TexturePackage))
+	{
+		return nullptr;
+	}
+
+	TexturePackage->FullyLoad(); // Make sure the destination package is loaded
+
+	bool bCreatingNewTexture = false;
+	UTexture2D* NewTexture = FindObject<UTexture2D>(TexturePackage, *AssetName);
+	if (!NewTexture)
+	{
+		bCreatingNewTexture = true;
+		NewTexture = NewObject<UTexture2D>(TexturePackage, *AssetName, RF_Public | RF_Standalone);
+	}
+
+	Proxy.WriteToTextureSource(NewTexture);
+
+	NewTexture->PreEditChange(nullptr);
 
-	const int32 ForceEvery = FMath::RoundFromZero(NumMapsToBake * ViewCaptureVectors.Num() / 100.f);
+	// Two 8 bit channels of linear data, BC5 compresses each of them separately from 8 bit endpoints (BC1 would quantize endpoints to 5:6:5)
+	NewTexture->MipGenSettings = TMGS_FromTextureGroup;
+	NewTexture->SRGB = false;
+	NewTexture->CompressionSettings = TC_BC5;
+	NewTexture->LODGroup = GetDefault<UImpostorBakerSettings>()->ImpostorTextureGroup;
+	NewTexture->NeverStream = true;
+	NewTexture->AddressX = TA_Clamp;
+	NewTexture->AddressY = TA_Clamp;
 
-	for (int32 Index = 0; Index < ViewCaptureVectors.Num(); Index++)
+	NewTexture->UpdateResource();
+	NewTexture->PostEditChange();
+	NewTexture->MarkPackageDirty();
+
+	if (bCreatingNewTexture)
+	{
+		FAssetRegistryModule::AssetCreated(NewTexture);
+	}
+
+	return NewTexture;
+}
+
+IImpostorCaptureBackend* UImpostorRenderTargetsManager::GetSelectedBackend() const
+{
+	switch (ImpostorData->CaptureBackend)
+	{
+	default: check(false);
+	case EImpostorCaptureBackendType::GPU:
+		return GPUCaptureBackend.Get();
+
+	case EImpostorCaptureBackendType::CPURasterizer:
+		return CPUCaptureBackend.Get();
+
+	case EImpostorCaptureBackendType::Replay:
+		return ReplayCaptureBackend.Get();
+	}
+}
+
+IImpostorCaptureBackend* UImpostorRenderTargetsManager::GetBackendForMap(const EImpostorBakeMapType TargetMap) const
+{
+	IImpostorCaptureBackend* Backend = GetSelectedBackend();
+	if (Backend->SupportsMap(TargetMap))
 	{
-		const FVector& Vector = ViewCaptureVectors[Index];
+		return Backend;
+	}
 
-		ProgressSlowTask(Message, Index % ForceEvery == 0);
+	return GPUCaptureBackend.Get();
+}
 
-		FVector WorldLocation = ComponentsManager->GetBounds().Origin;
-		WorldLocation += Vector * (ImpostorData->ProjectionType == ECameraProjectionMode::Type::Orthographic ? (ComponentsManager->ObjectRadius * 1.25f) : ImpostorData->CameraDistance);
-		SceneCaptureComponent2D->SetWorldLocation(WorldLocation);
-		SceneCaptureComponent2D->SetWorldRotation((Vector * -1.f).ToOrientationRotator());
+void UImpostorRenderTargetsManager::AnalyzeCaptureViews()
+{
+	ViewSymmetry = {};
+	NumSkippedCaptures = 0;
+	EmptyFrames.Reset();
+	NumSkippedEmptyCaptures = 0;
+	CoarseFrames = {};
 
-		GetManager<UImpostorMaterialsManager>()->UpdateDepthMaterialData(Vector);
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
 
-		SceneWorld->SendAllEndOfFrameUpdates();
+	TArray<FImpostorViewProjection> Views;
+	Views.Reserve(ComponentsManager->ViewCaptureVectors.Num());
+	for (int32 Index = 0; Index < ComponentsManager->ViewCaptureVectors.Num(); Index++)
+	{
+		Views.Add(ComponentsManager->GetViewProjection(Index));
+	}
 
-		TUniquePtr<ISceneRenderBuilder> SceneRenderBuilder = ISceneRenderBuilder::Create(SceneWorld->Scene);
-		SceneCaptureComponent2D->UpdateSceneCaptureContents(SceneWorld->Scene, *SceneRenderBuilder);
-		SceneRenderBuilder->Execute();
+	const FImpostorMeshGeometry Geometry =
+		ImpostorData->bSkipSymmetricCaptures || ImpostorData->bSkipEmptyFrames ?
+		FImpostorMeshGeometry::Gather(ImpostorData->ReferencedMesh) :
+		FImpostorMeshGeometry();
 
-		// Lower mips are necessary for distance field alpha and mesh cutouts
-		if (ImpostorData->bUseDistanceFieldAlpha || ImpostorData->bUseMeshCutout)
+	if (ImpostorData->bSkipEmptyFrames &&
+		!Geometry.IsEmpty())
+	{
+		// Back faces of single sided materials are culled by capture, so they don't cover the frame
+		TSet<int32> SingleSidedMaterials;
+		const TArray<FStaticMaterial>& Materials = ImpostorData->ReferencedMesh->GetStaticMaterials();
+		for (int32 MaterialIndex = 0; MaterialIndex < Materials.Num(); MaterialIndex++)
 		{
-			if (CurrentMap == EImpostorBakeMapType::BaseColor && bCapturingFinalColor)
+			const UMaterialInterface* Material = Materials[MaterialIndex].MaterialInterface;
+			if (Material &&
+				!Material->IsTwoSided())
 			{
-				for (int32 MipIndex = 1; MipIndex < SceneCaptureMipChain.Num(); MipIndex++)
-				{
-					UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, SceneCaptureMipChain[MipIndex], FLinearColor::Black);
-					ResampleRenderTarget(SceneCaptureMipChain[MipIndex - 1], SceneCaptureMipChain[MipIndex]);
-				}
+				SingleSidedMaterials.Add(MaterialIndex);
 			}
 		}
 
-		DrawSingleFrame(Index);
+		// Conservative coverage, so frame is only empty if no facing triangle touches it at all
+		const TArray<FImpostorCoverageMask> Coverage = FImpostorRasterizer::RasterizeCoverage(Geometry, Views, 16, nullptr, 8, &SingleSidedMaterials);
+
+		EmptyFrames.SetNumZeroed(Views.Num());
+		for (int32 Index = 0; Index < Views.Num(); Index++)
+		{
+			EmptyFrames[Index] = Coverage[Index].IsEmpty();
+		}
+	}
+
+	if (ImpostorData->bSkipSymmetricCaptures &&
+		!Geometry.IsEmpty())
+	{
+		// Vertices closer than this are considered to be the same
+		const float Tolerance = ComponentsManager->ObjectRadius * 0.001f;
+		const TArray<FImpostorSymmetryTransform> Symmetries = FImpostorViewSymmetry::FindSymmetries(Geometry, FVector3f(ComponentsManager->OffsetVector), Tolerance);
+
+		ViewSymmetry = FImpostorViewSymmetry::Create(Symmetries, Views);
+
+		UE_LOG(LogImpostorBaker, Log, TEXT("Found %d mesh symmetries, %d of %d views are symmetric copies"), Symmetries.Num(), ViewSymmetry.GetNumCopies(), Views.Num());
+	}
+
+	if (CaptureStage == ECaptureStage::Coarse)
+	{
+		// Every Nth frame on each atlas axis, including the last row and column
+		const int32 Stride = FMath::Max(2, ImpostorData->ProgressiveFrameStride);
+		const int32 NumHorizontalFrames = ComponentsManager->NumHorizontalFrames;
+		const int32 NumVerticalFrames = ComponentsManager->NumVerticalFrames;
+
+		TArray<bool> SourceViews;
+		TArray<bool> FilledViews;
+		SourceViews.SetNumZeroed(Views.Num());
+		FilledViews.SetNumZeroed(Views.Num());
+		for (int32 Index = 0; Index < Views.Num(); Index++)
+		{
+			const int32 X = Index % NumHorizontalFrames;
+			const int32 Y = Index / NumHorizontalFrames;
+			const bool bEmpty = EmptyFrames.IsValidIndex(Index) && EmptyFrames[Index];
+
+			FilledViews[Index] = !bEmpty;
+			SourceViews[Index] =
+				!bEmpty &&
+				(X % Stride == 0 || X == NumHorizontalFrames - 1) &&
+				(Y % Stride == 0 || Y == NumVerticalFrames - 1);
+		}
+
+		CoarseFrames = FImpostorViewSymmetry::CreateNearest(Views, SourceViews, FilledViews);
+	}
+}
+
+bool UImpostorRenderTargetsManager::CanSkipSymmetricCaptures(const EImpostorBakeMapType TargetMap, const bool bFinalColorPass) const
+{
+	if (!ViewSymmetry.HasCopies())
+	{
+		return false;
+	}
+
+	// Lights aren't symmetric, so lit captures are done for every view. Only alpha of final color pass is used.
+	switch (TargetMap)
+	{
+	case EImpostorBakeMapType::CustomLighting:
+		return false;
+
+	case EImpostorBakeMapType::BaseColor:
+		return bFinalColorPass || (!ImpostorData->bUseFinalColorInsteadBaseColor && ImpostorData->ProjectionType != ECameraProjectionMode::Orthographic);
+
+	default:
+		return true;
 	}
 }
 
-void UImpostorRenderTargetsManager::DrawSingleFrame(const int32 VectorIndex)
+void UImpostorRenderTargetsManager::PrepareMap(const EImpostorBakeMapType TargetMap)
 {
-	const FVector2D NumFrames(GetManager<UImpostorComponentsManager>()->NumHorizontalFrames, GetManager<UImpostorComponentsManager>()->NumVerticalFrames);
-	UTextureRenderTarget2D* RenderTarget = TargetMaps[CurrentMap];
+	// Base Color is baked twice (second time for final color), both passes have to be done by the same backend
+	CurrentBackend = MapBackends.FindRef(TargetMap);
+	if (!CurrentBackend)
+	{
+		CurrentBackend = GetBackendForMap(TargetMap);
+		MapBackends.Add(TargetMap, CurrentBackend);
+	}
 
-	UCanvas* Canvas;
-	FVector2D Size;
-	FDrawToRenderTargetContext Context;
+	const double StartTime = FPlatformTime::Seconds();
+	CurrentBackend->PrepareMap(TargetMap);
+	CurrentMapPrepareTime = FPlatformTime::Seconds() - StartTime;
 
-	UKismetRenderingLibrary::BeginDrawCanvasToRenderTarget(SceneWorld, RenderTarget, Canvas, Size, Context);
+	CurrentMap = TargetMap;
+	FramesBeforeCapture = CurrentBackend->GetWarmupFrames();
+	CurrentViewIndex = 0;
+	CurrentMapCaptureTime = 0.0;
+}
 
-	UMaterialInstanceDynamic* TargetMaterial = GetManager<UImpostorMaterialsManager>()->GetSampleMaterial(CurrentMap);
-	Canvas->K2_DrawMaterial(
-		TargetMaterial,
-		Size / NumFrames * FVector2D(VectorIndex % FMath::FloorToInt(NumFrames.X), FMath::Floor(VectorIndex / NumFrames.X)),
-		Size / NumFrames,
-		FVector2D::Zero(),
-		FVector2D::One(),
-		0.f,
-		FVector2D(0.5f, 0.5f));
+bool UImpostorRenderTargetsManager::CaptureImposterGrid(const int32 MaxViews)
+{
+	const double StartTime = FPlatformTime::Seconds();
 
-	UKismetRenderingLibrary::EndDrawCanvasToRenderTarget(SceneWorld, Context);
+	const bool bFinalColorPass =
+		CurrentMap == EImpostorBakeMapType::BaseColor &&
+		CaptureTimings.ContainsByPredicate([](const FCaptureTiming& Timing) { return Timing.Map == EImpostorBakeMapType::BaseColor; });
 
-	if (CurrentMap == EImpostorBakeMapType::BaseColor)
+	FString MapTypeString = GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames[CurrentMap].ToString();
+	if (bFinalColorPass)
 	{
-		// Accumulate Alphas for Mesh Cutout
-		UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, CombinedAlphas[ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards ? VectorIndex : 0], GetManager<UImpostorMaterialsManager>()->AddAlphasMaterial);
+		MapTypeString = "Final Color (Opacity)";
 	}
+
+	// Coarse pass copies every frame, which isn't captured, from the nearest captured one
+	const bool bCoarse = CaptureStage == ECaptureStage::Coarse;
+	const FImpostorViewSymmetry& FrameSources = bCoarse ? CoarseFrames : ViewSymmetry;
+	const bool bSkipCopies = bCoarse || CanSkipSymmetricCaptures(CurrentMap, bFinalColorPass);
+
+	const FString Message = "Baking impostor " + MapTypeString + " map... [" + LexToString(NumMapsToBake - MapsToBake.Num()) + " / " + LexToString(NumMapsToBake) + "]";
+
+	const UImpostorComponentsManager* ComponentsManager = GetManager<UImpostorComponentsManager>();
+	const int32 NumViews = ComponentsManager->ViewCaptureVectors.Num();
+
+	const int32 ForceEvery = FMath::RoundFromZero(NumMapsToBake * NumViews / 100.f);
+
+	int32 NumCaptured = 0;
+	for (; CurrentViewIndex < NumViews && NumCaptured < MaxViews; CurrentViewIndex++)
+	{
+		const int32 Index = CurrentViewIndex;
+
+		if (CaptureStage == ECaptureStage::Full)
+		{
+			ProgressSlowTask(Message, Index % ForceEvery == 0);
+		}
+
+		// Nothing would be drawn, frame stays cleared
+		if (EmptyFrames.IsValidIndex(Index) && EmptyFrames[Index])
+		{
+			if (!bCoarse)
+			{
+				NumSkippedEmptyCaptures++;
+			}
+			continue;
+		}
+
+		if (bSkipCopies && FrameSources.IsCopy(Index))
+		{
+			if (!bCoarse)
+			{
+				NumSkippedCaptures++;
+			}
+			continue;
+		}
+
+		CurrentBackend->CaptureView(Index);
+		CurrentBackend->PlaceFrame(Index);
+		NumCaptured++;
+	}
+
+	CurrentMapCaptureTime += FPlatformTime::Seconds() - StartTime;
+
+	if (CaptureStage == ECaptureStage::Refine)
+	{
+		const int32 NumMapsDone = NumMapsToBake - MapsToBake.Num() - 1;
+		const float Progress = (NumMapsDone + float(CurrentViewIndex) / NumViews) / NumMapsToBake;
+		SetOverlayText("Refining", "Refining", FString::Printf(TEXT("%s (%d%%)"), *MapTypeString, FMath::FloorToInt(Progress * 100.f)));
+	}
+
+	if (CurrentViewIndex < NumViews)
+	{
+		return false;
+	}
+
+	const double FillStartTime = FPlatformTime::Seconds();
+	if (bSkipCopies)
+	{
+		CurrentBackend->FillSymmetricFrames(FrameSources);
+	}
+	CurrentMapCaptureTime += FPlatformTime::Seconds() - FillStartTime;
+
+	FCaptureTiming& Timing = CaptureTimings.AddDefaulted_GetRef();
+	Timing.Map = CurrentMap;
+	Timing.BackendName = CurrentBackend->GetBackendName();
+	Timing.Time = CurrentMapPrepareTime + CurrentMapCaptureTime;
+
+	return true;
 }
 
 void UImpostorRenderTargetsManager::FinalizeBaking()
 {
-	CustomCompositing();
+	TArray<IImpostorCaptureBackend*> UsedBackends;
+	for (const auto& It : MapBackends)
+	{
+		UsedBackends.AddUnique(It.Value);
+	}
 
-	SceneCaptureComponent2D->TextureTarget = nullptr;
+	// GPU compositing works on render targets, so it goes after other backends uploaded their maps
+	UsedBackends.Remove(GPUCaptureBackend.Get());
+	UsedBackends.Add(GPUCaptureBackend.Get());
 
-	EndSlowTask();
+	for (IImpostorCaptureBackend* Backend : UsedBackends)
+	{
+		Backend->Composite();
+	}
+
+	// Coarse preview isn't worth replaying
+	if (ImpostorData->bRecordCapturesForReplay && CaptureStage != ECaptureStage::Coarse)
+	{
+		RecordCapturesForReplay();
+	}
+
+	for (IImpostorCaptureBackend* Backend : UsedBackends)
+	{
+		Backend->EndBake();
+	}
+	CurrentBackend = nullptr;
+
+	if (CaptureStage == ECaptureStage::Full)
+	{
+		EndSlowTask();
+	}
 
 	ForceTick(false);
 
 	CurrentMap = EImpostorBakeMapType::None;
 
+	if (CaptureStage == ECaptureStage::Coarse)
+	{
+		UE_LOG(LogImpostorBaker, Log, TEXT("Coarse preview captured, %d of %d views are copies"), CoarseFrames.GetNumCopies(), GetManager<UImpostorComponentsManager>()->ViewCaptureVectors.Num());
+
+		// Preview stays in target maps, refinement overwrites frames one by one
+		CreateRenderTargetMips(ImpostorData->SceneCaptureResolution);
+		for (UTextureRenderTarget2D* RenderTarget : CombinedAlphas)
+		{
+			ClearRenderTarget(RenderTarget);
+		}
+
+		StartBake(ECaptureStage::Refine);
+		return;
+	}
+
+	SetOverlayText("Refining", "");
+
+	ReportCaptureTimings();
+
 	if (ImpostorData->bUseMeshCutout)
 	{
 		GetManager<UImpostorProceduralMeshManager>()->Update();
 	}
 }
 
-void UImpostorRenderTargetsManager::CustomCompositing() const
+void UImpostorRenderTargetsManager::RecordCapturesForReplay() const
 {
-	// Enable disabled Lights when baking some maps
-	UImpostorLightingManager* LightingManager = GetManager<UImpostorLightingManager>();
-	if (IsValid(LightingManager))
+	for (const auto& It : MapBackends)
 	{
-		LightingManager->SetLightsVisibility(true);
-	}
+		FImpostorImage Image;
+		if (!It.Value->Readback(It.Key, Image))
+		{
+			continue;
+		}
 
-	if (ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::BaseColor))
-	{
-		UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, ScratchRenderTarget, FLinearColor::Black);
-		if (UTextureRenderTarget2D* RenderTarget = TargetMaps.FindRef(EImpostorBakeMapType::BaseColor))
+		const FString Filename = UImpostorReplayCaptureBackend::GetRecordingFilename(ImpostorData, It.Key);
+		if (!Image.SaveToFile(Filename))
 		{
-			ResampleRenderTarget(RenderTarget, ScratchRenderTarget);
-			UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
-			UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, RenderTarget, GetManager<UImpostorMaterialsManager>()->AddAlphaFromFinalColorMaterial);
+			UE_LOG(LogImpostorBaker, Warning, TEXT("Failed to record capture %s"), *Filename);
 		}
 	}
+}
 
-	if (ImpostorData->bCombineNormalAndDepth &&
-		ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::Normal) &&
-		ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::Depth))
+void UImpostorRenderTargetsManager::ReportCaptureTimings()
+{
+	FString Text;
+	double TotalTime = 0.0;
+	for (const FCaptureTiming& Timing : CaptureTimings)
 	{
-		UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, ScratchRenderTarget, FLinearColor::Black);
-		if (UTextureRenderTarget2D* RenderTarget = TargetMaps.FindRef(EImpostorBakeMapType::Normal))
+		const FString MapName = GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames[Timing.Map].ToString();
+		const FString Line = FString::Printf(TEXT("%s (%s): %.1f ms"), *MapName, *Timing.BackendName, Timing.Time * 1000.0);
+		UE_LOG(LogImpostorBaker, Log, TEXT("Captured %s"), *Line);
+
+		if (!Text.IsEmpty())
 		{
-			ResampleRenderTarget(RenderTarget, ScratchRenderTarget);
-			UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
-			UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, RenderTarget, GetManager<UImpostorMaterialsManager>()->CombinedNormalsDepthMaterial);
+			Text += "\n";
 		}
+		Text += Line;
+		TotalTime += Timing.Time;
 	}
 
-	if (ImpostorData->bCombineLightingAndColor &&
-		ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::BaseColor) &&
-		ImpostorData->MapsToRender.Contains(EImpostorBakeMapType::CustomLighting))
+	UE_LOG(LogImpostorBaker, Log, TEXT("Captured %d maps in %.1f ms"), CaptureTimings.Num(), TotalTime * 1000.0);
+	SetOverlayText("CaptureTiming", "Capture Timing", Text);
+
+	if (NumSkippedCaptures > 0)
 	{
-		UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, BaseColorScratchRenderTarget, FLinearColor::Black);
-		if (UTextureRenderTarget2D* RenderTarget = TargetMaps.FindRef(EImpostorBakeMapType::BaseColor))
-		{
-			ResampleRenderTarget(RenderTarget, BaseColorScratchRenderTarget);
-			UKismetRenderingLibrary::ClearRenderTarget2D(SceneWorld, RenderTarget, FLinearColor::Black);
-			UKismetRenderingLibrary::DrawMaterialToRenderTarget(SceneWorld, RenderTarget, GetManager<UImpostorMaterialsManager>()->BaseColorCustomLightingMaterial);
-		}
+		const FString SkippedText = FString::Printf(TEXT("%d (%d of %d views are symmetric copies)"), NumSkippedCaptures, ViewSymmetry.GetNumCopies(), GetManager<UImpostorComponentsManager>()->ViewCaptureVectors.Num());
+		UE_LOG(LogImpostorBaker, Log, TEXT("Skipped symmetric captures: %s"), *SkippedText);
+		SetOverlayText("SkippedCaptures", "Skipped Captures", SkippedText);
+	}
+	else
+	{
+		SetOverlayText("SkippedCaptures", "");
+	}
+
+	if (NumSkippedEmptyCaptures > 0)
+	{
+		const int32 NumEmptyFrames = Algo::Count(EmptyFrames, true);
+		const FString SkippedText = FString::Printf(TEXT("%d (%d of %d frames are empty)"), NumSkippedEmptyCaptures, NumEmptyFrames, EmptyFrames.Num());
+		UE_LOG(LogImpostorBaker, Log, TEXT("Skipped empty captures: %s"), *SkippedText);
+		SetOverlayText("SkippedEmptyCaptures", "Skipped Empty Captures", SkippedText);
+	}
+	else
+	{
+		SetOverlayText("SkippedEmptyCaptures", "");
 	}
 }
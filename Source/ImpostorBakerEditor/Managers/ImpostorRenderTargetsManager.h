@@ -1,44 +1,18 @@
 ﻿#pragma once
 
 #include <CoreMinimal.h>
-#include <SceneView.h>
-#include <SceneViewExtension.h>
 #include "ImpostorData/ImpostorData.h"
+#include "Utilities/ImpostorSymmetry.h"
 #include "ImpostorBaseManager.h"
 #include "ImpostorRenderTargetsManager.generated.h"
 
+class IImpostorCaptureBackend;
+class UImpostorCPUCaptureBackend;
+class UImpostorGPUCaptureBackend;
+class UImpostorReplayCaptureBackend;
+class UTexture2DArray;
 class UTextureRenderTarget2D;
 
-struct FLightingViewExtension final : FSceneViewExtensionBase
-{
-	FSceneInterface* Scene;
-	FLightingViewExtension(const FAutoRegister& AutoRegister, FSceneInterface* Scene)
-		: FSceneViewExtensionBase(AutoRegister)
-		, Scene(Scene)
-	{
-	}
-
-	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override
-	{
-	}
-
-	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override
-	{
-		InView.DiffuseOverrideParameter = FVector4f(GEngine->LightingOnlyBrightness.R, GEngine->LightingOnlyBrightness.G, GEngine->LightingOnlyBrightness.B, 0.0f);
-		InView.SpecularOverrideParameter = FVector4f(0.f, 0.f, 0.f, 0.f);
-	}
-
-	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override
-	{
-	}
-
-protected:
-	virtual bool IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const override
-	{
-		return Context.Scene == Scene;
-	}
-};
-
 UCLASS()
 class IMPOSTORBAKEREDITOR_API UImpostorRenderTargetsManager : public UImpostorBaseManager
 {
@@ -53,7 +27,7 @@ public:
 
 private:
 	void AllocateRenderTargets();
-	void CreateRenderTargetMips();
+	void CreateRenderTargetMips(int32 Resolution);
 	void CreateAlphasScratchRenderTargets();
 	void FillMapsToSave();
 
@@ -62,18 +36,53 @@ private:
 public:
 	void ClearRenderTargets();
 	void ClearRenderTarget(UTextureRenderTarget2D* RenderTarget) const;
-	void ResampleRenderTarget(UTextureRenderTarget2D* Source, UTextureRenderTarget2D* Dest) const;
+	void ResampleRenderTarget(UTexture* Source, UTextureRenderTarget2D* Dest) const;
 
 	void BakeRenderTargets();
-	TMap<EImpostorBakeMapType, UTexture2D*> SaveTextures();
+	// Stops bake in progress (e.g. progressive refinement), render targets are left as they are
+	void CancelBake();
+	// LODScreenSize caps textures size to what impostor LOD needs at that screen size, 0 keeps full size
+	TMap<EImpostorBakeMapType, UTexture2D*> SaveTextures(float LODScreenSize = 0.f);
+	// Frames of saved textures split into Texture2DArray slices, if Save Frame Arrays is enabled
+	TMap<EImpostorBakeMapType, UTexture2DArray*> SaveTextureArrays(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures) const;
+	// Saved textures scaled to atlas of Resolution width, every frame is resampled from its own area only.
+	// New textures are saved under current texture name, with settings of source textures.
+	TMap<EImpostorBakeMapType, UTexture2D*> SaveDownsampledTextures(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures, int32 Resolution) const;
+	// Coverage (R) and encoded depth (G) of frames in row major grid of Shadow Proxy Resolution, if shadow proxy is used
+	UTexture2D* SaveShadowProxyTexture(const TMap<EImpostorBakeMapType, UTexture2D*>& Textures) const;
+
+	bool IsBaking() const
+	{
+		return CurrentMap != EImpostorBakeMapType::None;
+	}
 
 private:
-	void PreparePostProcess(const EImpostorBakeMapType TargetMap);
-	void CaptureImposterGrid();
-	void DrawSingleFrame(int32 VectorIndex);
-	void FinalizeBaking();
+	IImpostorCaptureBackend* GetSelectedBackend() const;
+	// Selected backend, or GPU backend if selected one can't produce the map
+	IImpostorCaptureBackend* GetBackendForMap(EImpostorBakeMapType TargetMap) const;
 
-	void CustomCompositing() const;
+	enum class ECaptureStage : uint8
+	{
+		// Every view at once, with modal progress
+		Full,
+		// Sparse views at reduced resolution, others are copied from the nearest captured views
+		Coarse,
+		// Every view, few views per tick, on top of coarse pass
+		Refine
+	};
+
+	void StartBake(ECaptureStage Stage);
+
+	// Finds views, which don't have to be captured
+	void AnalyzeCaptureViews();
+	bool CanSkipSymmetricCaptures(EImpostorBakeMapType TargetMap, bool bFinalColorPass) const;
+
+	void PrepareMap(EImpostorBakeMapType TargetMap);
+	// Captures up to MaxViews views of current map, returns true once every view is done
+	bool CaptureImposterGrid(int32 MaxViews);
+	void FinalizeBaking();
+	void RecordCapturesForReplay() const;
+	void ReportCaptureTimings();
 
 public:
 	UPROPERTY(Transient)
@@ -106,8 +115,45 @@ private:
 
 	int32 NumMapsToBake = 0;
 	EImpostorBakeMapType CurrentMap = EImpostorBakeMapType::None;
-	TSharedPtr<FLightingViewExtension> Extension;
 	int32 FramesBeforeCapture = 0;
+	int32 CurrentViewIndex = 0;
+	ECaptureStage CaptureStage = ECaptureStage::Full;
 
-	bool bCapturingFinalColor = false;
+	UPROPERTY(Transient)
+	TObjectPtr<UImpostorGPUCaptureBackend> GPUCaptureBackend;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UImpostorCPUCaptureBackend> CPUCaptureBackend;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UImpostorReplayCaptureBackend> ReplayCaptureBackend;
+
+	IImpostorCaptureBackend* CurrentBackend = nullptr;
+	// Backend which produced each map during last bake
+	TMap<EImpostorBakeMapType, IImpostorCaptureBackend*> MapBackends;
+
+	struct FCaptureTiming
+	{
+		EImpostorBakeMapType Map = EImpostorBakeMapType::None;
+		FString BackendName;
+		double Time = 0.0;
+	};
+	// Time spent preparing and capturing every map (without warmup frames) during last bake
+	TArray<FCaptureTiming> CaptureTimings;
+	double CurrentMapPrepareTime = 0.0;
+	double CurrentMapCaptureTime = 0.0;
+
+	FImpostorViewSymmetry ViewSymmetry;
+	int32 NumSkippedCaptures = 0;
+
+	// Frames of coarse progressive pass, which aren't captured
+	FImpostorViewSymmetry CoarseFrames;
+
+	// Views, which projected mesh doesn't cover
+	TArray<bool> EmptyFrames;
+	int32 NumSkippedEmptyCaptures = 0;
+
+	friend class UImpostorGPUCaptureBackend;
+	friend class UImpostorCPUCaptureBackend;
+	friend class UImpostorReplayCaptureBackend;
 };
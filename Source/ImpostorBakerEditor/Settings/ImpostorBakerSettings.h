@@ -2,6 +2,7 @@
 
 #include <CoreMinimal.h>
 #include <Engine/DeveloperSettings.h>
+#include <Engine/TextureDefines.h>
 #include <Materials/MaterialInterface.h>
 #include "ImpostorData/ImpostorData.h"
 #include "ImpostorBakerSettings.generated.h"
@@ -51,6 +52,34 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Materials")
 	TSoftObjectPtr<UMaterialInterface> AddAlphaFromFinalColor;
 
+	// Viewport height in pixels, which impostor LOD screen size is computed for
+	UPROPERTY(Config, EditAnywhere, Category = "Export", Meta = (ClampMin = 1))
+	int32 ReferenceScreenHeight = 1080;
+
+	// Texture group of saved impostor textures. Separate (not combined with depth) normal maps use World Normal Map group.
+	UPROPERTY(Config, EditAnywhere, Category = "Export")
+	TEnumAsByte<TextureGroup> ImpostorTextureGroup = TEXTUREGROUP_World;
+
+	// Textures up to this size are never streamed, their whole mip chain stays resident
+	UPROPERTY(Config, EditAnywhere, Category = "Export")
+	int32 NeverStreamMaxSize = 1024;
+
+	// Warning is shown, if aligned frames leave larger fraction of the atlas unused (as gutter at right and bottom edges)
+	UPROPERTY(Config, EditAnywhere, Category = "Export", Meta = (ClampMin = 0, ClampMax = 1))
+	float FrameAlignmentMaxUnusedArea = 0.25f;
+
+	// First custom primitive data index, which shared atlas material function reads impostor parameters from (8 floats are used)
+	UPROPERTY(Config, EditAnywhere, Category = "Shared Atlas", Meta = (ClampMin = 0, ClampMax = 28))
+	int32 SharedAtlasPrimitiveDataIndex = 0;
+
+	// Impostors are near identical, if this fraction of perceptual hash bits differs at most in every saved map. Identical content is always detected.
+	UPROPERTY(Config, EditAnywhere, Category = "Deduplication", Meta = (ClampMin = 0, ClampMax = 0.5))
+	float DuplicateMaxHashDistance = 0.02f;
+
+	// Near identical impostors are consolidated too, otherwise they are only reported. Consolidation deletes their textures.
+	UPROPERTY(Config, EditAnywhere, Category = "Deduplication")
+	bool bConsolidateNearDuplicates = false;
+
 	// Default parameter name used to disable WPO usage for mesh.
 	// To have constant results, it is recommended to add lerp(0, {WPO}, Impostor_WPO) into mesh materials.
 	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters")
@@ -92,6 +121,57 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Impostor Preview")
 	FName ImpostorPreviewPivotOffset = "PivotOffset";
 
+	// Part of the atlas covered by frames (atlas UVs are multiplied by it), below 1 when frames are aligned
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Impostor Preview")
+	FName ImpostorPreviewFrameUVScale = "FrameUVScale";
+
+	// Frame Order of impostor (0 row major, 1 Morton, 2 Hilbert), input of MF_ImpostorFrameOrder
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Impostor Preview")
+	FName ImpostorPreviewFrameOrder = "FrameOrder";
+
 	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Impostor Preview")
 	TMap<EImpostorBakeMapType, FName> ImpostorPreviewMapNames;
+
+	// Static switch, which makes material blend frames from view lookup textures instead of octahedral grid
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|View Lookup")
+	FName ImpostorViewLookupSwitch = "UseViewLookup";
+
+	// Frame indices (RGB, alpha is unused), RGBA 32 bit float texture sampled with nearest filter, so any index is exact
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|View Lookup")
+	FName ImpostorViewLookupIndices = "ViewLookupIndices";
+
+	// Frame blend weights (RGB), 8 bit texture sampled with nearest filter
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|View Lookup")
+	FName ImpostorViewLookupWeights = "ViewLookupWeights";
+
+	// Static switch, which makes material sample frames from Texture2DArray slices instead of atlas areas
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Frame Arrays")
+	FName ImpostorFrameArraySwitch = "UseFrameArrays";
+
+	// Frame array parameters are named after map texture parameters with this suffix (e.g. BaseColorArray)
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Frame Arrays")
+	FString ImpostorFrameArraySuffix = "Array";
+
+	// Static switch, which makes parallax clamp and skip its steps by depth range texture
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Depth Range")
+	FName ImpostorDepthRangeSwitch = "UseDepthRange";
+
+	// Min (R) and max (G) encoded depth per frame tile, 8 bit texture with mips, loaded without filtering
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Depth Range")
+	FName ImpostorDepthRange = "DepthRange";
+
+	// Tiles on frame axis in the first mip of depth range texture
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Depth Range")
+	FName ImpostorDepthRangeTiles = "DepthRangeTiles";
+
+	// Encoded depth range of all frames
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Depth Range")
+	FName ImpostorDepthRangeMin = "DepthRangeMin";
+
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Depth Range")
+	FName ImpostorDepthRangeMax = "DepthRangeMax";
+
+	// Static switch, which makes material decode Normal from octahedral RG with MF_ImpostorOctahedralNormal and read depth from Depth texture
+	UPROPERTY(Config, EditAnywhere, Category = "Material Parameters|Normal Encoding")
+	FName ImpostorOctahedralNormalSwitch = "UseOctahedralNormals";
 };
@@ -0,0 +1,272 @@
+﻿#include "ImpostorAutoTuner.h"
+#include <Async/ParallelFor.h>
+#include <Engine/StaticMesh.h>
+#include <Misc/FileHelper.h>
+#include <UObject/Package.h>
+#include "ImpostorImageMetrics.h"
+#include "ImpostorMeshGeometry.h"
+#include "ImpostorRasterizer.h"
+#include "ImpostorRenderer.h"
+#include "ImpostorData/ImpostorData.h"
+
+namespace ImpostorAutoTuner
+{
+	// Box filtered frame, normals and depth are averaged over covered texels only and alpha is coverage
+	void WriteFrame(const FImpostorRasterizedFrame& Frame, const float DepthScale, const FIntRect& Rect, FImpostorImage& OutBaseColor, FImpostorImage& OutNormal)
+	{
+		const float Scale = float(Frame.Size) / Rect.Width();
+
+		for (int32 Y = 0; Y < Rect.Height(); Y++)
+		{
+			const int32 MinY = FMath::Min(FMath::FloorToInt32(Y * Scale), Frame.Size - 1);
+			const int32 MaxY = FMath::Clamp(FMath::FloorToInt32((Y + 1) * Scale), MinY + 1, Frame.Size);
+
+			for (int32 X = 0; X < Rect.Width(); X++)
+			{
+				const int32 MinX = FMath::Min(FMath::FloorToInt32(X * Scale), Frame.Size - 1);
+				const int32 MaxX = FMath::Clamp(FMath::FloorToInt32((X + 1) * Scale), MinX + 1, Frame.Size);
+
+				FVector3f Normal = FVector3f::ZeroVector;
+				float Depth = 0.f;
+				int32 NumCovered = 0;
+
+				for (int32 SourceY = MinY; SourceY < MaxY; SourceY++)
+				{
+					for (int32 SourceX = MinX; SourceX < MaxX; SourceX++)
+					{
+						if (Frame.IsCovered(SourceX, SourceY))
+						{
+							Normal += Frame.Normals[SourceY * Frame.Size + SourceX];
+							Depth += Frame.Depths[SourceY * Frame.Size + SourceX];
+							NumCovered++;
+						}
+					}
+				}
+
+				if (NumCovered == 0)
+				{
+					continue;
+				}
+
+				const uint8 Coverage = uint8(FMath::RoundToInt32(255.f * NumCovered / ((MaxX - MinX) * (MaxY - MinY))));
+				OutBaseColor.GetPixel(Rect.Min.X + X, Rect.Min.Y + Y) = FColor(255, 255, 255, Coverage);
+
+				// Same encoding as CPU capture backend with depth combined into normal alpha
+				FColor& NormalPixel = OutNormal.GetPixel(Rect.Min.X + X, Rect.Min.Y + Y);
+				NormalPixel = FLinearColor(Normal.GetSafeNormal() * 0.5f + 0.5f).QuantizeRound();
+				NormalPixel.A = uint8(FMath::Clamp(FMath::RoundToInt32((0.5f - Depth / NumCovered * DepthScale) * 255.f), 0, 255));
+			}
+		}
+	}
+
+	// Same rules as power of two Resolution property
+	TArray<int32> GetResolutions(const UImpostorData& ImpostorData)
+	{
+		TArray<int32> Resolutions;
+		for (const int32 Resolution : ImpostorData.AutoTuneResolutions)
+		{
+			Resolutions.AddUnique(1 << FMath::Clamp(FMath::FloorLog2(FMath::Max(Resolution, 1)), 9, 14));
+		}
+
+		Resolutions.Sort(TGreater<int32>());
+		return Resolutions;
+	}
+}
+
+TArray<FImpostorAutoTuneResult> FImpostorAutoTuner::Run(const UImpostorData& ImpostorData, const TFunction<void(const FString&)>& OnProgress)
+{
+	TArray<FImpostorAutoTuneResult> Results;
+	if (ImpostorData.ImpostorType == EImpostorLayoutType::TraditionalBillboards ||
+		!ImpostorData.ReferencedMesh)
+	{
+		return Results;
+	}
+
+	const FImpostorMeshGeometry Geometry = FImpostorMeshGeometry::Gather(ImpostorData.ReferencedMesh);
+	const TArray<int32> Resolutions = ImpostorAutoTuner::GetResolutions(ImpostorData);
+	if (Geometry.IsEmpty() ||
+		Resolutions.Num() == 0)
+	{
+		return Results;
+	}
+
+	TArray<int32> FramesCounts;
+	for (const int32 FramesCount : ImpostorData.AutoTuneFramesCounts)
+	{
+		if (FramesCount > 0)
+		{
+			FramesCounts.AddUnique(FramesCount);
+		}
+	}
+	FramesCounts.Sort();
+
+	const int32 Size = ImpostorData.QualityEvaluationSize;
+	const TArray<FVector> Directions = FImpostorRenderer::MakeTestDirections(ImpostorData.QualityEvaluationViews, ImpostorData.ImpostorType == EImpostorLayoutType::UpperHemisphereOnly);
+
+	// Layout of every candidate is created from a copy, so edited asset isn't touched
+	UImpostorData* Candidate = DuplicateObject(&ImpostorData, GetTransientPackage());
+
+	for (const int32 FramesCount : FramesCounts)
+	{
+		OnProgress(FString::Printf(TEXT("Measuring %d x %d frames..."), FramesCount, FramesCount));
+
+		Candidate->FramesCount = FramesCount;
+
+		FImpostorRenderSource Source;
+		if (!Source.InitLayout(*Candidate))
+		{
+			continue;
+		}
+
+		// Same radius, as components manager would use for these views
+		Source.Radius = ImpostorData.ReferencedMesh->GetBounds().SphereRadius + ImpostorData.GetMeshOffset().GetAbsMax();
+		if (ImpostorData.bUseTightProjectionBounds)
+		{
+			const float ProjectedRadius = Geometry.GetProjectedRadius(Source.Origin, Source.ViewVectors);
+			if (ProjectedRadius > 0.f)
+			{
+				Source.Radius = ProjectedRadius;
+			}
+		}
+
+		TArray<FImpostorViewProjection> Views;
+		for (int32 Index = 0; Index < Source.ViewVectors.Num(); Index++)
+		{
+			Views.Add(Source.GetViewProjection(Index));
+		}
+
+		// Frames are rasterized once at the largest resolution, smaller ones reuse them
+		const double RasterizeStartTime = FPlatformTime::Seconds();
+		const TArray<FImpostorRasterizedFrame> Frames = FImpostorRasterizer::RasterizeFrames(Geometry, Views, FMath::Max(Resolutions[0] / FramesCount, 1));
+		const double RasterizeTime = FPlatformTime::Seconds() - RasterizeStartTime;
+
+		const TArray<FImpostorRenderedView> MeshViews = FImpostorRenderer::RenderMesh(Geometry, Source.Origin, Source.Radius, Directions, Size);
+		const float DepthScale = 0.5f / FMath::Max(Source.Radius, UE_KINDA_SMALL_NUMBER);
+
+		for (const int32 Resolution : Resolutions)
+		{
+			if (Resolution / FramesCount < 1)
+			{
+				continue;
+			}
+
+			const double ResampleStartTime = FPlatformTime::Seconds();
+
+			Source.BaseColor.Init(Resolution, Resolution);
+			Source.Normal.Init(Resolution, Resolution);
+			Source.Depth = {};
+			Source.bDepthInNormalAlpha = true;
+
+			ParallelFor(Frames.Num(), [&](const int32 Index)
+			{
+				ImpostorAutoTuner::WriteFrame(Frames[Index], DepthScale, Source.GetFrameRect(Index, FIntPoint(Resolution)), Source.BaseColor, Source.Normal);
+			});
+
+			const double RasterizeAndResampleTime = RasterizeTime + FPlatformTime::Seconds() - ResampleStartTime;
+			const FImpostorImageMetrics Metrics = FImpostorImageMetrics::Compare(FImpostorRenderer::RenderImpostor(Source, Directions, Size), MeshViews);
+
+			FImpostorAutoTuneResult& Result = Results.AddDefaulted_GetRef();
+			Result.FramesCount = FramesCount;
+			Result.Resolution = Resolution;
+			Result.RasterizeTimeMs = RasterizeAndResampleTime * 1000.0;
+			Result.TextureBytes = GetTextureBytes(ImpostorData, Resolution);
+			Result.PSNR = Metrics.PSNR;
+			Result.SSIM = Metrics.SSIM;
+			Result.SilhouetteIoU = Metrics.SilhouetteIoU;
+			Result.NormalError = Metrics.NormalAngularError;
+			Result.bPassed =
+				Metrics.NormalAngularError <= ImpostorData.AutoTuneMaxNormalError &&
+				Metrics.SilhouetteIoU >= ImpostorData.AutoTuneMinSilhouetteIoU;
+		}
+	}
+
+	Candidate->MarkAsGarbage();
+
+	return Results;
+}
+
+int32 FImpostorAutoTuner::SelectResult(const TArray<FImpostorAutoTuneResult>& Results)
+{
+	int32 Selected = INDEX_NONE;
+	for (int32 Index = 0; Index < Results.Num(); Index++)
+	{
+		const FImpostorAutoTuneResult& Result = Results[Index];
+		if (!Result.bPassed)
+		{
+			continue;
+		}
+
+		if (Selected == INDEX_NONE ||
+			Result.TextureBytes < Results[Selected].TextureBytes ||
+			(Result.TextureBytes == Results[Selected].TextureBytes && Result.NormalError < Results[Selected].NormalError))
+		{
+			Selected = Index;
+		}
+	}
+
+	if (Selected != INDEX_NONE)
+	{
+		return Selected;
+	}
+
+	for (int32 Index = 0; Index < Results.Num(); Index++)
+	{
+		if (Selected == INDEX_NONE ||
+			Results[Index].NormalError < Results[Selected].NormalError)
+		{
+			Selected = Index;
+		}
+	}
+
+	return Selected;
+}
+
+int64 FImpostorAutoTuner::GetTextureBytes(const UImpostorData& ImpostorData, const int32 Resolution)
+{
+	// Same maps and sizes as render targets manager saves
+	int64 Bytes = 0;
+	for (const EImpostorBakeMapType TargetMap : ImpostorData.MapsToRender)
+	{
+		if ((TargetMap == EImpostorBakeMapType::CustomLighting && ImpostorData.bCombineLightingAndColor) ||
+			(TargetMap == EImpostorBakeMapType::Depth && ImpostorData.CombinesNormalAndDepth()))
+		{
+			continue;
+		}
+
+		// BC7 and BC5 are both 1 byte per texel, full mip chain adds a third
+		const int64 MapResolution = FMath::Max(Resolution / ImpostorData.GetMapResolutionDivisor(TargetMap), 1);
+		int64 MapBytes = MapResolution * MapResolution * 4 / 3;
+
+		// BC4 depth of octahedral normals is half a byte per texel
+		if (TargetMap == EImpostorBakeMapType::Depth &&
+			ImpostorData.NormalEncoding == EImpostorNormalEncoding::Octahedral)
+		{
+			MapBytes /= 2;
+		}
+
+		Bytes += MapBytes;
+	}
+
+	return Bytes;
+}
+
+bool FImpostorAutoTuner::SaveResults(const TArray<FImpostorAutoTuneResult>& Results, const FString& Filename)
+{
+	FString Csv = TEXT("FramesCount,Resolution,RasterizeTimeMs,TextureBytes,PSNR,SSIM,SilhouetteIoU,NormalError,Passed,Selected\n");
+	for (const FImpostorAutoTuneResult& Result : Results)
+	{
+		Csv += FString::Printf(TEXT("%d,%d,%.2f,%" INT64_FMT ",%.3f,%.4f,%.4f,%.3f,%d,%d\n"),
+			Result.FramesCount,
+			Result.Resolution,
+			Result.RasterizeTimeMs,
+			Result.TextureBytes,
+			Result.PSNR,
+			Result.SSIM,
+			Result.SilhouetteIoU,
+			Result.NormalError,
+			Result.bPassed ? 1 : 0,
+			Result.bSelected ? 1 : 0);
+	}
+
+	return FFileHelper::SaveStringToFile(Csv, *Filename);
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UImpostorData;
+struct FImpostorAutoTuneResult;
+
+// Sweeps Frames Count and Resolution candidates of (hemi)octahedral impostor and measures them without capturing the scene.
+// Depth, Normal and coverage are rasterized on CPU, rendered with FImpostorRenderer and compared with referenced mesh.
+// Scores estimate quality of CPU-rasterized frames only, they are not validated against frames captured by GPU bake.
+class FImpostorAutoTuner
+{
+public:
+	// OnProgress is called once per Frames Count candidate
+	static TArray<FImpostorAutoTuneResult> Run(const UImpostorData& ImpostorData, const TFunction<void(const FString&)>& OnProgress);
+
+	// Smallest passing candidate (by texture bytes, then by normal error), or the most accurate one if none passes
+	static int32 SelectResult(const TArray<FImpostorAutoTuneResult>& Results);
+
+	// Compressed size of textures saved for ImpostorData at Resolution, including mips
+	static int64 GetTextureBytes(const UImpostorData& ImpostorData, int32 Resolution);
+
+	static bool SaveResults(const TArray<FImpostorAutoTuneResult>& Results, const FString& Filename);
+};
@@ -25,6 +25,27 @@ FVector FImpostorBakerUtilities::HemiOctahedronToUnitVector(const FVector2D& Hem
 	return FVector(Octahedron.X, Octahedron.Y, 1.f - Octahedron.GetAbs().Dot(FVector2D::One())).GetSafeNormal();
 }
 
+FVector2D FImpostorBakerUtilities::UnitVectorToOctahedron(const FVector& Vector)
+{
+	const FVector Octahedron = Vector / FMath::Max(Vector.GetAbs().Dot(FVector::OneVector), UE_SMALL_NUMBER);
+	if (Octahedron.Z >= 0.f)
+	{
+		return FVector2D(Octahedron.X, Octahedron.Y);
+	}
+
+	return FVector2D(
+		(1.f - FMath::Abs(Octahedron.Y)) * (Octahedron.X >= 0.f ? 1.f : -1.f),
+		(1.f - FMath::Abs(Octahedron.X)) * (Octahedron.Y >= 0.f ? 1.f : -1.f));
+}
+
+FVector2D FImpostorBakerUtilities::UnitVectorToHemiOctahedron(const FVector& Vector)
+{
+	const FVector Clamped(Vector.X, Vector.Y, FMath::Max(Vector.Z, 0.f));
+	const FVector Octahedron = Clamped / FMath::Max(Clamped.GetAbs().Dot(FVector::OneVector), UE_SMALL_NUMBER);
+
+	return FVector2D(Octahedron.X + Octahedron.Y, Octahedron.X - Octahedron.Y);
+}
+
 FVector FImpostorBakerUtilities::GetGridVector(const int32 X, const int32 Y, const int32 Size, const EImpostorLayoutType Type)
 {
 	FVector2D Octahedron(float(X) / FMath::Max(1.f, float(Size - 1)), float(Y) / FMath::Max(1.f, float(Size - 1)));
@@ -51,6 +72,19 @@ int32 FImpostorBakerUtilities::GetImpostorTypeResolution(const EImpostorLayoutTy
 	}
 }
 
+double FImpostorBakerUtilities::GetFramePitch(const int32 AtlasSize, const int32 NumFrames, const int32 Alignment)
+{
+	const double Pitch = double(AtlasSize) / FMath::Max(NumFrames, 1);
+	if (Alignment <= 1 ||
+		Pitch < 1.0)
+	{
+		return Pitch;
+	}
+
+	const int32 FrameAlignment = FMath::Min(Alignment, 1 << FMath::FloorLog2(uint32(Pitch)));
+	return FMath::FloorToDouble(Pitch / FrameAlignment) * FrameAlignment;
+}
+
 bool FImpostorBakerUtilities::FindIntersection(const int32 CornerPass, const FImpostorTextureData& TextureData, const EImpostorLayoutType Type, const int32 StartX, int32& OutX, int32& OutY)
 {
 	OutX = StartX;
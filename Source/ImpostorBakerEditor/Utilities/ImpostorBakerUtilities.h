@@ -11,8 +11,14 @@ public:
 	static FVector OctahedronToUnitVector(const FVector2D& Octahedron);
 	static FVector HemiOctahedronToUnitVector(const FVector2D& HemiOctahedron);
 
+	// Inverse mappings, results are in [-1, 1] range. Directions below horizon are clamped to it for hemi-octahedron.
+	static FVector2D UnitVectorToOctahedron(const FVector& Vector);
+	static FVector2D UnitVectorToHemiOctahedron(const FVector& Vector);
+
 	static FVector GetGridVector(int32 X, int32 Y, int32 Size, EImpostorLayoutType Type);
 	static int32 GetImpostorTypeResolution(EImpostorLayoutType Type);
+	// Distance between frame origins along atlas axis, rounded down to multiple of Alignment (or of frame power of two size, if it's smaller)
+	static double GetFramePitch(int32 AtlasSize, int32 NumFrames, int32 Alignment);
 
 	static bool FindIntersection(int32 CornerPass, const FImpostorTextureData& TextureData, EImpostorLayoutType Type, int32 StartX, int32& OutX, int32& OutY);
 	static FVector2D GetRotatedCoordsByCorner(const FVector2D& XY, int32 Size, bool bVector, int32 Corner);
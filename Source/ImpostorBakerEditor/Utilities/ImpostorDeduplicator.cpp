@@ -0,0 +1,329 @@
+﻿#include "ImpostorDeduplicator.h"
+#include <Engine/Texture2D.h>
+#include <Hash/xxhash.h>
+#include <Materials/MaterialInstanceConstant.h>
+#include <ObjectTools.h>
+#include "ImpostorBakerEditorModule.h"
+#include "ImpostorImage.h"
+#include "ImpostorData/ImpostorData.h"
+#include "Settings/ImpostorBakerSettings.h"
+
+namespace ImpostorDeduplicator
+{
+	constexpr int32 HashSize = 32;
+
+	// Name suffixes of every texture saved for impostor: maps, their frame arrays, view lookup and depth range
+	TArray<FString> GetSavedTextureSuffixes()
+	{
+		TArray<FString> Suffixes;
+		for (const auto& [ImpostorBakeMapType, MapName] : GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames)
+		{
+			Suffixes.Add(MapName.ToString());
+			Suffixes.Add(MapName.ToString() + "_Array");
+		}
+		Suffixes.Append({ "ViewLookupIndices", "ViewLookupWeights", "DepthRange" });
+		return Suffixes;
+	}
+
+	// Saved materials can be shared, if they have the same parent and overridden values
+	bool HasSameParameters(const UMaterialInstanceConstant& A, const UMaterialInstanceConstant& B)
+	{
+		if (A.Parent != B.Parent ||
+			A.ScalarParameterValues.Num() != B.ScalarParameterValues.Num() ||
+			A.VectorParameterValues.Num() != B.VectorParameterValues.Num() ||
+			A.TextureParameterValues.Num() != B.TextureParameterValues.Num())
+		{
+			return false;
+		}
+
+		for (const FTextureParameterValue& Value : A.TextureParameterValues)
+		{
+			UTexture* OtherValue = nullptr;
+			if (!B.GetTextureParameterValue(FHashedMaterialParameterInfo(Value.ParameterInfo), OtherValue, true) ||
+				Value.ParameterValue != OtherValue)
+			{
+				return false;
+			}
+		}
+
+		for (const FScalarParameterValue& Value : A.ScalarParameterValues)
+		{
+			float OtherValue = 0.f;
+			if (!B.GetScalarParameterValue(FHashedMaterialParameterInfo(Value.ParameterInfo), OtherValue, true) ||
+				!FMath::IsNearlyEqual(Value.ParameterValue, OtherValue, UE_KINDA_SMALL_NUMBER))
+			{
+				return false;
+			}
+		}
+
+		for (const FVectorParameterValue& Value : A.VectorParameterValues)
+		{
+			FLinearColor OtherValue;
+			if (!B.GetVectorParameterValue(FHashedMaterialParameterInfo(Value.ParameterInfo), OtherValue, true) ||
+				!Value.ParameterValue.Equals(OtherValue, UE_KINDA_SMALL_NUMBER))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void ConsolidateInto(UObject* Source, UObject* Duplicate)
+	{
+		if (!Source ||
+			!Duplicate ||
+			Source == Duplicate)
+		{
+			return;
+		}
+
+		TArray<UObject*> ObjectsToConsolidate{ Duplicate };
+		ObjectTools::ConsolidateObjects(Source, ObjectsToConsolidate, false);
+	}
+}
+
+bool FImpostorDeduplicator::ComputeHashes(const UImpostorData& ImpostorData, uint64& OutContentHash, TMap<EImpostorBakeMapType, TArray<uint64>>& OutPerceptualHashes)
+{
+	FXxHash64Builder Builder;
+	bool bHasBaseColor = false;
+
+	for (const auto& [ImpostorBakeMapType, MapName] : GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames)
+	{
+		FImpostorImage Image;
+		if (!Image.ReadFromTextureSource(ImpostorData.LoadSavedTexture(ImpostorBakeMapType)))
+		{
+			continue;
+		}
+
+		const FIntPoint Size = Image.GetSize();
+		Builder.Update(&ImpostorBakeMapType, sizeof(ImpostorBakeMapType));
+		Builder.Update(&Size, sizeof(Size));
+		Builder.Update(Image.Pixels.GetData(), Image.Pixels.Num() * sizeof(FColor));
+
+		// Alpha of other maps can hold depth or be unused
+		const bool bBaseColor = ImpostorBakeMapType == EImpostorBakeMapType::BaseColor;
+		OutPerceptualHashes.Add(ImpostorBakeMapType, ComputePerceptualHash(Image, bBaseColor));
+		bHasBaseColor |= bBaseColor;
+	}
+
+	OutContentHash = Builder.Finalize().Hash;
+	return bHasBaseColor;
+}
+
+TArray<uint64> FImpostorDeduplicator::ComputePerceptualHash(const FImpostorImage& Image, const bool bCoverageInAlpha)
+{
+	using namespace ImpostorDeduplicator;
+
+	const FImpostorImage Small = Image.Resample(FIntRect(FIntPoint::ZeroValue, Image.GetSize()), FIntPoint(HashSize + 1, HashSize));
+
+	const auto GetLuma = [&](const int32 X, const int32 Y)
+	{
+		const FColor& Color = Small.GetPixel(X, Y);
+		return (0.299f * Color.R + 0.587f * Color.G + 0.114f * Color.B) * (bCoverageInAlpha ? Color.A : 255);
+	};
+
+	TArray<uint64> Hash;
+	Hash.Init(0, HashSize * HashSize / 64);
+	for (int32 Y = 0; Y < HashSize; Y++)
+	{
+		for (int32 X = 0; X < HashSize; X++)
+		{
+			if (GetLuma(X, Y) < GetLuma(X + 1, Y))
+			{
+				const int32 Bit = Y * HashSize + X;
+				Hash[Bit / 64] |= uint64(1) << (Bit % 64);
+			}
+		}
+	}
+
+	return Hash;
+}
+
+float FImpostorDeduplicator::GetHashDistance(const TArray<uint64>& A, const TArray<uint64>& B)
+{
+	if (A.Num() != B.Num() ||
+		A.Num() == 0)
+	{
+		return 1.f;
+	}
+
+	int32 NumDifferent = 0;
+	for (int32 Index = 0; Index < A.Num(); Index++)
+	{
+		NumDifferent += FMath::CountBits(A[Index] ^ B[Index]);
+	}
+
+	return float(NumDifferent) / (A.Num() * 64);
+}
+
+bool FImpostorDeduplicator::HasSameLayout(const UImpostorData& A, const UImpostorData& B)
+{
+	if (A.ImpostorType != B.ImpostorType ||
+		A.FramesCount != B.FramesCount ||
+		A.ViewDistribution != B.ViewDistribution ||
+		A.FrameAlignment != B.FrameAlignment ||
+		A.GetFrameOrder() != B.GetFrameOrder() ||
+		A.NormalEncoding != B.NormalEncoding ||
+		A.CombinesNormalAndDepth() != B.CombinesNormalAndDepth() ||
+		A.bSaveGridViewLookup != B.bSaveGridViewLookup ||
+		A.ViewLookupResolution != B.ViewLookupResolution ||
+		A.bSaveFrameArrays != B.bSaveFrameArrays ||
+		A.bSaveDepthRange != B.bSaveDepthRange ||
+		(A.bSaveDepthRange && A.DepthRangeTilesCount != B.DepthRangeTilesCount))
+	{
+		return false;
+	}
+
+	// Sizes cover resolution and resolution divisor of every map
+	for (const auto& [ImpostorBakeMapType, MapName] : GetDefault<UImpostorBakerSettings>()->ImpostorPreviewMapNames)
+	{
+		const UTexture2D* TextureA = A.LoadSavedTexture(ImpostorBakeMapType);
+		const UTexture2D* TextureB = B.LoadSavedTexture(ImpostorBakeMapType);
+		if (!TextureA ||
+			!TextureB)
+		{
+			if (TextureA != TextureB)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		if (TextureA->Source.GetSizeX() != TextureB->Source.GetSizeX() ||
+			TextureA->Source.GetSizeY() != TextureB->Source.GetSizeY())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+TArray<FImpostorDuplicateGroup> FImpostorDeduplicator::FindDuplicates(const TArray<UImpostorData*>& ImpostorDatas)
+{
+	struct FHashedImpostor
+	{
+		UImpostorData* ImpostorData = nullptr;
+		uint64 ContentHash = 0;
+		TMap<EImpostorBakeMapType, TArray<uint64>> PerceptualHashes;
+	};
+
+	TArray<FHashedImpostor> Hashed;
+	for (UImpostorData* ImpostorData : ImpostorDatas)
+	{
+		FHashedImpostor Entry;
+		Entry.ImpostorData = ImpostorData;
+		if (!ComputeHashes(*ImpostorData, Entry.ContentHash, Entry.PerceptualHashes))
+		{
+			UE_LOG(LogImpostorBaker, Warning, TEXT("%s wasn't saved, it's skipped by duplicate search"), *ImpostorData->GetName());
+			continue;
+		}
+
+		Hashed.Add(MoveTemp(Entry));
+	}
+
+	const float MaxDistance = GetDefault<UImpostorBakerSettings>()->DuplicateMaxHashDistance;
+
+	TArray<FImpostorDuplicateGroup> Groups;
+	TBitArray<> Grouped(false, Hashed.Num());
+	for (int32 SourceIndex = 0; SourceIndex < Hashed.Num(); SourceIndex++)
+	{
+		if (Grouped[SourceIndex])
+		{
+			continue;
+		}
+
+		const FHashedImpostor& Source = Hashed[SourceIndex];
+
+		// Identical and near identical duplicates of the same source are reported separately
+		FImpostorDuplicateGroup ExactGroup;
+		ExactGroup.Source = Source.ImpostorData;
+		FImpostorDuplicateGroup NearGroup;
+		NearGroup.Source = Source.ImpostorData;
+		NearGroup.bExact = false;
+
+		for (int32 Index = SourceIndex + 1; Index < Hashed.Num(); Index++)
+		{
+			const FHashedImpostor& Other = Hashed[Index];
+			if (Grouped[Index] ||
+				!HasSameLayout(*Source.ImpostorData, *Other.ImpostorData))
+			{
+				continue;
+			}
+
+			// Same layout means the same set of maps, each of them has to be near identical
+			bool bNear = true;
+			for (const auto& [ImpostorBakeMapType, PerceptualHash] : Source.PerceptualHashes)
+			{
+				const TArray<uint64>* OtherHash = Other.PerceptualHashes.Find(ImpostorBakeMapType);
+				bNear &= OtherHash && GetHashDistance(*OtherHash, PerceptualHash) <= MaxDistance;
+			}
+
+			if (Other.ContentHash == Source.ContentHash)
+			{
+				ExactGroup.Duplicates.Add(Other.ImpostorData);
+				Grouped[Index] = true;
+			}
+			else if (bNear)
+			{
+				NearGroup.Duplicates.Add(Other.ImpostorData);
+				Grouped[Index] = true;
+			}
+		}
+
+		for (FImpostorDuplicateGroup* Group : { &ExactGroup, &NearGroup })
+		{
+			if (Group->Duplicates.Num() > 0)
+			{
+				Groups.Add(MoveTemp(*Group));
+			}
+		}
+	}
+
+	return Groups;
+}
+
+int64 FImpostorDeduplicator::GetDuplicateBytes(const FImpostorDuplicateGroup& Group)
+{
+	int64 Bytes = 0;
+	for (const UImpostorData* Duplicate : Group.Duplicates)
+	{
+		for (const FString& Suffix : ImpostorDeduplicator::GetSavedTextureSuffixes())
+		{
+			const UTexture* Texture = Duplicate->LoadSavedTextureBySuffix(Suffix);
+			if (Texture &&
+				Group.Source->LoadSavedTextureBySuffix(Suffix))
+			{
+				Bytes += Texture->CalcTextureMemorySizeEnum(TMC_AllMips);
+			}
+		}
+	}
+
+	return Bytes;
+}
+
+void FImpostorDeduplicator::Consolidate(const FImpostorDuplicateGroup& Group)
+{
+	for (UImpostorData* Duplicate : Group.Duplicates)
+	{
+		// Frame arrays, view lookup and depth range are derived from maps of the same layout, so they are consolidated with them
+		for (const FString& Suffix : ImpostorDeduplicator::GetSavedTextureSuffixes())
+		{
+			ImpostorDeduplicator::ConsolidateInto(Group.Source->LoadSavedTextureBySuffix(Suffix), Duplicate->LoadSavedTextureBySuffix(Suffix));
+		}
+
+		// Meshes with different size or pivot keep their material, only its textures are replaced.
+		// Texture parameters are compared after consolidation, which redirected them to Source textures.
+		UMaterialInstanceConstant* SourceMaterial = Group.Source->LoadSavedMaterial();
+		UMaterialInstanceConstant* DuplicateMaterial = Duplicate->LoadSavedMaterial();
+		const bool bShareMaterial = SourceMaterial && DuplicateMaterial && ImpostorDeduplicator::HasSameParameters(*SourceMaterial, *DuplicateMaterial);
+
+		if (bShareMaterial)
+		{
+			ImpostorDeduplicator::ConsolidateInto(SourceMaterial, DuplicateMaterial);
+		}
+
+		UE_LOG(LogImpostorBaker, Log, TEXT("%s: textures%s are replaced with the ones of %s"), *Duplicate->GetName(), bShareMaterial ? TEXT(" and material") : TEXT(""), *Group.Source->GetName());
+	}
+}
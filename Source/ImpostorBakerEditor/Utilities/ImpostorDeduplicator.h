@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UImpostorData;
+enum class EImpostorBakeMapType;
+struct FImpostorImage;
+
+// Impostors, whose saved textures are identical (or near identical) to textures of Source
+struct FImpostorDuplicateGroup
+{
+public:
+	UImpostorData* Source = nullptr;
+	TArray<UImpostorData*> Duplicates;
+	// All duplicates have the same content hash as Source
+	bool bExact = true;
+};
+
+// Finds impostors with the same baked result (LOD variants, re-imports, kit copies) and makes them share one texture set and material
+class FImpostorDeduplicator
+{
+public:
+	// Content hash of all saved maps and perceptual hash of each of them. Returns false, if impostor wasn't saved.
+	static bool ComputeHashes(const UImpostorData& ImpostorData, uint64& OutContentHash, TMap<EImpostorBakeMapType, TArray<uint64>>& OutPerceptualHashes);
+
+	// Difference hash of luma, sampled on 33 x 32 grid (1024 bits). Luma is weighted by alpha, if it holds coverage.
+	static TArray<uint64> ComputePerceptualHash(const FImpostorImage& Image, bool bCoverageInAlpha);
+
+	// Fraction of differing bits
+	static float GetHashDistance(const TArray<uint64>& A, const TArray<uint64>& B);
+
+	// Frames of both impostors are laid out the same way, the same auxiliary textures are saved and all their saved maps have the same size
+	static bool HasSameLayout(const UImpostorData& A, const UImpostorData& B);
+
+	// Impostors are compared only with the same layout. Near identical have every map within threshold from project settings.
+	static TArray<FImpostorDuplicateGroup> FindDuplicates(const TArray<UImpostorData*>& ImpostorDatas);
+
+	// Memory of textures, which would be freed by consolidation of the group, including mips
+	static int64 GetDuplicateBytes(const FImpostorDuplicateGroup& Group);
+
+	// References to duplicate textures, including frame arrays, view lookup and depth range (and materials, if their parameters match),
+	// are replaced with Source ones, duplicates are deleted
+	static void Consolidate(const FImpostorDuplicateGroup& Group);
+};
@@ -0,0 +1,185 @@
+﻿#include "ImpostorDepthRange.h"
+#include <Async/ParallelFor.h>
+#include <Engine/Texture2D.h>
+
+namespace ImpostorDepthRange
+{
+	const FColor EmptyTile(MAX_uint8, 0, 0, 0);
+
+	bool IsCovered(const FColor& Range)
+	{
+		return Range.R <= Range.G;
+	}
+}
+
+FImpostorDepthRange FImpostorDepthRange::Build(const FImpostorImage& Depth, const int32 DepthChannel, const FImpostorImage& Coverage, const TArray<FIntRect>& CellRects, const int32 NumCellsX, const int32 TilesCount)
+{
+	FImpostorDepthRange Result;
+	if (Depth.IsEmpty() ||
+		CellRects.Num() == 0 ||
+		!ensure(NumCellsX > 0) ||
+		!ensure(FMath::IsPowerOfTwo(TilesCount)))
+	{
+		return Result;
+	}
+
+	Result.TilesCount = TilesCount;
+	Result.NumCellsX = NumCellsX;
+	Result.UsedCells.Init(false, CellRects.Num());
+
+	// Power of two size, so every mip halves tiles until single texel
+	const int32 NumCellsY = FMath::DivideAndRoundUp(CellRects.Num(), NumCellsX);
+	const int32 Size = FMath::RoundUpToPowerOfTwo(FMath::Max(NumCellsX, NumCellsY)) * TilesCount;
+
+	const bool bUseCoverage = Coverage.GetSize() == Depth.GetSize();
+
+	FImpostorImage& Finest = Result.Mips.AddDefaulted_GetRef();
+	Finest.Init(Size, Size, ImpostorDepthRange::EmptyTile);
+
+	ParallelFor(CellRects.Num(), [&](const int32 Slot)
+	{
+		const FIntRect Rect = FIntRect(CellRects[Slot].Min.ComponentMax(FIntPoint::ZeroValue), CellRects[Slot].Max.ComponentMin(Depth.GetSize()));
+		if (Rect.IsEmpty())
+		{
+			return;
+		}
+
+		Result.UsedCells[Slot] = true;
+		const FIntPoint Cell(Slot % NumCellsX, Slot / NumCellsX);
+		const FVector2f TileSize = FVector2f(Rect.Size()) / TilesCount;
+
+		for (int32 TileY = 0; TileY < TilesCount; TileY++)
+		{
+			for (int32 TileX = 0; TileX < TilesCount; TileX++)
+			{
+				// One texel border, so bilinear samples near tile edge are inside the range
+				const FIntPoint Min = FIntPoint(
+					Rect.Min.X + FMath::FloorToInt32(TileX * TileSize.X) - 1,
+					Rect.Min.Y + FMath::FloorToInt32(TileY * TileSize.Y) - 1).ComponentMax(Rect.Min);
+				const FIntPoint Max = FIntPoint(
+					Rect.Min.X + FMath::CeilToInt32((TileX + 1) * TileSize.X) + 1,
+					Rect.Min.Y + FMath::CeilToInt32((TileY + 1) * TileSize.Y) + 1).ComponentMin(Rect.Max);
+
+				FColor& Range = Finest.GetPixel(Cell.X * TilesCount + TileX, Cell.Y * TilesCount + TileY);
+				for (int32 Y = Min.Y; Y < Max.Y; Y++)
+				{
+					for (int32 X = Min.X; X < Max.X; X++)
+					{
+						if (bUseCoverage &&
+							Coverage.GetPixel(X, Y).A == 0)
+						{
+							continue;
+						}
+
+						const FColor& Pixel = Depth.GetPixel(X, Y);
+						const uint8 Value = DepthChannel == 3 ? Pixel.A : DepthChannel == 2 ? Pixel.B : DepthChannel == 1 ? Pixel.G : Pixel.R;
+						Range.R = FMath::Min(Range.R, Value);
+						Range.G = FMath::Max(Range.G, Value);
+					}
+				}
+
+				if (ImpostorDepthRange::IsCovered(Range))
+				{
+					Range.B = MAX_uint8;
+					Range.A = MAX_uint8;
+				}
+			}
+		}
+	});
+
+	for (int32 MipSize = Size / 2; MipSize >= 1; MipSize /= 2)
+	{
+		const FImpostorImage& Previous = Result.Mips.Last();
+
+		FImpostorImage Mip;
+		Mip.Init(MipSize, MipSize, ImpostorDepthRange::EmptyTile);
+		for (int32 Y = 0; Y < MipSize; Y++)
+		{
+			for (int32 X = 0; X < MipSize; X++)
+			{
+				FColor& Range = Mip.GetPixel(X, Y);
+				for (int32 Index = 0; Index < 4; Index++)
+				{
+					const FColor& Child = Previous.GetPixel(X * 2 + Index % 2, Y * 2 + Index / 2);
+					Range.R = FMath::Min(Range.R, Child.R);
+					Range.G = FMath::Max(Range.G, Child.G);
+					Range.B = FMath::Max(Range.B, Child.B);
+					Range.A = FMath::Max(Range.A, Child.A);
+				}
+			}
+		}
+		Result.Mips.Add(MoveTemp(Mip));
+	}
+
+	const FColor& Whole = Result.Mips.Last().GetPixel(0, 0);
+	Result.MinDepth = Whole.R;
+	Result.MaxDepth = Whole.G;
+
+	return Result;
+}
+
+void FImpostorDepthRange::WriteToTextureSource(UTexture2D* Texture) const
+{
+	if (!ensure(Texture) ||
+		IsEmpty())
+	{
+		return;
+	}
+
+	TArray<FColor> Data;
+	for (const FImpostorImage& Mip : Mips)
+	{
+		Data.Append(Mip.Pixels);
+	}
+
+	Texture->Source.Init(Mips[0].SizeX, Mips[0].SizeY, 1, Mips.Num(), TSF_BGRA8, reinterpret_cast<const uint8*>(Data.GetData()));
+}
+
+float FImpostorDepthRange::GetEmptyTilesFraction() const
+{
+	int32 NumTiles = 0;
+	int32 NumEmpty = 0;
+	for (int32 Slot = 0; Slot < UsedCells.Num(); Slot++)
+	{
+		if (!UsedCells[Slot])
+		{
+			continue;
+		}
+
+		const FIntPoint Cell(Slot % NumCellsX, Slot / NumCellsX);
+		for (int32 TileY = 0; TileY < TilesCount; TileY++)
+		{
+			for (int32 TileX = 0; TileX < TilesCount; TileX++)
+			{
+				NumTiles++;
+				NumEmpty += ImpostorDepthRange::IsCovered(Mips[0].GetPixel(Cell.X * TilesCount + TileX, Cell.Y * TilesCount + TileY)) ? 0 : 1;
+			}
+		}
+	}
+
+	return NumTiles > 0 ? float(NumEmpty) / NumTiles : 0.f;
+}
+
+float FImpostorDepthRange::GetAverageFrameRange() const
+{
+	const int32 FrameMip = FMath::FloorLog2(TilesCount);
+	if (!Mips.IsValidIndex(FrameMip))
+	{
+		return 0.f;
+	}
+
+	int32 NumFrames = 0;
+	float Sum = 0.f;
+	for (int32 Slot = 0; Slot < UsedCells.Num(); Slot++)
+	{
+		const FColor& Range = Mips[FrameMip].GetPixel(Slot % NumCellsX, Slot / NumCellsX);
+		if (UsedCells[Slot] &&
+			ImpostorDepthRange::IsCovered(Range))
+		{
+			NumFrames++;
+			Sum += float(Range.G - Range.R) / MAX_uint8;
+		}
+	}
+
+	return NumFrames > 0 ? Sum / NumFrames : 0.f;
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include "ImpostorImage.h"
+
+class UTexture2D;
+
+// Hierarchical min / max depth of impostor frames, in the same encoding as depth map (0.5 - Depth * 0.5 / Radius).
+// Mip 0 has TilesCount x TilesCount texels per atlas cell, so mip log2(TilesCount) has single texel with range of whole frame.
+// Texels store minimum in red and maximum in green, tiles without covered pixels have minimum above maximum.
+struct FImpostorDepthRange
+{
+public:
+	// CellRects are pixel rectangles of atlas cells in Depth image (row major, NumCellsX per row), empty for unused cells.
+	// Pixels with zero Coverage alpha are skipped, every pixel is covered if Coverage is empty.
+	static FImpostorDepthRange Build(const FImpostorImage& Depth, int32 DepthChannel, const FImpostorImage& Coverage, const TArray<FIntRect>& CellRects, int32 NumCellsX, int32 TilesCount);
+
+	bool IsEmpty() const
+	{
+		return Mips.Num() == 0;
+	}
+
+	// Replaces texture source data with all mips, texture has to keep them (Leave Existing Mips)
+	void WriteToTextureSource(UTexture2D* Texture) const;
+
+	// Fraction of finest tiles of used cells, which have no covered pixels
+	float GetEmptyTilesFraction() const;
+	// Average depth range of frames, relative to whole encoded range
+	float GetAverageFrameRange() const;
+
+public:
+	TArray<FImpostorImage> Mips;
+	int32 TilesCount = 1;
+
+	// Encoded depth range of all frames
+	uint8 MinDepth = MAX_uint8;
+	uint8 MaxDepth = 0;
+
+private:
+	TArray<bool> UsedCells;
+	int32 NumCellsX = 0;
+};
@@ -0,0 +1,201 @@
+﻿#include "ImpostorFrameOrder.h"
+#include <HAL/IConsoleManager.h>
+#include "ImpostorRenderer.h"
+#include "ImpostorViewDistribution.h"
+#include "ImpostorData/ImpostorData.h"
+
+namespace ImpostorFrameOrder
+{
+	constexpr int32 BlockSize = 4;
+	constexpr int32 BlockBytes = 16;
+	constexpr int32 LineBytes = 64;
+	constexpr int32 NumWays = 16;
+
+	struct FCache
+	{
+		explicit FCache(const int32 CacheBytes)
+		{
+			NumSets = FMath::Max(CacheBytes / (LineBytes * NumWays), 1);
+			Tags.Init(MAX_uint64, NumSets * NumWays);
+			LastUses.Init(0, NumSets * NumWays);
+		}
+
+		// Returns true on miss
+		bool Access(const uint64 Line)
+		{
+			const int32 Set = int32(Line % NumSets) * NumWays;
+			Time++;
+
+			int32 Oldest = Set;
+			for (int32 Way = Set; Way < Set + NumWays; Way++)
+			{
+				if (Tags[Way] == Line)
+				{
+					LastUses[Way] = Time;
+					return false;
+				}
+
+				if (LastUses[Way] < LastUses[Oldest])
+				{
+					Oldest = Way;
+				}
+			}
+
+			Tags[Oldest] = Line;
+			LastUses[Oldest] = Time;
+			return true;
+		}
+
+		int32 NumSets = 1;
+		uint64 Time = 0;
+		TArray<uint64> Tags;
+		TArray<uint64> LastUses;
+	};
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice SimulateCommand(
+		TEXT("ImpostorBaker.SimulateFrameCache"),
+		TEXT("Simulates texture cache misses of frame orders for random view directions, for every mip of impostor frames. Arguments: ImpostorData object path, optional number of directions and cache size in KB."),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+		{
+			const UImpostorData* ImpostorData = Args.Num() > 0 ? LoadObject<UImpostorData>(nullptr, *Args[0]) : nullptr;
+			if (!ImpostorData ||
+				ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards)
+			{
+				Ar.Logf(TEXT("(Hemi)octahedral ImpostorData wasn't found. Usage: ImpostorBaker.SimulateFrameCache /Game/Path/ImpostorData [NumDirections] [CacheKB]"));
+				return;
+			}
+
+			const int32 NumDirections = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 4096, 1);
+			const int32 CacheBytes = FMath::Max(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 16, 1) * 1024;
+
+			const int32 FramesCount = ImpostorData->FramesCount;
+			const FImpostorViewDistribution Distribution = FImpostorViewDistribution::Create(*ImpostorData, FImpostorViewDistribution::MakeViewVectors(*ImpostorData));
+			const TArray<FVector> Directions = FImpostorRenderer::MakeTestDirections(NumDirections, ImpostorData->ImpostorType == EImpostorLayoutType::UpperHemisphereOnly);
+
+			TArray<EImpostorFrameOrder> Orders = { EImpostorFrameOrder::RowMajor };
+			if (FMath::IsPowerOfTwo(FramesCount))
+			{
+				Orders.Append({ EImpostorFrameOrder::Morton, EImpostorFrameOrder::Hilbert });
+			}
+
+			Ar.Logf(TEXT("%s: cache lines missed per direction (atlas / frame linear), %d directions, %d KB cache"), *ImpostorData->GetName(), NumDirections, CacheBytes / 1024);
+			for (int32 FrameSize = FMath::Max(ImpostorData->Resolution / FramesCount, 1); FrameSize >= 1; FrameSize /= 2)
+			{
+				FString Line = FString::Printf(TEXT("Frame %4d:"), FrameSize);
+				for (const EImpostorFrameOrder Order : Orders)
+				{
+					Line += FString::Printf(TEXT("  %s %.1f / %.1f"),
+						*StaticEnum<EImpostorFrameOrder>()->GetNameStringByValue(int64(Order)),
+						FImpostorFrameOrder::SimulateCacheMisses(Distribution, Directions, Order, FramesCount, FrameSize, false, CacheBytes),
+						FImpostorFrameOrder::SimulateCacheMisses(Distribution, Directions, Order, FramesCount, FrameSize, true, CacheBytes));
+				}
+				Ar.Logf(TEXT("%s"), *Line);
+			}
+		}));
+}
+
+int32 FImpostorFrameOrder::GetSlot(const EImpostorFrameOrder Order, const int32 ViewIndex, const int32 FramesCount)
+{
+	const uint32 X = uint32(ViewIndex % FramesCount);
+	const uint32 Y = uint32(ViewIndex / FramesCount);
+
+	switch (Order)
+	{
+	default: check(false);
+	case EImpostorFrameOrder::RowMajor: return ViewIndex;
+	case EImpostorFrameOrder::Morton: return int32(EncodeMorton(X, Y));
+	case EImpostorFrameOrder::Hilbert: return int32(EncodeHilbert(X, Y, uint32(FramesCount)));
+	}
+}
+
+uint32 FImpostorFrameOrder::EncodeMorton(const uint32 X, const uint32 Y)
+{
+	uint32 Code = 0;
+	for (uint32 Bit = 0; Bit < 16; Bit++)
+	{
+		Code |= ((X >> Bit) & 1) << (2 * Bit);
+		Code |= ((Y >> Bit) & 1) << (2 * Bit + 1);
+	}
+	return Code;
+}
+
+uint32 FImpostorFrameOrder::EncodeHilbert(uint32 X, uint32 Y, const uint32 Size)
+{
+	uint32 Distance = 0;
+	for (uint32 Step = Size / 2; Step > 0; Step /= 2)
+	{
+		const uint32 RegionX = (X & Step) > 0 ? 1 : 0;
+		const uint32 RegionY = (Y & Step) > 0 ? 1 : 0;
+		Distance += Step * Step * ((3 * RegionX) ^ RegionY);
+
+		// Rotate quadrant, so the curve continues in it
+		if (RegionY == 0)
+		{
+			if (RegionX == 1)
+			{
+				X = Size - 1 - X;
+				Y = Size - 1 - Y;
+			}
+			Swap(X, Y);
+		}
+	}
+	return Distance;
+}
+
+float FImpostorFrameOrder::SimulateCacheMisses(const FImpostorViewDistribution& Distribution, const TArray<FVector>& Directions, const EImpostorFrameOrder Order, const int32 FramesCount, const int32 FrameSize, const bool bFrameLinear, const int32 CacheBytes)
+{
+	ImpostorFrameOrder::FCache Cache(CacheBytes);
+
+	const int32 AtlasBlocks = FMath::DivideAndRoundUp(FramesCount * FrameSize, ImpostorFrameOrder::BlockSize);
+	const int32 FrameBlocks = FMath::DivideAndRoundUp(FrameSize, ImpostorFrameOrder::BlockSize);
+
+	int64 NumMisses = 0;
+	for (const FVector& Direction : Directions)
+	{
+		FIntVector Views;
+		FVector3f Weights;
+		if (!Distribution.FindViews(FVector3f(Direction.GetSafeNormal()), Views, Weights))
+		{
+			continue;
+		}
+
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			if (Weights[Corner] <= 0.f)
+			{
+				continue;
+			}
+
+			const int32 Slot = GetSlot(Order, Views[Corner], FramesCount);
+
+			// Blocks of the frame, blocks shared by several small frames are read once
+			TSet<uint64> Lines;
+			if (bFrameLinear)
+			{
+				const uint64 FrameOffset = uint64(Slot) * FrameBlocks * FrameBlocks * ImpostorFrameOrder::BlockBytes;
+				for (int32 Block = 0; Block < FrameBlocks * FrameBlocks; Block++)
+				{
+					Lines.Add((FrameOffset + uint64(Block) * ImpostorFrameOrder::BlockBytes) / ImpostorFrameOrder::LineBytes);
+				}
+			}
+			else
+			{
+				const FIntPoint Min = FIntPoint(Slot % FramesCount, Slot / FramesCount) * FrameSize;
+				for (int32 BlockY = Min.Y / ImpostorFrameOrder::BlockSize; BlockY <= (Min.Y + FrameSize - 1) / ImpostorFrameOrder::BlockSize; BlockY++)
+				{
+					for (int32 BlockX = Min.X / ImpostorFrameOrder::BlockSize; BlockX <= (Min.X + FrameSize - 1) / ImpostorFrameOrder::BlockSize; BlockX++)
+					{
+						Lines.Add((uint64(BlockY) * AtlasBlocks + BlockX) * ImpostorFrameOrder::BlockBytes / ImpostorFrameOrder::LineBytes);
+					}
+				}
+			}
+
+			for (const uint64 Line : Lines)
+			{
+				NumMisses += Cache.Access(Line) ? 1 : 0;
+			}
+		}
+	}
+
+	return Directions.Num() > 0 ? float(double(NumMisses) / Directions.Num()) : 0.f;
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+struct FImpostorViewDistribution;
+enum class EImpostorFrameOrder;
+
+// Placement of view frames into atlas cells (and frame array slices).
+// Views are row major in FramesCount x FramesCount grid, swizzled orders keep frames blended together closer in memory.
+class FImpostorFrameOrder
+{
+public:
+	// Row major index of atlas cell, which frame of ViewIndex is stored in. Swizzled orders need power of two FramesCount.
+	static int32 GetSlot(EImpostorFrameOrder Order, int32 ViewIndex, int32 FramesCount);
+
+	static uint32 EncodeMorton(uint32 X, uint32 Y);
+	// Distance along Hilbert curve filling Size x Size grid, Size is power of two
+	static uint32 EncodeHilbert(uint32 X, uint32 Y, uint32 Size);
+
+	// Average cache lines missed per direction, when all three frames blended for each of Directions are sampled whole at FrameSize.
+	// Textures are BC compressed (16 bytes per 4x4 block), cache is 16 way set associative with LRU replacement and 64 byte lines.
+	// Frame linear layout stores frames one after another (frame arrays), otherwise blocks are row major over whole atlas.
+	static float SimulateCacheMisses(const FImpostorViewDistribution& Distribution, const TArray<FVector>& Directions, EImpostorFrameOrder Order, int32 FramesCount, int32 FrameSize, bool bFrameLinear, int32 CacheBytes);
+};
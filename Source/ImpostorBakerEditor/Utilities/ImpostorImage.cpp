@@ -0,0 +1,158 @@
+﻿#include "ImpostorImage.h"
+#include <Engine/Texture2D.h>
+#include <ImageUtils.h>
+#include <TextureResource.h>
+
+void FImpostorImage::Init(const int32 NewSizeX, const int32 NewSizeY, const FColor& Fill)
+{
+	SizeX = NewSizeX;
+	SizeY = NewSizeY;
+	Pixels.Init(Fill, SizeX * SizeY);
+}
+
+void FImpostorImage::CopyTo(FImpostorImage& Dest, const FIntPoint& Offset) const
+{
+	const int32 MinX = FMath::Max(0, -Offset.X);
+	const int32 MaxX = FMath::Min(SizeX, Dest.SizeX - Offset.X);
+	if (MinX >= MaxX)
+	{
+		return;
+	}
+
+	for (int32 Y = FMath::Max(0, -Offset.Y); Y < FMath::Min(SizeY, Dest.SizeY - Offset.Y); Y++)
+	{
+		FMemory::Memcpy(&Dest.GetPixel(Offset.X + MinX, Offset.Y + Y), &GetPixel(MinX, Y), (MaxX - MinX) * sizeof(FColor));
+	}
+}
+
+FImpostorImage FImpostorImage::CopyRect(const FIntRect& Rect) const
+{
+	FImpostorImage Result;
+	Result.Init(Rect.Width(), Rect.Height(), FColor::Black);
+	CopyTo(Result, -Rect.Min);
+	return Result;
+}
+
+FImpostorImage FImpostorImage::Resample(const FIntRect& Rect, const FIntPoint& NewSize) const
+{
+	FImpostorImage Result;
+	Result.Init(NewSize.X, NewSize.Y);
+
+	const FVector2f Scale = FVector2f(Rect.Size()) / FVector2f(NewSize);
+	for (int32 Y = 0; Y < NewSize.Y; Y++)
+	{
+		const int32 MinY = FMath::Min(Rect.Min.Y + FMath::FloorToInt32(Y * Scale.Y), Rect.Max.Y - 1);
+		const int32 MaxY = FMath::Clamp(Rect.Min.Y + FMath::FloorToInt32((Y + 1) * Scale.Y), MinY + 1, Rect.Max.Y);
+
+		for (int32 X = 0; X < NewSize.X; X++)
+		{
+			const int32 MinX = FMath::Min(Rect.Min.X + FMath::FloorToInt32(X * Scale.X), Rect.Max.X - 1);
+			const int32 MaxX = FMath::Clamp(Rect.Min.X + FMath::FloorToInt32((X + 1) * Scale.X), MinX + 1, Rect.Max.X);
+
+			int32 Sum[4] = { 0, 0, 0, 0 };
+			for (int32 SourceY = MinY; SourceY < MaxY; SourceY++)
+			{
+				for (int32 SourceX = MinX; SourceX < MaxX; SourceX++)
+				{
+					const FColor& Color = GetPixel(SourceX, SourceY);
+					Sum[0] += Color.R;
+					Sum[1] += Color.G;
+					Sum[2] += Color.B;
+					Sum[3] += Color.A;
+				}
+			}
+
+			const int32 Count = (MaxX - MinX) * (MaxY - MinY);
+			Result.GetPixel(X, Y) = FColor(
+				uint8((Sum[0] + Count / 2) / Count),
+				uint8((Sum[1] + Count / 2) / Count),
+				uint8((Sum[2] + Count / 2) / Count),
+				uint8((Sum[3] + Count / 2) / Count));
+		}
+	}
+
+	return Result;
+}
+
+UTexture2D* FImpostorImage::CreateTransientTexture(const bool bSRGB) const
+{
+	if (IsEmpty())
+	{
+		return nullptr;
+	}
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(SizeX, SizeY, PF_B8G8R8A8);
+	if (!ensure(Texture))
+	{
+		return nullptr;
+	}
+
+	Texture->SRGB = bSRGB;
+	Texture->Filter = TF_Nearest;
+
+	FTexture2DMipMap& Mip = Texture->GetPlatformData()->Mips[0];
+	void* Data = Mip.BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(Data, Pixels.GetData(), Pixels.Num() * sizeof(FColor));
+	Mip.BulkData.Unlock();
+
+	Texture->UpdateResource();
+	return Texture;
+}
+
+void FImpostorImage::WriteToTextureSource(UTexture2D* Texture) const
+{
+	if (!ensure(Texture) ||
+		IsEmpty())
+	{
+		return;
+	}
+
+	Texture->Source.Init(SizeX, SizeY, 1, 1, TSF_BGRA8, reinterpret_cast<const uint8*>(Pixels.GetData()));
+}
+
+bool FImpostorImage::ReadFromTextureSource(UTexture2D* Texture)
+{
+	FImage Image;
+	if (!Texture ||
+		!Texture->Source.IsValid() ||
+		!Texture->Source.GetMipImage(Image, 0))
+	{
+		return false;
+	}
+
+	// Same gamma space, so values are only reformatted
+	Image.ChangeFormat(ERawImageFormat::BGRA8, Image.GammaSpace);
+
+	SizeX = Image.SizeX;
+	SizeY = Image.SizeY;
+	Pixels = TArray<FColor>(Image.AsBGRA8().GetData(), Image.AsBGRA8().Num());
+	return true;
+}
+
+bool FImpostorImage::SaveToFile(const FString& Filename) const
+{
+	if (IsEmpty())
+	{
+		return false;
+	}
+
+	const FImageView ImageView(Pixels.GetData(), SizeX, SizeY, EGammaSpace::Linear);
+	return FImageUtils::SaveImageByExtension(*Filename, ImageView);
+}
+
+bool FImpostorImage::LoadFromFile(const FString& Filename)
+{
+	FImage Image;
+	if (!FImageUtils::LoadImage(*Filename, Image))
+	{
+		return false;
+	}
+
+	// Same gamma space, so values are only reformatted
+	Image.ChangeFormat(ERawImageFormat::BGRA8, Image.GammaSpace);
+
+	SizeX = Image.SizeX;
+	SizeY = Image.SizeY;
+	Pixels = TArray<FColor>(Image.AsBGRA8().GetData(), Image.AsBGRA8().Num());
+	return true;
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UTexture2D;
+
+// CPU side image with linear 8 bit BGRA pixels, used for atlases and frames produced without the renderer
+struct FImpostorImage
+{
+public:
+	void Init(int32 NewSizeX, int32 NewSizeY, const FColor& Fill = FColor(0, 0, 0, 0));
+
+	bool IsEmpty() const
+	{
+		return Pixels.Num() == 0;
+	}
+
+	FIntPoint GetSize() const
+	{
+		return FIntPoint(SizeX, SizeY);
+	}
+
+	FColor& GetPixel(const int32 X, const int32 Y)
+	{
+		return Pixels[Y * SizeX + X];
+	}
+
+	const FColor& GetPixel(const int32 X, const int32 Y) const
+	{
+		return Pixels[Y * SizeX + X];
+	}
+
+	// Copies whole image into Dest, with its top left corner at Offset. Pixels outside of Dest are skipped.
+	void CopyTo(FImpostorImage& Dest, const FIntPoint& Offset) const;
+	// Copy of Rect area, pixels outside of this image are left black
+	FImpostorImage CopyRect(const FIntRect& Rect) const;
+	// Rect area scaled to NewSize, every pixel averages texels its footprint covers (nearest texel when enlarging)
+	FImpostorImage Resample(const FIntRect& Rect, const FIntPoint& NewSize) const;
+
+	// Transient texture, which can be sampled by materials (e.g. to upload image into render target).
+	// sRGB texture should be used for pixels read from sRGB render target.
+	UTexture2D* CreateTransientTexture(bool bSRGB = false) const;
+
+	// Replaces texture source data, doesn't require RHI
+	void WriteToTextureSource(UTexture2D* Texture) const;
+	// Reads first mip of texture source data, doesn't require RHI. Values are converted to 8 bit without gamma changes.
+	bool ReadFromTextureSource(UTexture2D* Texture);
+
+	// Lossless image file (e.g. PNG), pixel values are stored as they are
+	bool SaveToFile(const FString& Filename) const;
+	bool LoadFromFile(const FString& Filename);
+
+public:
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	TArray<FColor> Pixels;
+};
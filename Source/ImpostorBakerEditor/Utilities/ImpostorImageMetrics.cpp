@@ -0,0 +1,287 @@
+﻿#include "ImpostorImageMetrics.h"
+#include <Async/ParallelFor.h>
+#include <HAL/IConsoleManager.h>
+#include "ImpostorImage.h"
+#include "ImpostorMeshGeometry.h"
+#include "ImpostorRenderer.h"
+#include "ImpostorData/ImpostorData.h"
+
+namespace ImpostorImageMetrics
+{
+	constexpr uint8 CoverageThreshold = 128;
+	constexpr int32 WindowSize = 8;
+	constexpr int32 WindowStride = 4;
+
+	struct FPixelSums
+	{
+		double SquaredError = 0.0;
+		double AngleSum = 0.0;
+		int64 NumUnion = 0;
+		int64 NumIntersection = 0;
+	};
+
+	struct FWindowSums
+	{
+		double SSIM = 0.0;
+		int64 NumWindows = 0;
+	};
+
+	float HorizontalSum(const VectorRegister4Float& Value)
+	{
+		alignas(16) float Values[4];
+		VectorStoreAligned(Value, Values);
+		return Values[0] + Values[1] + Values[2] + Values[3];
+	}
+
+	void ComparePixels(const FImpostorImage& Image, const FImpostorImage& Reference, const int32 Y, FPixelSums& OutSums)
+	{
+		const VectorRegister4Float ColorMask = MakeVectorRegisterFloat(1.f, 1.f, 1.f, 0.f);
+		const VectorRegister4Float NormalScale = VectorSetFloat1(2.f / 255.f);
+		const VectorRegister4Float NormalBias = VectorSetFloat1(-1.f);
+
+		VectorRegister4Float SquaredError = VectorZeroFloat();
+		for (int32 X = 0; X < Image.SizeX; X++)
+		{
+			const FColor& Pixel = Image.GetPixel(X, Y);
+			const FColor& ReferencePixel = Reference.GetPixel(X, Y);
+
+			const bool bCovered = Pixel.A >= CoverageThreshold;
+			const bool bReferenceCovered = ReferencePixel.A >= CoverageThreshold;
+			if (!bCovered &&
+				!bReferenceCovered)
+			{
+				continue;
+			}
+
+			const VectorRegister4Float Value = VectorMultiply(VectorLoadByte4(&Pixel), ColorMask);
+			const VectorRegister4Float ReferenceValue = VectorMultiply(VectorLoadByte4(&ReferencePixel), ColorMask);
+
+			const VectorRegister4Float Difference = VectorSubtract(Value, ReferenceValue);
+			SquaredError = VectorMultiplyAdd(Difference, Difference, SquaredError);
+			OutSums.NumUnion++;
+
+			if (!bCovered ||
+				!bReferenceCovered)
+			{
+				continue;
+			}
+
+			// Channel order doesn't matter for dot products
+			const VectorRegister4Float Normal = VectorMultiply(VectorMultiplyAdd(Value, NormalScale, NormalBias), ColorMask);
+			const VectorRegister4Float ReferenceNormal = VectorMultiply(VectorMultiplyAdd(ReferenceValue, NormalScale, NormalBias), ColorMask);
+
+			const float LengthsSquared = VectorDot3Scalar(Normal, Normal) * VectorDot3Scalar(ReferenceNormal, ReferenceNormal);
+			const float Cosine = VectorDot3Scalar(Normal, ReferenceNormal) * FMath::InvSqrt(FMath::Max(LengthsSquared, UE_SMALL_NUMBER));
+
+			OutSums.AngleSum += FMath::Acos(FMath::Clamp(Cosine, -1.f, 1.f));
+			OutSums.NumIntersection++;
+		}
+
+		OutSums.SquaredError += HorizontalSum(SquaredError);
+	}
+
+	// Rec. 601 luma and coverage (1 if either image covers the pixel), rows are padded to multiple of 4
+	void MakePlanes(const FImpostorImage& Image, const FImpostorImage& Reference, const int32 Stride, TArray<float>& OutLuma, TArray<float>& OutReferenceLuma, TArray<float>& OutCoverage)
+	{
+		OutLuma.SetNumZeroed(Stride * Image.SizeY);
+		OutReferenceLuma.SetNumZeroed(Stride * Image.SizeY);
+		OutCoverage.SetNumZeroed(Stride * Image.SizeY);
+
+		ParallelFor(Image.SizeY, [&](const int32 Y)
+		{
+			for (int32 X = 0; X < Image.SizeX; X++)
+			{
+				const FColor& Pixel = Image.GetPixel(X, Y);
+				const FColor& ReferencePixel = Reference.GetPixel(X, Y);
+
+				OutLuma[Y * Stride + X] = 0.299f * Pixel.R + 0.587f * Pixel.G + 0.114f * Pixel.B;
+				OutReferenceLuma[Y * Stride + X] = 0.299f * ReferencePixel.R + 0.587f * ReferencePixel.G + 0.114f * ReferencePixel.B;
+				OutCoverage[Y * Stride + X] = Pixel.A >= CoverageThreshold || ReferencePixel.A >= CoverageThreshold ? 1.f : 0.f;
+			}
+		});
+	}
+
+	// Windows starting at WindowY row, each window is summed as two 4 wide vectors per row
+	void CompareWindows(const TArray<float>& Luma, const TArray<float>& ReferenceLuma, const TArray<float>& Coverage, const int32 Stride, const int32 SizeX, const int32 WindowY, FWindowSums& OutSums)
+	{
+		constexpr float C1 = (0.01f * 255.f) * (0.01f * 255.f);
+		constexpr float C2 = (0.03f * 255.f) * (0.03f * 255.f);
+		constexpr float InvNumPixels = 1.f / (WindowSize * WindowSize);
+
+		for (int32 WindowX = 0; WindowX + WindowSize <= SizeX; WindowX += WindowStride)
+		{
+			VectorRegister4Float Sum = VectorZeroFloat();
+			VectorRegister4Float ReferenceSum = VectorZeroFloat();
+			VectorRegister4Float SquaredSum = VectorZeroFloat();
+			VectorRegister4Float ReferenceSquaredSum = VectorZeroFloat();
+			VectorRegister4Float ProductSum = VectorZeroFloat();
+			VectorRegister4Float CoverageSum = VectorZeroFloat();
+
+			for (int32 Y = WindowY; Y < WindowY + WindowSize; Y++)
+			{
+				for (int32 X = WindowX; X < WindowX + WindowSize; X += 4)
+				{
+					const int32 Index = Y * Stride + X;
+					const VectorRegister4Float Value = VectorLoad(&Luma[Index]);
+					const VectorRegister4Float ReferenceValue = VectorLoad(&ReferenceLuma[Index]);
+
+					Sum = VectorAdd(Sum, Value);
+					ReferenceSum = VectorAdd(ReferenceSum, ReferenceValue);
+					SquaredSum = VectorMultiplyAdd(Value, Value, SquaredSum);
+					ReferenceSquaredSum = VectorMultiplyAdd(ReferenceValue, ReferenceValue, ReferenceSquaredSum);
+					ProductSum = VectorMultiplyAdd(Value, ReferenceValue, ProductSum);
+					CoverageSum = VectorAdd(CoverageSum, VectorLoad(&Coverage[Index]));
+				}
+			}
+
+			if (HorizontalSum(CoverageSum) == 0.f)
+			{
+				continue;
+			}
+
+			const float Mean = HorizontalSum(Sum) * InvNumPixels;
+			const float ReferenceMean = HorizontalSum(ReferenceSum) * InvNumPixels;
+			const float Variance = HorizontalSum(SquaredSum) * InvNumPixels - Mean * Mean;
+			const float ReferenceVariance = HorizontalSum(ReferenceSquaredSum) * InvNumPixels - ReferenceMean * ReferenceMean;
+			const float Covariance = HorizontalSum(ProductSum) * InvNumPixels - Mean * ReferenceMean;
+
+			OutSums.SSIM +=
+				((2.f * Mean * ReferenceMean + C1) * (2.f * Covariance + C2)) /
+				((Mean * Mean + ReferenceMean * ReferenceMean + C1) * (Variance + ReferenceVariance + C2));
+			OutSums.NumWindows++;
+		}
+	}
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice EvaluateCommand(
+		TEXT("ImpostorBaker.EvaluateImpostor"),
+		TEXT("Compares saved impostor with its referenced mesh, both rendered on CPU from random directions. Arguments: ImpostorData object path, optional number of directions and image size."),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+		{
+			const UImpostorData* ImpostorData = Args.Num() > 0 ? LoadObject<UImpostorData>(nullptr, *Args[0]) : nullptr;
+			if (!ImpostorData)
+			{
+				Ar.Logf(TEXT("ImpostorData wasn't found. Usage: ImpostorBaker.EvaluateImpostor /Game/Path/ImpostorData [NumDirections] [Size]"));
+				return;
+			}
+
+			const int32 NumDirections = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : ImpostorData->QualityEvaluationViews, 1);
+			const int32 Size = FMath::Clamp(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : ImpostorData->QualityEvaluationSize, 16, 4096);
+
+			const double StartTime = FPlatformTime::Seconds();
+			FImpostorImageMetrics Metrics;
+			if (!FImpostorImageMetrics::EvaluateImpostor(*ImpostorData, NumDirections, Size, Metrics))
+			{
+				Ar.Logf(TEXT("%s: saved (hemi)octahedral impostor with Base Color texture is required"), *ImpostorData->GetName());
+				return;
+			}
+
+			Ar.Logf(TEXT("%s: %s (%d views of %dx%d, %.1f ms)"), *ImpostorData->GetName(), *Metrics.ToString(), NumDirections, Size, Size, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		}));
+}
+
+FImpostorImageMetrics FImpostorImageMetrics::Compare(const FImpostorImage& Image, const FImpostorImage& Reference)
+{
+	using namespace ImpostorImageMetrics;
+
+	FImpostorImageMetrics Metrics;
+	if (!ensure(Image.GetSize() == Reference.GetSize()) ||
+		Image.IsEmpty())
+	{
+		return Metrics;
+	}
+
+	TArray<FPixelSums> RowSums;
+	RowSums.SetNum(Image.SizeY);
+
+	ParallelFor(Image.SizeY, [&](const int32 Y)
+	{
+		ComparePixels(Image, Reference, Y, RowSums[Y]);
+	});
+
+	// Rows are summed in order, so results don't depend on scheduling
+	FPixelSums Sums;
+	for (const FPixelSums& Row : RowSums)
+	{
+		Sums.SquaredError += Row.SquaredError;
+		Sums.AngleSum += Row.AngleSum;
+		Sums.NumUnion += Row.NumUnion;
+		Sums.NumIntersection += Row.NumIntersection;
+	}
+
+	const double MeanSquaredError = Sums.NumUnion > 0 ? Sums.SquaredError / (Sums.NumUnion * 3) : 0.0;
+	Metrics.PSNR = MeanSquaredError > 0.0 ? FMath::Min(float(10.0 * FMath::LogX(10.0, 255.0 * 255.0 / MeanSquaredError)), MaxPSNR) : MaxPSNR;
+	Metrics.SilhouetteIoU = Sums.NumUnion > 0 ? double(Sums.NumIntersection) / Sums.NumUnion : 1.f;
+	Metrics.NormalAngularError = Sums.NumIntersection > 0 ? FMath::RadiansToDegrees(Sums.AngleSum / Sums.NumIntersection) : 0.f;
+
+	const int32 Stride = Align(Image.SizeX, 4);
+	TArray<float> Luma, ReferenceLuma, Coverage;
+	MakePlanes(Image, Reference, Stride, Luma, ReferenceLuma, Coverage);
+
+	const int32 NumWindowRows = Image.SizeY >= WindowSize ? (Image.SizeY - WindowSize) / WindowStride + 1 : 0;
+	TArray<FWindowSums> WindowSums;
+	WindowSums.SetNum(NumWindowRows);
+
+	ParallelFor(NumWindowRows, [&](const int32 Row)
+	{
+		CompareWindows(Luma, ReferenceLuma, Coverage, Stride, Image.SizeX, Row * WindowStride, WindowSums[Row]);
+	});
+
+	FWindowSums TotalWindowSums;
+	for (const FWindowSums& Row : WindowSums)
+	{
+		TotalWindowSums.SSIM += Row.SSIM;
+		TotalWindowSums.NumWindows += Row.NumWindows;
+	}
+
+	Metrics.SSIM = TotalWindowSums.NumWindows > 0 ? TotalWindowSums.SSIM / TotalWindowSums.NumWindows : 1.f;
+
+	return Metrics;
+}
+
+FImpostorImageMetrics FImpostorImageMetrics::Compare(const TArray<FImpostorRenderedView>& Views, const TArray<FImpostorRenderedView>& ReferenceViews)
+{
+	FImpostorImageMetrics Average;
+	if (!ensure(Views.Num() == ReferenceViews.Num()) ||
+		Views.Num() == 0)
+	{
+		return Average;
+	}
+
+	for (int32 Index = 0; Index < Views.Num(); Index++)
+	{
+		const FImpostorImageMetrics Metrics = Compare(Views[Index].Normal, ReferenceViews[Index].Normal);
+		Average.PSNR += Metrics.PSNR / Views.Num();
+		Average.SSIM += Metrics.SSIM / Views.Num();
+		Average.SilhouetteIoU += Metrics.SilhouetteIoU / Views.Num();
+		Average.NormalAngularError += Metrics.NormalAngularError / Views.Num();
+	}
+
+	return Average;
+}
+
+bool FImpostorImageMetrics::EvaluateImpostor(const UImpostorData& ImpostorData, const int32 NumDirections, const int32 Size, FImpostorImageMetrics& OutMetrics)
+{
+	FImpostorRenderSource Source;
+	if (!FImpostorRenderSource::Create(ImpostorData, Source))
+	{
+		return false;
+	}
+
+	const FImpostorMeshGeometry Geometry = FImpostorMeshGeometry::Gather(ImpostorData.ReferencedMesh);
+	if (Geometry.IsEmpty())
+	{
+		return false;
+	}
+
+	const TArray<FVector> Directions = FImpostorRenderer::MakeTestDirections(NumDirections, ImpostorData.ImpostorType == EImpostorLayoutType::UpperHemisphereOnly);
+	const TArray<FImpostorRenderedView> ImpostorViews = FImpostorRenderer::RenderImpostor(Source, Directions, Size);
+	const TArray<FImpostorRenderedView> MeshViews = FImpostorRenderer::RenderMesh(Geometry, Source.Origin, Source.Radius, Directions, Size);
+
+	OutMetrics = Compare(ImpostorViews, MeshViews);
+	return true;
+}
+
+FString FImpostorImageMetrics::ToString() const
+{
+	return FString::Printf(TEXT("PSNR %.2f dB, SSIM %.3f, Silhouette IoU %.3f, Normal Error %.2f deg"), PSNR, SSIM, SilhouetteIoU, NormalAngularError);
+}
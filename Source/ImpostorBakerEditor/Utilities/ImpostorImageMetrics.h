@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UImpostorData;
+struct FImpostorImage;
+struct FImpostorRenderedView;
+
+// Difference between image and its reference. Pixels are covered where alpha is at least 128, empty background isn't measured.
+struct FImpostorImageMetrics
+{
+public:
+	// Multithreaded, rows are processed with 4 wide SIMD
+	static FImpostorImageMetrics Compare(const FImpostorImage& Image, const FImpostorImage& Reference);
+
+	// Averages over views, using Normal images (mesh color isn't available on CPU)
+	static FImpostorImageMetrics Compare(const TArray<FImpostorRenderedView>& Views, const TArray<FImpostorRenderedView>& ReferenceViews);
+
+	// Renders saved impostor and its referenced mesh from NumDirections random directions and compares them
+	static bool EvaluateImpostor(const UImpostorData& ImpostorData, int32 NumDirections, int32 Size, FImpostorImageMetrics& OutMetrics);
+
+	FString ToString() const;
+
+public:
+	// Peak signal to noise ratio of RGB over pixels covered by either image, in dB. Identical images are capped to MaxPSNR.
+	float PSNR = 0.f;
+	// Structural similarity of luma over 8x8 windows (with stride of 4), which cover any pixel
+	float SSIM = 0.f;
+	// Intersection over union of covered pixels
+	float SilhouetteIoU = 0.f;
+	// Mean angle between decoded normals over pixels covered by both images, in degrees
+	float NormalAngularError = 0.f;
+
+	static constexpr float MaxPSNR = 100.f;
+};
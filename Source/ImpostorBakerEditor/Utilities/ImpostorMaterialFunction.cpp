@@ -0,0 +1,93 @@
+﻿#include "ImpostorMaterialFunction.h"
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <MaterialEditingLibrary.h>
+#include <Materials/MaterialExpressionFunctionOutput.h>
+#include <Materials/MaterialExpressionVectorParameter.h>
+#include <Materials/MaterialFunction.h>
+#include "ImpostorData/ImpostorData.h"
+
+UMaterialFunction* FImpostorMaterialFunction::Save(const UImpostorData& ImpostorData) const
+{
+	if (!ensure(Outputs.Num() > 0))
+	{
+		return nullptr;
+	}
+
+	UPackage* FunctionPackage = CreatePackage(*ImpostorData.GetPackageName(AssetName));
+	if (!ensure(FunctionPackage))
+	{
+		return nullptr;
+	}
+
+	FunctionPackage->FullyLoad(); // Make sure the destination package is loaded
+
+	if (UMaterialFunction* ExistingFunction = FindObject<UMaterialFunction>(FunctionPackage, *AssetName))
+	{
+		return ExistingFunction;
+	}
+
+	UMaterialFunction* Function = NewObject<UMaterialFunction>(FunctionPackage, *AssetName, RF_Public | RF_Standalone);
+	Function->Description = Description;
+	Function->bExposeToLibrary = true;
+
+	UMaterialExpressionCustom* Custom = CastChecked<UMaterialExpressionCustom>(UMaterialEditingLibrary::CreateMaterialExpressionInFunction(Function, UMaterialExpressionCustom::StaticClass(), -300, 0));
+	Custom->Description = AssetName.RightChop(3); // Without MF_ prefix
+	Custom->OutputType = Outputs[0].Type;
+	Custom->Code = Code;
+
+	Custom->Inputs.Reset();
+	for (int32 Index = 0; Index < Inputs.Num(); Index++)
+	{
+		const FImpostorMaterialFunctionInput& Input = Inputs[Index];
+
+		UMaterialExpression* Expression = nullptr;
+		if (Input.PrimitiveDataIndex != INDEX_NONE)
+		{
+			UMaterialExpressionVectorParameter* Parameter = CastChecked<UMaterialExpressionVectorParameter>(UMaterialEditingLibrary::CreateMaterialExpressionInFunction(Function, UMaterialExpressionVectorParameter::StaticClass(), -600, Index * 150));
+			Parameter->ParameterName = Input.Name;
+			Parameter->bUseCustomPrimitiveData = true;
+			Parameter->PrimitiveDataIndex = uint8(Input.PrimitiveDataIndex);
+			Parameter->Desc = Input.Description;
+			Expression = Parameter;
+		}
+		else
+		{
+			UMaterialExpressionFunctionInput* FunctionInput = CastChecked<UMaterialExpressionFunctionInput>(UMaterialEditingLibrary::CreateMaterialExpressionInFunction(Function, UMaterialExpressionFunctionInput::StaticClass(), -600, Index * 150));
+			FunctionInput->InputName = Input.Name;
+			FunctionInput->InputType = Input.Type;
+			FunctionInput->SortPriority = Index;
+			FunctionInput->Description = Input.Description;
+			Expression = FunctionInput;
+		}
+
+		FCustomInput& CustomInput = Custom->Inputs.AddDefaulted_GetRef();
+		CustomInput.InputName = Input.Name;
+		CustomInput.Input.Expression = Expression;
+	}
+
+	for (int32 Index = 1; Index < Outputs.Num(); Index++)
+	{
+		FCustomOutput& CustomOutput = Custom->AdditionalOutputs.AddDefaulted_GetRef();
+		CustomOutput.OutputName = Outputs[Index].Name;
+		CustomOutput.OutputType = Outputs[Index].Type;
+	}
+
+	// Rebuilds output pins
+	Custom->PostEditChange();
+
+	for (int32 Index = 0; Index < Outputs.Num(); Index++)
+	{
+		UMaterialExpressionFunctionOutput* Output = CastChecked<UMaterialExpressionFunctionOutput>(UMaterialEditingLibrary::CreateMaterialExpressionInFunction(Function, UMaterialExpressionFunctionOutput::StaticClass(), 0, Index * 150));
+		Output->OutputName = Outputs[Index].Name;
+		Output->SortPriority = Index;
+		Output->Description = Outputs[Index].Description;
+		Output->A.Expression = Custom;
+		Output->A.OutputIndex = Index;
+	}
+
+	UMaterialEditingLibrary::UpdateMaterialFunction(Function, nullptr);
+	Function->MarkPackageDirty();
+	FAssetRegistryModule::AssetCreated(Function);
+
+	return Function;
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include <Materials/MaterialExpressionCustom.h>
+#include <Materials/MaterialExpressionFunctionInput.h>
+
+class UImpostorData;
+class UMaterialFunction;
+
+struct FImpostorMaterialFunctionInput
+{
+	FName Name;
+	EFunctionInputType Type = FunctionInput_Scalar;
+	FString Description;
+	// Input is vector parameter read from custom primitive data at this index, instead of function input
+	int32 PrimitiveDataIndex = INDEX_NONE;
+};
+
+struct FImpostorMaterialFunctionOutput
+{
+	FName Name;
+	ECustomMaterialOutputType Type = CMOT_Float1;
+	FString Description;
+};
+
+// Material function made of single Custom node, which is generated into save location of impostor.
+// Inputs are passed to code by their names. First output is return value of code, others are assigned by it.
+struct FImpostorMaterialFunction
+{
+public:
+	// Existing function is kept as it is
+	UMaterialFunction* Save(const UImpostorData& ImpostorData) const;
+
+public:
+	FString AssetName;
+	FString Description;
+	TArray<FImpostorMaterialFunctionInput> Inputs;
+	TArray<FImpostorMaterialFunctionOutput> Outputs;
+	FString Code;
+};
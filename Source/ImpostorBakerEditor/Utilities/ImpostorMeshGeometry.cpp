@@ -0,0 +1,197 @@
+﻿#include "ImpostorMeshGeometry.h"
+#include <Async/ParallelFor.h>
+#include <Engine/StaticMesh.h>
+#include <MeshDescription.h>
+#include <StaticMeshAttributes.h>
+#include <StaticMeshResources.h>
+#include "ImpostorBakerUtilities.h"
+
+FImpostorMeshGeometry FImpostorMeshGeometry::Gather(const UStaticMesh* Mesh, const int32 LODIndex)
+{
+	FImpostorMeshGeometry Geometry;
+	if (!Mesh)
+	{
+		return Geometry;
+	}
+
+	const FStaticMeshRenderData* RenderData = Mesh->GetRenderData();
+	if (RenderData &&
+		RenderData->LODResources.IsValidIndex(LODIndex))
+	{
+		const FStaticMeshLODResources& LODResources = RenderData->LODResources[LODIndex];
+		const FPositionVertexBuffer& PositionBuffer = LODResources.VertexBuffers.PositionVertexBuffer;
+		const FStaticMeshVertexBuffer& VertexBuffer = LODResources.VertexBuffers.StaticMeshVertexBuffer;
+		if (PositionBuffer.GetVertexData() &&
+			PositionBuffer.GetNumVertices() > 0 &&
+			VertexBuffer.GetTangentData() &&
+			LODResources.IndexBuffer.GetNumIndices() > 0)
+		{
+			for (uint32 Index = 0; Index < PositionBuffer.GetNumVertices(); Index++)
+			{
+				Geometry.AddVertex(
+					PositionBuffer.VertexPosition(Index),
+					FVector3f(VertexBuffer.VertexTangentZ(Index)),
+					VertexBuffer.GetNumTexCoords() > 0 ? VertexBuffer.GetVertexUV(Index, 0) : FVector2f::ZeroVector);
+			}
+
+			LODResources.IndexBuffer.GetCopy(Geometry.Indices);
+
+			for (const FStaticMeshSection& Section : LODResources.Sections)
+			{
+				Geometry.Sections.Add({ int32(Section.FirstIndex), int32(Section.NumTriangles), Section.MaterialIndex });
+			}
+
+			Geometry.PadVertices();
+			return Geometry;
+		}
+	}
+
+	// CPU copy of render data can be stripped, fall back to source mesh description
+	const FMeshDescription* MeshDescription = Mesh->GetMeshDescription(LODIndex);
+	if (!MeshDescription)
+	{
+		return Geometry;
+	}
+
+	const FStaticMeshConstAttributes Attributes(*MeshDescription);
+	const TVertexAttributesConstRef<FVector3f> Positions = Attributes.GetVertexPositions();
+	const TVertexInstanceAttributesConstRef<FVector3f> InstanceNormals = Attributes.GetVertexInstanceNormals();
+	const TVertexInstanceAttributesConstRef<FVector2f> InstanceUVs = Attributes.GetVertexInstanceUVs();
+	const TPolygonGroupAttributesConstRef<FName> SlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+
+	// Vertex instances are used as vertices, since they hold UVs
+	TArray<int32> InstanceToVertex;
+	InstanceToVertex.Init(INDEX_NONE, MeshDescription->VertexInstances().GetArraySize());
+	for (const FVertexInstanceID VertexInstanceID : MeshDescription->VertexInstances().GetElementIDs())
+	{
+		InstanceToVertex[VertexInstanceID.GetValue()] = Geometry.NumVertices;
+		Geometry.AddVertex(
+			Positions[MeshDescription->GetVertexInstanceVertex(VertexInstanceID)],
+			InstanceNormals[VertexInstanceID],
+			InstanceUVs.GetNumChannels() > 0 ? InstanceUVs.Get(VertexInstanceID, 0) : FVector2f::ZeroVector);
+	}
+
+	for (const FPolygonGroupID PolygonGroupID : MeshDescription->PolygonGroups().GetElementIDs())
+	{
+		FImpostorMeshSection Section;
+		Section.FirstIndex = Geometry.Indices.Num();
+		Section.MaterialIndex = FMath::Max(0, Mesh->GetMaterialIndex(SlotNames[PolygonGroupID]));
+
+		for (const FTriangleID TriangleID : MeshDescription->GetPolygonGroupTriangles(PolygonGroupID))
+		{
+			for (const FVertexInstanceID VertexInstanceID : MeshDescription->GetTriangleVertexInstances(TriangleID))
+			{
+				Geometry.Indices.Add(InstanceToVertex[VertexInstanceID.GetValue()]);
+			}
+			Section.NumTriangles++;
+		}
+
+		Geometry.Sections.Add(Section);
+	}
+
+	Geometry.PadVertices();
+	return Geometry;
+}
+
+float FImpostorMeshGeometry::GetProjectedRadius(const FVector& Origin, const TArray<FVector>& ViewVectors, float* OutDepthRadius) const
+{
+	if (OutDepthRadius)
+	{
+		*OutDepthRadius = 0.f;
+	}
+
+	if (IsEmpty() ||
+		ViewVectors.Num() == 0)
+	{
+		return 0.f;
+	}
+
+	TArray<float> ViewRadii;
+	ViewRadii.SetNumZeroed(ViewVectors.Num());
+	TArray<float> ViewDepths;
+	ViewDepths.SetNumZeroed(ViewVectors.Num());
+
+	ParallelFor(ViewVectors.Num(), [&](const int32 ViewIndex)
+	{
+		FVector X, Y, Z;
+		FImpostorBakerUtilities::DeriveAxes(ViewVectors[ViewIndex], X, Y, Z);
+
+		// dot(Position - Origin, Axis) is computed as dot(Position, Axis) + Offset
+		const VectorRegister4Float XX = VectorSetFloat1(X.X);
+		const VectorRegister4Float XY = VectorSetFloat1(X.Y);
+		const VectorRegister4Float XZ = VectorSetFloat1(X.Z);
+		const VectorRegister4Float XOffset = VectorSetFloat1(-FVector::DotProduct(Origin, X));
+
+		const VectorRegister4Float YX = VectorSetFloat1(Y.X);
+		const VectorRegister4Float YY = VectorSetFloat1(Y.Y);
+		const VectorRegister4Float YZ = VectorSetFloat1(Y.Z);
+		const VectorRegister4Float YOffset = VectorSetFloat1(-FVector::DotProduct(Origin, Y));
+
+		const VectorRegister4Float ZX = VectorSetFloat1(Z.X);
+		const VectorRegister4Float ZY = VectorSetFloat1(Z.Y);
+		const VectorRegister4Float ZZ = VectorSetFloat1(Z.Z);
+		const VectorRegister4Float ZOffset = VectorSetFloat1(-FVector::DotProduct(Origin, Z));
+
+		VectorRegister4Float MaxExtent = VectorZeroFloat();
+		VectorRegister4Float MaxDepth = VectorZeroFloat();
+		for (int32 Index = 0; Index < PositionsX.Num(); Index += 4)
+		{
+			const VectorRegister4Float PX = VectorLoad(&PositionsX[Index]);
+			const VectorRegister4Float PY = VectorLoad(&PositionsY[Index]);
+			const VectorRegister4Float PZ = VectorLoad(&PositionsZ[Index]);
+
+			const VectorRegister4Float ProjectedX = VectorMultiplyAdd(PZ, XZ, VectorMultiplyAdd(PY, XY, VectorMultiplyAdd(PX, XX, XOffset)));
+			const VectorRegister4Float ProjectedY = VectorMultiplyAdd(PZ, YZ, VectorMultiplyAdd(PY, YY, VectorMultiplyAdd(PX, YX, YOffset)));
+			// Depth doesn't take frame space, it only decides how far capture has to be placed
+			const VectorRegister4Float ProjectedZ = VectorMultiplyAdd(PZ, ZZ, VectorMultiplyAdd(PY, ZY, VectorMultiplyAdd(PX, ZX, ZOffset)));
+
+			MaxExtent = VectorMax(MaxExtent, VectorMax(VectorAbs(ProjectedX), VectorAbs(ProjectedY)));
+			MaxDepth = VectorMax(MaxDepth, VectorAbs(ProjectedZ));
+		}
+
+		alignas(16) float Extents[4];
+		VectorStoreAligned(MaxExtent, Extents);
+		ViewRadii[ViewIndex] = FMath::Max(FMath::Max(Extents[0], Extents[1]), FMath::Max(Extents[2], Extents[3]));
+
+		VectorStoreAligned(MaxDepth, Extents);
+		ViewDepths[ViewIndex] = FMath::Max(FMath::Max(Extents[0], Extents[1]), FMath::Max(Extents[2], Extents[3]));
+	});
+
+	// Every view shares one frame size, so the largest screen extent of any view wins
+	float Radius = 0.f;
+	for (int32 ViewIndex = 0; ViewIndex < ViewVectors.Num(); ViewIndex++)
+	{
+		Radius = FMath::Max(Radius, ViewRadii[ViewIndex]);
+		if (OutDepthRadius)
+		{
+			*OutDepthRadius = FMath::Max(*OutDepthRadius, ViewDepths[ViewIndex]);
+		}
+	}
+
+	return Radius;
+}
+
+void FImpostorMeshGeometry::AddVertex(const FVector3f& Position, const FVector3f& Normal, const FVector2f& UV)
+{
+	Normals.Add(Normal);
+	UVs.Add(UV);
+	PositionsX.Add(Position.X);
+	PositionsY.Add(Position.Y);
+	PositionsZ.Add(Position.Z);
+	NumVertices++;
+}
+
+void FImpostorMeshGeometry::PadVertices()
+{
+	if (NumVertices == 0)
+	{
+		return;
+	}
+
+	while (PositionsX.Num() % 4 != 0)
+	{
+		PositionsX.Add(PositionsX.Last());
+		PositionsY.Add(PositionsY.Last());
+		PositionsZ.Add(PositionsZ.Last());
+	}
+}
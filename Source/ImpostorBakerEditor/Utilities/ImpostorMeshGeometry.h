@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UStaticMesh;
+
+struct FImpostorMeshSection
+{
+	int32 FirstIndex = 0;
+	int32 NumTriangles = 0;
+	int32 MaterialIndex = 0;
+};
+
+// CPU copy of static mesh geometry. Positions are stored as structure of arrays, so they can be processed 4 at a time.
+struct FImpostorMeshGeometry
+{
+public:
+	static FImpostorMeshGeometry Gather(const UStaticMesh* Mesh, int32 LODIndex = 0);
+
+	bool IsEmpty() const
+	{
+		return NumVertices == 0;
+	}
+
+	int32 GetNumVertices() const
+	{
+		return NumVertices;
+	}
+
+	FVector3f GetPosition(const int32 Index) const
+	{
+		return FVector3f(PositionsX[Index], PositionsY[Index], PositionsZ[Index]);
+	}
+
+	// Largest distance from Origin along screen axes of any view, depth is excluded.
+	// Frame of this radius fits every vertex, from every view direction.
+	// OutDepthRadius is the largest distance along view directions, which capture has to be placed beyond.
+	float GetProjectedRadius(const FVector& Origin, const TArray<FVector>& ViewVectors, float* OutDepthRadius = nullptr) const;
+
+private:
+	void AddVertex(const FVector3f& Position, const FVector3f& Normal, const FVector2f& UV);
+	void PadVertices();
+
+public:
+	// Padded to multiple of 4 by repeating last vertex
+	TArray<float> PositionsX;
+	TArray<float> PositionsY;
+	TArray<float> PositionsZ;
+
+	// Not padded
+	TArray<FVector3f> Normals;
+	// First UV channel, not padded
+	TArray<FVector2f> UVs;
+
+	TArray<uint32> Indices;
+	TArray<FImpostorMeshSection> Sections;
+
+private:
+	int32 NumVertices = 0;
+};
@@ -0,0 +1,175 @@
+﻿#include "ImpostorNormalEncoding.h"
+#include <Async/ParallelFor.h>
+#include <Math/RandomStream.h>
+#include <Misc/AutomationTest.h>
+#include "ImpostorImage.h"
+#include "ImpostorOctahedralMath.h"
+
+namespace ImpostorNormalEncoding
+{
+	float Unpack(const uint8 Value)
+	{
+		return Value / 127.5f - 1.f;
+	}
+
+	uint8 Pack(const float Value)
+	{
+		return uint8(FMath::Clamp(FMath::RoundToInt32(Value * 127.5f + 127.5f), 0, MAX_uint8));
+	}
+
+	FColor PackVector(const FVector3f& Vector)
+	{
+		return FColor(Pack(Vector.X), Pack(Vector.Y), Pack(Vector.Z), MAX_uint8);
+	}
+
+	FVector3f UnpackVector(const FColor& Color)
+	{
+		return FVector3f(Unpack(Color.R), Unpack(Color.G), Unpack(Color.B)).GetSafeNormal();
+	}
+
+	float GetAngle(const FVector3f& A, const FVector3f& B)
+	{
+		return FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(A | B, -1.f, 1.f)));
+	}
+}
+
+void FImpostorNormalEncoding::EncodeOctahedral(FImpostorImage& Image)
+{
+	using namespace ImpostorNormalEncoding;
+
+	ParallelFor(Image.SizeY, [&](const int32 Y)
+	{
+		FImpostorVectorBatch Vectors;
+		FImpostorOctahedronBatch Octahedrons;
+		Vectors.SetNum(Image.SizeX);
+		for (int32 X = 0; X < Image.SizeX; X++)
+		{
+			const FColor& Pixel = Image.GetPixel(X, Y);
+			Vectors.X[X] = Unpack(Pixel.R);
+			Vectors.Y[X] = Unpack(Pixel.G);
+			Vectors.Z[X] = Unpack(Pixel.B);
+		}
+
+		// Mapping divides by manhattan length, so unpacked vectors don't need to be normalized
+		FImpostorOctahedralMath::UnitVectorToOctahedron(Vectors, Octahedrons);
+
+		for (int32 X = 0; X < Image.SizeX; X++)
+		{
+			Image.GetPixel(X, Y) = FColor(Pack(Octahedrons.X[X]), Pack(Octahedrons.Y[X]), 0, MAX_uint8);
+		}
+	});
+}
+
+void FImpostorNormalEncoding::DecodeOctahedral(FImpostorImage& Image)
+{
+	using namespace ImpostorNormalEncoding;
+
+	ParallelFor(Image.SizeY, [&](const int32 Y)
+	{
+		FImpostorOctahedronBatch Octahedrons;
+		FImpostorVectorBatch Vectors;
+		Octahedrons.SetNum(Image.SizeX);
+		for (int32 X = 0; X < Image.SizeX; X++)
+		{
+			const FColor& Pixel = Image.GetPixel(X, Y);
+			Octahedrons.X[X] = Unpack(Pixel.R);
+			Octahedrons.Y[X] = Unpack(Pixel.G);
+		}
+
+		FImpostorOctahedralMath::OctahedronToUnitVector(Octahedrons, Vectors);
+
+		for (int32 X = 0; X < Image.SizeX; X++)
+		{
+			Image.GetPixel(X, Y) = PackVector(Vectors.Get(X));
+		}
+	});
+}
+
+void FImpostorNormalEncoding::SplatChannel(FImpostorImage& Image, const int32 Channel)
+{
+	for (FColor& Pixel : Image.Pixels)
+	{
+		const uint8 Value = Channel == 3 ? Pixel.A : Channel == 2 ? Pixel.B : Channel == 1 ? Pixel.G : Pixel.R;
+		Pixel = FColor(Value, Value, Value, Value);
+	}
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FImpostorNormalEncodingTest, "ImpostorBaker.NormalEncoding", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FImpostorNormalEncodingTest::RunTest(const FString& Parameters)
+{
+	using namespace ImpostorNormalEncoding;
+
+	// Both encodings are limited by 8 bit input, octahedral one adds its own quantization
+	constexpr float Tolerance = 2.f;
+	constexpr int32 Size = 256;
+
+	FRandomStream RandomStream(1337);
+
+	TArray<FVector3f> Vectors;
+	Vectors.SetNumUninitialized(Size * Size);
+	for (FVector3f& Vector : Vectors)
+	{
+		Vector = FVector3f(RandomStream.GetUnitVector());
+	}
+
+	// Captured normals are already packed to 8 bits
+	FImpostorImage Packed;
+	Packed.Init(Size, Size);
+	for (int32 Index = 0; Index < Vectors.Num(); Index++)
+	{
+		Packed.Pixels[Index] = PackVector(Vectors[Index]);
+	}
+
+	FImpostorImage Encoded = Packed;
+	FImpostorNormalEncoding::EncodeOctahedral(Encoded);
+
+	FImpostorImage Decoded = Encoded;
+	FImpostorNormalEncoding::DecodeOctahedral(Decoded);
+
+	float OctahedralMax = 0.f;
+	float RoundTripMax = 0.f;
+	int32 NumMismatches = 0;
+	bool bTwoChannels = true;
+	for (int32 Index = 0; Index < Vectors.Num(); Index++)
+	{
+		const FVector3f& Vector = Vectors[Index];
+
+		// Octahedral encoding of exact direction, the best it can do with 8 bits
+		const FVector2f Octahedron = FImpostorOctahedralMath::UnitVectorToOctahedron(Vector);
+		const FVector3f Quantized = FImpostorOctahedralMath::OctahedronToUnitVector(FVector2f(Unpack(Pack(Octahedron.X)), Unpack(Pack(Octahedron.Y))));
+		OctahedralMax = FMath::Max(OctahedralMax, GetAngle(Vector, Quantized));
+
+		// Baking path, packed input through batch encode and decode
+		const FColor& EncodedPixel = Encoded.Pixels[Index];
+		const FVector3f RoundTrip = FImpostorOctahedralMath::OctahedronToUnitVector(FVector2f(Unpack(EncodedPixel.R), Unpack(EncodedPixel.G)));
+		RoundTripMax = FMath::Max(RoundTripMax, GetAngle(Vector, RoundTrip));
+		bTwoChannels &= EncodedPixel.B == 0 && EncodedPixel.A == MAX_uint8;
+
+		// Batch decode has to match scalar mapping within a quantization step
+		const FColor Reference = PackVector(RoundTrip);
+		const FColor& Pixel = Decoded.Pixels[Index];
+		if (FMath::Abs(Reference.R - Pixel.R) > 1 ||
+			FMath::Abs(Reference.G - Pixel.G) > 1 ||
+			FMath::Abs(Reference.B - Pixel.B) > 1)
+		{
+			NumMismatches++;
+		}
+	}
+
+	TestTrue(FString::Printf(TEXT("Octahedral RG8 max error %.3f deg"), OctahedralMax), OctahedralMax <= Tolerance);
+	TestTrue(FString::Printf(TEXT("Packed RGB8 to octahedral RG8 max error %.3f deg"), RoundTripMax), RoundTripMax <= Tolerance);
+	TestTrue(TEXT("EncodeOctahedral clears blue and sets opaque alpha"), bTwoChannels);
+	TestTrue(FString::Printf(TEXT("DecodeOctahedral mismatches %d"), NumMismatches), NumMismatches == 0);
+
+	FImpostorImage Splat;
+	Splat.Init(1, 1, FColor(10, 20, 30, 40));
+	FImpostorNormalEncoding::SplatChannel(Splat, 2);
+	TestTrue(TEXT("SplatChannel copies channel into all channels"), Splat.Pixels[0] == FColor(30, 30, 30, 30));
+
+	return true;
+}
+
+#endif
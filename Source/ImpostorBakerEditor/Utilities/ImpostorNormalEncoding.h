@@ -0,0 +1,18 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+struct FImpostorImage;
+
+// Conversions of saved Normal maps between packed (RGB = Normal * 0.5 + 0.5) and octahedral (RG = Octahedron * 0.5 + 0.5) encodings.
+// Images are processed 4 texels at a time with FImpostorOctahedralMath batch mappings.
+class FImpostorNormalEncoding
+{
+public:
+	// Blue is cleared and alpha is set to opaque, so two channel compression (BC5) keeps all of the data
+	static void EncodeOctahedral(FImpostorImage& Image);
+	static void DecodeOctahedral(FImpostorImage& Image);
+
+	// Copies Channel into all channels, so single channel compression (BC4) keeps it whichever channel it reads
+	static void SplatChannel(FImpostorImage& Image, int32 Channel);
+};
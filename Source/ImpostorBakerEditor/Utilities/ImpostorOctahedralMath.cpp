@@ -0,0 +1,455 @@
+﻿#include "ImpostorOctahedralMath.h"
+#include <Math/RandomStream.h>
+#include <Misc/AutomationTest.h>
+#include "ImpostorBakerUtilities.h"
+
+namespace ImpostorOctahedralMath
+{
+	VectorRegister4Float SignNotZero(const VectorRegister4Float& Value)
+	{
+		return VectorSelect(VectorCompareGE(Value, VectorZeroFloat()), VectorOneFloat(), VectorNegate(VectorOneFloat()));
+	}
+
+	void Normalize(VectorRegister4Float& X, VectorRegister4Float& Y, VectorRegister4Float& Z)
+	{
+		const VectorRegister4Float LengthSquared = VectorMultiplyAdd(Z, Z, VectorMultiplyAdd(Y, Y, VectorMultiply(X, X)));
+		const VectorRegister4Float InvLength = VectorReciprocalSqrtAccurate(VectorMax(LengthSquared, VectorSetFloat1(UE_SMALL_NUMBER)));
+		X = VectorMultiply(X, InvLength);
+		Y = VectorMultiply(Y, InvLength);
+		Z = VectorMultiply(Z, InvLength);
+	}
+
+	VectorRegister4Float InvManhattanLength(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z)
+	{
+		const VectorRegister4Float Length = VectorAdd(VectorAdd(VectorAbs(X), VectorAbs(Y)), VectorAbs(Z));
+		return VectorDivide(VectorOneFloat(), VectorMax(Length, VectorSetFloat1(UE_SMALL_NUMBER)));
+	}
+}
+
+void FImpostorVectorBatch::SetNum(const int32 NewNum)
+{
+	NumElements = NewNum;
+
+	const int32 NumPadded = Align(NewNum, 4);
+	X.SetNumZeroed(NumPadded);
+	Y.SetNumZeroed(NumPadded);
+	Z.SetNumZeroed(NumPadded);
+}
+
+void FImpostorOctahedronBatch::SetNum(const int32 NewNum)
+{
+	NumElements = NewNum;
+
+	const int32 NumPadded = Align(NewNum, 4);
+	X.SetNumZeroed(NumPadded);
+	Y.SetNumZeroed(NumPadded);
+}
+
+void FImpostorGridFramesBatch::SetNum(const int32 NewNum)
+{
+	NumElements = NewNum;
+
+	const int32 NumPadded = Align(NewNum, 4);
+	for (int32 Index = 0; Index < 3; Index++)
+	{
+		Frames[Index].SetNumZeroed(NumPadded);
+		Weights[Index].SetNumZeroed(NumPadded);
+	}
+}
+
+FVector3f FImpostorOctahedralMath::OctahedronToUnitVector(const FVector2f& Octahedron)
+{
+	const float Z = 1.f - FMath::Abs(Octahedron.X) - FMath::Abs(Octahedron.Y);
+	if (Z < 0.f)
+	{
+		return FVector3f(
+			(1.f - FMath::Abs(Octahedron.Y)) * (Octahedron.X >= 0.f ? 1.f : -1.f),
+			(1.f - FMath::Abs(Octahedron.X)) * (Octahedron.Y >= 0.f ? 1.f : -1.f),
+			Z).GetSafeNormal();
+	}
+
+	return FVector3f(Octahedron.X, Octahedron.Y, Z).GetSafeNormal();
+}
+
+FVector3f FImpostorOctahedralMath::HemiOctahedronToUnitVector(const FVector2f& HemiOctahedron)
+{
+	const FVector2f Octahedron = FVector2f(HemiOctahedron.X + HemiOctahedron.Y, HemiOctahedron.X - HemiOctahedron.Y) * 0.5f;
+	return FVector3f(Octahedron.X, Octahedron.Y, 1.f - FMath::Abs(Octahedron.X) - FMath::Abs(Octahedron.Y)).GetSafeNormal();
+}
+
+FVector2f FImpostorOctahedralMath::UnitVectorToOctahedron(const FVector3f& Vector)
+{
+	const FVector3f Octahedron = Vector / FMath::Max(FMath::Abs(Vector.X) + FMath::Abs(Vector.Y) + FMath::Abs(Vector.Z), UE_SMALL_NUMBER);
+	if (Octahedron.Z >= 0.f)
+	{
+		return FVector2f(Octahedron.X, Octahedron.Y);
+	}
+
+	return FVector2f(
+		(1.f - FMath::Abs(Octahedron.Y)) * (Octahedron.X >= 0.f ? 1.f : -1.f),
+		(1.f - FMath::Abs(Octahedron.X)) * (Octahedron.Y >= 0.f ? 1.f : -1.f));
+}
+
+FVector2f FImpostorOctahedralMath::UnitVectorToHemiOctahedron(const FVector3f& Vector)
+{
+	const FVector3f Clamped(Vector.X, Vector.Y, FMath::Max(Vector.Z, 0.f));
+	const FVector3f Octahedron = Clamped / FMath::Max(FMath::Abs(Clamped.X) + FMath::Abs(Clamped.Y) + Clamped.Z, UE_SMALL_NUMBER);
+
+	return FVector2f(Octahedron.X + Octahedron.Y, Octahedron.X - Octahedron.Y);
+}
+
+void FImpostorOctahedralMath::GetGridFrames(const FVector2f& Octahedron, const int32 FramesCount, FIntVector& OutFrames, FVector3f& OutWeights)
+{
+	// Frames are at grid corners, same as GetGridVector
+	const FVector2f GridPosition = (Octahedron * 0.5f + 0.5f) * float(FramesCount - 1);
+	const float MaxCell = float(FMath::Max(0, FramesCount - 2));
+	const FVector2f Cell(
+		FMath::Clamp(FMath::FloorToFloat(GridPosition.X), 0.f, MaxCell),
+		FMath::Clamp(FMath::FloorToFloat(GridPosition.Y), 0.f, MaxCell));
+	const FVector2f Fraction(
+		FMath::Clamp(GridPosition.X - Cell.X, 0.f, 1.f),
+		FMath::Clamp(GridPosition.Y - Cell.Y, 0.f, 1.f));
+
+	const auto GetFrame = [&](const float X, const float Y)
+	{
+		return FMath::Min(int32(Y), FramesCount - 1) * FramesCount + FMath::Min(int32(X), FramesCount - 1);
+	};
+
+	// Cell corner, corner next to diagonal and opposite corner
+	const bool bLowerTriangle = Fraction.X > Fraction.Y;
+	OutFrames = FIntVector(
+		GetFrame(Cell.X, Cell.Y),
+		bLowerTriangle ? GetFrame(Cell.X + 1.f, Cell.Y) : GetFrame(Cell.X, Cell.Y + 1.f),
+		GetFrame(Cell.X + 1.f, Cell.Y + 1.f));
+	OutWeights = FVector3f(
+		FMath::Min(1.f - Fraction.X, 1.f - Fraction.Y),
+		FMath::Abs(Fraction.X - Fraction.Y),
+		FMath::Min(Fraction.X, Fraction.Y));
+}
+
+void FImpostorOctahedralMath::OctahedronToUnitVector(const FImpostorOctahedronBatch& Octahedrons, FImpostorVectorBatch& OutVectors)
+{
+	OutVectors.SetNum(Octahedrons.Num());
+
+	for (int32 Index = 0; Index < Octahedrons.Num(); Index += 4)
+	{
+		const VectorRegister4Float OX = VectorLoad(&Octahedrons.X[Index]);
+		const VectorRegister4Float OY = VectorLoad(&Octahedrons.Y[Index]);
+		const VectorRegister4Float AbsX = VectorAbs(OX);
+		const VectorRegister4Float AbsY = VectorAbs(OY);
+
+		VectorRegister4Float Z = VectorSubtract(VectorSubtract(VectorOneFloat(), AbsX), AbsY);
+
+		// Lower hemisphere is folded over octahedron edges
+		const VectorRegister4Float Folded = VectorCompareLT(Z, VectorZeroFloat());
+		VectorRegister4Float X = VectorSelect(Folded, VectorMultiply(VectorSubtract(VectorOneFloat(), AbsY), ImpostorOctahedralMath::SignNotZero(OX)), OX);
+		VectorRegister4Float Y = VectorSelect(Folded, VectorMultiply(VectorSubtract(VectorOneFloat(), AbsX), ImpostorOctahedralMath::SignNotZero(OY)), OY);
+
+		ImpostorOctahedralMath::Normalize(X, Y, Z);
+
+		VectorStore(X, &OutVectors.X[Index]);
+		VectorStore(Y, &OutVectors.Y[Index]);
+		VectorStore(Z, &OutVectors.Z[Index]);
+	}
+}
+
+void FImpostorOctahedralMath::HemiOctahedronToUnitVector(const FImpostorOctahedronBatch& HemiOctahedrons, FImpostorVectorBatch& OutVectors)
+{
+	OutVectors.SetNum(HemiOctahedrons.Num());
+
+	const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+	for (int32 Index = 0; Index < HemiOctahedrons.Num(); Index += 4)
+	{
+		const VectorRegister4Float HX = VectorLoad(&HemiOctahedrons.X[Index]);
+		const VectorRegister4Float HY = VectorLoad(&HemiOctahedrons.Y[Index]);
+
+		VectorRegister4Float X = VectorMultiply(VectorAdd(HX, HY), Half);
+		VectorRegister4Float Y = VectorMultiply(VectorSubtract(HX, HY), Half);
+		VectorRegister4Float Z = VectorSubtract(VectorSubtract(VectorOneFloat(), VectorAbs(X)), VectorAbs(Y));
+
+		ImpostorOctahedralMath::Normalize(X, Y, Z);
+
+		VectorStore(X, &OutVectors.X[Index]);
+		VectorStore(Y, &OutVectors.Y[Index]);
+		VectorStore(Z, &OutVectors.Z[Index]);
+	}
+}
+
+void FImpostorOctahedralMath::UnitVectorToOctahedron(const FImpostorVectorBatch& Vectors, FImpostorOctahedronBatch& OutOctahedrons)
+{
+	OutOctahedrons.SetNum(Vectors.Num());
+
+	for (int32 Index = 0; Index < Vectors.Num(); Index += 4)
+	{
+		const VectorRegister4Float VX = VectorLoad(&Vectors.X[Index]);
+		const VectorRegister4Float VY = VectorLoad(&Vectors.Y[Index]);
+		const VectorRegister4Float VZ = VectorLoad(&Vectors.Z[Index]);
+
+		const VectorRegister4Float InvLength = ImpostorOctahedralMath::InvManhattanLength(VX, VY, VZ);
+		const VectorRegister4Float OX = VectorMultiply(VX, InvLength);
+		const VectorRegister4Float OY = VectorMultiply(VY, InvLength);
+
+		const VectorRegister4Float Folded = VectorCompareLT(VZ, VectorZeroFloat());
+		const VectorRegister4Float FoldedX = VectorMultiply(VectorSubtract(VectorOneFloat(), VectorAbs(OY)), ImpostorOctahedralMath::SignNotZero(OX));
+		const VectorRegister4Float FoldedY = VectorMultiply(VectorSubtract(VectorOneFloat(), VectorAbs(OX)), ImpostorOctahedralMath::SignNotZero(OY));
+
+		VectorStore(VectorSelect(Folded, FoldedX, OX), &OutOctahedrons.X[Index]);
+		VectorStore(VectorSelect(Folded, FoldedY, OY), &OutOctahedrons.Y[Index]);
+	}
+}
+
+void FImpostorOctahedralMath::UnitVectorToHemiOctahedron(const FImpostorVectorBatch& Vectors, FImpostorOctahedronBatch& OutHemiOctahedrons)
+{
+	OutHemiOctahedrons.SetNum(Vectors.Num());
+
+	for (int32 Index = 0; Index < Vectors.Num(); Index += 4)
+	{
+		const VectorRegister4Float VX = VectorLoad(&Vectors.X[Index]);
+		const VectorRegister4Float VY = VectorLoad(&Vectors.Y[Index]);
+		const VectorRegister4Float VZ = VectorMax(VectorLoad(&Vectors.Z[Index]), VectorZeroFloat());
+
+		const VectorRegister4Float InvLength = ImpostorOctahedralMath::InvManhattanLength(VX, VY, VZ);
+		const VectorRegister4Float OX = VectorMultiply(VX, InvLength);
+		const VectorRegister4Float OY = VectorMultiply(VY, InvLength);
+
+		VectorStore(VectorAdd(OX, OY), &OutHemiOctahedrons.X[Index]);
+		VectorStore(VectorSubtract(OX, OY), &OutHemiOctahedrons.Y[Index]);
+	}
+}
+
+void FImpostorOctahedralMath::GetGridFrames(const FImpostorOctahedronBatch& Octahedrons, const int32 FramesCount, FImpostorGridFramesBatch& OutFrames)
+{
+	OutFrames.SetNum(Octahedrons.Num());
+
+	const VectorRegister4Float Half = VectorSetFloat1(0.5f);
+	const VectorRegister4Float GridScale = VectorSetFloat1(float(FramesCount - 1));
+	const VectorRegister4Float MaxCell = VectorSetFloat1(float(FMath::Max(0, FramesCount - 2)));
+
+	alignas(16) float CellsX[4];
+	alignas(16) float CellsY[4];
+	alignas(16) float LowerTriangles[4];
+
+	for (int32 Index = 0; Index < Octahedrons.Num(); Index += 4)
+	{
+		const VectorRegister4Float GridX = VectorMultiply(VectorMultiplyAdd(VectorLoad(&Octahedrons.X[Index]), Half, Half), GridScale);
+		const VectorRegister4Float GridY = VectorMultiply(VectorMultiplyAdd(VectorLoad(&Octahedrons.Y[Index]), Half, Half), GridScale);
+
+		const VectorRegister4Float CellX = VectorMin(VectorMax(VectorFloor(GridX), VectorZeroFloat()), MaxCell);
+		const VectorRegister4Float CellY = VectorMin(VectorMax(VectorFloor(GridY), VectorZeroFloat()), MaxCell);
+
+		const VectorRegister4Float FractionX = VectorMin(VectorMax(VectorSubtract(GridX, CellX), VectorZeroFloat()), VectorOneFloat());
+		const VectorRegister4Float FractionY = VectorMin(VectorMax(VectorSubtract(GridY, CellY), VectorZeroFloat()), VectorOneFloat());
+
+		VectorStore(VectorMin(VectorSubtract(VectorOneFloat(), FractionX), VectorSubtract(VectorOneFloat(), FractionY)), &OutFrames.Weights[0][Index]);
+		VectorStore(VectorAbs(VectorSubtract(FractionX, FractionY)), &OutFrames.Weights[1][Index]);
+		VectorStore(VectorMin(FractionX, FractionY), &OutFrames.Weights[2][Index]);
+
+		VectorStoreAligned(CellX, CellsX);
+		VectorStoreAligned(CellY, CellsY);
+		VectorStoreAligned(VectorSelect(VectorCompareGT(FractionX, FractionY), VectorOneFloat(), VectorZeroFloat()), LowerTriangles);
+
+		// Frame indices are integer math
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			const int32 X = int32(CellsX[Lane]);
+			const int32 Y = int32(CellsY[Lane]);
+			const int32 NextX = FMath::Min(X + 1, FramesCount - 1);
+			const int32 NextY = FMath::Min(Y + 1, FramesCount - 1);
+			const bool bLowerTriangle = LowerTriangles[Lane] != 0.f;
+
+			OutFrames.Frames[0][Index + Lane] = Y * FramesCount + X;
+			OutFrames.Frames[1][Index + Lane] = bLowerTriangle ? Y * FramesCount + NextX : NextY * FramesCount + X;
+			OutFrames.Frames[2][Index + Lane] = NextY * FramesCount + NextX;
+		}
+	}
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FImpostorOctahedralMathTest, "ImpostorBaker.OctahedralMath", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FImpostorOctahedralMathTest::RunTest(const FString& Parameters)
+{
+	constexpr float Tolerance = 1.e-5f;
+
+	// Reference values are evaluated by hand from HLSL of impostor materials:
+	// octahedral normal and view lookup functions (same mappings), grid to vector and frame triangle interpolation
+	{
+		const TPair<FVector2f, FVector3f> Cases[] =
+		{
+			{ FVector2f(0.f, 0.f), FVector3f(0.f, 0.f, 1.f) },
+			{ FVector2f(0.5f, 0.5f), FVector3f(0.70710678f, 0.70710678f, 0.f) },
+			{ FVector2f(0.25f, -0.5f), FVector3f(0.40824829f, -0.81649658f, 0.40824829f) },
+			{ FVector2f(-0.75f, 0.5f), FVector3f(-0.81649658f, 0.40824829f, -0.40824829f) },
+			{ FVector2f(1.f, 1.f), FVector3f(0.f, 0.f, -1.f) },
+		};
+		for (const auto& [Octahedron, Expected] : Cases)
+		{
+			TestTrue(FString::Printf(TEXT("OctahedronToUnitVector(%s)"), *Octahedron.ToString()), OctahedronToUnitVector(Octahedron).Equals(Expected, Tolerance));
+			TestTrue(FString::Printf(TEXT("UnitVectorToOctahedron(%s)"), *Expected.ToString()), UnitVectorToOctahedron(Expected).Equals(Octahedron, Tolerance));
+		}
+	}
+
+	{
+		const TPair<FVector2f, FVector3f> Cases[] =
+		{
+			{ FVector2f(0.f, 0.f), FVector3f(0.f, 0.f, 1.f) },
+			{ FVector2f(1.f, 1.f), FVector3f(1.f, 0.f, 0.f) },
+			{ FVector2f(1.f, -1.f), FVector3f(0.f, 1.f, 0.f) },
+			{ FVector2f(-1.f, -1.f), FVector3f(-1.f, 0.f, 0.f) },
+			{ FVector2f(0.5f, 0.f), FVector3f(0.40824829f, 0.40824829f, 0.81649658f) },
+		};
+		for (const auto& [HemiOctahedron, Expected] : Cases)
+		{
+			TestTrue(FString::Printf(TEXT("HemiOctahedronToUnitVector(%s)"), *HemiOctahedron.ToString()), HemiOctahedronToUnitVector(HemiOctahedron).Equals(Expected, Tolerance));
+			TestTrue(FString::Printf(TEXT("UnitVectorToHemiOctahedron(%s)"), *Expected.ToString()), UnitVectorToHemiOctahedron(Expected).Equals(HemiOctahedron, Tolerance));
+		}
+
+		// Directions below horizon are clamped to it
+		TestTrue(TEXT("UnitVectorToHemiOctahedron below horizon"), UnitVectorToHemiOctahedron(FVector3f(0.f, -1.f, -3.f)).Equals(FVector2f(-1.f, 1.f), Tolerance));
+		// Unnormalized vectors are projected by their Manhattan length
+		TestTrue(TEXT("UnitVectorToOctahedron of lower hemisphere"), UnitVectorToOctahedron(FVector3f(0.5f, -0.25f, -0.25f)).Equals(FVector2f(0.75f, -0.5f), Tolerance));
+		TestTrue(TEXT("UnitVectorToOctahedron of unnormalized vector"), UnitVectorToOctahedron(FVector3f(-1.f, 2.f, 1.f)).Equals(FVector2f(-0.25f, 0.5f), Tolerance));
+	}
+
+	{
+		struct FGridCase
+		{
+			FVector2f Octahedron;
+			int32 FramesCount;
+			FIntVector Frames;
+			FVector3f Weights;
+		};
+		const FGridCase Cases[] =
+		{
+			{ FVector2f(0.f, 0.f), 16, FIntVector(119, 135, 136), FVector3f(0.5f, 0.f, 0.5f) },
+			{ FVector2f(-1.f, -1.f), 16, FIntVector(0, 16, 17), FVector3f(1.f, 0.f, 0.f) },
+			{ FVector2f(1.f, 1.f), 16, FIntVector(238, 254, 255), FVector3f(0.f, 0.f, 1.f) },
+			{ FVector2f(0.25f, -0.625f), 5, FIntVector(2, 7, 8), FVector3f(0.25f, 0.25f, 0.5f) },
+			{ FVector2f(0.875f, -0.875f), 5, FIntVector(3, 4, 9), FVector3f(0.25f, 0.5f, 0.25f) },
+		};
+		for (const FGridCase& Case : Cases)
+		{
+			FIntVector Frames;
+			FVector3f Weights;
+			GetGridFrames(Case.Octahedron, Case.FramesCount, Frames, Weights);
+			TestTrue(FString::Printf(TEXT("GetGridFrames(%s, %d) frames"), *Case.Octahedron.ToString(), Case.FramesCount), Frames == Case.Frames);
+			TestTrue(FString::Printf(TEXT("GetGridFrames(%s, %d) weights"), *Case.Octahedron.ToString(), Case.FramesCount), Weights.Equals(Case.Weights, Tolerance));
+
+			FImpostorOctahedronBatch Octahedrons;
+			Octahedrons.SetNum(1);
+			Octahedrons.Set(0, Case.Octahedron);
+			FImpostorGridFramesBatch BatchFrames;
+			GetGridFrames(Octahedrons, Case.FramesCount, BatchFrames);
+			TestTrue(TEXT("Batch GetGridFrames frames"), FIntVector(BatchFrames.Frames[0][0], BatchFrames.Frames[1][0], BatchFrames.Frames[2][0]) == Case.Frames);
+			TestTrue(TEXT("Batch GetGridFrames weights"), FVector3f(BatchFrames.Weights[0][0], BatchFrames.Weights[1][0], BatchFrames.Weights[2][0]).Equals(Case.Weights, Tolerance));
+		}
+	}
+
+	// Batch and scalar mappings have to match double precision ones on random directions, odd count covers padding
+	constexpr int32 NumSamples = 4099;
+	FRandomStream RandomStream(1337);
+
+	FImpostorVectorBatch Vectors;
+	FImpostorOctahedronBatch Octahedrons;
+	Vectors.SetNum(NumSamples);
+	Octahedrons.SetNum(NumSamples);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		Vectors.Set(Index, FVector3f(RandomStream.GetUnitVector()));
+		Octahedrons.Set(Index, FVector2f(RandomStream.FRandRange(-1.f, 1.f), RandomStream.FRandRange(-1.f, 1.f)));
+	}
+
+	FImpostorVectorBatch BatchVectors;
+	FImpostorOctahedronBatch BatchOctahedrons;
+
+	float ForwardError = 0.f;
+	float HemiForwardError = 0.f;
+	float InverseError = 0.f;
+	float HemiInverseError = 0.f;
+	float RoundTripError = 0.f;
+	float HemiRoundTripError = 0.f;
+
+	OctahedronToUnitVector(Octahedrons, BatchVectors);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		const FVector Reference = FImpostorBakerUtilities::OctahedronToUnitVector(FVector2D(Octahedrons.Get(Index)));
+		ForwardError = FMath::Max(ForwardError, (BatchVectors.Get(Index) - FVector3f(Reference)).GetAbsMax());
+		ForwardError = FMath::Max(ForwardError, (OctahedronToUnitVector(Octahedrons.Get(Index)) - FVector3f(Reference)).GetAbsMax());
+	}
+
+	UnitVectorToOctahedron(BatchVectors, BatchOctahedrons);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		RoundTripError = FMath::Max(RoundTripError, (BatchOctahedrons.Get(Index) - Octahedrons.Get(Index)).GetAbsMax());
+	}
+
+	HemiOctahedronToUnitVector(Octahedrons, BatchVectors);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		const FVector Reference = FImpostorBakerUtilities::HemiOctahedronToUnitVector(FVector2D(Octahedrons.Get(Index)));
+		HemiForwardError = FMath::Max(HemiForwardError, (BatchVectors.Get(Index) - FVector3f(Reference)).GetAbsMax());
+		HemiForwardError = FMath::Max(HemiForwardError, (HemiOctahedronToUnitVector(Octahedrons.Get(Index)) - FVector3f(Reference)).GetAbsMax());
+	}
+
+	UnitVectorToHemiOctahedron(BatchVectors, BatchOctahedrons);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		HemiRoundTripError = FMath::Max(HemiRoundTripError, (BatchOctahedrons.Get(Index) - Octahedrons.Get(Index)).GetAbsMax());
+	}
+
+	UnitVectorToOctahedron(Vectors, BatchOctahedrons);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		const FVector2D Reference = FImpostorBakerUtilities::UnitVectorToOctahedron(FVector(Vectors.Get(Index)));
+		InverseError = FMath::Max(InverseError, (BatchOctahedrons.Get(Index) - FVector2f(Reference)).GetAbsMax());
+		InverseError = FMath::Max(InverseError, (UnitVectorToOctahedron(Vectors.Get(Index)) - FVector2f(Reference)).GetAbsMax());
+	}
+
+	UnitVectorToHemiOctahedron(Vectors, BatchOctahedrons);
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		const FVector2D Reference = FImpostorBakerUtilities::UnitVectorToHemiOctahedron(FVector(Vectors.Get(Index)));
+		HemiInverseError = FMath::Max(HemiInverseError, (BatchOctahedrons.Get(Index) - FVector2f(Reference)).GetAbsMax());
+		HemiInverseError = FMath::Max(HemiInverseError, (UnitVectorToHemiOctahedron(Vectors.Get(Index)) - FVector2f(Reference)).GetAbsMax());
+	}
+
+	TestTrue(FString::Printf(TEXT("OctahedronToUnitVector max error %g"), ForwardError), ForwardError <= Tolerance);
+	TestTrue(FString::Printf(TEXT("HemiOctahedronToUnitVector max error %g"), HemiForwardError), HemiForwardError <= Tolerance);
+	TestTrue(FString::Printf(TEXT("UnitVectorToOctahedron max error %g"), InverseError), InverseError <= Tolerance);
+	TestTrue(FString::Printf(TEXT("UnitVectorToHemiOctahedron max error %g"), HemiInverseError), HemiInverseError <= Tolerance);
+	TestTrue(FString::Printf(TEXT("Octahedron round trip max error %g"), RoundTripError), RoundTripError <= Tolerance);
+	TestTrue(FString::Printf(TEXT("HemiOctahedron round trip max error %g"), HemiRoundTripError), HemiRoundTripError <= Tolerance);
+
+	// Cell can differ right at grid lines (e.g. with fused multiply add), so blended frame weights are compared instead of corners
+	constexpr int32 FramesCount = 16;
+	FImpostorGridFramesBatch BatchFrames;
+	GetGridFrames(Octahedrons, FramesCount, BatchFrames);
+
+	float WeightError = 0.f;
+	for (int32 Index = 0; Index < NumSamples; Index++)
+	{
+		FIntVector Frames;
+		FVector3f Weights;
+		GetGridFrames(Octahedrons.Get(Index), FramesCount, Frames, Weights);
+		WeightError = FMath::Max(WeightError, FMath::Abs(Weights.X + Weights.Y + Weights.Z - 1.f));
+
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			float ScalarWeight = 0.f;
+			float BatchWeight = 0.f;
+			for (int32 OtherCorner = 0; OtherCorner < 3; OtherCorner++)
+			{
+				ScalarWeight += Frames[OtherCorner] == Frames[Corner] ? Weights[OtherCorner] : 0.f;
+				BatchWeight += BatchFrames.Frames[OtherCorner][Index] == Frames[Corner] ? BatchFrames.Weights[OtherCorner][Index] : 0.f;
+			}
+			WeightError = FMath::Max(WeightError, FMath::Abs(ScalarWeight - BatchWeight));
+		}
+	}
+
+	TestTrue(FString::Printf(TEXT("GetGridFrames max weight error %g"), WeightError), WeightError <= Tolerance);
+
+	return true;
+}
+
+#endif
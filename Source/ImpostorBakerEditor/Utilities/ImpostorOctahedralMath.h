@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+// Unit vectors stored as structure of arrays, padded to multiple of 4, so they can be processed 4 at a time
+struct FImpostorVectorBatch
+{
+public:
+	void SetNum(int32 NewNum);
+
+	int32 Num() const
+	{
+		return NumElements;
+	}
+
+	void Set(const int32 Index, const FVector3f& Vector)
+	{
+		X[Index] = Vector.X;
+		Y[Index] = Vector.Y;
+		Z[Index] = Vector.Z;
+	}
+
+	FVector3f Get(const int32 Index) const
+	{
+		return FVector3f(X[Index], Y[Index], Z[Index]);
+	}
+
+public:
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+
+private:
+	int32 NumElements = 0;
+};
+
+// (Hemi)octahedral coordinates in [-1, 1] range, padded to multiple of 4
+struct FImpostorOctahedronBatch
+{
+public:
+	void SetNum(int32 NewNum);
+
+	int32 Num() const
+	{
+		return NumElements;
+	}
+
+	void Set(const int32 Index, const FVector2f& Octahedron)
+	{
+		X[Index] = Octahedron.X;
+		Y[Index] = Octahedron.Y;
+	}
+
+	FVector2f Get(const int32 Index) const
+	{
+		return FVector2f(X[Index], Y[Index]);
+	}
+
+public:
+	TArray<float> X;
+	TArray<float> Y;
+
+private:
+	int32 NumElements = 0;
+};
+
+// Three grid frames (indices of FramesCount x FramesCount grid) and their blend weights per element
+struct FImpostorGridFramesBatch
+{
+public:
+	void SetNum(int32 NewNum);
+
+	int32 Num() const
+	{
+		return NumElements;
+	}
+
+public:
+	TArray<int32> Frames[3];
+	TArray<float> Weights[3];
+
+private:
+	int32 NumElements = 0;
+};
+
+// Float (hemi)octahedral mappings, both directions. Batch functions process 4 elements at a time with SIMD and
+// match scalar functions (and FImpostorBakerUtilities double precision mappings) within float precision.
+class FImpostorOctahedralMath
+{
+public:
+	static FVector3f OctahedronToUnitVector(const FVector2f& Octahedron);
+	static FVector3f HemiOctahedronToUnitVector(const FVector2f& HemiOctahedron);
+	static FVector2f UnitVectorToOctahedron(const FVector3f& Vector);
+	static FVector2f UnitVectorToHemiOctahedron(const FVector3f& Vector);
+
+	// Frames and blend weights at octahedral coordinates, same as impostor material frame triangle interpolation:
+	// grid cell is split along its diagonal, weights are barycentric coordinates in the triangle.
+	static void GetGridFrames(const FVector2f& Octahedron, int32 FramesCount, FIntVector& OutFrames, FVector3f& OutWeights);
+
+	static void OctahedronToUnitVector(const FImpostorOctahedronBatch& Octahedrons, FImpostorVectorBatch& OutVectors);
+	static void HemiOctahedronToUnitVector(const FImpostorOctahedronBatch& HemiOctahedrons, FImpostorVectorBatch& OutVectors);
+	static void UnitVectorToOctahedron(const FImpostorVectorBatch& Vectors, FImpostorOctahedronBatch& OutOctahedrons);
+	static void UnitVectorToHemiOctahedron(const FImpostorVectorBatch& Vectors, FImpostorOctahedronBatch& OutHemiOctahedrons);
+	static void GetGridFrames(const FImpostorOctahedronBatch& Octahedrons, int32 FramesCount, FImpostorGridFramesBatch& OutFrames);
+};
@@ -0,0 +1,723 @@
+﻿#include "ImpostorRasterizer.h"
+#include <Async/ParallelFor.h>
+#include <Engine/Texture2D.h>
+#include <ImageCore.h>
+#include <Materials/MaterialInterface.h>
+#include "ImpostorBakerUtilities.h"
+#include "ImpostorMeshGeometry.h"
+
+FImpostorViewProjection::FImpostorViewProjection(const FVector& ViewVector, const FVector& InOrigin, const float Radius, const ECameraProjectionMode::Type ProjectionType, const float InCameraDistance, const float CameraFOV)
+{
+	FVector X, Y, Z;
+	FImpostorBakerUtilities::DeriveAxes(ViewVector, X, Y, Z);
+
+	Origin = FVector3f(InOrigin);
+	AxisX = FVector3f(X);
+	AxisY = FVector3f(Y);
+	AxisZ = FVector3f(Z);
+
+	bPerspective = ProjectionType == ECameraProjectionMode::Perspective;
+	CameraDistance = InCameraDistance;
+	Scale = bPerspective ? 1.f / FMath::Tan(FMath::DegreesToRadians(CameraFOV) / 2.f) : 1.f / FMath::Max(Radius, UE_KINDA_SMALL_NUMBER);
+}
+
+FVector3f FImpostorViewProjection::Project(const FVector3f& Position) const
+{
+	const FVector3f Local = Position - Origin;
+	const float Depth = FVector3f::DotProduct(Local, AxisZ);
+
+	// Perspective camera is placed CameraDistance away from origin, against the view direction
+	const float InvW = bPerspective ? 1.f / FMath::Max(Depth + CameraDistance, UE_KINDA_SMALL_NUMBER) : 1.f;
+
+	return FVector3f(
+		FVector3f::DotProduct(Local, AxisX) * InvW * Scale * 0.5f + 0.5f,
+		FVector3f::DotProduct(Local, AxisY) * InvW * Scale * 0.5f + 0.5f,
+		Depth);
+}
+
+bool FImpostorViewProjection::IsFacing(const FVector3f& Position, const FVector3f& Normal) const
+{
+	// Camera looks along AxisZ, perspective one is placed CameraDistance before origin
+	const FVector3f ToCamera = bPerspective ? Origin - AxisZ * CameraDistance - Position : -AxisZ;
+	return FVector3f::DotProduct(Normal, ToCamera) > 0.f;
+}
+
+void FImpostorCoverageMask::Init(const int32 NewSize)
+{
+	Size = NewSize;
+	WordsPerRow = FMath::DivideAndRoundUp(Size, 64);
+	Words.Reset();
+	Words.SetNumZeroed(WordsPerRow * Size);
+}
+
+void FImpostorCoverageMask::SetSpan(const int32 Y, int32 MinX, int32 MaxX)
+{
+	MinX = FMath::Max(MinX, 0);
+	MaxX = FMath::Min(MaxX, Size - 1);
+	if (Y < 0 ||
+		Y >= Size ||
+		MinX > MaxX)
+	{
+		return;
+	}
+
+	uint64* Row = &Words[Y * WordsPerRow];
+	const int32 FirstWord = MinX / 64;
+	const int32 LastWord = MaxX / 64;
+	for (int32 WordIndex = FirstWord; WordIndex <= LastWord; WordIndex++)
+	{
+		const int32 FirstBit = WordIndex == FirstWord ? MinX % 64 : 0;
+		const int32 LastBit = WordIndex == LastWord ? MaxX % 64 : 63;
+		const uint64 HighMask = LastBit == 63 ? ~uint64(0) : (uint64(1) << (LastBit + 1)) - 1;
+		Row[WordIndex] |= HighMask & ~((uint64(1) << FirstBit) - 1);
+	}
+}
+
+void FImpostorCoverageMask::Union(const FImpostorCoverageMask& Other)
+{
+	if (!ensure(Other.Size == Size))
+	{
+		return;
+	}
+
+	for (int32 Index = 0; Index < Words.Num(); Index++)
+	{
+		Words[Index] |= Other.Words[Index];
+	}
+}
+
+bool FImpostorCoverageMask::IsEmpty() const
+{
+	for (const uint64 Word : Words)
+	{
+		if (Word != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FImpostorCoverageMask FImpostorCoverageMask::Downsample(const int32 NewSize) const
+{
+	FImpostorCoverageMask Result;
+	Result.Init(NewSize);
+	if (NewSize == Size)
+	{
+		Result.Words = Words;
+		return Result;
+	}
+
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		for (int32 X = 0; X < Size; X++)
+		{
+			if (Get(X, Y))
+			{
+				Result.Set(X * NewSize / Size, Y * NewSize / Size);
+			}
+		}
+	}
+
+	return Result;
+}
+
+bool FImpostorOpacityMask::Create(const UMaterialInterface* Material, FImpostorOpacityMask& OutMask)
+{
+	if (!Material ||
+		Material->GetBlendMode() != BLEND_Masked)
+	{
+		return false;
+	}
+
+	TArray<UTexture*> Textures;
+	TArray<FName> TextureParameterNames;
+	const_cast<UMaterialInterface*>(Material)->GetTexturesInPropertyChain(MP_OpacityMask, Textures, &TextureParameterNames, nullptr, GMaxRHIFeatureLevel, EMaterialQualityLevel::High);
+
+	// Only single texture driven opacity is predictable. Anything else is treated as fully opaque.
+	UTexture2D* Texture = Textures.Num() == 1 ? Cast<UTexture2D>(Textures[0]) : nullptr;
+	if (!Texture ||
+		!Texture->Source.IsValid())
+	{
+		return false;
+	}
+
+	FImage SourceImage;
+	if (!Texture->Source.GetMipImage(SourceImage, 0, 0, 0))
+	{
+		return false;
+	}
+
+	FImage Image;
+	SourceImage.CopyTo(Image, ERawImageFormat::BGRA8, EGammaSpace::Linear);
+
+	// Opacity is usually stored in alpha channel, grayscale masks use red
+	const bool bUseAlpha = Texture->HasAlphaChannel();
+
+	OutMask.SizeX = Image.SizeX;
+	OutMask.SizeY = Image.SizeY;
+	OutMask.ClipValue = Material->GetOpacityMaskClipValue();
+	OutMask.Values.SetNumUninitialized(int64(Image.SizeX) * Image.SizeY);
+
+	const TArrayView64<FColor> Colors = Image.AsBGRA8();
+	for (int64 Index = 0; Index < OutMask.Values.Num(); Index++)
+	{
+		OutMask.Values[Index] = bUseAlpha ? Colors[Index].A : Colors[Index].R;
+	}
+
+	return true;
+}
+
+bool FImpostorOpacityMask::IsVisible(const FVector2f& UV) const
+{
+	const float U = UV.X - FMath::FloorToFloat(UV.X);
+	const float V = UV.Y - FMath::FloorToFloat(UV.Y);
+	const int32 X = FMath::Min(FMath::FloorToInt32(U * SizeX), SizeX - 1);
+	const int32 Y = FMath::Min(FMath::FloorToInt32(V * SizeY), SizeY - 1);
+
+	return Values[Y * SizeX + X] / 255.f >= ClipValue;
+}
+
+TArray<FImpostorCoverageMask> FImpostorRasterizer::RasterizeCoverage(
+	const FImpostorMeshGeometry& Geometry,
+	const TArray<FImpostorViewProjection>& Views,
+	const int32 Size,
+	const TMap<int32, FImpostorOpacityMask>* OpacityMasks,
+	const int32 Supersample,
+	const TSet<int32>* SingleSidedMaterials)
+{
+	TArray<FImpostorCoverageMask> Result;
+	Result.SetNum(Views.Num());
+	for (FImpostorCoverageMask& Mask : Result)
+	{
+		Mask.Init(Size);
+	}
+
+	const int32 NumTriangles = Geometry.Indices.Num() / 3;
+	if (Geometry.IsEmpty() ||
+		NumTriangles == 0)
+	{
+		return Result;
+	}
+
+	// Opacity is alpha tested per sample, so everything is rasterized at sample resolution and reduced afterwards
+	const bool bSampleOpacity = OpacityMasks && OpacityMasks->Num() > 0;
+	const int32 RasterSize = bSampleOpacity ? Size * FMath::Max(1, Supersample) : Size;
+
+	TArray<int32> TriangleMaterials;
+	TriangleMaterials.Init(INDEX_NONE, NumTriangles);
+	for (const FImpostorMeshSection& Section : Geometry.Sections)
+	{
+		for (int32 Index = 0; Index < Section.NumTriangles; Index++)
+		{
+			TriangleMaterials[Section.FirstIndex / 3 + Index] = Section.MaterialIndex;
+		}
+	}
+
+	// With only few views (billboards), triangles are split into chunks, so work is still spread across all cores
+	constexpr int32 MinTrianglesPerChunk = 4096;
+	const int32 NumChunks = FMath::Clamp(FMath::DivideAndRoundUp(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), Views.Num()), 1, FMath::DivideAndRoundUp(NumTriangles, MinTrianglesPerChunk));
+	const int32 TrianglesPerChunk = FMath::DivideAndRoundUp(NumTriangles, NumChunks);
+
+	TArray<FImpostorCoverageMask> ChunkMasks;
+	ChunkMasks.SetNum(Views.Num() * NumChunks);
+
+	ParallelFor(ChunkMasks.Num(), [&](const int32 JobIndex)
+	{
+		const FImpostorViewProjection& View = Views[JobIndex / NumChunks];
+		const int32 FirstTriangle = JobIndex % NumChunks * TrianglesPerChunk;
+		const int32 LastTriangle = FMath::Min(FirstTriangle + TrianglesPerChunk, NumTriangles);
+
+		FImpostorCoverageMask& Mask = ChunkMasks[JobIndex];
+		Mask.Init(RasterSize);
+
+		for (int32 TriangleIndex = FirstTriangle; TriangleIndex < LastTriangle; TriangleIndex++)
+		{
+			FVector2f Positions[3];
+			FVector2f UVs[3];
+			bool bBehindCamera = false;
+			for (int32 Corner = 0; Corner < 3; Corner++)
+			{
+				const uint32 VertexIndex = Geometry.Indices[TriangleIndex * 3 + Corner];
+				const FVector3f Projected = View.Project(Geometry.GetPosition(VertexIndex));
+				bBehindCamera |= View.bPerspective && Projected.Z + View.CameraDistance <= 0.f;
+
+				Positions[Corner] = FVector2f(Projected.X, Projected.Y) * RasterSize;
+				UVs[Corner] = Geometry.UVs[VertexIndex];
+			}
+
+			if (bBehindCamera)
+			{
+				continue;
+			}
+
+			if (SingleSidedMaterials &&
+				SingleSidedMaterials->Contains(TriangleMaterials[TriangleIndex]))
+			{
+				const uint32 A = Geometry.Indices[TriangleIndex * 3 + 0];
+				const uint32 B = Geometry.Indices[TriangleIndex * 3 + 1];
+				const uint32 C = Geometry.Indices[TriangleIndex * 3 + 2];
+
+				// Winding is taken from vertex normals, so it doesn't depend on handedness of the mesh
+				FVector3f FaceNormal = FVector3f::CrossProduct(Geometry.GetPosition(B) - Geometry.GetPosition(A), Geometry.GetPosition(C) - Geometry.GetPosition(A));
+				if (FVector3f::DotProduct(FaceNormal, Geometry.Normals[A] + Geometry.Normals[B] + Geometry.Normals[C]) < 0.f)
+				{
+					FaceNormal = -FaceNormal;
+				}
+
+				if (!View.IsFacing(Geometry.GetPosition(A), FaceNormal))
+				{
+					continue;
+				}
+			}
+
+			const FImpostorOpacityMask* OpacityMask = bSampleOpacity ? OpacityMasks->Find(TriangleMaterials[TriangleIndex]) : nullptr;
+			if (OpacityMask)
+			{
+				RasterizeSampled(Positions, UVs, *OpacityMask, Mask);
+			}
+			else
+			{
+				RasterizeConservative(Positions[0], Positions[1], Positions[2], Mask);
+			}
+		}
+	});
+
+	ParallelFor(Views.Num(), [&](const int32 ViewIndex)
+	{
+		FImpostorCoverageMask Combined;
+		Combined.Init(RasterSize);
+		for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+		{
+			Combined.Union(ChunkMasks[ViewIndex * NumChunks + ChunkIndex]);
+		}
+
+		Result[ViewIndex] = Combined.Downsample(Size);
+	});
+
+	return Result;
+}
+
+void FImpostorRasterizer::RasterizeConservative(const FVector2f& A, const FVector2f& B, const FVector2f& C, FImpostorCoverageMask& Mask)
+{
+	const FVector2f Corners[3] = { A, B, C };
+	const float MinY = FMath::Min3(A.Y, B.Y, C.Y);
+	const float MaxY = FMath::Max3(A.Y, B.Y, C.Y);
+
+	const int32 StartY = FMath::Max(0, FMath::FloorToInt32(MinY));
+	const int32 EndY = FMath::Min(Mask.GetSize() - 1, FMath::CeilToInt32(MaxY) - 1);
+
+	for (int32 Y = StartY; Y <= EndY; Y++)
+	{
+		// Horizontal extent of triangle clipped to [Y, Y + 1] slab
+		const float SlabMin = Y;
+		const float SlabMax = Y + 1;
+
+		float MinX = FLT_MAX;
+		float MaxX = -FLT_MAX;
+
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			const FVector2f& Start = Corners[Corner];
+			const FVector2f& End = Corners[(Corner + 1) % 3];
+
+			if (Start.Y >= SlabMin &&
+				Start.Y <= SlabMax)
+			{
+				MinX = FMath::Min(MinX, Start.X);
+				MaxX = FMath::Max(MaxX, Start.X);
+			}
+
+			for (const float Border : { SlabMin, SlabMax })
+			{
+				if ((Start.Y - Border) * (End.Y - Border) < 0.f)
+				{
+					const float X = Start.X + (Border - Start.Y) / (End.Y - Start.Y) * (End.X - Start.X);
+					MinX = FMath::Min(MinX, X);
+					MaxX = FMath::Max(MaxX, X);
+				}
+			}
+		}
+
+		if (MinX > MaxX)
+		{
+			continue;
+		}
+
+		const int32 FirstCell = FMath::FloorToInt32(MinX);
+		Mask.SetSpan(Y, FirstCell, FMath::Max(FirstCell, FMath::CeilToInt32(MaxX) - 1));
+	}
+}
+
+void FImpostorRasterizer::RasterizeSampled(const FVector2f (&Positions)[3], const FVector2f (&UVs)[3], const FImpostorOpacityMask& OpacityMask, FImpostorCoverageMask& Mask)
+{
+	const FVector2f& A = Positions[0];
+	const FVector2f& B = Positions[1];
+	const FVector2f& C = Positions[2];
+
+	const float Area = FVector2f::CrossProduct(B - A, C - A);
+	if (FMath::IsNearlyZero(Area))
+	{
+		return;
+	}
+
+	const float MinY = FMath::Min3(A.Y, B.Y, C.Y);
+	const float MaxY = FMath::Max3(A.Y, B.Y, C.Y);
+
+	// Samples are taken at cell centers
+	const int32 StartY = FMath::Max(0, FMath::CeilToInt32(MinY - 0.5f));
+	const int32 EndY = FMath::Min(Mask.GetSize() - 1, FMath::FloorToInt32(MaxY - 0.5f));
+
+	for (int32 Y = StartY; Y <= EndY; Y++)
+	{
+		const float CenterY = Y + 0.5f;
+
+		float MinX = FLT_MAX;
+		float MaxX = -FLT_MAX;
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			const FVector2f& Start = Positions[Corner];
+			const FVector2f& End = Positions[(Corner + 1) % 3];
+			if ((Start.Y - CenterY) * (End.Y - CenterY) > 0.f ||
+				Start.Y == End.Y)
+			{
+				continue;
+			}
+
+			const float X = Start.X + (CenterY - Start.Y) / (End.Y - Start.Y) * (End.X - Start.X);
+			MinX = FMath::Min(MinX, X);
+			MaxX = FMath::Max(MaxX, X);
+		}
+
+		if (MinX > MaxX)
+		{
+			continue;
+		}
+
+		const int32 StartX = FMath::Max(0, FMath::CeilToInt32(MinX - 0.5f));
+		const int32 EndX = FMath::Min(Mask.GetSize() - 1, FMath::FloorToInt32(MaxX - 0.5f));
+
+		for (int32 X = StartX; X <= EndX; X++)
+		{
+			const FVector2f Sample(X + 0.5f, CenterY);
+			const float WeightB = FVector2f::CrossProduct(Sample - A, C - A) / Area;
+			const float WeightC = FVector2f::CrossProduct(B - A, Sample - A) / Area;
+			const float WeightA = 1.f - WeightB - WeightC;
+
+			if (OpacityMask.IsVisible(UVs[0] * WeightA + UVs[1] * WeightB + UVs[2] * WeightC))
+			{
+				Mask.Set(X, Y);
+			}
+		}
+	}
+}
+
+namespace ImpostorRasterizer
+{
+	constexpr int32 TileSize = 32;
+
+	// Edge I is opposite to vertex I, so normalized edge function is barycentric weight of that vertex
+	struct FTriangleSetup
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float InvArea;
+
+		// Depth key is linear in screen space, smaller is closer
+		float KeyA;
+		float KeyB;
+		float KeyC;
+
+		uint32 Vertices[3];
+		FIntRect Bounds;
+	};
+}
+
+TArray<FImpostorRasterizedFrame> FImpostorRasterizer::RasterizeFrames(const FImpostorMeshGeometry& Geometry, const TArray<FImpostorViewProjection>& Views, const int32 Size)
+{
+	TArray<FImpostorRasterizedFrame> Frames;
+	Frames.SetNum(Views.Num());
+
+	ParallelFor(Views.Num(), [&](const int32 ViewIndex)
+	{
+		RasterizeFrame(Geometry, Views[ViewIndex], Size, Frames[ViewIndex]);
+	});
+
+	return Frames;
+}
+
+void FImpostorRasterizer::RasterizeFrame(const FImpostorMeshGeometry& Geometry, const FImpostorViewProjection& View, const int32 Size, FImpostorRasterizedFrame& OutFrame)
+{
+	using namespace ImpostorRasterizer;
+
+	OutFrame.Size = Size;
+	OutFrame.Depths.Init(MAX_flt, Size * Size);
+	OutFrame.Normals.Init(FVector3f::ZeroVector, Size * Size);
+
+	if (Geometry.IsEmpty() ||
+		Size <= 0)
+	{
+		return;
+	}
+
+	// Project all vertices, 4 at a time
+	const int32 NumPadded = Geometry.PositionsX.Num();
+	TArray<float> ScreenX;
+	TArray<float> ScreenY;
+	TArray<float> Depths;
+	TArray<float> InvWs;
+	ScreenX.SetNumUninitialized(NumPadded);
+	ScreenY.SetNumUninitialized(NumPadded);
+	Depths.SetNumUninitialized(NumPadded);
+	InvWs.SetNumUninitialized(NumPadded);
+
+	{
+		const VectorRegister4Float XX = VectorSetFloat1(View.AxisX.X);
+		const VectorRegister4Float XY = VectorSetFloat1(View.AxisX.Y);
+		const VectorRegister4Float XZ = VectorSetFloat1(View.AxisX.Z);
+		const VectorRegister4Float XOffset = VectorSetFloat1(-FVector3f::DotProduct(View.Origin, View.AxisX));
+
+		const VectorRegister4Float YX = VectorSetFloat1(View.AxisY.X);
+		const VectorRegister4Float YY = VectorSetFloat1(View.AxisY.Y);
+		const VectorRegister4Float YZ = VectorSetFloat1(View.AxisY.Z);
+		const VectorRegister4Float YOffset = VectorSetFloat1(-FVector3f::DotProduct(View.Origin, View.AxisY));
+
+		const VectorRegister4Float ZX = VectorSetFloat1(View.AxisZ.X);
+		const VectorRegister4Float ZY = VectorSetFloat1(View.AxisZ.Y);
+		const VectorRegister4Float ZZ = VectorSetFloat1(View.AxisZ.Z);
+		const VectorRegister4Float ZOffset = VectorSetFloat1(-FVector3f::DotProduct(View.Origin, View.AxisZ));
+
+		const VectorRegister4Float HalfScaleSize = VectorSetFloat1(View.Scale * 0.5f * Size);
+		const VectorRegister4Float HalfSize = VectorSetFloat1(0.5f * Size);
+		const VectorRegister4Float CameraDistance = VectorSetFloat1(View.CameraDistance);
+
+		for (int32 Index = 0; Index < NumPadded; Index += 4)
+		{
+			const VectorRegister4Float PX = VectorLoad(&Geometry.PositionsX[Index]);
+			const VectorRegister4Float PY = VectorLoad(&Geometry.PositionsY[Index]);
+			const VectorRegister4Float PZ = VectorLoad(&Geometry.PositionsZ[Index]);
+
+			const VectorRegister4Float LocalX = VectorMultiplyAdd(PZ, XZ, VectorMultiplyAdd(PY, XY, VectorMultiplyAdd(PX, XX, XOffset)));
+			const VectorRegister4Float LocalY = VectorMultiplyAdd(PZ, YZ, VectorMultiplyAdd(PY, YY, VectorMultiplyAdd(PX, YX, YOffset)));
+			const VectorRegister4Float LocalZ = VectorMultiplyAdd(PZ, ZZ, VectorMultiplyAdd(PY, ZY, VectorMultiplyAdd(PX, ZX, ZOffset)));
+
+			const VectorRegister4Float InvW = View.bPerspective ? VectorReciprocalAccurate(VectorAdd(LocalZ, CameraDistance)) : VectorOneFloat();
+
+			VectorStore(VectorMultiplyAdd(VectorMultiply(LocalX, InvW), HalfScaleSize, HalfSize), &ScreenX[Index]);
+			VectorStore(VectorMultiplyAdd(VectorMultiply(LocalY, InvW), HalfScaleSize, HalfSize), &ScreenY[Index]);
+			VectorStore(LocalZ, &Depths[Index]);
+			VectorStore(InvW, &InvWs[Index]);
+		}
+	}
+
+	// Triangle setup and binning into tiles
+	const int32 NumTilesX = FMath::DivideAndRoundUp(Size, TileSize);
+	const int32 NumTiles = NumTilesX * NumTilesX;
+
+	TArray<FTriangleSetup> Triangles;
+	Triangles.Reserve(Geometry.Indices.Num() / 3);
+
+	TArray<TArray<int32>> TileTriangles;
+	TileTriangles.SetNum(NumTiles);
+
+	for (int32 TriangleIndex = 0; TriangleIndex < Geometry.Indices.Num() / 3; TriangleIndex++)
+	{
+		uint32 Vertices[3] = {
+			Geometry.Indices[TriangleIndex * 3 + 0],
+			Geometry.Indices[TriangleIndex * 3 + 1],
+			Geometry.Indices[TriangleIndex * 3 + 2]
+		};
+
+		if (View.bPerspective &&
+			(InvWs[Vertices[0]] <= 0.f || InvWs[Vertices[1]] <= 0.f || InvWs[Vertices[2]] <= 0.f))
+		{
+			continue;
+		}
+
+		float Area = (ScreenX[Vertices[1]] - ScreenX[Vertices[0]]) * (ScreenY[Vertices[2]] - ScreenY[Vertices[0]]) - (ScreenY[Vertices[1]] - ScreenY[Vertices[0]]) * (ScreenX[Vertices[2]] - ScreenX[Vertices[0]]);
+		if (FMath::Abs(Area) < UE_SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		// Both faces are rasterized, same as two sided materials
+		if (Area < 0.f)
+		{
+			Swap(Vertices[1], Vertices[2]);
+			Area = -Area;
+		}
+
+		const FVector2f P[3] = {
+			FVector2f(ScreenX[Vertices[0]], ScreenY[Vertices[0]]),
+			FVector2f(ScreenX[Vertices[1]], ScreenY[Vertices[1]]),
+			FVector2f(ScreenX[Vertices[2]], ScreenY[Vertices[2]])
+		};
+
+		FIntRect Bounds(
+			FMath::FloorToInt32(FMath::Min3(P[0].X, P[1].X, P[2].X)),
+			FMath::FloorToInt32(FMath::Min3(P[0].Y, P[1].Y, P[2].Y)),
+			FMath::CeilToInt32(FMath::Max3(P[0].X, P[1].X, P[2].X)),
+			FMath::CeilToInt32(FMath::Max3(P[0].Y, P[1].Y, P[2].Y)));
+		Bounds.Clip(FIntRect(0, 0, Size, Size));
+		if (Bounds.IsEmpty())
+		{
+			continue;
+		}
+
+		FTriangleSetup& Setup = Triangles.AddDefaulted_GetRef();
+		Setup.InvArea = 1.f / Area;
+		Setup.KeyA = Setup.KeyB = Setup.KeyC = 0.f;
+
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			const FVector2f& Start = P[(Corner + 1) % 3];
+			const FVector2f& End = P[(Corner + 2) % 3];
+
+			Setup.EdgeA[Corner] = Start.Y - End.Y;
+			Setup.EdgeB[Corner] = End.X - Start.X;
+			Setup.EdgeC[Corner] = -(Setup.EdgeA[Corner] * Start.X + Setup.EdgeB[Corner] * Start.Y);
+			Setup.Vertices[Corner] = Vertices[Corner];
+
+			// Orthographic depth and perspective 1/w are both linear in screen space
+			const float Key = (View.bPerspective ? -InvWs[Vertices[Corner]] : Depths[Vertices[Corner]]) * Setup.InvArea;
+			Setup.KeyA += Key * Setup.EdgeA[Corner];
+			Setup.KeyB += Key * Setup.EdgeB[Corner];
+			Setup.KeyC += Key * Setup.EdgeC[Corner];
+		}
+		Setup.Bounds = Bounds;
+
+		for (int32 TileY = Bounds.Min.Y / TileSize; TileY <= (Bounds.Max.Y - 1) / TileSize; TileY++)
+		{
+			for (int32 TileX = Bounds.Min.X / TileSize; TileX <= (Bounds.Max.X - 1) / TileSize; TileX++)
+			{
+				TileTriangles[TileY * NumTilesX + TileX].Add(Triangles.Num() - 1);
+			}
+		}
+	}
+
+	ParallelFor(NumTiles, [&](const int32 TileIndex)
+	{
+		const TArray<int32>& Bin = TileTriangles[TileIndex];
+		if (Bin.Num() == 0)
+		{
+			return;
+		}
+
+		const FIntPoint TileMin(TileIndex % NumTilesX * TileSize, TileIndex / NumTilesX * TileSize);
+		const FIntRect TileRect(TileMin, FIntPoint(FMath::Min(TileMin.X + TileSize, Size), FMath::Min(TileMin.Y + TileSize, Size)));
+
+		alignas(16) float Keys[TileSize * TileSize];
+		int32 Visible[TileSize * TileSize];
+		for (int32 Index = 0; Index < TileSize * TileSize; Index++)
+		{
+			Keys[Index] = MAX_flt;
+			Visible[Index] = INDEX_NONE;
+		}
+
+		const VectorRegister4Float LaneOffsets = MakeVectorRegisterFloat(0.5f, 1.5f, 2.5f, 3.5f);
+		const VectorRegister4Float FrameSize = VectorSetFloat1(float(Size));
+
+		for (const int32 SetupIndex : Bin)
+		{
+			const FTriangleSetup& Setup = Triangles[SetupIndex];
+
+			FIntRect Rect = Setup.Bounds;
+			Rect.Clip(TileRect);
+			if (Rect.IsEmpty())
+			{
+				continue;
+			}
+
+			// Rows are processed in aligned 4 pixel groups
+			const int32 StartX = TileMin.X + (Rect.Min.X - TileMin.X) / 4 * 4;
+
+			const VectorRegister4Float A0 = VectorSetFloat1(Setup.EdgeA[0]);
+			const VectorRegister4Float A1 = VectorSetFloat1(Setup.EdgeA[1]);
+			const VectorRegister4Float A2 = VectorSetFloat1(Setup.EdgeA[2]);
+			const VectorRegister4Float KeyA = VectorSetFloat1(Setup.KeyA);
+
+			for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; Y++)
+			{
+				const float CenterY = Y + 0.5f;
+				const VectorRegister4Float Row0 = VectorSetFloat1(Setup.EdgeB[0] * CenterY + Setup.EdgeC[0]);
+				const VectorRegister4Float Row1 = VectorSetFloat1(Setup.EdgeB[1] * CenterY + Setup.EdgeC[1]);
+				const VectorRegister4Float Row2 = VectorSetFloat1(Setup.EdgeB[2] * CenterY + Setup.EdgeC[2]);
+				const VectorRegister4Float RowKey = VectorSetFloat1(Setup.KeyB * CenterY + Setup.KeyC);
+
+				for (int32 X = StartX; X < Rect.Max.X; X += 4)
+				{
+					const VectorRegister4Float CenterX = VectorAdd(VectorSetFloat1(float(X)), LaneOffsets);
+
+					const VectorRegister4Float Edge0 = VectorMultiplyAdd(A0, CenterX, Row0);
+					const VectorRegister4Float Edge1 = VectorMultiplyAdd(A1, CenterX, Row1);
+					const VectorRegister4Float Edge2 = VectorMultiplyAdd(A2, CenterX, Row2);
+					const VectorRegister4Float Key = VectorMultiplyAdd(KeyA, CenterX, RowKey);
+
+					float* TileKeys = &Keys[(Y - TileMin.Y) * TileSize + (X - TileMin.X)];
+					const VectorRegister4Float OldKey = VectorLoadAligned(TileKeys);
+
+					VectorRegister4Float Mask = VectorBitwiseAnd(VectorCompareGE(Edge0, VectorZeroFloat()), VectorCompareGE(Edge1, VectorZeroFloat()));
+					Mask = VectorBitwiseAnd(Mask, VectorCompareGE(Edge2, VectorZeroFloat()));
+					Mask = VectorBitwiseAnd(Mask, VectorCompareLT(CenterX, FrameSize));
+					Mask = VectorBitwiseAnd(Mask, VectorCompareLT(Key, OldKey));
+
+					const int32 Lanes = VectorMaskBits(Mask);
+					if (Lanes == 0)
+					{
+						continue;
+					}
+
+					VectorStoreAligned(VectorSelect(Mask, Key, OldKey), TileKeys);
+
+					int32* TileVisible = &Visible[(Y - TileMin.Y) * TileSize + (X - TileMin.X)];
+					for (int32 Lane = 0; Lane < 4; Lane++)
+					{
+						if (Lanes & (1 << Lane))
+						{
+							TileVisible[Lane] = SetupIndex;
+						}
+					}
+				}
+			}
+		}
+
+		// Attributes are resolved once per pixel, only for the visible triangle
+		for (int32 Y = TileRect.Min.Y; Y < TileRect.Max.Y; Y++)
+		{
+			for (int32 X = TileRect.Min.X; X < TileRect.Max.X; X++)
+			{
+				const int32 SetupIndex = Visible[(Y - TileMin.Y) * TileSize + (X - TileMin.X)];
+				if (SetupIndex == INDEX_NONE)
+				{
+					continue;
+				}
+
+				const FTriangleSetup& Setup = Triangles[SetupIndex];
+				const FVector2f Center(X + 0.5f, Y + 0.5f);
+
+				float Weights[3];
+				float WeightsSum = 0.f;
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					// Perspective correct weights
+					Weights[Corner] = (Setup.EdgeA[Corner] * Center.X + Setup.EdgeB[Corner] * Center.Y + Setup.EdgeC[Corner]) * Setup.InvArea * InvWs[Setup.Vertices[Corner]];
+					WeightsSum += Weights[Corner];
+				}
+
+				float Depth = 0.f;
+				FVector3f Normal = FVector3f::ZeroVector;
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const float Weight = Weights[Corner] / WeightsSum;
+					Depth += Depths[Setup.Vertices[Corner]] * Weight;
+					Normal += Geometry.Normals[Setup.Vertices[Corner]] * Weight;
+				}
+
+				OutFrame.Depths[Y * Size + X] = Depth;
+				OutFrame.Normals[Y * Size + X] = Normal.GetSafeNormal();
+			}
+		}
+	});
+}
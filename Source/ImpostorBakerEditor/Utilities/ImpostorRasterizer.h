@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include <Camera/CameraTypes.h>
+
+class UMaterialInterface;
+struct FImpostorMeshGeometry;
+
+// Projection of a single capture view, matching scene capture placement and framing
+struct FImpostorViewProjection
+{
+public:
+	FImpostorViewProjection() = default;
+	FImpostorViewProjection(const FVector& ViewVector, const FVector& Origin, float Radius, ECameraProjectionMode::Type ProjectionType, float CameraDistance, float CameraFOV);
+
+	// Returns position in frame space: XY in [0, 1] range (Y goes down), Z is depth along the view direction
+	FVector3f Project(const FVector3f& Position) const;
+	// Whether surface at Position with Normal faces the capture camera
+	bool IsFacing(const FVector3f& Position, const FVector3f& Normal) const;
+
+public:
+	FVector3f Origin = FVector3f::ZeroVector;
+	FVector3f AxisX = FVector3f::ZeroVector;
+	FVector3f AxisY = FVector3f::ZeroVector;
+	FVector3f AxisZ = FVector3f::ZeroVector;
+
+	bool bPerspective = false;
+	float CameraDistance = 0.f;
+	// Orthographic: 1 / Radius, perspective: 1 / tan(FOV / 2)
+	float Scale = 0.f;
+};
+
+// Square bit grid, rows are packed into 64 bit words
+struct FImpostorCoverageMask
+{
+public:
+	void Init(int32 NewSize);
+
+	int32 GetSize() const
+	{
+		return Size;
+	}
+
+	bool Get(const int32 X, const int32 Y) const
+	{
+		return (Words[Y * WordsPerRow + X / 64] >> (X % 64)) & 1;
+	}
+
+	void Set(const int32 X, const int32 Y)
+	{
+		Words[Y * WordsPerRow + X / 64] |= uint64(1) << (X % 64);
+	}
+
+	// Sets all bits in [MinX, MaxX] range
+	void SetSpan(int32 Y, int32 MinX, int32 MaxX);
+	void Union(const FImpostorCoverageMask& Other);
+	bool IsEmpty() const;
+
+	// Each result bit is set if any bit in its source block is set
+	FImpostorCoverageMask Downsample(int32 NewSize) const;
+
+private:
+	int32 Size = 0;
+	int32 WordsPerRow = 0;
+	TArray<uint64> Words;
+};
+
+// Opacity mask texture of masked material, read from texture source data
+struct FImpostorOpacityMask
+{
+public:
+	static bool Create(const UMaterialInterface* Material, FImpostorOpacityMask& OutMask);
+
+	bool IsVisible(const FVector2f& UV) const;
+
+public:
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	TArray<uint8> Values;
+	float ClipValue = 0.333f;
+};
+
+// Single view rasterized from mesh geometry. Uncovered pixels have depth of MAX_flt.
+struct FImpostorRasterizedFrame
+{
+public:
+	bool IsCovered(const int32 X, const int32 Y) const
+	{
+		return Depths[Y * Size + X] != MAX_flt;
+	}
+
+public:
+	int32 Size = 0;
+	// Distance from projection origin along view axis, dot(Position - Origin, AxisZ)
+	TArray<float> Depths;
+	// Interpolated vertex normals, in mesh space
+	TArray<FVector3f> Normals;
+};
+
+// Multithreaded CPU rasterizers, which produce impostor data from mesh geometry without capturing the scene
+class FImpostorRasterizer
+{
+public:
+	// Rasterizes mesh into Size x Size coverage mask for every view.
+	// Cells are conservatively covered, if any triangle touches them.
+	// If opacity masks are provided (per material index), these sections are sampled Supersample times per cell axis and alpha tested instead.
+	// Triangles of single sided materials (per material index) are skipped, if they face away from the view.
+	static TArray<FImpostorCoverageMask> RasterizeCoverage(
+		const FImpostorMeshGeometry& Geometry,
+		const TArray<FImpostorViewProjection>& Views,
+		int32 Size,
+		const TMap<int32, FImpostorOpacityMask>* OpacityMasks = nullptr,
+		int32 Supersample = 8,
+		const TSet<int32>* SingleSidedMaterials = nullptr);
+
+	// Tiled depth buffered rasterizer with 4 wide SIMD edge and depth tests.
+	// Views are rasterized in parallel, as well as tiles of every view.
+	static TArray<FImpostorRasterizedFrame> RasterizeFrames(const FImpostorMeshGeometry& Geometry, const TArray<FImpostorViewProjection>& Views, int32 Size);
+
+private:
+	static void RasterizeFrame(const FImpostorMeshGeometry& Geometry, const FImpostorViewProjection& View, int32 Size, FImpostorRasterizedFrame& OutFrame);
+	static void RasterizeConservative(const FVector2f& A, const FVector2f& B, const FVector2f& C, FImpostorCoverageMask& Mask);
+	static void RasterizeSampled(const FVector2f (&Positions)[3], const FVector2f (&UVs)[3], const FImpostorOpacityMask& OpacityMask, FImpostorCoverageMask& Mask);
+};
@@ -0,0 +1,359 @@
+﻿#include "ImpostorRenderer.h"
+#include <Async/ParallelFor.h>
+#include <Engine/StaticMesh.h>
+#include <Engine/Texture2D.h>
+#include <HAL/IConsoleManager.h>
+#include <Math/RandomStream.h>
+#include <Misc/Paths.h>
+#include "ImpostorBakerUtilities.h"
+#include "ImpostorFrameOrder.h"
+#include "ImpostorMeshGeometry.h"
+#include "ImpostorNormalEncoding.h"
+#include "ImpostorData/ImpostorData.h"
+
+namespace ImpostorRenderer
+{
+	// Bilinear sample in [0, 1] range, clamped to frame rectangle so neighbor frames don't bleed in
+	FVector4f SampleFrame(const FImpostorImage& Image, const FIntRect& Rect, const FVector2f& UV)
+	{
+		const float X = FMath::Clamp(UV.X * Rect.Width() - 0.5f, 0.f, Rect.Width() - 1.f);
+		const float Y = FMath::Clamp(UV.Y * Rect.Height() - 0.5f, 0.f, Rect.Height() - 1.f);
+
+		const int32 X0 = FMath::FloorToInt32(X);
+		const int32 Y0 = FMath::FloorToInt32(Y);
+		const int32 X1 = FMath::Min(X0 + 1, Rect.Width() - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, Rect.Height() - 1);
+
+		const auto Fetch = [&](const int32 PixelX, const int32 PixelY)
+		{
+			const FColor& Color = Image.GetPixel(Rect.Min.X + PixelX, Rect.Min.Y + PixelY);
+			return FVector4f(Color.R, Color.G, Color.B, Color.A) / 255.f;
+		};
+
+		const float FracX = X - X0;
+		const float FracY = Y - Y0;
+		return FMath::Lerp(
+			FMath::Lerp(Fetch(X0, Y0), Fetch(X1, Y0), FracX),
+			FMath::Lerp(Fetch(X0, Y1), Fetch(X1, Y1), FracX),
+			FracY);
+	}
+
+	FColor EncodeNormal(const FVector3f& Normal, const uint8 Alpha)
+	{
+		FColor Color = FLinearColor(Normal.GetSafeNormal() * 0.5f + 0.5f).QuantizeRound();
+		Color.A = Alpha;
+		return Color;
+	}
+
+	FAutoConsoleCommandWithWorldArgsAndOutputDevice RenderCommand(
+		TEXT("ImpostorBaker.RenderImpostor"),
+		TEXT("Renders saved impostor and its referenced mesh on CPU from random directions into Saved/ImpostorBaker/Render. Arguments: ImpostorData object path, optional number of directions and image size."),
+		FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+		{
+			const UImpostorData* ImpostorData = Args.Num() > 0 ? LoadObject<UImpostorData>(nullptr, *Args[0]) : nullptr;
+			if (!ImpostorData)
+			{
+				Ar.Logf(TEXT("ImpostorData wasn't found. Usage: ImpostorBaker.RenderImpostor /Game/Path/ImpostorData [NumDirections] [Size]"));
+				return;
+			}
+
+			FImpostorRenderSource Source;
+			if (!FImpostorRenderSource::Create(*ImpostorData, Source))
+			{
+				Ar.Logf(TEXT("%s: saved (hemi)octahedral impostor with Base Color texture is required"), *ImpostorData->GetName());
+				return;
+			}
+
+			const int32 NumDirections = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 16, 1);
+			const int32 Size = FMath::Clamp(Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 256, 8, 4096);
+			const TArray<FVector> Directions = FImpostorRenderer::MakeTestDirections(NumDirections, ImpostorData->ImpostorType == EImpostorLayoutType::UpperHemisphereOnly);
+
+			const double StartTime = FPlatformTime::Seconds();
+			const TArray<FImpostorRenderedView> ImpostorViews = FImpostorRenderer::RenderImpostor(Source, Directions, Size);
+			const double ImpostorTime = FPlatformTime::Seconds() - StartTime;
+
+			const TArray<FImpostorRenderedView> MeshViews = FImpostorRenderer::RenderMesh(FImpostorMeshGeometry::Gather(ImpostorData->ReferencedMesh), Source.Origin, Source.Radius, Directions, Size);
+			const double MeshTime = FPlatformTime::Seconds() - StartTime - ImpostorTime;
+
+			const FString Directory = FPaths::ProjectSavedDir() / "ImpostorBaker" / "Render" / ImpostorData->NewTextureName;
+			for (int32 Index = 0; Index < Directions.Num(); Index++)
+			{
+				const FString Prefix = Directory / FString::Printf(TEXT("View%03d_"), Index);
+				ImpostorViews[Index].Color.SaveToFile(Prefix + "Impostor_Color.png");
+				ImpostorViews[Index].Normal.SaveToFile(Prefix + "Impostor_Normal.png");
+				MeshViews[Index].Normal.SaveToFile(Prefix + "Mesh_Normal.png");
+			}
+
+			Ar.Logf(TEXT("Rendered %d views of %dx%d: impostor %.1f ms, mesh %.1f ms. Images are saved to %s"), Directions.Num(), Size, Size, ImpostorTime * 1000.0, MeshTime * 1000.0, *Directory);
+		}));
+}
+
+bool FImpostorRenderSource::Create(const UImpostorData& ImpostorData, FImpostorRenderSource& OutSource)
+{
+	if (!OutSource.InitLayout(ImpostorData))
+	{
+		return false;
+	}
+
+	if (!OutSource.BaseColor.ReadFromTextureSource(ImpostorData.LoadSavedTexture(EImpostorBakeMapType::BaseColor)))
+	{
+		return false;
+	}
+
+	// Missing normals and depth only disable shading comparison and parallax
+	if (OutSource.Normal.ReadFromTextureSource(ImpostorData.LoadSavedTexture(EImpostorBakeMapType::Normal)) &&
+		ImpostorData.NormalEncoding == EImpostorNormalEncoding::Octahedral)
+	{
+		FImpostorNormalEncoding::DecodeOctahedral(OutSource.Normal);
+	}
+
+	OutSource.bDepthInNormalAlpha = ImpostorData.CombinesNormalAndDepth();
+
+	if (!OutSource.bDepthInNormalAlpha)
+	{
+		OutSource.Depth.ReadFromTextureSource(ImpostorData.LoadSavedTexture(EImpostorBakeMapType::Depth));
+	}
+
+	return true;
+}
+
+bool FImpostorRenderSource::InitLayout(const UImpostorData& ImpostorData)
+{
+	if (ImpostorData.ImpostorType == EImpostorLayoutType::TraditionalBillboards ||
+		!ImpostorData.ReferencedMesh)
+	{
+		return false;
+	}
+
+	NumHorizontalFrames = NumVerticalFrames = ImpostorData.FramesCount;
+	FrameAlignment = ImpostorData.GetFrameAlignment();
+	FrameOrder = ImpostorData.GetFrameOrder();
+	ViewVectors = FImpostorViewDistribution::MakeViewVectors(ImpostorData);
+	Distribution = FImpostorViewDistribution::Create(ImpostorData, ViewVectors);
+
+	// Same as components manager bounds, but in mesh space
+	const FBoxSphereBounds Bounds = ImpostorData.ReferencedMesh->GetBounds();
+	const FVector2D Offset = ImpostorData.GetMeshOffset();
+	Origin = Bounds.Origin - FVector(Offset.X, Offset.Y, 0.f);
+	Radius = ImpostorData.ProjectionRadius > 0.f ? ImpostorData.ProjectionRadius : Bounds.SphereRadius + Offset.GetAbsMax();
+
+	ProjectionType = ImpostorData.ProjectionType;
+	CameraDistance = ImpostorData.CameraDistance;
+	CameraFOV = ImpostorData.CameraFOV;
+
+	return !Distribution.IsEmpty();
+}
+
+FImpostorViewProjection FImpostorRenderSource::GetViewProjection(const int32 ViewIndex) const
+{
+	return FImpostorViewProjection(ViewVectors[ViewIndex], Origin, Radius, ProjectionType, CameraDistance, CameraFOV);
+}
+
+FIntRect FImpostorRenderSource::GetFrameRect(const int32 ViewIndex, const FIntPoint& AtlasSize) const
+{
+	const FVector2D FrameSize(
+		FImpostorBakerUtilities::GetFramePitch(AtlasSize.X, NumHorizontalFrames, FrameAlignment),
+		FImpostorBakerUtilities::GetFramePitch(AtlasSize.Y, NumVerticalFrames, FrameAlignment));
+	const int32 Slot = FImpostorFrameOrder::GetSlot(FrameOrder, ViewIndex, NumHorizontalFrames);
+	const FIntPoint Min(FMath::FloorToInt32(FrameSize.X * (Slot % NumHorizontalFrames)), FMath::FloorToInt32(FrameSize.Y * (Slot / NumHorizontalFrames)));
+
+	return FIntRect(Min, Min + FIntPoint(FMath::FloorToInt32(FrameSize.X), FMath::FloorToInt32(FrameSize.Y)));
+}
+
+FImpostorViewProjection FImpostorRenderer::GetCamera(const FVector& Direction, const FVector& Origin, const float Radius)
+{
+	return FImpostorViewProjection(Direction, Origin, Radius, ECameraProjectionMode::Orthographic, 0.f, 0.f);
+}
+
+TArray<FImpostorRenderedView> FImpostorRenderer::RenderImpostor(const FImpostorRenderSource& Source, const TArray<FVector>& Directions, const int32 Size, const float ClipValue)
+{
+	TArray<FImpostorRenderedView> Views;
+	Views.SetNum(Directions.Num());
+
+	ParallelFor(Directions.Num(), [&](const int32 Index)
+	{
+		RenderImpostorView(Source, Directions[Index], Size, ClipValue, Views[Index]);
+	});
+
+	return Views;
+}
+
+void FImpostorRenderer::RenderImpostorView(const FImpostorRenderSource& Source, const FVector& Direction, const int32 Size, const float ClipValue, FImpostorRenderedView& OutView)
+{
+	OutView.Direction = Direction;
+	OutView.Color.Init(Size, Size);
+	OutView.Normal.Init(Size, Size);
+
+	FIntVector Views;
+	FVector3f Weights;
+	if (Source.BaseColor.IsEmpty() ||
+		!Source.Distribution.FindViews(FVector3f(Direction.GetSafeNormal()), Views, Weights))
+	{
+		return;
+	}
+
+	const FImpostorViewProjection Camera = GetCamera(Direction, Source.Origin, Source.Radius);
+	const FImpostorImage& DepthImage = Source.bDepthInNormalAlpha ? Source.Normal : Source.Depth;
+	const int32 DepthChannel = Source.bDepthInNormalAlpha ? 3 : 0;
+	const bool bHasDepth = Source.HasDepth();
+	const bool bHasNormal = !Source.Normal.IsEmpty();
+
+	struct FFrame
+	{
+		FImpostorViewProjection Projection;
+		FIntRect ColorRect;
+		FIntRect NormalRect;
+		FIntRect DepthRect;
+		float Weight = 0.f;
+		// Cosine between camera and frame view axes, ray distance per unit of frame depth
+		float Cosine = 0.f;
+	};
+
+	TArray<FFrame, TInlineAllocator<3>> Frames;
+	for (int32 Corner = 0; Corner < 3; Corner++)
+	{
+		const int32 ViewIndex = Views[Corner];
+		if (Weights[Corner] <= 0.f ||
+			!Source.ViewVectors.IsValidIndex(ViewIndex))
+		{
+			continue;
+		}
+
+		FFrame& Frame = Frames.AddDefaulted_GetRef();
+		Frame.Projection = Source.GetViewProjection(ViewIndex);
+		Frame.ColorRect = Source.GetFrameRect(ViewIndex, Source.BaseColor.GetSize());
+		Frame.NormalRect = bHasNormal ? Source.GetFrameRect(ViewIndex, Source.Normal.GetSize()) : FIntRect();
+		Frame.DepthRect = bHasDepth ? Source.GetFrameRect(ViewIndex, DepthImage.GetSize()) : FIntRect();
+		Frame.Weight = Weights[Corner];
+		Frame.Cosine = FVector3f::DotProduct(Camera.AxisZ, Frame.Projection.AxisZ);
+
+		// Frames facing away can't be intersected by camera rays
+		if (Frame.Cosine < UE_KINDA_SMALL_NUMBER)
+		{
+			Frames.Pop();
+		}
+	}
+
+	for (int32 Y = 0; Y < Size; Y++)
+	{
+		for (int32 X = 0; X < Size; X++)
+		{
+			const FVector3f RayStart = Camera.Origin + (Camera.AxisX * ((X + 0.5f) / Size * 2.f - 1.f) + Camera.AxisY * ((Y + 0.5f) / Size * 2.f - 1.f)) * Source.Radius;
+
+			FVector4f Color = FVector4f::Zero();
+			FVector3f Normal = FVector3f::ZeroVector;
+			float TotalWeight = 0.f;
+
+			for (const FFrame& Frame : Frames)
+			{
+				// Ray hits plane at Depth along frame view axis
+				const auto Intersect = [&](const float Depth)
+				{
+					const float Distance = (Depth - FVector3f::DotProduct(RayStart - Frame.Projection.Origin, Frame.Projection.AxisZ)) / Frame.Cosine;
+					const FVector3f Projected = Frame.Projection.Project(RayStart + Camera.AxisZ * Distance);
+					return FVector2f(Projected.X, Projected.Y);
+				};
+
+				FVector2f UV = Intersect(0.f);
+
+				// Single parallax step, ray is intersected again with the plane of depth sampled at first intersection
+				if (bHasDepth)
+				{
+					const float EncodedDepth = ImpostorRenderer::SampleFrame(DepthImage, Frame.DepthRect, UV)[DepthChannel];
+					UV = Intersect((0.5f - EncodedDepth) * 2.f * Source.Radius);
+				}
+
+				if (UV.X < 0.f || UV.X > 1.f ||
+					UV.Y < 0.f || UV.Y > 1.f)
+				{
+					continue;
+				}
+
+				Color += ImpostorRenderer::SampleFrame(Source.BaseColor, Frame.ColorRect, UV) * Frame.Weight;
+				if (bHasNormal)
+				{
+					const FVector4f EncodedNormal = ImpostorRenderer::SampleFrame(Source.Normal, Frame.NormalRect, UV);
+					// Blended like color, so frames with small weights don't pull the normal as much as the dominant one
+					Normal += (FVector3f(EncodedNormal.X, EncodedNormal.Y, EncodedNormal.Z) * 2.f - 1.f) * Frame.Weight;
+				}
+				TotalWeight += Frame.Weight;
+			}
+
+			if (TotalWeight <= 0.f)
+			{
+				continue;
+			}
+
+			// Frames outside of their rectangles are transparent
+			const float Alpha = Color.W;
+			if (Alpha < ClipValue)
+			{
+				continue;
+			}
+
+			Color /= TotalWeight;
+			OutView.Color.GetPixel(X, Y) = FLinearColor(Color.X, Color.Y, Color.Z, 1.f).QuantizeRound();
+			OutView.Normal.GetPixel(X, Y) = ImpostorRenderer::EncodeNormal(bHasNormal ? Normal : -Camera.AxisZ, 255);
+		}
+	}
+}
+
+TArray<FImpostorRenderedView> FImpostorRenderer::RenderMesh(const FImpostorMeshGeometry& Geometry, const FVector& Origin, const float Radius, const TArray<FVector>& Directions, const int32 Size)
+{
+	TArray<FImpostorViewProjection> Cameras;
+	for (const FVector& Direction : Directions)
+	{
+		Cameras.Add(GetCamera(Direction, Origin, Radius));
+	}
+
+	const TArray<FImpostorRasterizedFrame> Frames = FImpostorRasterizer::RasterizeFrames(Geometry, Cameras, Size);
+
+	TArray<FImpostorRenderedView> Views;
+	Views.SetNum(Directions.Num());
+
+	ParallelFor(Directions.Num(), [&](const int32 Index)
+	{
+		FImpostorRenderedView& View = Views[Index];
+		View.Direction = Directions[Index];
+		View.Normal.Init(Size, Size);
+
+		if (!Frames.IsValidIndex(Index) ||
+			Frames[Index].Size != Size)
+		{
+			return;
+		}
+
+		for (int32 Y = 0; Y < Size; Y++)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				if (Frames[Index].IsCovered(X, Y))
+				{
+					View.Normal.GetPixel(X, Y) = ImpostorRenderer::EncodeNormal(Frames[Index].Normals[Y * Size + X], 255);
+				}
+			}
+		}
+	});
+
+	return Views;
+}
+
+TArray<FVector> FImpostorRenderer::MakeTestDirections(const int32 NumDirections, const bool bHemisphere, const int32 Seed)
+{
+	FRandomStream RandomStream(Seed);
+
+	TArray<FVector> Directions;
+	Directions.Reserve(NumDirections);
+
+	for (int32 Index = 0; Index < NumDirections; Index++)
+	{
+		FVector Direction = RandomStream.VRand();
+		if (bHemisphere)
+		{
+			Direction.Z = FMath::Abs(Direction.Z);
+		}
+		Directions.Add(Direction);
+	}
+
+	return Directions;
+}
@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+#include <Camera/CameraTypes.h>
+#include "ImpostorImage.h"
+#include "ImpostorRasterizer.h"
+#include "ImpostorViewDistribution.h"
+
+class UImpostorData;
+struct FImpostorMeshGeometry;
+enum class EImpostorFrameOrder;
+
+// Baked (hemi)octahedral impostor maps and the layout they were captured with
+struct FImpostorRenderSource
+{
+public:
+	// Reads maps saved for ImpostorData from their texture source data, so no RHI is needed
+	static bool Create(const UImpostorData& ImpostorData, FImpostorRenderSource& OutSource);
+
+	// Layout and projection of ImpostorData, maps have to be filled separately
+	bool InitLayout(const UImpostorData& ImpostorData);
+
+	FImpostorViewProjection GetViewProjection(int32 ViewIndex) const;
+
+	// Pixel rectangle of single frame in atlas of AtlasSize, same placement as frames drawn by the baker
+	FIntRect GetFrameRect(int32 ViewIndex, const FIntPoint& AtlasSize) const;
+
+	bool HasDepth() const
+	{
+		return bDepthInNormalAlpha ? !Normal.IsEmpty() : !Depth.IsEmpty();
+	}
+
+public:
+	// Alpha is frame opacity
+	FImpostorImage BaseColor;
+	// Mesh space normals, encoded into [0, 1] range
+	FImpostorImage Normal;
+	// Depth encoded as 0.5 - Depth * 0.5 / Radius in red channel (or Normal alpha)
+	FImpostorImage Depth;
+	bool bDepthInNormalAlpha = false;
+
+	int32 NumHorizontalFrames = 0;
+	int32 NumVerticalFrames = 0;
+	int32 FrameAlignment = 1;
+	EImpostorFrameOrder FrameOrder = {};
+	TArray<FVector> ViewVectors;
+	FImpostorViewDistribution Distribution;
+
+	// Projection origin and radius, in referenced mesh space
+	FVector Origin = FVector::ZeroVector;
+	float Radius = 0.f;
+
+	ECameraProjectionMode::Type ProjectionType = ECameraProjectionMode::Orthographic;
+	float CameraDistance = 0.f;
+	float CameraFOV = 0.f;
+};
+
+// Image of impostor or mesh, seen from Direction with orthographic camera framing the projection radius
+struct FImpostorRenderedView
+{
+public:
+	FVector Direction = FVector::ZeroVector;
+	// Blended base color, alpha is 255 where pixel passed alpha test. Empty for mesh renders.
+	FImpostorImage Color;
+	// Encoded mesh space normals, alpha is 255 where pixel is covered
+	FImpostorImage Normal;
+};
+
+// Multithreaded CPU reference of impostor material, used to evaluate bakes without GPU.
+// Reproduces frame selection, three frame blend and single step depth parallax of the material.
+class FImpostorRenderer
+{
+public:
+	// Orthographic camera looking from Direction, pixel centers of Size x Size image are at (X + 0.5) / Size frame coordinates
+	static FImpostorViewProjection GetCamera(const FVector& Direction, const FVector& Origin, float Radius);
+
+	static TArray<FImpostorRenderedView> RenderImpostor(const FImpostorRenderSource& Source, const TArray<FVector>& Directions, int32 Size, float ClipValue = 0.5f);
+
+	// Normals and coverage of referenced mesh geometry, with the same cameras as RenderImpostor
+	static TArray<FImpostorRenderedView> RenderMesh(const FImpostorMeshGeometry& Geometry, const FVector& Origin, float Radius, const TArray<FVector>& Directions, int32 Size);
+
+	// Random directions, which don't match any captured view. Same Seed gives same directions.
+	static TArray<FVector> MakeTestDirections(int32 NumDirections, bool bHemisphere, int32 Seed = 0);
+
+private:
+	static void RenderImpostorView(const FImpostorRenderSource& Source, const FVector& Direction, int32 Size, float ClipValue, FImpostorRenderedView& OutView);
+};
@@ -0,0 +1,475 @@
+﻿#include "ImpostorSharedAtlas.h"
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <AssetToolsModule.h>
+#include <Components/StaticMeshComponent.h>
+#include <Editor.h>
+#include <Engine/StaticMesh.h>
+#include <Engine/Texture2D.h>
+#include <Factories/MaterialInstanceConstantFactoryNew.h>
+#include <MaterialShared.h>
+#include <Materials/MaterialFunction.h>
+#include <Materials/MaterialInstanceConstant.h>
+#include <UObject/UObjectIterator.h>
+#include "ImpostorBakerEditorModule.h"
+#include "ImpostorImage.h"
+#include "ImpostorMaterialFunction.h"
+#include "ImpostorData/ImpostorData.h"
+#include "Settings/ImpostorBakerSettings.h"
+
+namespace ImpostorSharedAtlas
+{
+	// Every map is packed in memory as FColor image, 8192 x 8192 takes 256 MB
+	constexpr int32 MaxAtlasSize = 8192;
+
+	// Parameters of MF_ImpostorSharedAtlas, read from custom primitive data
+	const TCHAR* ScaleOffsetParameter = TEXT("SharedAtlasScaleOffset");
+	const TCHAR* PivotSizeParameter = TEXT("SharedAtlasPivotSize");
+
+	bool HasVectorParameter(const UMaterialInterface* Material, const FName Name)
+	{
+		TMap<FMaterialParameterInfo, FMaterialParameterMetadata> Parameters;
+		Material->GetAllParametersOfType(EMaterialParameterType::Vector, Parameters);
+		for (const auto& [MaterialParameterInfo, MaterialParameterMetadata] : Parameters)
+		{
+			if (MaterialParameterInfo.Name == Name)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Slots of impostor material are switched to shared one, returns false if mesh doesn't use impostor material
+	bool ApplyMaterial(UStaticMesh* Mesh, const UMaterialInterface* ImpostorMaterial, UMaterialInterface* SharedMaterial)
+	{
+		TArray<FStaticMaterial>& Materials = Mesh->GetStaticMaterials();
+		if (!Materials.ContainsByPredicate([&](const FStaticMaterial& Material) { return Material.MaterialInterface == ImpostorMaterial; }))
+		{
+			return false;
+		}
+
+		Mesh->Modify();
+		for (FStaticMaterial& Material : Materials)
+		{
+			if (Material.MaterialInterface == ImpostorMaterial)
+			{
+				Material.MaterialInterface = SharedMaterial;
+			}
+		}
+		Mesh->PostEditChange();
+		Mesh->MarkPackageDirty();
+
+		return true;
+	}
+
+	// Custom primitive data is set on components of editor levels, which render the meshes. Returns number of updated components.
+	int32 ApplyPrimitiveData(const TArray<UStaticMesh*>& Meshes, const TArray<float>& PrimitiveData)
+	{
+		const int32 PrimitiveDataIndex = GetDefault<UImpostorBakerSettings>()->SharedAtlasPrimitiveDataIndex;
+
+		int32 NumComponents = 0;
+		for (TObjectIterator<UStaticMeshComponent> It; It; ++It)
+		{
+			UStaticMeshComponent* Component = *It;
+			const UWorld* World = Component->GetWorld();
+			if (!World ||
+				World->WorldType != EWorldType::Editor ||
+				!Meshes.Contains(Component->GetStaticMesh()))
+			{
+				continue;
+			}
+
+			Component->Modify();
+			Component->SetDefaultCustomPrimitiveDataVector4(PrimitiveDataIndex, FVector4(PrimitiveData[0], PrimitiveData[1], PrimitiveData[2], PrimitiveData[3]));
+			Component->SetDefaultCustomPrimitiveDataVector4(PrimitiveDataIndex + 4, FVector4(PrimitiveData[4], PrimitiveData[5], PrimitiveData[6], PrimitiveData[7]));
+			NumComponents++;
+		}
+
+		return NumComponents;
+	}
+
+	// Texture settings are copied from the first impostor texture of the same map
+	UTexture2D* SaveTexture(const FImpostorImage& Image, const UImpostorData& ImpostorData, const FString& AssetName, const UTexture2D* Template)
+	{
+		UPackage* TexturePackage = CreatePackage(*ImpostorData.GetPackageName(AssetName));
+		if (!ensure(TexturePackage))
+		{
+			return nullptr;
+		}
+
+		TexturePackage->FullyLoad(); // Make sure the destination package is loaded
+
+		bool bCreatingNewTexture = false;
+		UTexture2D* NewTexture = FindObject<UTexture2D>(TexturePackage, *AssetName);
+		if (!NewTexture)
+		{
+			bCreatingNewTexture = true;
+			NewTexture = NewObject<UTexture2D>(TexturePackage, *AssetName, RF_Public | RF_Standalone);
+		}
+
+		Image.WriteToTextureSource(NewTexture);
+
+		NewTexture->PreEditChange(nullptr);
+
+		NewTexture->MipGenSettings = Template->MipGenSettings;
+		NewTexture->SRGB = Template->SRGB;
+		NewTexture->CompressionSettings = Template->CompressionSettings;
+		NewTexture->LODGroup = Template->LODGroup;
+		NewTexture->NeverStream = Image.GetSize().GetMax() <= GetDefault<UImpostorBakerSettings>()->NeverStreamMaxSize;
+
+		NewTexture->UpdateResource();
+		NewTexture->PostEditChange();
+		NewTexture->MarkPackageDirty();
+
+		if (bCreatingNewTexture)
+		{
+			FAssetRegistryModule::AssetCreated(NewTexture);
+		}
+
+		return NewTexture;
+	}
+
+	// Parameters of the first impostor saved material are copied, its textures are replaced with shared ones.
+	// Frame arrays and depth range are baked per impostor and don't follow the atlas, so they are turned off.
+	UMaterialInstanceConstant* SaveMaterial(const UImpostorData& ImpostorData, const FString& AssetName, UMaterialInstanceConstant* Template, const TMap<EImpostorBakeMapType, UTexture2D*>& Textures)
+	{
+		const UImpostorBakerSettings* Settings = GetDefault<UImpostorBakerSettings>();
+
+		UPackage* MaterialInstancePackage = CreatePackage(*ImpostorData.GetPackageName(AssetName));
+		if (!ensure(MaterialInstancePackage))
+		{
+			return nullptr;
+		}
+
+		MaterialInstancePackage->FullyLoad(); // Make sure the destination package is loaded
+
+		FMaterialUpdateContext MaterialUpdateContext(FMaterialUpdateContext::EOptions::Default & ~FMaterialUpdateContext::EOptions::RecreateRenderStates);
+
+		UMaterialInstanceConstant* NewMaterial = FindObject<UMaterialInstanceConstant>(MaterialInstancePackage, *AssetName);
+		if (!NewMaterial)
+		{
+			UMaterialInstanceConstantFactoryNew* Factory = NewObject<UMaterialInstanceConstantFactoryNew>();
+			Factory->InitialParent = Template->Parent;
+
+			IAssetTools& AssetTools = FModuleManager::Get().LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+			NewMaterial = Cast<UMaterialInstanceConstant>(AssetTools.CreateAsset(AssetName, ImpostorData.SaveLocation.Path, UMaterialInstanceConstant::StaticClass(), Factory));
+			if (!ensure(NewMaterial))
+			{
+				return nullptr;
+			}
+		}
+		else if (NewMaterial->Parent != Template->Parent)
+		{
+			NewMaterial->SetParentEditorOnly(Template->Parent, true);
+		}
+
+		MaterialUpdateContext.AddMaterialInstance(NewMaterial);
+
+		NewMaterial->CopyMaterialUniformParametersEditorOnly(Template, true);
+
+		for (const auto& [ImpostorBakeMapType, Texture] : Textures)
+		{
+			NewMaterial->SetTextureParameterValueEditorOnly(Settings->ImpostorPreviewMapNames[ImpostorBakeMapType], Texture);
+		}
+
+		NewMaterial->SetStaticSwitchParameterValueEditorOnly(Settings->ImpostorFrameArraySwitch, false);
+		NewMaterial->SetStaticSwitchParameterValueEditorOnly(Settings->ImpostorDepthRangeSwitch, false);
+		NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorDepthRangeMin, 0.f);
+		NewMaterial->SetScalarParameterValueEditorOnly(Settings->ImpostorDepthRangeMax, 1.f);
+
+		// References to textures of the first impostor are dropped
+		NewMaterial->TextureParameterValues.RemoveAll([&](const FTextureParameterValue& Value)
+		{
+			return Value.ParameterInfo.Name == Settings->ImpostorDepthRange ||
+				Value.ParameterInfo.Name.ToString().EndsWith(Settings->ImpostorFrameArraySuffix);
+		});
+
+		NewMaterial->UpdateCachedData();
+		NewMaterial->PostEditChange();
+		NewMaterial->MarkPackageDirty();
+
+		return NewMaterial;
+	}
+}
+
+bool FImpostorSharedAtlas::Pack(const TArray<FIntPoint>& Sizes, const int32 MaxSize, int32& OutAtlasSize, TArray<FIntPoint>& OutOffsets)
+{
+	TArray<int32> Order;
+	int64 Area = 0;
+	int32 MaxDimension = 1;
+	for (int32 Index = 0; Index < Sizes.Num(); Index++)
+	{
+		Order.Add(Index);
+		Area += int64(Sizes[Index].X) * Sizes[Index].Y;
+		MaxDimension = FMath::Max(MaxDimension, Sizes[Index].GetMax());
+	}
+
+	Order.Sort([&](const int32 A, const int32 B)
+	{
+		return Sizes[A].Y != Sizes[B].Y ? Sizes[A].Y > Sizes[B].Y : Sizes[A].X > Sizes[B].X;
+	});
+
+	OutOffsets.SetNum(Sizes.Num());
+
+	const int32 MinSize = FMath::Max(FMath::CeilToInt32(FMath::Sqrt(double(Area))), MaxDimension);
+	for (int32 AtlasSize = FMath::RoundUpToPowerOfTwo(MinSize); AtlasSize <= MaxSize; AtlasSize *= 2)
+	{
+		FIntPoint Cursor = FIntPoint::ZeroValue;
+		int32 ShelfHeight = 0;
+		bool bFits = true;
+
+		for (const int32 Index : Order)
+		{
+			const FIntPoint& Size = Sizes[Index];
+			if (Cursor.X + Size.X > AtlasSize)
+			{
+				Cursor = FIntPoint(0, Cursor.Y + ShelfHeight);
+				ShelfHeight = 0;
+			}
+
+			if (Cursor.Y + Size.Y > AtlasSize)
+			{
+				bFits = false;
+				break;
+			}
+
+			OutOffsets[Index] = Cursor;
+			Cursor.X += Size.X;
+			ShelfHeight = FMath::Max(ShelfHeight, Size.Y);
+		}
+
+		if (bFits)
+		{
+			OutAtlasSize = AtlasSize;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool FImpostorSharedAtlas::Create(const TArray<UImpostorData*>& ImpostorDatas, const FString& AssetName, FString& OutError)
+{
+	const UImpostorBakerSettings* Settings = GetDefault<UImpostorBakerSettings>();
+
+	if (ImpostorDatas.Num() < 2)
+	{
+		OutError = "At least two impostors are required.";
+		return false;
+	}
+
+	UImpostorData* FirstData = ImpostorDatas[0];
+	UMaterialInstanceConstant* FirstMaterial = FirstData->LoadSavedMaterial();
+
+	// Without MF_ImpostorSharedAtlas in parent material, all impostors would sample the whole shared atlas
+	if (FirstMaterial &&
+		(!ImpostorSharedAtlas::HasVectorParameter(FirstMaterial, ImpostorSharedAtlas::ScaleOffsetParameter) ||
+		!ImpostorSharedAtlas::HasVectorParameter(FirstMaterial, ImpostorSharedAtlas::PivotSizeParameter)))
+	{
+		OutError = FString::Printf(TEXT("%s doesn't read %s and %s parameters from custom primitive data, use MF_ImpostorSharedAtlas function in it first."),
+			*GetNameSafe(FirstMaterial->Parent),
+			ImpostorSharedAtlas::ScaleOffsetParameter,
+			ImpostorSharedAtlas::PivotSizeParameter);
+		return false;
+	}
+
+	// Shared material has to compute frames the same way for all impostors
+	for (const UImpostorData* ImpostorData : ImpostorDatas)
+	{
+		if (ImpostorData->ImpostorType == EImpostorLayoutType::TraditionalBillboards)
+		{
+			OutError = ImpostorData->GetName() + ": traditional billboards can't be packed, (hemi)octahedral impostors are required.";
+			return false;
+		}
+
+		if (!ImpostorData->LoadSavedMaterial() ||
+			!ImpostorData->LoadSavedTexture(EImpostorBakeMapType::BaseColor))
+		{
+			OutError = ImpostorData->GetName() + ": impostor has to be saved first.";
+			return false;
+		}
+
+		if (ImpostorData->ImpostorType != FirstData->ImpostorType ||
+			ImpostorData->FramesCount != FirstData->FramesCount ||
+			ImpostorData->ViewDistribution != FirstData->ViewDistribution ||
+			ImpostorData->FrameAlignment != FirstData->FrameAlignment ||
+			ImpostorData->GetFrameOrder() != FirstData->GetFrameOrder() ||
+			ImpostorData->CombinesNormalAndDepth() != FirstData->CombinesNormalAndDepth() ||
+			ImpostorData->NormalEncoding != FirstData->NormalEncoding ||
+			ImpostorData->GetMaterial() != FirstData->GetMaterial())
+		{
+			OutError = ImpostorData->GetName() + ": layout, frames count, view distribution, frame alignment, frame order or material differs from " + FirstData->GetName() + ".";
+			return false;
+		}
+
+		// Aligned atlases of different resolution cover different part of their texture
+		float FrameUVScale = 1.f;
+		float FirstFrameUVScale = 1.f;
+		ImpostorData->LoadSavedMaterial()->GetScalarParameterValue(FHashedMaterialParameterInfo(Settings->ImpostorPreviewFrameUVScale), FrameUVScale);
+		FirstMaterial->GetScalarParameterValue(FHashedMaterialParameterInfo(Settings->ImpostorPreviewFrameUVScale), FirstFrameUVScale);
+		if (!FMath::IsNearlyEqual(FrameUVScale, FirstFrameUVScale, UE_KINDA_SMALL_NUMBER))
+		{
+			OutError = ImpostorData->GetName() + ": frame UV scale differs from " + FirstData->GetName() + ", save both impostors with the same resolution or without frame alignment.";
+			return false;
+		}
+
+		if (ImpostorData->bSaveFrameArrays ||
+			ImpostorData->bSaveDepthRange)
+		{
+			UE_LOG(LogImpostorBaker, Warning, TEXT("%s: frame arrays and depth range aren't used by shared atlas material"), *ImpostorData->GetName());
+		}
+	}
+
+	// Rectangles are packed at Base Color size
+	TArray<FIntPoint> Sizes;
+	for (const UImpostorData* ImpostorData : ImpostorDatas)
+	{
+		const UTexture2D* BaseColor = ImpostorData->LoadSavedTexture(EImpostorBakeMapType::BaseColor);
+		Sizes.Add(FIntPoint(BaseColor->Source.GetSizeX(), BaseColor->Source.GetSizeY()));
+	}
+
+	// Maps saved for the first impostor. Every map keeps its resolution divisor, so rectangles are scaled down with it.
+	TMap<EImpostorBakeMapType, int32> Divisors;
+	for (const auto& [ImpostorBakeMapType, MapName] : Settings->ImpostorPreviewMapNames)
+	{
+		const UTexture2D* FirstTexture = FirstData->LoadSavedTexture(ImpostorBakeMapType);
+		if (!FirstTexture)
+		{
+			continue;
+		}
+
+		const int32 Divisor = FMath::Max(1, Sizes[0].X / FMath::Max(1, FirstTexture->Source.GetSizeX()));
+		for (int32 Index = 0; Index < ImpostorDatas.Num(); Index++)
+		{
+			const UTexture2D* Texture = ImpostorDatas[Index]->LoadSavedTexture(ImpostorBakeMapType);
+			if (Texture &&
+				FIntPoint(Texture->Source.GetSizeX(), Texture->Source.GetSizeY()) * Divisor != Sizes[Index])
+			{
+				OutError = ImpostorDatas[Index]->GetName() + ": " + MapName.ToString() + " resolution divisor differs from " + FirstData->GetName() + ".";
+				return false;
+			}
+		}
+
+		Divisors.Add(ImpostorBakeMapType, Divisor);
+	}
+
+	int32 AtlasSize = 0;
+	TArray<FIntPoint> Offsets;
+	if (!Pack(Sizes, ImpostorSharedAtlas::MaxAtlasSize, AtlasSize, Offsets))
+	{
+		OutError = FString::Printf(TEXT("Impostor atlases don't fit into %d x %d texture."), ImpostorSharedAtlas::MaxAtlasSize, ImpostorSharedAtlas::MaxAtlasSize);
+		return false;
+	}
+
+	TMap<EImpostorBakeMapType, UTexture2D*> Textures;
+	for (const auto& [TargetMap, Divisor] : Divisors)
+	{
+		const FString MapName = Settings->ImpostorPreviewMapNames[TargetMap].ToString();
+
+		// Sizes and offsets are multiples of divisor, atlases are packed from power of two rectangles
+		FImpostorImage Atlas;
+		Atlas.Init(AtlasSize / Divisor, AtlasSize / Divisor);
+
+		for (int32 Index = 0; Index < ImpostorDatas.Num(); Index++)
+		{
+			FImpostorImage Image;
+			if (!Image.ReadFromTextureSource(ImpostorDatas[Index]->LoadSavedTexture(TargetMap)))
+			{
+				UE_LOG(LogImpostorBaker, Warning, TEXT("%s: %s texture is missing, its shared atlas area is left empty"), *ImpostorDatas[Index]->GetName(), *MapName);
+				continue;
+			}
+
+			Image.CopyTo(Atlas, Offsets[Index] / Divisor);
+		}
+
+		UTexture2D* Texture = ImpostorSharedAtlas::SaveTexture(Atlas, *FirstData, "T_" + AssetName + "_" + MapName, FirstData->LoadSavedTexture(TargetMap));
+		if (Texture)
+		{
+			Textures.Add(TargetMap, Texture);
+		}
+	}
+
+	UMaterialInstanceConstant* Material = ImpostorSharedAtlas::SaveMaterial(*FirstData, "MI_" + AssetName, FirstMaterial, Textures);
+	if (!Material)
+	{
+		OutError = "Shared material wasn't created.";
+		return false;
+	}
+
+	SavePrimitiveDataFunction(*FirstData);
+
+	for (int32 Index = 0; Index < ImpostorDatas.Num(); Index++)
+	{
+		UImpostorData* ImpostorData = ImpostorDatas[Index];
+		const UMaterialInstanceConstant* ImpostorMaterial = ImpostorData->LoadSavedMaterial();
+
+		float MeshSize = 0.f;
+		FLinearColor PivotOffset = FLinearColor::Transparent;
+		ImpostorMaterial->GetScalarParameterValue(FHashedMaterialParameterInfo(Settings->ImpostorPreviewMeshRadius), MeshSize);
+		ImpostorMaterial->GetVectorParameterValue(FHashedMaterialParameterInfo(Settings->ImpostorPreviewPivotOffset), PivotOffset);
+
+		const FVector2f Scale = FVector2f(Sizes[Index]) / AtlasSize;
+		const FVector2f Offset = FVector2f(Offsets[Index]) / AtlasSize;
+
+		ImpostorData->Modify();
+		ImpostorData->SharedAtlasMaterial = Material;
+		ImpostorData->SharedAtlasPrimitiveData = { Scale.X, Scale.Y, Offset.X, Offset.Y, PivotOffset.R, PivotOffset.G, PivotOffset.B, MeshSize };
+		ImpostorData->MarkPackageDirty();
+
+		// Saved impostor mesh and impostor LOD of referenced mesh draw with shared material
+		TArray<UStaticMesh*> Meshes;
+		for (UStaticMesh* Mesh : { ImpostorData->LoadSavedMesh(), ImpostorData->ReferencedMesh.Get() })
+		{
+			if (Mesh &&
+				ImpostorSharedAtlas::ApplyMaterial(Mesh, ImpostorMaterial, Material))
+			{
+				Meshes.Add(Mesh);
+			}
+		}
+
+		const int32 NumComponents = ImpostorSharedAtlas::ApplyPrimitiveData(Meshes, ImpostorData->SharedAtlasPrimitiveData);
+
+		UE_LOG(LogImpostorBaker, Log, TEXT("%s: shared atlas rect %d x %d at %d, %d, %d meshes and %d level components updated, custom primitive data from %d: %s"),
+			*ImpostorData->GetName(),
+			Sizes[Index].X,
+			Sizes[Index].Y,
+			Offsets[Index].X,
+			Offsets[Index].Y,
+			Meshes.Num(),
+			NumComponents,
+			Settings->SharedAtlasPrimitiveDataIndex,
+			*FString::JoinBy(ImpostorData->SharedAtlasPrimitiveData, TEXT(", "), [](const float Value) { return FString::SanitizeFloat(Value); }));
+	}
+
+	const TArray<UObject*> ObjectsToSync{ Material };
+	GEditor->SyncBrowserToObjects(ObjectsToSync);
+
+	return true;
+}
+
+UMaterialFunction* FImpostorSharedAtlas::SavePrimitiveDataFunction(const UImpostorData& ImpostorData)
+{
+	const int32 PrimitiveDataIndex = GetDefault<UImpostorBakerSettings>()->SharedAtlasPrimitiveDataIndex;
+
+	// Index is baked into parameters, so every index gets its own function
+	FImpostorMaterialFunction Function;
+	Function.AssetName = FString::Printf(TEXT("MF_ImpostorSharedAtlas_%d"), PrimitiveDataIndex);
+	Function.Description = "Impostor parameters read from custom primitive data, for materials of impostors packed into shared atlas by Impostor Baker. Frame UVs of impostor own atlas are remapped into its shared atlas rectangle, pivot offset and mesh size replace material parameters.";
+	Function.Inputs = {
+		{ "UV", FunctionInput_Vector2, "Texture coordinates in impostor own atlas" },
+		{ ImpostorSharedAtlas::ScaleOffsetParameter, FunctionInput_Vector4, "Atlas UV scale and offset", PrimitiveDataIndex },
+		{ ImpostorSharedAtlas::PivotSizeParameter, FunctionInput_Vector4, "Pivot offset and mesh size", PrimitiveDataIndex + 4 }
+	};
+	Function.Outputs = {
+		{ "UV", CMOT_Float2, "Texture coordinates in shared atlas" },
+		{ "PivotOffset", CMOT_Float3, "Replaces Pivot Offset parameter" },
+		{ "MeshSize", CMOT_Float1, "Replaces Mesh Size parameter" }
+	};
+	Function.Code =
+		"PivotOffset = SharedAtlasPivotSize.xyz;\n"
+		"MeshSize = SharedAtlasPivotSize.w;\n"
+		"return UV * SharedAtlasScaleOffset.xy + SharedAtlasScaleOffset.zw;";
+
+	return Function.Save(ImpostorData);
+}
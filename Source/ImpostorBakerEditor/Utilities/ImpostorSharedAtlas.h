@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UImpostorData;
+class UMaterialFunction;
+
+// Packs saved atlases of several impostors into one set of textures with one material instance, so they can share draw state.
+// Every impostor keeps its own frame grid. Its atlas rectangle, pivot offset and mesh size are read from custom primitive data
+// by MF_ImpostorSharedAtlas function, which has to be used by the impostor parent material.
+// Saved meshes are switched to the shared material and components of editor levels using them get the custom primitive data.
+class FImpostorSharedAtlas
+{
+public:
+	// Shelf packing into the smallest square power of two atlas, rectangles are placed from the tallest.
+	// Power of two squares (impostor atlases) land on offsets aligned to their size, so mips of neighbors never blend.
+	static bool Pack(const TArray<FIntPoint>& Sizes, int32 MaxSize, int32& OutAtlasSize, TArray<FIntPoint>& OutOffsets);
+
+	// Textures and material instance are saved next to the first impostor, with AssetName suffix.
+	// Impostors must be saved with the same layout, frames count, view distribution, frame alignment, frame UV scale, frame order, map resolution divisors and material.
+	// Shared material samples atlases only, frame arrays and depth range are turned off in it.
+	static bool Create(const TArray<UImpostorData*>& ImpostorDatas, const FString& AssetName, FString& OutError);
+
+	static UMaterialFunction* SavePrimitiveDataFunction(const UImpostorData& ImpostorData);
+
+	// Atlas UV scale and offset, pivot offset and mesh size
+	static constexpr int32 NumPrimitiveData = 8;
+};
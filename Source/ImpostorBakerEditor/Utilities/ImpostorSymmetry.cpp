@@ -0,0 +1,353 @@
+﻿#include "ImpostorSymmetry.h"
+#include <Async/ParallelFor.h>
+#include "ImpostorImage.h"
+#include "ImpostorMeshGeometry.h"
+#include "ImpostorRasterizer.h"
+
+FImpostorSymmetryTransform FImpostorSymmetryTransform::MakeRotation(const float Angle)
+{
+	float Sin, Cos;
+	FMath::SinCos(&Sin, &Cos, Angle);
+
+	FImpostorSymmetryTransform Result;
+	Result.M[0][0] = Cos;
+	Result.M[0][1] = -Sin;
+	Result.M[1][0] = Sin;
+	Result.M[1][1] = Cos;
+	return Result;
+}
+
+FImpostorSymmetryTransform FImpostorSymmetryTransform::MakeMirror(const float PlaneAngle)
+{
+	float Sin, Cos;
+	FMath::SinCos(&Sin, &Cos, PlaneAngle * 2.f);
+
+	FImpostorSymmetryTransform Result;
+	Result.M[0][0] = Cos;
+	Result.M[0][1] = Sin;
+	Result.M[1][0] = Sin;
+	Result.M[1][1] = -Cos;
+	return Result;
+}
+
+bool FImpostorSymmetryTransform::Equals(const FImpostorSymmetryTransform& Other, const float Tolerance) const
+{
+	return
+		FMath::IsNearlyEqual(M[0][0], Other.M[0][0], Tolerance) &&
+		FMath::IsNearlyEqual(M[0][1], Other.M[0][1], Tolerance) &&
+		FMath::IsNearlyEqual(M[1][0], Other.M[1][0], Tolerance) &&
+		FMath::IsNearlyEqual(M[1][1], Other.M[1][1], Tolerance);
+}
+
+TArray<FImpostorSymmetryTransform> FImpostorViewSymmetry::FindSymmetries(const FImpostorMeshGeometry& Geometry, const FVector3f& Origin, float Tolerance)
+{
+	TArray<FImpostorSymmetryTransform> Result;
+
+	const int32 NumVertices = Geometry.GetNumVertices();
+	if (NumVertices == 0)
+	{
+		return Result;
+	}
+
+	Tolerance = FMath::Max(Tolerance, UE_KINDA_SMALL_NUMBER);
+
+	// Rotations by 1/N of full circle and mirror planes at 1/N of half circle, up to 16-fold symmetry
+	TArray<FImpostorSymmetryTransform> Candidates;
+	const auto AddCandidate = [&Candidates](const FImpostorSymmetryTransform& Candidate)
+	{
+		if (!Candidate.Equals(FImpostorSymmetryTransform()) &&
+			!Candidates.ContainsByPredicate([&](const FImpostorSymmetryTransform& Other) { return Other.Equals(Candidate, 1.e-4f); }))
+		{
+			Candidates.Add(Candidate);
+		}
+	};
+
+	for (int32 Order = 2; Order <= 16; Order++)
+	{
+		for (int32 Step = 0; Step < Order; Step++)
+		{
+			AddCandidate(FImpostorSymmetryTransform::MakeRotation(UE_TWO_PI * Step / Order));
+			AddCandidate(FImpostorSymmetryTransform::MakeMirror(UE_PI * Step / Order));
+		}
+	}
+
+	// Material of every vertex, from sections referencing it
+	TArray<int32> VertexMaterials;
+	VertexMaterials.Init(INDEX_NONE, NumVertices);
+	for (const FImpostorMeshSection& Section : Geometry.Sections)
+	{
+		for (int32 Index = Section.FirstIndex; Index < Section.FirstIndex + Section.NumTriangles * 3; Index++)
+		{
+			VertexMaterials[Geometry.Indices[Index]] = Section.MaterialIndex;
+		}
+	}
+
+	// Spatial hash with cells of tolerance size, matches are searched in neighbouring cells as well
+	const float InvCellSize = 1.f / Tolerance;
+	const auto GetCell = [&](const FVector3f& Position)
+	{
+		return FIntVector(
+			FMath::FloorToInt32(Position.X * InvCellSize),
+			FMath::FloorToInt32(Position.Y * InvCellSize),
+			FMath::FloorToInt32(Position.Z * InvCellSize));
+	};
+
+	TMultiMap<FIntVector, int32> Cells;
+	Cells.Reserve(NumVertices);
+	for (int32 Index = 0; Index < NumVertices; Index++)
+	{
+		Cells.Add(GetCell(Geometry.GetPosition(Index) - Origin), Index);
+	}
+
+	const auto HasMatchingVertex = [&](const int32 VertexIndex, const FImpostorSymmetryTransform& Transform)
+	{
+		const FVector3f Position = Transform.TransformVector(Geometry.GetPosition(VertexIndex) - Origin);
+		const FVector3f Normal = Transform.TransformVector(Geometry.Normals[VertexIndex]);
+		const FIntVector Cell = GetCell(Position);
+
+		TArray<int32, TInlineAllocator<16>> CellVertices;
+		for (int32 Z = -1; Z <= 1; Z++)
+		{
+			for (int32 Y = -1; Y <= 1; Y++)
+			{
+				for (int32 X = -1; X <= 1; X++)
+				{
+					CellVertices.Reset();
+					Cells.MultiFind(Cell + FIntVector(X, Y, Z), CellVertices);
+
+					for (const int32 Candidate : CellVertices)
+					{
+						if (VertexMaterials[Candidate] == VertexMaterials[VertexIndex] &&
+							FVector3f::DistSquared(Geometry.GetPosition(Candidate) - Origin, Position) <= FMath::Square(Tolerance) &&
+							(Geometry.Normals[Candidate] | Normal) > 0.99f &&
+							Geometry.UVs[Candidate].Equals(Geometry.UVs[VertexIndex], 1.e-3f))
+						{
+							return true;
+						}
+					}
+				}
+			}
+		}
+
+		return false;
+	};
+
+	TArray<bool> IsSymmetry;
+	IsSymmetry.SetNumZeroed(Candidates.Num());
+
+	ParallelFor(Candidates.Num(), [&](const int32 CandidateIndex)
+	{
+		for (int32 Index = 0; Index < NumVertices; Index++)
+		{
+			if (!HasMatchingVertex(Index, Candidates[CandidateIndex]))
+			{
+				return;
+			}
+		}
+
+		IsSymmetry[CandidateIndex] = true;
+	});
+
+	for (int32 Index = 0; Index < Candidates.Num(); Index++)
+	{
+		if (IsSymmetry[Index])
+		{
+			Result.Add(Candidates[Index]);
+		}
+	}
+
+	return Result;
+}
+
+FImpostorViewSymmetry FImpostorViewSymmetry::Create(const TArray<FImpostorSymmetryTransform>& Symmetries, const TArray<FImpostorViewProjection>& Views)
+{
+	FImpostorViewSymmetry Result;
+	Result.Frames.SetNum(Views.Num());
+
+	if (Symmetries.Num() == 0)
+	{
+		return Result;
+	}
+
+	const auto RoundAxis = [](const float Value, int8& OutValue)
+	{
+		OutValue = static_cast<int8>(FMath::RoundToInt32(Value));
+		return FMath::IsNearlyEqual(Value, float(OutValue), 1.e-3f);
+	};
+
+	for (int32 SourceIndex = 0; SourceIndex < Views.Num(); SourceIndex++)
+	{
+		if (Result.IsCopy(SourceIndex))
+		{
+			continue;
+		}
+
+		const FImpostorViewProjection& Source = Views[SourceIndex];
+		for (const FImpostorSymmetryTransform& Transform : Symmetries)
+		{
+			const FVector3f AxisX = Transform.TransformVector(Source.AxisX);
+			const FVector3f AxisY = Transform.TransformVector(Source.AxisY);
+			const FVector3f AxisZ = Transform.TransformVector(Source.AxisZ);
+
+			for (int32 Index = SourceIndex + 1; Index < Views.Num(); Index++)
+			{
+				const FImpostorViewProjection& View = Views[Index];
+				if (Result.IsCopy(Index) ||
+					(View.AxisZ | AxisZ) < 1.f - 1.e-4f)
+				{
+					continue;
+				}
+
+				// Frame axes have to map onto each other exactly, which isn't the case around poles
+				FImpostorSymmetricFrame Frame;
+				if (!RoundAxis(AxisX | View.AxisX, Frame.FrameAxes[0][0]) ||
+					!RoundAxis(AxisX | View.AxisY, Frame.FrameAxes[0][1]) ||
+					!RoundAxis(AxisY | View.AxisX, Frame.FrameAxes[1][0]) ||
+					!RoundAxis(AxisY | View.AxisY, Frame.FrameAxes[1][1]) ||
+					FMath::Abs(Frame.FrameAxes[0][0] * Frame.FrameAxes[1][1] - Frame.FrameAxes[0][1] * Frame.FrameAxes[1][0]) != 1)
+				{
+					continue;
+				}
+
+				Frame.SourceIndex = SourceIndex;
+				Frame.Transform = Transform;
+				Result.Frames[Index] = Frame;
+				Result.NumCopies++;
+			}
+		}
+	}
+
+	return Result;
+}
+
+FImpostorViewSymmetry FImpostorViewSymmetry::CreateNearest(const TArray<FImpostorViewProjection>& Views, const TArray<bool>& SourceViews, const TArray<bool>& FilledViews)
+{
+	FImpostorViewSymmetry Result;
+	Result.Frames.SetNum(Views.Num());
+
+	for (int32 Index = 0; Index < Views.Num(); Index++)
+	{
+		if (SourceViews[Index] ||
+			!FilledViews[Index])
+		{
+			continue;
+		}
+
+		float BestDot = -MAX_flt;
+		for (int32 SourceIndex = 0; SourceIndex < Views.Num(); SourceIndex++)
+		{
+			const float Dot = Views[SourceIndex].AxisZ | Views[Index].AxisZ;
+			if (SourceViews[SourceIndex] &&
+				Dot > BestDot)
+			{
+				BestDot = Dot;
+				Result.Frames[Index].SourceIndex = SourceIndex;
+			}
+		}
+
+		if (Result.Frames[Index].SourceIndex != INDEX_NONE)
+		{
+			Result.NumCopies++;
+		}
+	}
+
+	return Result;
+}
+
+void FImpostorViewSymmetry::FillFrames(FImpostorImage& Atlas, const TFunctionRef<FIntRect(int32)> GetFrameRect, const bool bNormalMap) const
+{
+	TArray<int32> CopiedFrames;
+	for (int32 Index = 0; Index < Frames.Num(); Index++)
+	{
+		if (IsCopy(Index))
+		{
+			CopiedFrames.Add(Index);
+		}
+	}
+
+	TArray<FIntRect> FrameRects;
+	FrameRects.SetNum(Frames.Num());
+	for (int32 Index = 0; Index < Frames.Num(); Index++)
+	{
+		FrameRects[Index] = GetFrameRect(Index);
+	}
+
+	// Source frames are never copies, so frames can be filled in place
+	ParallelFor(CopiedFrames.Num(), [&](const int32 Index)
+	{
+		const FImpostorSymmetricFrame& Frame = Frames[CopiedFrames[Index]];
+		CopyFrame(Atlas, FrameRects[Frame.SourceIndex], Atlas, FrameRects[CopiedFrames[Index]], Frame, bNormalMap);
+	});
+}
+
+void FImpostorViewSymmetry::FillCombinedMask(FImpostorImage& Mask) const
+{
+	TArray<FImpostorSymmetricFrame> UniqueFrames;
+	for (const FImpostorSymmetricFrame& Frame : Frames)
+	{
+		if (Frame.SourceIndex != INDEX_NONE &&
+			!UniqueFrames.ContainsByPredicate([&](const FImpostorSymmetricFrame& Other) { return FMemory::Memcmp(Other.FrameAxes, Frame.FrameAxes, sizeof(Frame.FrameAxes)) == 0; }))
+		{
+			UniqueFrames.Add(Frame);
+		}
+	}
+
+	const FImpostorImage Source = Mask;
+	const FIntRect Rect(FIntPoint::ZeroValue, Mask.GetSize());
+
+	FImpostorImage Transformed;
+	Transformed.Init(Mask.SizeX, Mask.SizeY);
+
+	for (const FImpostorSymmetricFrame& Frame : UniqueFrames)
+	{
+		CopyFrame(Source, Rect, Transformed, Rect, Frame, false);
+
+		for (int32 Index = 0; Index < Mask.Pixels.Num(); Index++)
+		{
+			FColor& Pixel = Mask.Pixels[Index];
+			const FColor& Other = Transformed.Pixels[Index];
+			Pixel = FColor(FMath::Max(Pixel.R, Other.R), FMath::Max(Pixel.G, Other.G), FMath::Max(Pixel.B, Other.B), FMath::Max(Pixel.A, Other.A));
+		}
+	}
+}
+
+void FImpostorViewSymmetry::CopyFrame(const FImpostorImage& Source, const FIntRect& SourceRect, FImpostorImage& Dest, const FIntRect& DestRect, const FImpostorSymmetricFrame& Frame, const bool bNormalMap)
+{
+	const FIntPoint Size = DestRect.Size();
+	if (!ensure(Size == SourceRect.Size()))
+	{
+		return;
+	}
+
+	for (int32 Y = 0; Y < Size.Y; Y++)
+	{
+		for (int32 X = 0; X < Size.X; X++)
+		{
+			// Doubled coordinates relative to frame center, so pixel centers stay integer
+			const int32 CenterX = 2 * X + 1 - Size.X;
+			const int32 CenterY = 2 * Y + 1 - Size.Y;
+			const int32 SourceX = (Frame.FrameAxes[0][0] * CenterX + Frame.FrameAxes[0][1] * CenterY + Size.X - 1) / 2;
+			const int32 SourceY = (Frame.FrameAxes[1][0] * CenterX + Frame.FrameAxes[1][1] * CenterY + Size.Y - 1) / 2;
+
+			const FIntPoint SourcePixel = SourceRect.Min + FIntPoint(SourceX, SourceY);
+			const FIntPoint DestPixel = DestRect.Min + FIntPoint(X, Y);
+			if (SourcePixel.X < 0 || SourcePixel.Y < 0 || SourcePixel.X >= Source.SizeX || SourcePixel.Y >= Source.SizeY ||
+				DestPixel.X < 0 || DestPixel.Y < 0 || DestPixel.X >= Dest.SizeX || DestPixel.Y >= Dest.SizeY)
+			{
+				continue;
+			}
+
+			FColor Pixel = Source.GetPixel(SourcePixel.X, SourcePixel.Y);
+			if (bNormalMap)
+			{
+				const FVector3f Normal = Frame.Transform.TransformVector(FVector3f(Pixel.R, Pixel.G, Pixel.B) / 127.5f - 1.f);
+				const FVector3f Encoded = (Normal * 0.5f + 0.5f) * 255.f;
+				Pixel.R = FMath::Clamp(FMath::RoundToInt32(Encoded.X), 0, 255);
+				Pixel.G = FMath::Clamp(FMath::RoundToInt32(Encoded.Y), 0, 255);
+				Pixel.B = FMath::Clamp(FMath::RoundToInt32(Encoded.Z), 0, 255);
+			}
+
+			Dest.GetPixel(DestPixel.X, DestPixel.Y) = Pixel;
+		}
+	}
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+struct FImpostorImage;
+struct FImpostorMeshGeometry;
+struct FImpostorViewProjection;
+
+// Orthogonal transform of horizontal plane (rotation around vertical axis or vertical mirror plane), vertical axis is kept
+struct FImpostorSymmetryTransform
+{
+public:
+	static FImpostorSymmetryTransform MakeRotation(float Angle);
+	static FImpostorSymmetryTransform MakeMirror(float PlaneAngle);
+
+	FVector3f TransformVector(const FVector3f& Vector) const
+	{
+		return FVector3f(M[0][0] * Vector.X + M[0][1] * Vector.Y, M[1][0] * Vector.X + M[1][1] * Vector.Y, Vector.Z);
+	}
+
+	bool Equals(const FImpostorSymmetryTransform& Other, float Tolerance = UE_KINDA_SMALL_NUMBER) const;
+
+public:
+	float M[2][2] = {{1.f, 0.f}, {0.f, 1.f}};
+};
+
+// Frame copied from another (source) frame. Frame space coordinates, relative to frame center, are mapped with signed permutation matrix.
+struct FImpostorSymmetricFrame
+{
+	int32 SourceIndex = INDEX_NONE;
+	FImpostorSymmetryTransform Transform;
+	// Source pixel = FrameAxes * destination pixel
+	int8 FrameAxes[2][2] = {{1, 0}, {0, 1}};
+};
+
+// Capture views which are symmetric copies of other views, so only unique views have to be captured
+struct FImpostorViewSymmetry
+{
+public:
+	// Finds transforms, which map mesh onto itself around Origin: every vertex has a matching vertex (position, normal, UV and material) after the transform
+	static TArray<FImpostorSymmetryTransform> FindSymmetries(const FImpostorMeshGeometry& Geometry, const FVector3f& Origin, float Tolerance);
+
+	// Views, whose direction and frame axes map onto an earlier view by any of symmetries, are marked as copies
+	static FImpostorViewSymmetry Create(const TArray<FImpostorSymmetryTransform>& Symmetries, const TArray<FImpostorViewProjection>& Views);
+
+	// Approximate copies for previews: views, which are filled, are copied as they are from the nearest source view
+	static FImpostorViewSymmetry CreateNearest(const TArray<FImpostorViewProjection>& Views, const TArray<bool>& SourceViews, const TArray<bool>& FilledViews);
+
+	bool HasCopies() const
+	{
+		return NumCopies > 0;
+	}
+
+	int32 GetNumCopies() const
+	{
+		return NumCopies;
+	}
+
+	bool IsCopy(const int32 ViewIndex) const
+	{
+		return Frames.IsValidIndex(ViewIndex) && Frames[ViewIndex].SourceIndex != INDEX_NONE;
+	}
+
+	const FImpostorSymmetricFrame& GetFrame(const int32 ViewIndex) const
+	{
+		return Frames[ViewIndex];
+	}
+
+	// Fills every copied frame of the atlas from its source frame. Normals (encoded as N * 0.5 + 0.5) are transformed as well.
+	void FillFrames(FImpostorImage& Atlas, TFunctionRef<FIntRect(int32)> GetFrameRect, bool bNormalMap) const;
+
+	// Adds every frame transform of the mask to itself (for masks combined over all views)
+	void FillCombinedMask(FImpostorImage& Mask) const;
+
+	static void CopyFrame(const FImpostorImage& Source, const FIntRect& SourceRect, FImpostorImage& Dest, const FIntRect& DestRect, const FImpostorSymmetricFrame& Frame, bool bNormalMap);
+
+private:
+	TArray<FImpostorSymmetricFrame> Frames;
+	int32 NumCopies = 0;
+};
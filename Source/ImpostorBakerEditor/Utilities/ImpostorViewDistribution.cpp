@@ -0,0 +1,423 @@
+﻿#include "ImpostorViewDistribution.h"
+#include <Async/ParallelFor.h>
+#include "ImpostorBakerUtilities.h"
+#include "ImpostorImage.h"
+#include "ImpostorOctahedralMath.h"
+#include "ImpostorData/ImpostorData.h"
+
+namespace ImpostorViewDistribution
+{
+	FVector3f LookupToUnitVector(const int32 X, const int32 Y, const int32 Size, const bool bHemisphere)
+	{
+		const FVector2f Octahedron = FVector2f((X + 0.5f) / Size, (Y + 0.5f) / Size) * 2.f - 1.f;
+		return bHemisphere ? FImpostorOctahedralMath::HemiOctahedronToUnitVector(Octahedron) : FImpostorOctahedralMath::OctahedronToUnitVector(Octahedron);
+	}
+
+	uint64 MakeEdgeKey(const int32 A, const int32 B)
+	{
+		return (uint64(uint32(A)) << 32) | uint32(B);
+	}
+}
+
+TArray<FVector> FImpostorViewDistribution::MakeGridVectors(const int32 FramesCount, const EImpostorLayoutType Type)
+{
+	TArray<FVector> Vectors;
+	Vectors.SetNumUninitialized(FramesCount * FramesCount);
+
+	for (int32 Y = 0; Y < FramesCount; Y++)
+	{
+		for (int32 X = 0; X < FramesCount; X++)
+		{
+			Vectors[Y * FramesCount + X] = FImpostorBakerUtilities::GetGridVector(X, Y, FramesCount, Type);
+		}
+	}
+
+	return Vectors;
+}
+
+TArray<FVector> FImpostorViewDistribution::MakeViewVectors(const UImpostorData& ImpostorData)
+{
+	if (ImpostorData.ViewDistribution == EImpostorViewDistribution::OctahedralGrid)
+	{
+		return MakeGridVectors(ImpostorData.FramesCount, ImpostorData.ImpostorType);
+	}
+
+	// Same frames count, so atlas layout is kept, only views are placed differently
+	return MakeFibonacciVectors(ImpostorData.FramesCount * ImpostorData.FramesCount, ImpostorData.ImpostorType == EImpostorLayoutType::UpperHemisphereOnly);
+}
+
+FImpostorViewDistribution FImpostorViewDistribution::Create(const UImpostorData& ImpostorData, const TArray<FVector>& ViewVectors)
+{
+	const bool bHemisphere = ImpostorData.ImpostorType == EImpostorLayoutType::UpperHemisphereOnly;
+
+	FImpostorViewDistribution Distribution;
+	if (ImpostorData.ViewDistribution == EImpostorViewDistribution::OctahedralGrid)
+	{
+		Distribution.BuildGrid(ImpostorData.FramesCount, bHemisphere);
+	}
+	else
+	{
+		Distribution.Build(ViewVectors, bHemisphere);
+	}
+
+	return Distribution;
+}
+
+TArray<FVector> FImpostorViewDistribution::MakeFibonacciVectors(const int32 NumViews, const bool bHemisphere)
+{
+	const double GoldenAngle = UE_DOUBLE_PI * (3.0 - FMath::Sqrt(5.0));
+
+	TArray<FVector> Vectors;
+	Vectors.SetNumUninitialized(NumViews);
+	for (int32 Index = 0; Index < NumViews; Index++)
+	{
+		// Equal area bands, so views are spaced evenly
+		const double T = (Index + 0.5) / NumViews;
+		const double Z = bHemisphere ? 1.0 - T : 1.0 - 2.0 * T;
+		const double Radius = FMath::Sqrt(FMath::Max(0.0, 1.0 - Z * Z));
+		const double Angle = GoldenAngle * Index;
+
+		Vectors[Index] = FVector(FMath::Cos(Angle) * Radius, FMath::Sin(Angle) * Radius, Z);
+	}
+
+	return Vectors;
+}
+
+float FImpostorViewDistribution::GetMaxAngularError(const TArray<FVector>& Vectors, const bool bHemisphere, const int32 SampleSize)
+{
+	if (Vectors.Num() == 0)
+	{
+		return 180.f;
+	}
+
+	// Sampled directions at texel centers
+	FImpostorOctahedronBatch Octahedrons;
+	Octahedrons.SetNum(SampleSize * SampleSize);
+	for (int32 Y = 0; Y < SampleSize; Y++)
+	{
+		for (int32 X = 0; X < SampleSize; X++)
+		{
+			Octahedrons.Set(Y * SampleSize + X, FVector2f((X + 0.5f) / SampleSize, (Y + 0.5f) / SampleSize) * 2.f - 1.f);
+		}
+	}
+
+	FImpostorVectorBatch Directions;
+	if (bHemisphere)
+	{
+		FImpostorOctahedralMath::HemiOctahedronToUnitVector(Octahedrons, Directions);
+	}
+	else
+	{
+		FImpostorOctahedralMath::OctahedronToUnitVector(Octahedrons, Directions);
+	}
+
+	TArray<FVector3f> Views;
+	for (const FVector& Vector : Vectors)
+	{
+		Views.Add(FVector3f(Vector));
+	}
+
+	TArray<float> RowMinDots;
+	RowMinDots.SetNumUninitialized(SampleSize);
+
+	ParallelFor(SampleSize, [&](const int32 Y)
+	{
+		float MinDot = 1.f;
+		for (int32 X = 0; X < SampleSize; X++)
+		{
+			const FVector3f Direction = Directions.Get(Y * SampleSize + X);
+
+			float MaxDot = -1.f;
+			for (const FVector3f& View : Views)
+			{
+				MaxDot = FMath::Max(MaxDot, Direction.Dot(View));
+			}
+			MinDot = FMath::Min(MinDot, MaxDot);
+		}
+		RowMinDots[Y] = MinDot;
+	});
+
+	return FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(FMath::Min(RowMinDots), -1.f, 1.f)));
+}
+
+void FImpostorViewDistribution::Build(const TArray<FVector>& Vectors, const bool bInHemisphere)
+{
+	bHemisphere = bInHemisphere;
+	GridSize = 0;
+	Points.Reset();
+	PointViews.Reset();
+	Triangles.Reset();
+
+	for (int32 Index = 0; Index < Vectors.Num(); Index++)
+	{
+		Points.Add(FVector3f(Vectors[Index].GetSafeNormal()));
+		PointViews.Add(Index);
+	}
+
+	if (bHemisphere)
+	{
+		for (int32 Index = 0; Index < Vectors.Num(); Index++)
+		{
+			// Views on horizon are their own mirrors
+			if (Points[Index].Z > UE_KINDA_SMALL_NUMBER)
+			{
+				Points.Add(Points[Index] * FVector3f(1.f, 1.f, -1.f));
+				PointViews.Add(Index);
+			}
+		}
+	}
+
+	if (Points.Num() < 4)
+	{
+		return;
+	}
+
+	// Incremental convex hull, points are on unit sphere, so every point is on the hull
+	const auto GetNormal = [&](const FIntVector& Triangle)
+	{
+		return FVector(Points[Triangle.Y] - Points[Triangle.X]).Cross(FVector(Points[Triangle.Z] - Points[Triangle.X]));
+	};
+
+	const auto IsVisible = [&](const FIntVector& Triangle, const int32 PointIndex)
+	{
+		return GetNormal(Triangle).Dot(FVector(Points[PointIndex] - Points[Triangle.X])) > UE_DOUBLE_SMALL_NUMBER;
+	};
+
+	// Initial tetrahedron
+	int32 Tetrahedron[4] = { 0, INDEX_NONE, INDEX_NONE, INDEX_NONE };
+	{
+		double MaxDistance = 0.0;
+		for (int32 Index = 1; Index < Points.Num(); Index++)
+		{
+			const double Distance = FVector(Points[Index] - Points[0]).SizeSquared();
+			if (Distance > MaxDistance)
+			{
+				MaxDistance = Distance;
+				Tetrahedron[1] = Index;
+			}
+		}
+
+		if (Tetrahedron[1] == INDEX_NONE)
+		{
+			return;
+		}
+
+		double MaxArea = 0.0;
+		for (int32 Index = 1; Index < Points.Num(); Index++)
+		{
+			const double Area = FVector(Points[Tetrahedron[1]] - Points[0]).Cross(FVector(Points[Index] - Points[0])).SizeSquared();
+			if (Area > MaxArea)
+			{
+				MaxArea = Area;
+				Tetrahedron[2] = Index;
+			}
+		}
+
+		double MaxVolume = 0.0;
+		for (int32 Index = 1; Index < Points.Num() && Tetrahedron[2] != INDEX_NONE; Index++)
+		{
+			const double Volume = FMath::Abs(GetNormal(FIntVector(0, Tetrahedron[1], Tetrahedron[2])).Dot(FVector(Points[Index] - Points[0])));
+			if (Volume > MaxVolume)
+			{
+				MaxVolume = Volume;
+				Tetrahedron[3] = Index;
+			}
+		}
+
+		if (Tetrahedron[3] == INDEX_NONE)
+		{
+			// Degenerate (coplanar) views
+			return;
+		}
+	}
+
+	TArray<FIntVector> HullTriangles;
+	TArray<FVector> HullNormals;
+	TArray<bool> AliveTriangles;
+	TMap<uint64, int32> EdgeTriangles;
+
+	const auto AddTriangle = [&](const FIntVector& Triangle)
+	{
+		const int32 TriangleIndex = HullTriangles.Add(Triangle);
+		HullNormals.Add(GetNormal(Triangle));
+		AliveTriangles.Add(true);
+		EdgeTriangles.Add(ImpostorViewDistribution::MakeEdgeKey(Triangle.X, Triangle.Y), TriangleIndex);
+		EdgeTriangles.Add(ImpostorViewDistribution::MakeEdgeKey(Triangle.Y, Triangle.Z), TriangleIndex);
+		EdgeTriangles.Add(ImpostorViewDistribution::MakeEdgeKey(Triangle.Z, Triangle.X), TriangleIndex);
+	};
+
+	{
+		const int32 A = Tetrahedron[0];
+		const int32 B = Tetrahedron[1];
+		const int32 C = Tetrahedron[2];
+		const int32 D = Tetrahedron[3];
+
+		// Faces have to point away from the opposite vertex
+		const bool bFlip = IsVisible(FIntVector(A, B, C), D);
+		AddTriangle(bFlip ? FIntVector(A, C, B) : FIntVector(A, B, C));
+		AddTriangle(bFlip ? FIntVector(A, B, D) : FIntVector(A, D, B));
+		AddTriangle(bFlip ? FIntVector(B, C, D) : FIntVector(B, D, C));
+		AddTriangle(bFlip ? FIntVector(C, A, D) : FIntVector(C, D, A));
+	}
+
+	TArray<int32> VisibleTriangles;
+	TArray<TPair<int32, int32>> HorizonEdges;
+	for (int32 PointIndex = 0; PointIndex < Points.Num(); PointIndex++)
+	{
+		if (PointIndex == Tetrahedron[0] ||
+			PointIndex == Tetrahedron[1] ||
+			PointIndex == Tetrahedron[2] ||
+			PointIndex == Tetrahedron[3])
+		{
+			continue;
+		}
+
+		VisibleTriangles.Reset();
+		for (int32 TriangleIndex = 0; TriangleIndex < HullTriangles.Num(); TriangleIndex++)
+		{
+			if (AliveTriangles[TriangleIndex] &&
+				HullNormals[TriangleIndex].Dot(FVector(Points[PointIndex] - Points[HullTriangles[TriangleIndex].X])) > UE_DOUBLE_SMALL_NUMBER)
+			{
+				VisibleTriangles.Add(TriangleIndex);
+			}
+		}
+
+		if (VisibleTriangles.Num() == 0)
+		{
+			// Duplicated view
+			continue;
+		}
+
+		for (const int32 TriangleIndex : VisibleTriangles)
+		{
+			AliveTriangles[TriangleIndex] = false;
+		}
+
+		// Edges of visible region, which are shared with triangles left on the hull
+		HorizonEdges.Reset();
+		for (const int32 TriangleIndex : VisibleTriangles)
+		{
+			const FIntVector& Triangle = HullTriangles[TriangleIndex];
+			const int32 Vertices[3] = { Triangle.X, Triangle.Y, Triangle.Z };
+			for (int32 Edge = 0; Edge < 3; Edge++)
+			{
+				const int32 A = Vertices[Edge];
+				const int32 B = Vertices[(Edge + 1) % 3];
+				EdgeTriangles.Remove(ImpostorViewDistribution::MakeEdgeKey(A, B));
+
+				const int32* Neighbour = EdgeTriangles.Find(ImpostorViewDistribution::MakeEdgeKey(B, A));
+				if (Neighbour && AliveTriangles[*Neighbour])
+				{
+					HorizonEdges.Add({ A, B });
+				}
+			}
+		}
+
+		for (const TPair<int32, int32>& Edge : HorizonEdges)
+		{
+			AddTriangle(FIntVector(Edge.Key, Edge.Value, PointIndex));
+		}
+	}
+
+	for (int32 TriangleIndex = 0; TriangleIndex < HullTriangles.Num(); TriangleIndex++)
+	{
+		if (AliveTriangles[TriangleIndex])
+		{
+			Triangles.Add(HullTriangles[TriangleIndex]);
+		}
+	}
+}
+
+void FImpostorViewDistribution::BuildGrid(const int32 FramesCount, const bool bInHemisphere)
+{
+	bHemisphere = bInHemisphere;
+	GridSize = FMath::Max(1, FramesCount);
+	Points.Reset();
+	PointViews.Reset();
+	Triangles.Reset();
+}
+
+bool FImpostorViewDistribution::FindGridViews(const FVector3f& Direction, FIntVector& OutViews, FVector3f& OutWeights) const
+{
+	const FVector2f Octahedron = bHemisphere ?
+		FImpostorOctahedralMath::UnitVectorToHemiOctahedron(Direction) :
+		FImpostorOctahedralMath::UnitVectorToOctahedron(Direction);
+
+	FImpostorOctahedralMath::GetGridFrames(Octahedron, GridSize, OutViews, OutWeights);
+	return true;
+}
+
+bool FImpostorViewDistribution::FindViews(const FVector3f& Direction, FIntVector& OutViews, FVector3f& OutWeights) const
+{
+	if (GridSize > 0)
+	{
+		return FindGridViews(Direction, OutViews, OutWeights);
+	}
+
+	// Edge planes go through sphere center, so Direction doesn't have to be projected onto triangle
+	constexpr float Tolerance = -1.e-6f;
+
+	for (const FIntVector& Triangle : Triangles)
+	{
+		const FVector3f& A = Points[Triangle.X];
+		const FVector3f& B = Points[Triangle.Y];
+		const FVector3f& C = Points[Triangle.Z];
+
+		const float WeightA = Direction.Dot(B.Cross(C));
+		if (WeightA < Tolerance)
+		{
+			continue;
+		}
+
+		const float WeightB = Direction.Dot(C.Cross(A));
+		if (WeightB < Tolerance)
+		{
+			continue;
+		}
+
+		const float WeightC = Direction.Dot(A.Cross(B));
+		if (WeightC < Tolerance)
+		{
+			continue;
+		}
+
+		const FVector3f Weights = FVector3f(FMath::Max(WeightA, 0.f), FMath::Max(WeightB, 0.f), FMath::Max(WeightC, 0.f));
+		const float Sum = Weights.X + Weights.Y + Weights.Z;
+		if (Sum <= 0.f)
+		{
+			continue;
+		}
+
+		OutViews = FIntVector(PointViews[Triangle.X], PointViews[Triangle.Y], PointViews[Triangle.Z]);
+		OutWeights = Weights / Sum;
+		return true;
+	}
+
+	return false;
+}
+
+void FImpostorViewDistribution::BakeLookup(const int32 Size, TArray<FLinearColor>& OutIndices, FImpostorImage& OutWeights) const
+{
+	OutIndices.SetNumZeroed(Size * Size);
+	OutWeights.Init(Size, Size);
+
+	ParallelFor(Size, [&](const int32 Y)
+	{
+		for (int32 X = 0; X < Size; X++)
+		{
+			const FVector3f Direction = ImpostorViewDistribution::LookupToUnitVector(X, Y, Size, bHemisphere);
+
+			FIntVector Views(0, 0, 0);
+			FVector3f Weights(1.f, 0.f, 0.f);
+			ensure(FindViews(Direction, Views, Weights));
+
+			// Weights are quantized so they sum up to exactly 1
+			const uint8 WeightA = uint8(FMath::RoundToInt(Weights.X * 255.f));
+			const uint8 WeightB = uint8(FMath::Min(FMath::RoundToInt(Weights.Y * 255.f), 255 - WeightA));
+			const uint8 WeightC = uint8(255 - WeightA - WeightB);
+
+			OutIndices[Y * Size + X] = FLinearColor(Views.X, Views.Y, Views.Z, 0.f);
+			OutWeights.GetPixel(X, Y) = FColor(WeightA, WeightB, WeightC, 255);
+		}
+	});
+}
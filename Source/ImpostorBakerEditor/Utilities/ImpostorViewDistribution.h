@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <CoreMinimal.h>
+
+class UImpostorData;
+struct FImpostorImage;
+enum class EImpostorLayoutType;
+
+// Views placed near uniformly on the (hemi)sphere instead of octahedral grid.
+// Views are triangulated, so any direction is blended from 3 views, which are looked up from baked texture.
+struct FImpostorViewDistribution
+{
+public:
+	// Octahedral grid vectors, same as FImpostorBakerUtilities::GetGridVector
+	static TArray<FVector> MakeGridVectors(int32 FramesCount, EImpostorLayoutType Type);
+
+	// Fibonacci spiral, first view is the closest one to the top
+	static TArray<FVector> MakeFibonacciVectors(int32 NumViews, bool bHemisphere);
+
+	// View vectors of (hemi)octahedral impostor layouts, in atlas order
+	static TArray<FVector> MakeViewVectors(const UImpostorData& ImpostorData);
+
+	// Frame lookup of (hemi)octahedral impostor layouts, ViewVectors are from MakeViewVectors
+	static FImpostorViewDistribution Create(const UImpostorData& ImpostorData, const TArray<FVector>& ViewVectors);
+
+	// Max angle in degrees between any direction and its nearest view, directions are sampled with (hemi)octahedral SampleSize x SampleSize grid
+	static float GetMaxAngularError(const TArray<FVector>& Vectors, bool bHemisphere, int32 SampleSize = 128);
+
+	// Spherical Delaunay triangulation of view vectors, which is their convex hull.
+	// Hemisphere views are mirrored below horizon, so horizon directions blend between views above it.
+	void Build(const TArray<FVector>& Vectors, bool bHemisphere);
+
+	// FramesCount x FramesCount (hemi)octahedral grid. Cells are split along their diagonal, same as impostor material triangle interpolation.
+	void BuildGrid(int32 FramesCount, bool bHemisphere);
+
+	bool IsEmpty() const
+	{
+		return GridSize == 0 && Triangles.Num() == 0;
+	}
+
+	// Views of triangle containing Direction and their normalized blend weights
+	bool FindViews(const FVector3f& Direction, FIntVector& OutViews, FVector3f& OutWeights) const;
+
+	// Size x Size lookup in (hemi)octahedral mapping of the grid layout (texel centers, same as GetGridVector with continuous coordinates).
+	// Indices are exact integers in RGB of 32 bit float texels (half floats lose integers above 2048), weights are RGB of 8 bit texels and sum up to 255.
+	void BakeLookup(int32 Size, TArray<FLinearColor>& OutIndices, FImpostorImage& OutWeights) const;
+
+private:
+	bool FindGridViews(const FVector3f& Direction, FIntVector& OutViews, FVector3f& OutWeights) const;
+
+private:
+	bool bHemisphere = false;
+	int32 GridSize = 0;
+	TArray<FVector3f> Points;
+	// View of each point, mirrored points refer to their source views
+	TArray<int32> PointViews;
+	// Counter clockwise, seen from outside
+	TArray<FIntVector> Triangles;
+};